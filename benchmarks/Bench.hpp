@@ -0,0 +1,243 @@
+#pragma once
+
+#include "NetBindings.hpp"
+#include "NetManager.hpp"
+#include "NetStats.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace margelo::nitro::net::bench {
+
+/// Heap allocations made through operator new (C++ bridge code only; the
+/// Rust core uses its own allocator and is not counted). Defined in
+/// bench.cpp, which replaces the global operators.
+struct AllocationCounter {
+  static std::atomic<uint64_t> count;
+  static std::atomic<uint64_t> bytes;
+};
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+  std::string name;
+  uint64_t ops = 0;       // Operations measured
+  double seconds = 0;     // Wall time of the measured phase
+  uint64_t bytes = 0;     // Payload moved, for throughput benchmarks
+  uint64_t allocations = 0;
+  uint64_t allocatedBytes = 0;
+  std::optional<LatencyHistogram::Snapshot> latency;
+  std::string note;
+};
+
+/// Measures wall time and allocations of one benchmark phase.
+class Measurement {
+public:
+  Measurement()
+      : _start(Clock::now()),
+        _allocations(AllocationCounter::count.load()),
+        _allocatedBytes(AllocationCounter::bytes.load()) {}
+
+  Result finish(std::string name, uint64_t ops) const {
+    Result result;
+    result.name = std::move(name);
+    result.ops = ops;
+    result.seconds =
+        std::chrono::duration<double>(Clock::now() - _start).count();
+    result.allocations = AllocationCounter::count.load() - _allocations;
+    result.allocatedBytes = AllocationCounter::bytes.load() - _allocatedBytes;
+    return result;
+  }
+
+private:
+  const Clock::time_point _start;
+  const uint64_t _allocations;
+  const uint64_t _allocatedBytes;
+};
+
+/// Waits on the benchmark thread for state changed by core callbacks.
+class Signal {
+public:
+  template <typename F> void update(F &&change) {
+    {
+      std::lock_guard lock(_mutex);
+      change();
+    }
+    _cv.notify_all();
+  }
+
+  /// Returns false if `ready` did not hold within `timeout`.
+  template <typename P>
+  bool wait(P &&ready,
+            std::chrono::milliseconds timeout = std::chrono::seconds(30)) {
+    std::unique_lock lock(_mutex);
+    return _cv.wait_for(lock, timeout, ready);
+  }
+
+private:
+  std::mutex _mutex;
+  std::condition_variable _cv;
+};
+
+/// A core socket or server whose events go to a std::function, registered
+/// with NetManager the way the drivers register themselves.
+class Endpoint {
+public:
+  using Handler = std::function<void(int type, const uint8_t *, size_t)>;
+
+  Endpoint(uint32_t id, Handler handler)
+      : _id(id), _handler(std::move(handler)) {
+    NetManager::shared().registerHandler(_id, this, onEventThunk);
+  }
+  ~Endpoint() { NetManager::shared().unregisterHandler(_id); }
+
+  Endpoint(const Endpoint &) = delete;
+  Endpoint &operator=(const Endpoint &) = delete;
+
+  uint32_t id() const { return _id; }
+
+private:
+  static void onEventThunk(void *context, int type, const uint8_t *data,
+                           size_t len) {
+    static_cast<Endpoint *>(context)->_handler(type, data, len);
+  }
+
+  const uint32_t _id;
+  const Handler _handler;
+};
+
+[[noreturn]] inline void fail(const std::string &message) {
+  std::fprintf(stderr, "bench: %s\n", message.c_str());
+  std::exit(1);
+}
+
+inline std::string payloadString(const uint8_t *data, size_t len) {
+  return std::string(reinterpret_cast<const char *>(data), len);
+}
+
+/// Listens on an ephemeral port and hands accepted socket IDs to `onAccept`
+/// from inside the CONNECTION dispatch, so the accepted socket's handler is
+/// registered before its first DATA event.
+class Listener {
+public:
+  explicit Listener(std::function<void(uint32_t)> onAccept,
+                    uint32_t secureContext = 0)
+      : _onAccept(std::move(onAccept)),
+        _server(net_create_server(), [this](int type, const uint8_t *data,
+                                            size_t len) {
+          onEvent(type, data, len);
+        }) {
+    if (secureContext != 0) {
+      net_listen_tls(_server.id(), 0, 1024, false, false, secureContext);
+    } else {
+      net_listen(_server.id(), 0, 1024, false, false);
+    }
+    if (!_signal.wait([this] { return _listening || !_error.empty(); }))
+      fail("listen timed out");
+    if (!_error.empty())
+      fail("listen failed: " + _error);
+
+    char buf[128];
+    const size_t len = net_get_server_local_address(_server.id(), buf,
+                                                    sizeof(buf) - 1);
+    const std::string address(buf, len < sizeof(buf) ? len : 0);
+    const size_t colon = address.rfind(':');
+    if (colon == std::string::npos)
+      fail("unexpected server address: " + address);
+    _port = std::atoi(address.c_str() + colon + 1);
+  }
+
+  ~Listener() {
+    net_server_close(_server.id());
+    net_destroy_server(_server.id());
+  }
+
+  int port() const { return _port; }
+
+private:
+  void onEvent(int type, const uint8_t *data, size_t len) {
+    if (type == 6) { // CONNECTION
+      if (len == 7 && std::memcmp(data, "success", 7) == 0) {
+        _signal.update([this] { _listening = true; });
+        return;
+      }
+      _onAccept(static_cast<uint32_t>(
+          std::strtoul(payloadString(data, len).c_str(), nullptr, 10)));
+    } else if (type == 3) { // ERROR
+      _signal.update([&] { _error = payloadString(data, len); });
+    }
+  }
+
+  const std::function<void(uint32_t)> _onAccept;
+  Signal _signal;
+  bool _listening = false;
+  std::string _error;
+  int _port = 0;
+  Endpoint _server; // Last, so it is unregistered first
+};
+
+inline void printResult(const Result &result) {
+  std::printf("%-24s %10llu ops %9.3f s %12.1f ops/s", result.name.c_str(),
+              static_cast<unsigned long long>(result.ops), result.seconds,
+              result.seconds > 0 ? result.ops / result.seconds : 0.0);
+  if (result.bytes > 0) {
+    std::printf(" %9.1f MB/s",
+                result.bytes / result.seconds / (1024.0 * 1024.0));
+  }
+  if (result.ops > 0) {
+    std::printf(" %8.2f allocs/op %10.1f B/op",
+                static_cast<double>(result.allocations) / result.ops,
+                static_cast<double>(result.allocatedBytes) / result.ops);
+  }
+  if (result.latency) {
+    std::printf(" p50 %llu us p99 %llu us",
+                static_cast<unsigned long long>(result.latency->p50),
+                static_cast<unsigned long long>(result.latency->p99));
+  }
+  if (!result.note.empty())
+    std::printf(" (%s)", result.note.c_str());
+  std::printf("\n");
+}
+
+inline void printJson(const std::vector<Result> &results) {
+  std::printf("[\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    const double ops = r.ops > 0 ? static_cast<double>(r.ops) : 1.0;
+    std::printf("  {\"name\": \"%s\", \"ops\": %llu, \"seconds\": %.6f, "
+                "\"opsPerSecond\": %.3f, \"mbPerSecond\": %.3f, "
+                "\"allocsPerOp\": %.4f, \"allocBytesPerOp\": %.2f",
+                r.name.c_str(), static_cast<unsigned long long>(r.ops),
+                r.seconds, r.seconds > 0 ? r.ops / r.seconds : 0.0,
+                r.seconds > 0 && r.bytes > 0
+                    ? r.bytes / r.seconds / (1024.0 * 1024.0)
+                    : 0.0,
+                r.allocations / ops, r.allocatedBytes / ops);
+    if (r.latency) {
+      std::printf(", \"latencyUs\": {\"min\": %llu, \"mean\": %.2f, "
+                  "\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, "
+                  "\"max\": %llu}",
+                  static_cast<unsigned long long>(r.latency->min),
+                  r.latency->mean,
+                  static_cast<unsigned long long>(r.latency->p50),
+                  static_cast<unsigned long long>(r.latency->p90),
+                  static_cast<unsigned long long>(r.latency->p99),
+                  static_cast<unsigned long long>(r.latency->max));
+    }
+    if (!r.note.empty())
+      std::printf(", \"note\": \"%s\"", r.note.c_str());
+    std::printf("}%s\n", i + 1 < results.size() ? "," : "");
+  }
+  std::printf("]\n");
+}
+
+} // namespace margelo::nitro::net::bench
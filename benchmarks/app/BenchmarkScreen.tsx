@@ -0,0 +1,257 @@
+/**
+ * Benchmark screen for an example app: runs the native harness' scenarios
+ * through the JS API over loopback, so the bridge and JS costs show up next
+ * to the native numbers. Native counters (events and ArrayBuffer bytes per
+ * operation, dispatch latency) come from `getRuntimeStats()` deltas.
+ *
+ * Not part of the published package: copy it into an example app and render
+ * `<BenchmarkScreen tlsCert={certPem} tlsKey={keyPem} />`.
+ */
+import React, { useCallback, useState } from 'react';
+import { Button, ScrollView, StyleSheet, Text, View } from 'react-native';
+import { Buffer } from 'react-native-nitro-buffer';
+import { createServer, connect, getRuntimeStats, http, tls } from 'react-native-nitro-net';
+import type { NetRuntimeStats, Socket } from 'react-native-nitro-net';
+
+interface BenchResult {
+    name: string
+    ops: number
+    seconds: number
+    bytes?: number
+    /** Round-trip or handshake latency in ms */
+    latency?: { p50: number; p99: number }
+    eventsPerOp: number
+    bufferBytesPerOp: number
+    /** Native dispatch latency p99 (ms) over the whole runtime */
+    dispatchP99: number
+    note?: string
+}
+
+interface Props {
+    /** PEM certificate and key for the TLS handshake benchmarks */
+    tlsCert?: string
+    tlsKey?: string
+    iterations?: number
+    handshakes?: number
+    transferMiB?: number
+}
+
+const now = () => performance.now();
+
+function percentile(sorted: number[], q: number): number {
+    if (sorted.length === 0) return 0;
+    return sorted[Math.min(sorted.length - 1, Math.ceil(q * sorted.length) - 1)];
+}
+
+function latencyOf(samples: number[]) {
+    const sorted = [...samples].sort((a, b) => a - b);
+    return { p50: percentile(sorted, 0.5), p99: percentile(sorted, 0.99) };
+}
+
+/** Wall time and native counter deltas of one measured phase. */
+function measure(name: string) {
+    const before: NetRuntimeStats = getRuntimeStats();
+    const start = now();
+    return (ops: number, extra: Partial<BenchResult> = {}): BenchResult => {
+        const seconds = (now() - start) / 1000;
+        const after = getRuntimeStats();
+        return {
+            name,
+            ops,
+            seconds,
+            eventsPerOp: (after.eventsDispatched - before.eventsDispatched) / ops,
+            bufferBytesPerOp: (after.bufferBytes - before.bufferBytes) / ops,
+            dispatchP99: after.dispatchLatency.p99,
+            ...extra,
+        };
+    };
+}
+
+function listen(server: { listen: (port: number, cb: () => void) => void; address: () => any }): Promise<number> {
+    return new Promise((resolve) => server.listen(0, () => resolve(server.address().port)));
+}
+
+async function benchEcho(iterations: number): Promise<BenchResult> {
+    const server = createServer((socket: Socket) => socket.on('data', (data: any) => socket.write(data)));
+    const port = await listen(server);
+    const client = connect({ port, host: '127.0.0.1' });
+    await new Promise<void>((resolve) => client.once('connect', () => resolve()));
+    client.setNoDelay(true);
+
+    const payload = Buffer.alloc(64, 'x');
+    const roundTrip = () => new Promise<void>((resolve) => {
+        let received = 0;
+        const onData = (data: any) => {
+            received += data.length;
+            if (received >= payload.length) {
+                client.off('data', onData);
+                resolve();
+            }
+        };
+        client.on('data', onData);
+        client.write(payload);
+    });
+
+    for (let i = 0; i < iterations / 10; i++) await roundTrip();
+    const samples: number[] = [];
+    const done = measure('tcp_echo_rtt');
+    for (let i = 0; i < iterations; i++) {
+        const start = now();
+        await roundTrip();
+        samples.push(now() - start);
+    }
+    const result = done(iterations, { latency: latencyOf(samples) });
+    client.destroy();
+    server.close();
+    return result;
+}
+
+async function benchHttp(requests: number, connections = 4): Promise<BenchResult> {
+    const server = http.createServer((_req, res) => {
+        res.setHeader('Content-Type', 'text/plain');
+        res.end('ok');
+    });
+    const port = await listen(server);
+    const agent = new http.Agent({ keepAlive: true, maxSockets: connections });
+    const get = () => new Promise<void>((resolve, reject) => {
+        http.get({ host: '127.0.0.1', port, path: '/bench', agent }, (res) => {
+            res.on('data', () => { });
+            res.on('end', () => resolve());
+        }).on('error', reject);
+    });
+
+    let issued = 0;
+    const worker = async () => {
+        while (issued++ < requests) await get();
+    };
+    const done = measure('http_keepalive');
+    await Promise.all(Array.from({ length: connections }, worker));
+    const result = done(requests, { note: `${connections} connections` });
+    agent.destroy();
+    server.close();
+    return result;
+}
+
+async function benchTls(cert: string, key: string, handshakes: number, resume: boolean): Promise<BenchResult> {
+    const server = tls.createServer({ cert, key });
+    server.on('secureConnection', (socket: Socket) => socket.on('error', () => { }));
+    const port = await listen(server);
+    // Resumption goes through the context's session cache; a zero-size cache
+    // forces full handshakes.
+    const secureContext = tls.createSecureContext({ sessionCacheSize: resume ? 64 : 0 });
+    const handshake = () => new Promise<boolean>((resolve, reject) => {
+        const socket = tls.connect({ port, host: '127.0.0.1', servername: 'localhost', rejectUnauthorized: false, secureContext });
+        socket.once('secureConnect', () => {
+            const reused = socket.isSessionReused();
+            socket.destroy();
+            resolve(reused);
+        });
+        socket.once('error', reject);
+    });
+
+    if (resume) {
+        await handshake();
+        // Let the first session ticket reach the cache.
+        await new Promise((resolve) => setTimeout(resolve, 100));
+    }
+    const samples: number[] = [];
+    let reused = 0;
+    const done = measure(resume ? 'tls_handshake_resumed' : 'tls_handshake_full');
+    for (let i = 0; i < handshakes; i++) {
+        const start = now();
+        if (await handshake()) reused++;
+        samples.push(now() - start);
+    }
+    const result = done(handshakes, { latency: latencyOf(samples), note: `${reused} reused` });
+    server.close();
+    return result;
+}
+
+async function benchThroughput(transferMiB: number): Promise<BenchResult> {
+    const total = transferMiB * 1024 * 1024;
+    let received = 0;
+    let finish: () => void = () => { };
+    const finished = new Promise<void>((resolve) => { finish = resolve; });
+    const server = createServer((socket: Socket) => socket.on('data', (data: any) => {
+        received += data.length;
+        if (received >= total) finish();
+    }));
+    const port = await listen(server);
+    const client = connect({ port, host: '127.0.0.1' });
+    await new Promise<void>((resolve) => client.once('connect', () => resolve()));
+
+    const chunk = Buffer.alloc(64 * 1024, 'x');
+    const chunks = total / chunk.length;
+    const done = measure('tcp_throughput');
+    for (let i = 0; i < chunks; i++) {
+        if (!client.write(chunk)) {
+            await new Promise<void>((resolve) => client.once('drain', () => resolve()));
+        }
+    }
+    await finished;
+    const result = done(chunks, { bytes: total, note: '64 KiB writes' });
+    client.destroy();
+    server.close();
+    return result;
+}
+
+function format(result: BenchResult): string {
+    const lines = [
+        `${result.ops} ops in ${result.seconds.toFixed(3)} s, ${(result.ops / result.seconds).toFixed(1)} ops/s`,
+    ];
+    if (result.bytes) lines.push(`${(result.bytes / result.seconds / (1024 * 1024)).toFixed(1)} MB/s`);
+    if (result.latency) lines.push(`p50 ${result.latency.p50.toFixed(3)} ms, p99 ${result.latency.p99.toFixed(3)} ms`);
+    lines.push(`${result.eventsPerOp.toFixed(2)} events/op, ${result.bufferBytesPerOp.toFixed(0)} buffer B/op`);
+    lines.push(`dispatch p99 ${result.dispatchP99.toFixed(3)} ms`);
+    if (result.note) lines.push(result.note);
+    return lines.join('\n');
+}
+
+export function BenchmarkScreen({ tlsCert, tlsKey, iterations = 2000, handshakes = 100, transferMiB = 64 }: Props) {
+    const [results, setResults] = useState<BenchResult[]>([]);
+    const [running, setRunning] = useState(false);
+    const [error, setError] = useState<string | null>(null);
+
+    const run = useCallback(async () => {
+        setRunning(true);
+        setError(null);
+        setResults([]);
+        const append = (result: BenchResult) => setResults((prev) => [...prev, result]);
+        try {
+            append(await benchEcho(iterations));
+            append(await benchHttp(iterations));
+            if (tlsCert && tlsKey) {
+                append(await benchTls(tlsCert, tlsKey, handshakes, false));
+                append(await benchTls(tlsCert, tlsKey, handshakes, true));
+            }
+            append(await benchThroughput(transferMiB));
+        } catch (e: any) {
+            setError(String(e?.message ?? e));
+        } finally {
+            setRunning(false);
+        }
+    }, [iterations, handshakes, transferMiB, tlsCert, tlsKey]);
+
+    return (
+        <ScrollView contentContainerStyle={styles.container}>
+            <Button title={running ? 'Running…' : 'Run benchmarks'} onPress={run} disabled={running} />
+            {error && <Text style={styles.error}>{error}</Text>}
+            {results.map((result) => (
+                <View key={result.name} style={styles.card}>
+                    <Text style={styles.name}>{result.name}</Text>
+                    <Text style={styles.value}>{format(result)}</Text>
+                </View>
+            ))}
+        </ScrollView>
+    );
+}
+
+const styles = StyleSheet.create({
+    container: { padding: 16 },
+    card: { marginTop: 12, padding: 12, borderRadius: 8, backgroundColor: '#f2f2f2' },
+    name: { fontWeight: '600', marginBottom: 4 },
+    value: { fontFamily: 'Courier', fontSize: 12 },
+    error: { color: '#c00', marginTop: 12 },
+});
+
+export default BenchmarkScreen;
@@ -0,0 +1,494 @@
+// Benchmarks for the native bridge, run against the prebuilt Rust core over
+// loopback. See benchmarks/README.md.
+
+#include "Bench.hpp"
+#include "HttpStreamParser.hpp"
+#include "NetScheduler.hpp"
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <unordered_map>
+
+using namespace margelo::nitro::net;
+using namespace margelo::nitro::net::bench;
+
+std::atomic<uint64_t> AllocationCounter::count{0};
+std::atomic<uint64_t> AllocationCounter::bytes{0};
+
+void *operator new(size_t size) {
+  AllocationCounter::count.fetch_add(1, std::memory_order_relaxed);
+  AllocationCounter::bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+struct Options {
+  uint64_t iterations = 20000; // Echo round trips, HTTP requests
+  uint64_t handshakes = 500;
+  uint64_t transferMiB = 512;
+  size_t echoSize = 64;
+  size_t connections = 4; // HTTP keep-alive connections
+  std::string certFile, keyFile;
+  std::string only; // Run a single benchmark
+  bool json = false;
+};
+
+constexpr const char *kLoopback = "127.0.0.1";
+
+/// A client socket connected to `port` (TLS when `tls` is set).
+class Client {
+public:
+  using Handler = Endpoint::Handler;
+
+  Client(int port, Handler onData, bool tls = false,
+         const std::vector<uint8_t> *ticket = nullptr)
+      : _onData(std::move(onData)),
+        _socket(net_create_socket(),
+                [this](int type, const uint8_t *data, size_t len) {
+                  onEvent(type, data, len);
+                }) {
+    if (tls) {
+      if (ticket && !ticket->empty())
+        net_set_session(_socket.id(), ticket->data(), ticket->size());
+      net_connect_tls(_socket.id(), kLoopback, port, "localhost", 0);
+    } else {
+      net_connect(_socket.id(), kLoopback, port);
+    }
+  }
+
+  ~Client() { net_destroy_socket(_socket.id()); }
+
+  uint32_t id() const { return _socket.id(); }
+
+  /// Waits for CONNECT; false if the socket failed or closed first.
+  bool waitConnected() {
+    _signal.wait([this] { return _connected || _failed; });
+    return _connected;
+  }
+
+  /// Waits for the first session ticket, when the server sends one.
+  std::vector<uint8_t> waitTicket(std::chrono::milliseconds timeout) {
+    _signal.wait([this] { return !_ticket.empty(); }, timeout);
+    std::lock_guard lock(_ticketMutex);
+    return _ticket;
+  }
+
+private:
+  void onEvent(int type, const uint8_t *data, size_t len) {
+    switch (type) {
+    case 1: // CONNECT
+      _signal.update([this] { _connected = true; });
+      break;
+    case 2: // DATA
+      if (_onData)
+        _onData(type, data, len);
+      break;
+    case 3: // ERROR
+    case 4: // CLOSE
+      _signal.update([this] { _failed = true; });
+      break;
+    case 9: // SESSION
+      _signal.update([&] {
+        std::lock_guard lock(_ticketMutex);
+        if (_ticket.empty())
+          _ticket.assign(data, data + len);
+      });
+      break;
+    default:
+      break;
+    }
+  }
+
+  const Handler _onData;
+  Signal _signal;
+  bool _connected = false;
+  bool _failed = false;
+  std::mutex _ticketMutex;
+  std::vector<uint8_t> _ticket;
+  Endpoint _socket; // Last, so it is unregistered first
+};
+
+/// Accepted sockets with a per-connection handler. Sockets are destroyed
+/// off the core's callback thread once they close; their endpoints are kept
+/// until the benchmark ends so no handler can outlive its state.
+class Accepted {
+public:
+  using Factory = std::function<Endpoint::Handler(uint32_t id)>;
+
+  explicit Accepted(Factory factory) : _factory(std::move(factory)) {}
+
+  ~Accepted() {
+    std::unordered_map<uint32_t, std::unique_ptr<Endpoint>> open;
+    std::vector<std::unique_ptr<Endpoint>> closed;
+    {
+      std::lock_guard lock(_mutex);
+      open.swap(_open);
+      closed.swap(_closed);
+    }
+    // Unregistering waits for running handlers, which may take _mutex.
+    for (auto &[id, endpoint] : open) {
+      endpoint.reset();
+      net_destroy_socket(id);
+    }
+  }
+
+  void accept(uint32_t id) {
+    auto handler = _factory(id);
+    std::lock_guard lock(_mutex);
+    _open[id] = std::make_unique<Endpoint>(
+        id, [this, id, handler](int type, const uint8_t *data, size_t len) {
+          if (type == 3 || type == 4) { // ERROR, CLOSE
+            closed(id);
+            return;
+          }
+          handler(type, data, len);
+        });
+  }
+
+private:
+  void closed(uint32_t id) {
+    std::lock_guard lock(_mutex);
+    auto it = _open.find(id);
+    if (it == _open.end())
+      return;
+    _closed.push_back(std::move(it->second));
+    _open.erase(it);
+    // Don't re-enter the core from its own callback.
+    NetScheduler::shared().schedule(std::chrono::microseconds(0),
+                                    [id] { net_destroy_socket(id); });
+  }
+
+  const Factory _factory;
+  std::mutex _mutex;
+  std::unordered_map<uint32_t, std::unique_ptr<Endpoint>> _open;
+  std::vector<std::unique_ptr<Endpoint>> _closed;
+};
+
+// Round trips of `echoSize` bytes, one at a time: each measures core read,
+// NetManager::dispatch into the server handler, the echo write, and dispatch
+// back into the client.
+Result benchEcho(const Options &options) {
+  Accepted accepted([](uint32_t id) {
+    return [id](int type, const uint8_t *data, size_t len) {
+      if (type == 2) // DATA
+        net_write(id, data, len);
+    };
+  });
+  Listener listener([&](uint32_t id) { accepted.accept(id); });
+
+  Signal signal;
+  size_t received = 0;
+  Client client(listener.port(), [&](int, const uint8_t *, size_t len) {
+    signal.update([&] { received += len; });
+  });
+  if (!client.waitConnected())
+    fail("echo: connect failed");
+  net_set_nodelay(client.id(), true);
+
+  const std::vector<uint8_t> payload(options.echoSize, 'x');
+  LatencyHistogram histogram;
+  auto roundTrip = [&](bool record) {
+    const auto start = Clock::now();
+    net_write(client.id(), payload.data(), payload.size());
+    if (!signal.wait([&] { return received >= payload.size(); }))
+      fail("echo: round trip timed out");
+    if (record)
+      histogram.record(Clock::now() - start);
+    signal.update([&] { received -= payload.size(); });
+  };
+
+  for (uint64_t i = 0; i < options.iterations / 10; i++) {
+    roundTrip(false); // Warm-up
+  }
+  const Measurement measurement;
+  for (uint64_t i = 0; i < options.iterations; i++) {
+    roundTrip(true);
+  }
+  Result result = measurement.finish("tcp_echo_rtt", options.iterations);
+  result.latency = histogram.snapshot();
+  return result;
+}
+
+// Counts complete messages in a feedAll batch; false on a parse error.
+bool countMessages(const std::vector<uint8_t> &batch, uint64_t &complete) {
+  for (size_t at = 0; at + 4 <= batch.size();) {
+    const uint32_t size = batch[at] | batch[at + 1] << 8 |
+                          batch[at + 2] << 16 |
+                          static_cast<uint32_t>(batch[at + 3]) << 24;
+    const uint8_t flags = batch[at + 5];
+    if ((flags & kHttpFrameError) != 0)
+      return false;
+    if ((flags & kHttpFrameComplete) != 0)
+      complete++;
+    at += 4 + ((size + 3) & ~3U);
+  }
+  return true;
+}
+
+// Keep-alive requests over `connections` sockets, each with one request in
+// flight. Both ends parse with HttpStreamParser, the parser behind
+// HybridHttpParser::feedAll.
+Result benchHttp(const Options &options) {
+  static constexpr char kRequest[] = "GET /bench HTTP/1.1\r\n"
+                                     "Host: localhost\r\n"
+                                     "User-Agent: nitro-net-bench\r\n"
+                                     "Accept: */*\r\n\r\n";
+  static constexpr char kResponse[] = "HTTP/1.1 200 OK\r\n"
+                                      "Content-Type: text/plain\r\n"
+                                      "Content-Length: 2\r\n"
+                                      "Connection: keep-alive\r\n\r\nok";
+
+  Accepted accepted([](uint32_t id) {
+    auto parser = std::make_shared<HttpStreamParser>(0);
+    auto batch = std::make_shared<std::vector<uint8_t>>();
+    return [id, parser, batch](int type, const uint8_t *data, size_t len) {
+      if (type != 2) // DATA
+        return;
+      batch->clear();
+      parser->feed(data, len, *batch);
+      uint64_t requests = 0;
+      if (!countMessages(*batch, requests))
+        fail("http: server parse error");
+      for (uint64_t i = 0; i < requests; i++) {
+        net_write(id, reinterpret_cast<const uint8_t *>(kResponse),
+                  sizeof(kResponse) - 1);
+      }
+    };
+  });
+  Listener listener([&](uint32_t id) { accepted.accept(id); });
+
+  Signal signal;
+  uint64_t completed = 0;
+  std::atomic<uint64_t> issued{0};
+  const uint64_t total = options.iterations;
+  auto sendRequest = [](uint32_t id) {
+    net_write(id, reinterpret_cast<const uint8_t *>(kRequest),
+              sizeof(kRequest) - 1);
+  };
+
+  struct Connection {
+    HttpStreamParser parser{1};
+    std::vector<uint8_t> batch;
+    std::unique_ptr<Client> client;
+  };
+  std::vector<std::unique_ptr<Connection>> connections;
+  for (size_t i = 0; i < options.connections; i++) {
+    auto connection = std::make_unique<Connection>();
+    Connection *c = connection.get();
+    c->client = std::make_unique<Client>(
+        listener.port(), [&, c](int, const uint8_t *data, size_t len) {
+          c->batch.clear();
+          c->parser.feed(data, len, c->batch);
+          uint64_t responses = 0;
+          if (!countMessages(c->batch, responses))
+            fail("http: client parse error");
+          for (uint64_t r = 0; r < responses; r++) {
+            if (issued.fetch_add(1) < total)
+              sendRequest(c->client->id());
+          }
+          if (responses > 0)
+            signal.update([&] { completed += responses; });
+        });
+    if (!c->client->waitConnected())
+      fail("http: connect failed");
+    net_set_nodelay(c->client->id(), true);
+    connections.push_back(std::move(connection));
+  }
+
+  const Measurement measurement;
+  for (auto &connection : connections) {
+    if (issued.fetch_add(1) < total)
+      sendRequest(connection->client->id());
+  }
+  if (!signal.wait([&] { return completed >= total; },
+                   std::chrono::seconds(120)))
+    fail("http: requests timed out");
+  Result result = measurement.finish("http_keepalive", total);
+  result.note = std::to_string(options.connections) + " connections";
+  // Let the last responses' handlers finish before the parsers go away.
+  connections.clear();
+  return result;
+}
+
+std::string readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    fail("cannot read " + path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// Full TLS connects to a loopback server, sequentially; with `resume`, each
+// connect offers the ticket of the first connection.
+Result benchTls(const Options &options, bool resume) {
+  const std::string cert = readFile(options.certFile);
+  const std::string key = readFile(options.keyFile);
+  const uint32_t context =
+      net_create_secure_context(cert.c_str(), key.c_str(), nullptr);
+  if (context == 0)
+    fail("tls: invalid certificate or key");
+
+  Accepted accepted(
+      [](uint32_t) { return [](int, const uint8_t *, size_t) {}; });
+  Listener listener([&](uint32_t id) { accepted.accept(id); }, context);
+
+  std::vector<uint8_t> ticket;
+  if (resume) {
+    Client first(listener.port(), nullptr, true);
+    if (!first.waitConnected())
+      fail("tls: handshake failed");
+    ticket = first.waitTicket(std::chrono::seconds(2));
+    if (ticket.empty())
+      fail("tls: server sent no session ticket");
+  }
+
+  LatencyHistogram histogram;
+  uint64_t reused = 0;
+  const Measurement measurement;
+  for (uint64_t i = 0; i < options.handshakes; i++) {
+    const auto start = Clock::now();
+    Client client(listener.port(), nullptr, true, resume ? &ticket : nullptr);
+    if (!client.waitConnected())
+      fail("tls: handshake failed");
+    histogram.record(Clock::now() - start);
+    if (net_is_session_reused(client.id()))
+      reused++;
+  }
+  Result result = measurement.finish(
+      resume ? "tls_handshake_resumed" : "tls_handshake_full",
+      options.handshakes);
+  result.latency = histogram.snapshot();
+  result.note = std::to_string(reused) + " reused";
+  return result;
+}
+
+// One socket streaming 64 KiB writes to a sink, keeping at most `kWindow`
+// bytes unacknowledged by the receiving handler.
+Result benchThroughput(const Options &options) {
+  static constexpr size_t kChunk = 64 * 1024;
+  static constexpr uint64_t kWindow = 8 * 1024 * 1024;
+
+  Signal signal;
+  uint64_t received = 0;
+  Accepted accepted([&](uint32_t) {
+    return [&](int type, const uint8_t *, size_t len) {
+      if (type == 2) // DATA
+        signal.update([&] { received += len; });
+    };
+  });
+  Listener listener([&](uint32_t id) { accepted.accept(id); });
+
+  Client client(listener.port(), nullptr);
+  if (!client.waitConnected())
+    fail("throughput: connect failed");
+
+  const std::vector<uint8_t> chunk(kChunk, 'x');
+  const uint64_t total = options.transferMiB * 1024 * 1024;
+  const uint64_t chunks = total / kChunk;
+  const Measurement measurement;
+  uint64_t sent = 0;
+  for (uint64_t i = 0; i < chunks; i++) {
+    if (!signal.wait([&] { return sent - received < kWindow; }))
+      fail("throughput: transfer stalled");
+    net_write(client.id(), chunk.data(), chunk.size());
+    sent += chunk.size();
+  }
+  if (!signal.wait([&] { return received >= sent; }))
+    fail("throughput: transfer stalled");
+  Result result = measurement.finish("tcp_throughput", chunks);
+  result.bytes = sent;
+  result.note = "64 KiB writes";
+  return result;
+}
+
+void usage() {
+  std::fprintf(
+      stderr,
+      "usage: nitro-net-bench [--json] [--only NAME] [--iterations N]\n"
+      "                       [--handshakes N] [--transfer-mib N]\n"
+      "                       [--echo-size BYTES] [--connections N]\n"
+      "                       [--cert PEM --key PEM]\n"
+      "benchmarks: echo, http, tls, throughput (tls needs --cert/--key)\n");
+  std::exit(2);
+}
+
+Options parseOptions(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc)
+        usage();
+      return argv[++i];
+    };
+    if (arg == "--json") {
+      options.json = true;
+    } else if (arg == "--only") {
+      options.only = value();
+    } else if (arg == "--iterations") {
+      options.iterations = std::stoull(value());
+    } else if (arg == "--handshakes") {
+      options.handshakes = std::stoull(value());
+    } else if (arg == "--transfer-mib") {
+      options.transferMiB = std::stoull(value());
+    } else if (arg == "--echo-size") {
+      options.echoSize = std::stoul(value());
+    } else if (arg == "--connections") {
+      options.connections = std::max<size_t>(std::stoul(value()), 1);
+    } else if (arg == "--cert") {
+      options.certFile = value();
+    } else if (arg == "--key") {
+      options.keyFile = value();
+    } else {
+      usage();
+    }
+  }
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const Options options = parseOptions(argc, argv);
+  NetLog::shared().setLevel(LogLevel::Error);
+  NetManager::shared(); // Starts the core runtime
+
+  auto selected = [&](const char *name) {
+    return options.only.empty() || options.only == name;
+  };
+  const bool tls = !options.certFile.empty() && !options.keyFile.empty();
+  if (options.only == "tls" && !tls)
+    usage();
+
+  std::vector<Result> results;
+  auto run = [&](Result result) {
+    if (!options.json)
+      printResult(result);
+    results.push_back(std::move(result));
+  };
+  if (selected("echo"))
+    run(benchEcho(options));
+  if (selected("http"))
+    run(benchHttp(options));
+  if (selected("tls") && tls) {
+    run(benchTls(options, false));
+    run(benchTls(options, true));
+  }
+  if (selected("throughput"))
+    run(benchThroughput(options));
+
+  if (options.json)
+    printJson(results);
+  return 0;
+}
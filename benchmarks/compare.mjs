@@ -0,0 +1,60 @@
+#!/usr/bin/env node
+// Compares two `nitro-net-bench --json` runs and exits non-zero on a
+// regression beyond the threshold.
+//
+//   node benchmarks/compare.mjs baseline.json current.json [--threshold 10]
+
+import { readFileSync } from 'node:fs';
+
+const args = process.argv.slice(2);
+let threshold = 10;
+const thresholdAt = args.indexOf('--threshold');
+if (thresholdAt !== -1) {
+    threshold = Number(args[thresholdAt + 1]);
+    args.splice(thresholdAt, 2);
+}
+if (args.length !== 2 || !Number.isFinite(threshold)) {
+    console.error('usage: compare.mjs baseline.json current.json [--threshold PERCENT]');
+    process.exit(2);
+}
+
+const load = (path) => new Map(JSON.parse(readFileSync(path, 'utf8')).map((r) => [r.name, r]));
+const baseline = load(args[0]);
+const current = load(args[1]);
+
+// [label, read, higher is better]
+const metrics = [
+    ['ops/s', (r) => r.opsPerSecond, true],
+    ['MB/s', (r) => r.mbPerSecond, true],
+    ['p50 us', (r) => r.latencyUs?.p50, false],
+    ['p99 us', (r) => r.latencyUs?.p99, false],
+    ['allocs/op', (r) => r.allocsPerOp, false],
+];
+
+let regressions = 0;
+for (const [name, now] of current) {
+    const base = baseline.get(name);
+    if (!base) {
+        console.log(`${name}: new benchmark`);
+        continue;
+    }
+    for (const [label, read, higherIsBetter] of metrics) {
+        const before = read(base);
+        const after = read(now);
+        if (before === undefined || after === undefined || (before === 0 && after === 0)) continue;
+        const change = before === 0 ? (after === 0 ? 0 : 100) : ((after - before) / before) * 100;
+        const worse = higherIsBetter ? change < -threshold : change > threshold;
+        // Allocation counts are exact; a fraction of one extra allocation per
+        // operation is still worth flagging even where the relative change is
+        // small.
+        const allocRegression = label === 'allocs/op' && after - before >= 0.5;
+        const flag = worse || allocRegression;
+        if (flag) regressions++;
+        console.log(
+            `${flag ? 'REGRESSION' : 'ok        '} ${name} ${label}: ` +
+            `${before.toFixed(2)} -> ${after.toFixed(2)} (${change >= 0 ? '+' : ''}${change.toFixed(1)}%)`
+        );
+    }
+}
+
+process.exit(regressions > 0 ? 1 : 0);
@@ -0,0 +1,574 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// One field of an HTTP/2 header block. Names are lowercase.
+struct HpackHeader {
+  std::string name;
+  std::string value;
+};
+
+namespace hpack {
+
+struct StaticEntry {
+  std::string_view name;
+  std::string_view value;
+};
+
+// RFC 7541 Appendix A (index 1 is kStaticTable[0]) and Appendix B.
+inline constexpr StaticEntry kStaticTable[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+inline constexpr uint32_t kHuffmanCodes[256] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5,
+    0xfffffe6, 0xfffffe7, 0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9,
+    0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec, 0xfffffed, 0xfffffee,
+    0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9,
+    0xffffffa, 0xffffffb, 0x14, 0x3f8, 0x3f9, 0xffa,
+    0x1ff9, 0x15, 0xf8, 0x7fa, 0x3fa, 0x3fb,
+    0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b,
+    0x1c, 0x1d, 0x1e, 0x1f, 0x5c, 0xfb,
+    0x7ffc, 0x20, 0xffb, 0x3fc, 0x1ffa, 0x21,
+    0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e,
+    0x6f, 0x70, 0x71, 0x72, 0xfc, 0x73,
+    0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5,
+    0x25, 0x26, 0x27, 0x6, 0x74, 0x75,
+    0x28, 0x29, 0x2a, 0x7, 0x2b, 0x76,
+    0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd,
+    0x1ffd, 0xffffffc, 0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8,
+    0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9, 0x3fffd6, 0x7fffda,
+    0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1,
+    0x7fffe2, 0x7fffe3, 0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5,
+    0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef, 0x3fffda, 0x1fffdd,
+    0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf,
+    0x7fffeb, 0x7fffec, 0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2,
+    0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef, 0xfffea, 0x3fffe2,
+    0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2,
+    0x3fffe8, 0x1ffffec, 0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde,
+    0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed, 0x7fff2, 0x1fffe3,
+    0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3,
+    0x7ffffe4, 0x7ffffe5, 0xfffec, 0xfffff3, 0xfffed, 0x1fffe6,
+    0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3, 0x3fffea, 0x3fffeb,
+    0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8,
+    0x7ffffe9, 0x7ffffea, 0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed,
+    0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+};
+inline constexpr uint8_t kHuffmanCodeLengths[256] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+};
+
+constexpr size_t kStaticTableSize =
+    sizeof(kStaticTable) / sizeof(*kStaticTable);
+// Size of an entry beyond its name and value (RFC 7541 4.1)
+constexpr size_t kEntryOverhead = 32;
+constexpr size_t kDefaultTableSize = 4096;
+
+/// Appends `value` with an N-bit prefix (RFC 7541 5.1); `first` holds the
+/// representation's flag bits above the prefix.
+inline void encodeInteger(std::vector<uint8_t> &out, uint8_t first,
+                          int prefixBits, uint64_t value) {
+  const uint64_t max = (1U << prefixBits) - 1;
+  if (value < max) {
+    out.push_back(static_cast<uint8_t>(first | value));
+    return;
+  }
+  out.push_back(static_cast<uint8_t>(first | max));
+  value -= max;
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(0x80 | (value & 0x7F)));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+/// Reads an N-bit prefix integer at `p`, advancing it. Returns false if the
+/// input ends early or the value does not fit in 32 bits.
+inline bool decodeInteger(const uint8_t *&p, const uint8_t *end,
+                          int prefixBits, uint64_t &value) {
+  if (p == end)
+    return false;
+  const uint64_t max = (1U << prefixBits) - 1;
+  value = *p++ & max;
+  if (value < max)
+    return true;
+  for (int shift = 0; shift <= 28; shift += 7) {
+    if (p == end)
+      return false;
+    const uint8_t byte = *p++;
+    value += static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+      return value <= UINT32_MAX;
+  }
+  return false;
+}
+
+inline size_t huffmanLength(std::string_view s) {
+  size_t bits = 0;
+  for (const char c : s) {
+    bits += kHuffmanCodeLengths[static_cast<uint8_t>(c)];
+  }
+  return (bits + 7) / 8;
+}
+
+inline void huffmanEncode(std::vector<uint8_t> &out, std::string_view s) {
+  uint64_t acc = 0;
+  int bits = 0;
+  for (const char c : s) {
+    const uint8_t symbol = static_cast<uint8_t>(c);
+    acc = acc << kHuffmanCodeLengths[symbol] | kHuffmanCodes[symbol];
+    bits += kHuffmanCodeLengths[symbol];
+    while (bits >= 8) {
+      bits -= 8;
+      out.push_back(static_cast<uint8_t>(acc >> bits));
+    }
+  }
+  if (bits > 0) // Pad with the most significant bits of EOS (all ones)
+    out.push_back(static_cast<uint8_t>(acc << (8 - bits) | (0xFF >> bits)));
+}
+
+/// Byte-wise Huffman decoding tree, built once: every node maps the next
+/// 8 input bits either to a symbol (and the bits its code used) or to a
+/// child node for codes longer than 8 bits.
+class HuffmanTree {
+public:
+  struct Slot {
+    uint16_t child = 0; // Node index; 0 = symbol (the root is never a child)
+    uint8_t symbol = 0;
+    uint8_t length = 0; // Code bits used in this node; 0 = invalid code
+  };
+  struct Node {
+    Slot slots[256];
+  };
+
+  static const HuffmanTree &shared() {
+    static const HuffmanTree tree;
+    return tree;
+  }
+
+  const Node &node(size_t index) const { return _nodes[index]; }
+
+private:
+  HuffmanTree() : _nodes(1) {
+    for (size_t symbol = 0; symbol < 256; symbol++) {
+      const uint32_t code = kHuffmanCodes[symbol];
+      int length = kHuffmanCodeLengths[symbol];
+      size_t current = 0;
+      while (length > 8) {
+        length -= 8;
+        const uint8_t index = static_cast<uint8_t>(code >> length);
+        if (_nodes[current].slots[index].child == 0) {
+          _nodes[current].slots[index].child =
+              static_cast<uint16_t>(_nodes.size());
+          _nodes.emplace_back();
+        }
+        current = _nodes[current].slots[index].child;
+      }
+      const int shift = 8 - length;
+      const size_t first = static_cast<uint8_t>(code << shift);
+      for (size_t i = first; i < first + (size_t{1} << shift); i++) {
+        Slot &slot = _nodes[current].slots[i];
+        slot.symbol = static_cast<uint8_t>(symbol);
+        slot.length = static_cast<uint8_t>(length);
+      }
+    }
+  }
+
+  std::vector<Node> _nodes;
+};
+
+/// Appends the decoded string to `out`. Returns false for invalid codes,
+/// EOS, or padding that is longer than 7 bits or not all ones.
+inline bool huffmanDecode(const uint8_t *data, size_t len, std::string &out) {
+  const HuffmanTree &tree = HuffmanTree::shared();
+  size_t node = 0;
+  uint64_t acc = 0;
+  int bits = 0;       // Valid low bits of acc not yet fed into the tree
+  int symbolBits = 0; // Bits of the symbol being decoded
+  for (size_t i = 0; i < len; i++) {
+    acc = acc << 8 | data[i];
+    bits += 8;
+    symbolBits += 8;
+    while (bits >= 8) {
+      const HuffmanTree::Slot &slot =
+          tree.node(node).slots[static_cast<uint8_t>(acc >> (bits - 8))];
+      if (slot.child != 0) {
+        node = slot.child;
+        bits -= 8;
+        continue;
+      }
+      if (slot.length == 0)
+        return false;
+      out.push_back(static_cast<char>(slot.symbol));
+      bits -= slot.length;
+      node = 0;
+      symbolBits = bits;
+    }
+  }
+  while (bits > 0) {
+    const HuffmanTree::Slot &slot =
+        tree.node(node).slots[static_cast<uint8_t>(acc << (8 - bits))];
+    if (slot.child != 0 || slot.length == 0 || slot.length > bits)
+      break;
+    out.push_back(static_cast<char>(slot.symbol));
+    bits -= slot.length;
+    node = 0;
+    symbolBits = bits;
+  }
+  const uint64_t mask = (uint64_t{1} << bits) - 1;
+  return symbolBits <= 7 && (acc & mask) == mask;
+}
+
+/// Dynamic table (RFC 7541 2.3.2): the newest entry has index 62.
+class DynamicTable {
+public:
+  size_t size() const { return _size; }
+  size_t maxSize() const { return _maxSize; }
+  size_t count() const { return _entries.size(); }
+
+  void setMaxSize(size_t maxSize) {
+    _maxSize = maxSize;
+    evict(0);
+  }
+
+  void add(std::string_view name, std::string_view value) {
+    const size_t size = name.size() + value.size() + kEntryOverhead;
+    evict(size);
+    if (size > _maxSize) // Too large: the table is left empty
+      return;
+    _entries.push_front({std::string(name), std::string(value)});
+    _size += size;
+  }
+
+  /// Entry `index` counted from 0 = newest.
+  const HpackHeader &at(size_t index) const { return _entries[index]; }
+
+private:
+  void evict(size_t room) {
+    while (!_entries.empty() && _size + room > _maxSize) {
+      const HpackHeader &oldest = _entries.back();
+      _size -= oldest.name.size() + oldest.value.size() + kEntryOverhead;
+      _entries.pop_back();
+    }
+  }
+
+  std::deque<HpackHeader> _entries;
+  size_t _size = 0;
+  size_t _maxSize = kDefaultTableSize;
+};
+
+} // namespace hpack
+
+/// HPACK decoder of one connection's incoming header blocks. Blocks must be
+/// decoded in the order they arrive, including those of streams we then
+/// refuse, to keep the dynamic table in step with the peer's encoder.
+class HpackDecoder {
+public:
+  enum class Result { Ok, TooLarge, Error };
+
+  /// `maxTableSize` is the SETTINGS_HEADER_TABLE_SIZE we advertise;
+  /// `maxListSize` bounds a decoded block (SETTINGS_MAX_HEADER_LIST_SIZE).
+  HpackDecoder(size_t maxTableSize, size_t maxListSize)
+      : _maxTableSize(maxTableSize), _maxListSize(maxListSize) {
+    _table.setMaxSize(maxTableSize);
+  }
+
+  /// Decodes a complete header block into `out`. TooLarge means the block
+  /// was decoded (the table stays in step) but exceeds the list limit, so
+  /// only the stream fails; Error is a connection-level COMPRESSION_ERROR.
+  Result decode(const uint8_t *data, size_t len,
+                std::vector<HpackHeader> &out) {
+    out.clear();
+    const uint8_t *p = data;
+    const uint8_t *end = data + len;
+    size_t listSize = 0;
+    bool fieldSeen = false;
+    while (p < end) {
+      const uint8_t first = *p;
+      uint64_t index;
+      if ((first & 0xE0) == 0x20) { // Dynamic table size update
+        if (fieldSeen || !hpack::decodeInteger(p, end, 5, index) ||
+            index > _maxTableSize)
+          return Result::Error;
+        _table.setMaxSize(static_cast<size_t>(index));
+        continue;
+      }
+      fieldSeen = true;
+      HpackHeader header;
+      if ((first & 0x80) != 0) { // Indexed field
+        if (!hpack::decodeInteger(p, end, 7, index) ||
+            !lookup(index, header, true))
+          return Result::Error;
+      } else {
+        // Literal: with incremental indexing (01), without (0000) or
+        // never indexed (0001); the name is indexed unless the index is 0.
+        const bool indexing = (first & 0xC0) == 0x40;
+        if (!hpack::decodeInteger(p, end, indexing ? 6 : 4, index))
+          return Result::Error;
+        if (index != 0) {
+          if (!lookup(index, header, false))
+            return Result::Error;
+        } else if (!readString(p, end, header.name)) {
+          return Result::Error;
+        }
+        if (!readString(p, end, header.value))
+          return Result::Error;
+        if (indexing)
+          _table.add(header.name, header.value);
+      }
+      listSize += header.name.size() + header.value.size() +
+                  hpack::kEntryOverhead;
+      if (listSize <= _maxListSize)
+        out.push_back(std::move(header));
+    }
+    return listSize <= _maxListSize ? Result::Ok : Result::TooLarge;
+  }
+
+private:
+  bool lookup(uint64_t index, HpackHeader &header, bool withValue) const {
+    if (index == 0)
+      return false;
+    if (index <= hpack::kStaticTableSize) {
+      const hpack::StaticEntry &entry = hpack::kStaticTable[index - 1];
+      header.name = entry.name;
+      if (withValue)
+        header.value = entry.value;
+      return true;
+    }
+    index -= hpack::kStaticTableSize + 1;
+    if (index >= _table.count())
+      return false;
+    const HpackHeader &entry = _table.at(static_cast<size_t>(index));
+    header.name = entry.name;
+    if (withValue)
+      header.value = entry.value;
+    return true;
+  }
+
+  static bool readString(const uint8_t *&p, const uint8_t *end,
+                         std::string &out) {
+    if (p == end)
+      return false;
+    const bool huffman = (*p & 0x80) != 0;
+    uint64_t length;
+    if (!hpack::decodeInteger(p, end, 7, length) ||
+        length > static_cast<uint64_t>(end - p))
+      return false;
+    const size_t n = static_cast<size_t>(length);
+    out.clear();
+    if (huffman) {
+      if (!hpack::huffmanDecode(p, n, out))
+        return false;
+    } else {
+      out.assign(reinterpret_cast<const char *>(p), n);
+    }
+    p += n;
+    return true;
+  }
+
+  const size_t _maxTableSize;
+  const size_t _maxListSize;
+  hpack::DynamicTable _table;
+};
+
+/// HPACK encoder of one connection's outgoing header blocks. Fields are
+/// indexed incrementally, except values that rarely repeat (paths, lengths,
+/// dates) and credentials, which are sent never-indexed (RFC 7541 7.1.3).
+class HpackEncoder {
+public:
+  /// Applies the peer's SETTINGS_HEADER_TABLE_SIZE. We use at most the
+  /// default size, and announce a change at the start of the next block.
+  void setPeerMaxTableSize(size_t size) {
+    const size_t target = std::min(size, hpack::kDefaultTableSize);
+    if (target == _table.maxSize() && !_sizeUpdate)
+      return;
+    _minSizeSequence = std::min(_minSizeSequence, target);
+    _table.setMaxSize(target);
+    _sizeUpdate = true;
+  }
+
+  void encode(const std::vector<HpackHeader> &headers,
+              std::vector<uint8_t> &out) {
+    if (_sizeUpdate) {
+      // A smaller size in between must be signalled too (RFC 7541 4.2).
+      if (_minSizeSequence < _table.maxSize())
+        hpack::encodeInteger(out, 0x20, 5, _minSizeSequence);
+      hpack::encodeInteger(out, 0x20, 5, _table.maxSize());
+      _sizeUpdate = false;
+      _minSizeSequence = SIZE_MAX;
+    }
+    for (const HpackHeader &header : headers) {
+      encodeField(header.name, header.value, out);
+    }
+  }
+
+private:
+  enum class Indexing { Incremental, None, Never };
+
+  static Indexing indexingOf(std::string_view name, std::string_view value) {
+    if (name == "authorization" || name == "proxy-authorization" ||
+        (name == "cookie" && value.size() < 20))
+      return Indexing::Never;
+    if (name == ":path" || name == "content-length" || name == "date" ||
+        name == "etag" || name == "last-modified" || name == "if-none-match" ||
+        name == "if-modified-since" || name == "content-range" ||
+        name == "set-cookie")
+      return Indexing::None;
+    return Indexing::Incremental;
+  }
+
+  void encodeField(std::string_view name, std::string_view value,
+                   std::vector<uint8_t> &out) {
+    const Indexing indexing = indexingOf(name, value);
+    size_t nameIndex = 0;
+    for (size_t i = 0; i < hpack::kStaticTableSize; i++) {
+      const hpack::StaticEntry &entry = hpack::kStaticTable[i];
+      if (entry.name != name)
+        continue;
+      if (indexing != Indexing::Never && entry.value == value) {
+        hpack::encodeInteger(out, 0x80, 7, i + 1);
+        return;
+      }
+      if (nameIndex == 0)
+        nameIndex = i + 1;
+    }
+    for (size_t i = 0; i < _table.count(); i++) {
+      const HpackHeader &entry = _table.at(i);
+      if (entry.name != name)
+        continue;
+      const size_t index = hpack::kStaticTableSize + 1 + i;
+      if (indexing != Indexing::Never && entry.value == value) {
+        hpack::encodeInteger(out, 0x80, 7, index);
+        return;
+      }
+      if (nameIndex == 0)
+        nameIndex = index;
+    }
+    switch (indexing) {
+    case Indexing::Incremental:
+      hpack::encodeInteger(out, 0x40, 6, nameIndex);
+      break;
+    case Indexing::None:
+      hpack::encodeInteger(out, 0x00, 4, nameIndex);
+      break;
+    case Indexing::Never:
+      hpack::encodeInteger(out, 0x10, 4, nameIndex);
+      break;
+    }
+    if (nameIndex == 0)
+      writeString(name, out);
+    writeString(value, out);
+    if (indexing == Indexing::Incremental)
+      _table.add(name, value);
+  }
+
+  static void writeString(std::string_view s, std::vector<uint8_t> &out) {
+    const size_t huffman = hpack::huffmanLength(s);
+    if (huffman < s.size()) {
+      hpack::encodeInteger(out, 0x80, 7, huffman);
+      hpack::huffmanEncode(out, s);
+    } else {
+      hpack::encodeInteger(out, 0x00, 7, s.size());
+      out.insert(out.end(), s.begin(), s.end());
+    }
+  }
+
+  hpack::DynamicTable _table;
+  bool _sizeUpdate = false;
+  size_t _minSizeSequence = SIZE_MAX;
+};
+
+} // namespace margelo::nitro::net
@@ -0,0 +1,1157 @@
+#pragma once
+
+#include "Hpack.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// Settings of one HTTP/2 connection (RFC 9113). The windows and limits
+/// are the ones we advertise to the peer.
+struct Http2Config {
+  bool client = false; // Sends the connection preface and opens streams
+  uint32_t maxConcurrentStreams = 100; // Streams the peer may open
+  uint32_t initialWindowSize = 1024 * 1024; // Receive window per stream
+  uint32_t headerTableSize = 4096;
+  uint32_t maxHeaderListSize = 64 * 1024;
+};
+
+/// Kind byte of the records in one HTTP2 event.
+enum Http2RecordKind : uint8_t {
+  kHttp2Attached = 0,
+  kHttp2Headers = 1,
+  kHttp2Data = 2,
+  kHttp2StreamClose = 3,
+  kHttp2GoAway = 4,
+  kHttp2Settings = 5,
+  kHttp2Drain = 6,
+};
+
+enum Http2RecordFlag : uint8_t {
+  kHttp2EndStream = 1 << 0, // HEADERS, DATA: the peer ended the stream
+  kHttp2ByPeer = 1 << 1,    // STREAM_CLOSE, GOAWAY: sent by the peer
+};
+
+/// Error codes of RST_STREAM and GOAWAY (RFC 9113 7).
+enum Http2ErrorCode : uint32_t {
+  kHttp2NoError = 0x0,
+  kHttp2ProtocolError = 0x1,
+  kHttp2InternalError = 0x2,
+  kHttp2FlowControlError = 0x3,
+  kHttp2StreamClosed = 0x5,
+  kHttp2FrameSizeError = 0x6,
+  kHttp2RefusedStream = 0x7,
+  kHttp2Cancel = 0x8,
+  kHttp2CompressionError = 0x9,
+  kHttp2EnhanceYourCalm = 0xB,
+};
+
+/// Size of the header of every record (little-endian):
+///   0 u8 kind, 1 u8 flags, 2 u16 reserved, 4 u32 stream ID,
+///   8 u32 payload length, then the payload.
+/// Payloads: HEADERS "name\0value\0" pairs; DATA the bytes; STREAM_CLOSE
+/// u32 error code; GOAWAY u32 last stream ID, u32 error code, debug data;
+/// SETTINGS u32 streams the peer lets us open; ATTACHED and DRAIN none.
+constexpr size_t kHttp2RecordHeaderSize = 12;
+
+/// One HTTP/2 connection over a socket: framing, HPACK, stream states,
+/// flow control and prioritization run here, so JS only sees finished
+/// header lists, body bytes and stream ends. Everything the codec produces
+/// for JS during one call (one socket read, usually) goes out as a single
+/// event holding a sequence of records.
+///
+/// Every stream has a send queue for DATA the peer's windows don't admit
+/// yet. When a window opens, queued DATA goes out by RFC 9218 priority:
+/// lowest urgency first, then non-incremental streams in stream ID order,
+/// then incremental ones round-robin. A client stream's urgency is set
+/// when it is opened, a server stream's from the request's `priority`
+/// header or a PRIORITY_UPDATE frame. Received DATA is acknowledged as
+/// soon as it is handed on, unless JS pauses the stream.
+class Http2Session {
+public:
+  /// Receives bytes to write to the socket, or an event for JS.
+  using Output = std::function<void(const uint8_t *data, size_t len)>;
+
+  static constexpr uint8_t kDefaultUrgency = 3;
+  // Queued DATA per stream above which sendData reports backpressure
+  static constexpr size_t kStreamHighWaterMark = 64 * 1024;
+
+  Http2Session(const Http2Config &config, Output write, Output deliver)
+      : _config(config),
+        _decoder(config.headerTableSize, config.maxHeaderListSize),
+        _write(std::move(write)), _deliver(std::move(deliver)) {}
+
+  /// Sends our connection preface: the client magic, SETTINGS, and a
+  /// WINDOW_UPDATE raising the connection window.
+  void open() {
+    std::lock_guard lock(_mutex);
+    if (_config.client)
+      _out.insert(_out.end(), kClientMagic.begin(), kClientMagic.end());
+    struct Setting {
+      uint16_t id;
+      uint32_t value;
+    };
+    std::vector<Setting> settings;
+    if (_config.headerTableSize != hpack::kDefaultTableSize)
+      settings.push_back({kSettingsHeaderTableSize, _config.headerTableSize});
+    if (_config.client)
+      settings.push_back({kSettingsEnablePush, 0});
+    else
+      settings.push_back(
+          {kSettingsMaxConcurrentStreams, _config.maxConcurrentStreams});
+    settings.push_back({kSettingsInitialWindowSize, _config.initialWindowSize});
+    settings.push_back(
+        {kSettingsMaxHeaderListSize, _config.maxHeaderListSize});
+    frameHeaderLocked(settings.size() * 6, kFrameSettings, 0, 0);
+    for (const Setting &setting : settings) {
+      put16(setting.id);
+      put32(setting.value);
+    }
+    windowUpdateLocked(0, kConnectionWindow - kDefaultWindow);
+    writeOutLocked();
+  }
+
+  /// Raw bytes from the socket.
+  void onData(const uint8_t *data, size_t len) {
+    std::lock_guard lock(_mutex);
+    if (!_started) {
+      _held.insert(_held.end(), data, data + len);
+      return;
+    }
+    decodeLocked(data, len);
+    finishLocked();
+  }
+
+  /// Decodes `head` (bytes that reached JS before the attach marker), then
+  /// everything held since, and from then on decodes as bytes arrive.
+  void start(const uint8_t *head, size_t len) {
+    std::lock_guard lock(_mutex);
+    if (_started)
+      return;
+    _started = true;
+    if (len > 0)
+      decodeLocked(head, len);
+    if (!_held.empty())
+      decodeLocked(_held.data(), _held.size());
+    std::vector<uint8_t>().swap(_held);
+    finishLocked();
+  }
+
+  /// Opens a client stream with its request headers. Returns the stream
+  /// ID, or 0 if no stream can be opened now: the peer's concurrency limit
+  /// is reached, or the connection is going away.
+  uint32_t openStream(const std::vector<HpackHeader> &headers, bool endStream,
+                      uint8_t urgency, bool incremental) {
+    std::lock_guard lock(_mutex);
+    if (!_config.client || _failed || _goAwayReceived || _goAwaySent ||
+        _streams.size() >= _peerMaxConcurrentStreams ||
+        _nextStreamId > kMaxStreamId)
+      return 0;
+    const uint32_t id = _nextStreamId;
+    _nextStreamId += 2;
+    Stream &stream = addStreamLocked(id);
+    stream.urgency = std::min<uint8_t>(urgency, 7);
+    stream.incremental = incremental;
+    headersLocked(id, headers, endStream);
+    if (endStream)
+      stream.localClosed = true;
+    finishLocked();
+    return id;
+  }
+
+  /// Sends response headers or trailers. Trailers wait for the stream's
+  /// queued DATA. Returns false if the stream is gone or already ended.
+  bool sendHeaders(uint32_t id, const std::vector<HpackHeader> &headers,
+                   bool endStream) {
+    std::lock_guard lock(_mutex);
+    Stream *stream = findLocked(id);
+    if (_failed || stream == nullptr || stream->localClosed ||
+        stream->endQueued)
+      return false;
+    if (queuedBytes(*stream) > 0) {
+      stream->trailers = headers;
+      stream->endQueued = true;
+    } else {
+      headersLocked(id, headers, endStream);
+      if (endStream)
+        endLocalLocked(id, *stream);
+    }
+    finishLocked();
+    return true;
+  }
+
+  /// Sends DATA, queueing what the windows don't admit yet. Returns false
+  /// once the stream queues kStreamHighWaterMark bytes or more, or is gone;
+  /// a DRAIN record follows when the queue falls below the mark again.
+  bool sendData(uint32_t id, const uint8_t *data, size_t len,
+                bool endStream) {
+    std::lock_guard lock(_mutex);
+    Stream *stream = findLocked(id);
+    if (_failed || stream == nullptr || stream->localClosed ||
+        stream->endQueued)
+      return false;
+    size_t sent = 0;
+    if (queuedBytes(*stream) == 0) {
+      // Nothing of a stream that may go first waits for this window (it
+      // would have been sent when the window opened), so write directly.
+      while (sent < len && _sendWindow > 0 && stream->sendWindow > 0) {
+        const size_t n = std::min(sendable(*stream), len - sent);
+        const bool last = endStream && sent + n == len;
+        dataFrameLocked(id, data + sent, n, last);
+        sent += n;
+        _sendWindow -= static_cast<int64_t>(n);
+        stream->sendWindow -= static_cast<int64_t>(n);
+      }
+      if (sent == len) {
+        if (len == 0 && endStream)
+          dataFrameLocked(id, nullptr, 0, true);
+        if (endStream)
+          endLocalLocked(id, *stream);
+        finishLocked();
+        return true;
+      }
+    }
+    stream->queue.insert(stream->queue.end(), data + sent, data + len);
+    stream->endQueued = endStream;
+    const bool below = queuedBytes(*stream) < kStreamHighWaterMark;
+    stream->drainWanted = stream->drainWanted || !below;
+    finishLocked();
+    return below;
+  }
+
+  /// Cancels a stream with RST_STREAM.
+  void resetStream(uint32_t id, uint32_t code) {
+    std::lock_guard lock(_mutex);
+    if (!_failed && findLocked(id) != nullptr)
+      resetLocked(id, code);
+    finishLocked();
+  }
+
+  /// While paused, received DATA is not acknowledged, so the peer stops
+  /// once the stream's window is used up.
+  void setStreamPaused(uint32_t id, bool paused) {
+    std::lock_guard lock(_mutex);
+    Stream *stream = findLocked(id);
+    if (_failed || stream == nullptr || stream->paused == paused)
+      return;
+    stream->paused = paused;
+    if (!paused)
+      acknowledgeLocked(id, *stream, 0);
+    finishLocked();
+  }
+
+  /// Sends GOAWAY: no new streams, while the open ones complete.
+  void close(uint32_t code) {
+    std::lock_guard lock(_mutex);
+    if (!_failed && !_goAwaySent)
+      goAwayLocked(code, {});
+    finishLocked();
+  }
+
+private:
+  static constexpr std::string_view kClientMagic =
+      "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+  static constexpr size_t kFrameHeaderSize = 9;
+  static constexpr uint32_t kMaxStreamId = 0x7FFFFFFF;
+  static constexpr int64_t kMaxWindow = 0x7FFFFFFF;
+  static constexpr int64_t kDefaultWindow = 65535;
+  static constexpr int64_t kConnectionWindow = 16 * 1024 * 1024;
+  // We advertise the default frame size, and send no larger frames either,
+  // so a big body does not hold the connection against other streams.
+  static constexpr size_t kMaxFrameSize = 16384;
+  static constexpr uint32_t kDefaultPeerStreams = 100; // Until SETTINGS
+
+  enum FrameType : uint8_t {
+    kFrameData = 0x0,
+    kFrameHeaders = 0x1,
+    kFramePriority = 0x2,
+    kFrameRstStream = 0x3,
+    kFrameSettings = 0x4,
+    kFramePushPromise = 0x5,
+    kFramePing = 0x6,
+    kFrameGoAway = 0x7,
+    kFrameWindowUpdate = 0x8,
+    kFrameContinuation = 0x9,
+    kFramePriorityUpdate = 0x10, // RFC 9218
+  };
+
+  enum FrameFlag : uint8_t {
+    kFlagEndStream = 0x1,
+    kFlagAck = 0x1,
+    kFlagEndHeaders = 0x4,
+    kFlagPadded = 0x8,
+    kFlagPriority = 0x20,
+  };
+
+  enum SettingsId : uint16_t {
+    kSettingsHeaderTableSize = 0x1,
+    kSettingsEnablePush = 0x2,
+    kSettingsMaxConcurrentStreams = 0x3,
+    kSettingsInitialWindowSize = 0x4,
+    kSettingsMaxFrameSize = 0x5,
+    kSettingsMaxHeaderListSize = 0x6,
+  };
+
+  struct Stream {
+    int64_t sendWindow = 0;
+    int64_t receiveWindow = 0;
+    int64_t unacknowledged = 0; // Received bytes not yet given back
+    uint8_t urgency = kDefaultUrgency;
+    bool incremental = false;
+    bool paused = false;
+    bool localClosed = false;  // END_STREAM sent
+    bool remoteClosed = false; // END_STREAM received
+    // DATA waiting for window, from queueStart on
+    std::vector<uint8_t> queue;
+    size_t queueStart = 0;
+    bool endQueued = false; // END_STREAM (or trailers) follows the queue
+    std::vector<HpackHeader> trailers;
+    bool drainWanted = false;
+    bool headersReceived = false; // Final (non-1xx) headers; next are trailers
+  };
+
+  static size_t queuedBytes(const Stream &stream) {
+    return stream.queue.size() - stream.queueStart;
+  }
+
+  // ---- Output
+
+  void put8(uint8_t value) { _out.push_back(value); }
+  void put16(uint16_t value) {
+    _out.push_back(static_cast<uint8_t>(value >> 8));
+    _out.push_back(static_cast<uint8_t>(value));
+  }
+  void put32(uint32_t value) {
+    put16(static_cast<uint16_t>(value >> 16));
+    put16(static_cast<uint16_t>(value));
+  }
+
+  void frameHeaderLocked(size_t length, uint8_t type, uint8_t flags,
+                         uint32_t id) {
+    put8(static_cast<uint8_t>(length >> 16));
+    put16(static_cast<uint16_t>(length));
+    put8(type);
+    put8(flags);
+    put32(id & kMaxStreamId);
+  }
+
+  void dataFrameLocked(uint32_t id, const uint8_t *data, size_t len,
+                       bool endStream) {
+    frameHeaderLocked(len, kFrameData, endStream ? kFlagEndStream : 0, id);
+    if (len > 0)
+      _out.insert(_out.end(), data, data + len);
+  }
+
+  // Encodes and sends a header block as HEADERS plus CONTINUATION frames,
+  // back to back as the protocol demands.
+  void headersLocked(uint32_t id, const std::vector<HpackHeader> &headers,
+                     bool endStream) {
+    _encoded.clear();
+    _encoder.encode(headers, _encoded);
+    size_t at = 0;
+    do {
+      const size_t n = std::min(kMaxFrameSize, _encoded.size() - at);
+      const bool last = at + n == _encoded.size();
+      const uint8_t type = at == 0 ? kFrameHeaders : kFrameContinuation;
+      uint8_t flags = last ? kFlagEndHeaders : 0;
+      if (at == 0 && endStream)
+        flags |= kFlagEndStream;
+      frameHeaderLocked(n, type, flags, id);
+      _out.insert(_out.end(), _encoded.begin() + at,
+                  _encoded.begin() + at + n);
+      at += n;
+    } while (at < _encoded.size());
+  }
+
+  void windowUpdateLocked(uint32_t id, int64_t increment) {
+    frameHeaderLocked(4, kFrameWindowUpdate, 0, id);
+    put32(static_cast<uint32_t>(increment));
+  }
+
+  void goAwayLocked(uint32_t code, std::string_view debug) {
+    _goAwaySent = true;
+    frameHeaderLocked(8 + debug.size(), kFrameGoAway, 0, 0);
+    put32(_lastPeerStreamId);
+    put32(code);
+    _out.insert(_out.end(), debug.begin(), debug.end());
+  }
+
+  void writeOutLocked() {
+    if (_out.empty())
+      return;
+    _write(_out.data(), _out.size());
+    _out.clear();
+  }
+
+  // ---- Records for JS
+
+  // Starts a record whose payload the caller appends; returns its offset
+  // for endRecordLocked.
+  size_t beginRecordLocked(uint8_t kind, uint8_t flags, uint32_t id) {
+    const size_t at = _records.size();
+    _records.resize(at + kHttp2RecordHeaderSize);
+    uint8_t *header = _records.data() + at;
+    header[0] = kind;
+    header[1] = flags;
+    header[2] = header[3] = 0;
+    storeLe32(header + 4, id);
+    return at;
+  }
+
+  void endRecordLocked(size_t at) {
+    storeLe32(_records.data() + at + 8,
+              static_cast<uint32_t>(_records.size() - at -
+                                    kHttp2RecordHeaderSize));
+  }
+
+  void recordLocked(uint8_t kind, uint8_t flags, uint32_t id,
+                    const uint8_t *payload, size_t len) {
+    const size_t at = beginRecordLocked(kind, flags, id);
+    if (len > 0)
+      _records.insert(_records.end(), payload, payload + len);
+    endRecordLocked(at);
+  }
+
+  void recordWordsLocked(uint8_t kind, uint8_t flags, uint32_t id,
+                         std::initializer_list<uint32_t> words,
+                         std::string_view tail = {}) {
+    const size_t at = beginRecordLocked(kind, flags, id);
+    for (const uint32_t word : words) {
+      uint8_t bytes[4];
+      storeLe32(bytes, word);
+      _records.insert(_records.end(), bytes, bytes + 4);
+    }
+    _records.insert(_records.end(), tail.begin(), tail.end());
+    endRecordLocked(at);
+  }
+
+  static void storeLe32(uint8_t *p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+    p[2] = static_cast<uint8_t>(value >> 16);
+    p[3] = static_cast<uint8_t>(value >> 24);
+  }
+
+  // Writes what was produced, then hands the records to JS. Both happen
+  // under the lock, so output of concurrent calls never reorders.
+  void finishLocked() {
+    writeOutLocked();
+    if (_records.empty())
+      return;
+    _deliver(_records.data(), _records.size());
+    _records.clear();
+    if (_records.capacity() > kRetainedBufferSize)
+      std::vector<uint8_t>().swap(_records);
+  }
+
+  // ---- Streams
+
+  Stream *findLocked(uint32_t id) {
+    const auto it = _streams.find(id);
+    return it == _streams.end() ? nullptr : &it->second;
+  }
+
+  Stream &addStreamLocked(uint32_t id) {
+    Stream &stream = _streams[id];
+    stream.sendWindow = _peerInitialWindow;
+    stream.receiveWindow = _config.initialWindowSize;
+    return stream;
+  }
+
+  // Whether `id` names a stream that existed (and is now closed). Others
+  // are idle: frames on them are errors.
+  bool wasOpenedLocked(uint32_t id) const {
+    if ((id & 1) == 0)
+      return false; // We refuse server push; no even stream ever opens
+    return _config.client ? id < _nextStreamId : id <= _lastPeerStreamId;
+  }
+
+  void closeStreamLocked(uint32_t id, uint32_t code, uint8_t flags) {
+    _streams.erase(id);
+    recordWordsLocked(kHttp2StreamClose, flags, id, {code});
+  }
+
+  void endLocalLocked(uint32_t id, Stream &stream) {
+    stream.localClosed = true;
+    if (stream.remoteClosed)
+      closeStreamLocked(id, kHttp2NoError, 0);
+  }
+
+  void endRemoteLocked(uint32_t id, Stream &stream) {
+    stream.remoteClosed = true;
+    if (stream.localClosed)
+      closeStreamLocked(id, kHttp2NoError, 0);
+  }
+
+  // Stream error (RFC 9113 5.4.2): RST_STREAM, and the stream is gone.
+  void resetLocked(uint32_t id, uint32_t code) {
+    frameHeaderLocked(4, kFrameRstStream, 0, id);
+    put32(code);
+    if (findLocked(id) != nullptr)
+      closeStreamLocked(id, code, 0);
+  }
+
+  // Connection error (RFC 9113 5.4.1): GOAWAY, then nothing more is read.
+  // JS learns of it from a GOAWAY record without kHttp2ByPeer.
+  void failLocked(uint32_t code, std::string_view reason) {
+    if (_failed)
+      return;
+    _failed = true;
+    goAwayLocked(code, reason);
+    recordWordsLocked(kHttp2GoAway, 0, 0, {_lastPeerStreamId, code}, reason);
+  }
+
+  // Gives received bytes back to the peer once half a window has been
+  // consumed, or everything when `threshold` is 0.
+  void acknowledgeLocked(uint32_t id, Stream &stream, int64_t threshold) {
+    if (stream.paused || stream.remoteClosed ||
+        stream.unacknowledged <= threshold)
+      return;
+    windowUpdateLocked(id, stream.unacknowledged);
+    stream.receiveWindow += stream.unacknowledged;
+    stream.unacknowledged = 0;
+  }
+
+  size_t sendable(const Stream &stream) const {
+    return static_cast<size_t>(std::min<int64_t>(
+        {_sendWindow, stream.sendWindow,
+         static_cast<int64_t>(std::min(kMaxFrameSize, _peerMaxFrameSize))}));
+  }
+
+  // Next stream whose queued DATA may go out, by RFC 9218 priority.
+  uint32_t scheduleLocked() {
+    uint32_t best = 0;
+    uint8_t bestUrgency = 8;
+    bool bestIncremental = true;
+    uint32_t firstIncremental = 0; // Round-robin wraps around to this one
+    for (const auto &[id, stream] : _streams) {
+      if (queuedBytes(stream) == 0 || stream.sendWindow <= 0)
+        continue;
+      if (stream.urgency != bestUrgency) {
+        if (stream.urgency > bestUrgency)
+          continue;
+        bestUrgency = stream.urgency;
+        best = 0;
+        bestIncremental = true;
+        firstIncremental = 0;
+      }
+      if (!stream.incremental) {
+        if (bestIncremental || id < best) {
+          best = id;
+          bestIncremental = false;
+        }
+        continue;
+      }
+      if (!bestIncremental)
+        continue;
+      if (firstIncremental == 0)
+        firstIncremental = id;
+      if (best == 0 && id > _lastScheduled)
+        best = id;
+    }
+    if (best == 0)
+      best = firstIncremental;
+    return best;
+  }
+
+  // Sends queued DATA while the connection window admits some.
+  void flushQueuesLocked() {
+    while (_sendWindow > 0) {
+      const uint32_t id = scheduleLocked();
+      if (id == 0)
+        return;
+      _lastScheduled = id;
+      Stream &stream = _streams[id];
+      const size_t n = std::min(sendable(stream), queuedBytes(stream));
+      const bool last = n == queuedBytes(stream);
+      const bool endStream = last && stream.endQueued;
+      dataFrameLocked(id, stream.queue.data() + stream.queueStart, n,
+                      endStream && stream.trailers.empty());
+      _sendWindow -= static_cast<int64_t>(n);
+      stream.sendWindow -= static_cast<int64_t>(n);
+      stream.queueStart += n;
+      if (last) {
+        std::vector<uint8_t>().swap(stream.queue);
+        stream.queueStart = 0;
+      } else if (stream.queueStart >= kStreamHighWaterMark) {
+        stream.queue.erase(stream.queue.begin(),
+                           stream.queue.begin() + stream.queueStart);
+        stream.queueStart = 0;
+      }
+      if (stream.drainWanted &&
+          queuedBytes(stream) < kStreamHighWaterMark) {
+        stream.drainWanted = false;
+        recordLocked(kHttp2Drain, 0, id, nullptr, 0);
+      }
+      if (endStream) {
+        if (!stream.trailers.empty()) {
+          headersLocked(id, stream.trailers, true);
+          stream.trailers.clear();
+        }
+        endLocalLocked(id, stream);
+      }
+    }
+  }
+
+  // ---- Input
+
+  void decodeLocked(const uint8_t *data, size_t len) {
+    if (_failed)
+      return;
+    const uint8_t *p = data;
+    size_t n = len;
+    if (!_in.empty()) {
+      _in.insert(_in.end(), data, data + len);
+      p = _in.data();
+      n = _in.size();
+    }
+    size_t used = 0;
+    if (!_config.client && _magicSeen < kClientMagic.size()) {
+      const size_t m = std::min(kClientMagic.size() - _magicSeen, n);
+      if (memcmp(p, kClientMagic.data() + _magicSeen, m) != 0) {
+        failLocked(kHttp2ProtocolError, "Invalid connection preface");
+        return;
+      }
+      _magicSeen += m;
+      used = m;
+    }
+    while (!_failed && n - used >= kFrameHeaderSize) {
+      const uint8_t *frame = p + used;
+      const size_t length = static_cast<size_t>(frame[0]) << 16 |
+                            static_cast<size_t>(frame[1]) << 8 | frame[2];
+      if (length > kMaxFrameSize) {
+        failLocked(kHttp2FrameSizeError, "Frame too large");
+        break;
+      }
+      if (n - used < kFrameHeaderSize + length)
+        break;
+      const uint32_t id = load32(frame + 5) & kMaxStreamId;
+      frameLocked(frame[3], frame[4], id, frame + kFrameHeaderSize, length);
+      used += kFrameHeaderSize + length;
+    }
+    if (!_in.empty()) {
+      _in.erase(_in.begin(), _in.begin() + used);
+    } else if (used < n) {
+      _in.assign(p + used, p + n);
+    }
+    if (_failed)
+      std::vector<uint8_t>().swap(_in);
+    flushQueuesLocked();
+  }
+
+  static uint32_t load32(const uint8_t *p) {
+    return static_cast<uint32_t>(p[0]) << 24 |
+           static_cast<uint32_t>(p[1]) << 16 |
+           static_cast<uint32_t>(p[2]) << 8 | p[3];
+  }
+
+  void frameLocked(uint8_t type, uint8_t flags, uint32_t id,
+                   const uint8_t *payload, size_t len) {
+    if (!_settingsSeen && type != kFrameSettings) {
+      failLocked(kHttp2ProtocolError, "Expected SETTINGS first");
+      return;
+    }
+    if (_blockStreamId != 0 &&
+        (type != kFrameContinuation || id != _blockStreamId)) {
+      failLocked(kHttp2ProtocolError, "Expected CONTINUATION");
+      return;
+    }
+    switch (type) {
+    case kFrameData:
+      dataLocked(flags, id, payload, len);
+      break;
+    case kFrameHeaders:
+      headersFrameLocked(flags, id, payload, len);
+      break;
+    case kFrameContinuation:
+      if (_blockStreamId == 0) {
+        failLocked(kHttp2ProtocolError, "Unexpected CONTINUATION");
+        return;
+      }
+      appendBlockLocked(flags, payload, len);
+      break;
+    case kFramePriority:
+      if (id == 0)
+        failLocked(kHttp2ProtocolError, "PRIORITY on stream 0");
+      else if (len != 5)
+        resetLocked(id, kHttp2FrameSizeError);
+      break; // RFC 9113 deprecates the priority tree; ignored
+    case kFrameRstStream:
+      rstStreamLocked(id, payload, len);
+      break;
+    case kFrameSettings:
+      settingsLocked(flags, id, payload, len);
+      break;
+    case kFramePushPromise:
+      failLocked(kHttp2ProtocolError, "Push is disabled");
+      break;
+    case kFramePing:
+      if (len != 8) {
+        failLocked(kHttp2FrameSizeError, "Invalid PING");
+      } else if (id != 0) {
+        failLocked(kHttp2ProtocolError, "PING on a stream");
+      } else if ((flags & kFlagAck) == 0) {
+        frameHeaderLocked(8, kFramePing, kFlagAck, 0);
+        _out.insert(_out.end(), payload, payload + len);
+      }
+      break;
+    case kFrameGoAway:
+      goAwayFrameLocked(id, payload, len);
+      break;
+    case kFrameWindowUpdate:
+      windowUpdateFrameLocked(id, payload, len);
+      break;
+    case kFramePriorityUpdate:
+      priorityUpdateLocked(id, payload, len);
+      break;
+    default:
+      break; // Unknown frame types are ignored (RFC 9113 5.5)
+    }
+  }
+
+  void dataLocked(uint8_t flags, uint32_t id, const uint8_t *payload,
+                  size_t len) {
+    if (id == 0) {
+      failLocked(kHttp2ProtocolError, "DATA on stream 0");
+      return;
+    }
+    // The whole frame, padding included, counts against the windows.
+    _receiveWindow -= static_cast<int64_t>(len);
+    if (_receiveWindow < 0) {
+      failLocked(kHttp2FlowControlError, "Connection window exceeded");
+      return;
+    }
+    // The connection window is always given back, so one paused stream
+    // cannot stall the others.
+    _unacknowledged += static_cast<int64_t>(len);
+    if (_unacknowledged >= kConnectionWindow / 2) {
+      windowUpdateLocked(0, _unacknowledged);
+      _receiveWindow += _unacknowledged;
+      _unacknowledged = 0;
+    }
+    size_t size = len;
+    if (!stripPaddingLocked(flags, payload, size))
+      return;
+    Stream *stream = findLocked(id);
+    if (stream == nullptr) {
+      // Frames in flight when a stream closed are ignored.
+      if (!wasOpenedLocked(id))
+        failLocked(kHttp2ProtocolError, "DATA on an idle stream");
+      return;
+    }
+    if (stream->remoteClosed) {
+      resetLocked(id, kHttp2StreamClosed);
+      return;
+    }
+    stream->receiveWindow -= static_cast<int64_t>(len);
+    if (stream->receiveWindow < 0) {
+      resetLocked(id, kHttp2FlowControlError);
+      return;
+    }
+    stream->unacknowledged += static_cast<int64_t>(len);
+    const bool endStream = (flags & kFlagEndStream) != 0;
+    recordLocked(kHttp2Data, endStream ? kHttp2EndStream : 0, id, payload,
+                 size);
+    if (endStream)
+      endRemoteLocked(id, *stream);
+    else
+      acknowledgeLocked(id, *stream, _config.initialWindowSize / 2);
+  }
+
+  // Drops the pad length byte and the padding of a PADDED frame.
+  bool stripPaddingLocked(uint8_t flags, const uint8_t *&payload,
+                          size_t &len) {
+    if ((flags & kFlagPadded) == 0)
+      return true;
+    if (len == 0 || payload[0] >= len) {
+      failLocked(kHttp2ProtocolError, "Invalid padding");
+      return false;
+    }
+    len -= 1 + payload[0];
+    payload++;
+    return true;
+  }
+
+  void headersFrameLocked(uint8_t flags, uint32_t id, const uint8_t *payload,
+                          size_t len) {
+    if (id == 0) {
+      failLocked(kHttp2ProtocolError, "HEADERS on stream 0");
+      return;
+    }
+    if (!stripPaddingLocked(flags, payload, len))
+      return;
+    if ((flags & kFlagPriority) != 0) {
+      if (len < 5) {
+        failLocked(kHttp2FrameSizeError, "Invalid HEADERS");
+        return;
+      }
+      payload += 5;
+      len -= 5;
+    }
+    _blockStreamId = id;
+    _blockEndStream = (flags & kFlagEndStream) != 0;
+    _block.clear();
+    appendBlockLocked(flags, payload, len);
+  }
+
+  void appendBlockLocked(uint8_t flags, const uint8_t *payload, size_t len) {
+    // Blocks are decoded whole; bound what a peer can make us buffer.
+    if (_block.size() + len >
+        std::max<size_t>(_config.maxHeaderListSize, kMaxFrameSize) * 2) {
+      failLocked(kHttp2EnhanceYourCalm, "Header block too large");
+      return;
+    }
+    _block.insert(_block.end(), payload, payload + len);
+    if ((flags & kFlagEndHeaders) == 0)
+      return;
+    const uint32_t id = std::exchange(_blockStreamId, 0);
+    headerBlockLocked(id, _blockEndStream);
+    _block.clear();
+  }
+
+  void headerBlockLocked(uint32_t id, bool endStream) {
+    const HpackDecoder::Result result =
+        _decoder.decode(_block.data(), _block.size(), _headers);
+    if (result == HpackDecoder::Result::Error) {
+      failLocked(kHttp2CompressionError, "Invalid header block");
+      return;
+    }
+    Stream *stream = findLocked(id);
+    if (stream == nullptr) {
+      const bool request =
+          !_config.client && (id & 1) != 0 && id > _lastPeerStreamId;
+      if (!request) {
+        if (!wasOpenedLocked(id))
+          failLocked(kHttp2ProtocolError, "HEADERS on an idle stream");
+        return;
+      }
+      _lastPeerStreamId = id;
+      if (_goAwaySent)
+        return;
+      if (_streams.size() >= _config.maxConcurrentStreams) {
+        resetLocked(id, kHttp2RefusedStream);
+        return;
+      }
+      stream = &addStreamLocked(id);
+      applyPriorityHeaderLocked(*stream);
+    } else if (stream->remoteClosed) {
+      resetLocked(id, kHttp2StreamClosed);
+      return;
+    }
+    if (result == HpackDecoder::Result::TooLarge ||
+        !validHeadersLocked(stream->headersReceived)) {
+      resetLocked(id, kHttp2ProtocolError);
+      return;
+    }
+    if (!_config.client || !informationalLocked())
+      stream->headersReceived = true;
+    const size_t at =
+        beginRecordLocked(kHttp2Headers, endStream ? kHttp2EndStream : 0, id);
+    for (const HpackHeader &header : _headers) {
+      _records.insert(_records.end(), header.name.begin(), header.name.end());
+      _records.push_back(0);
+      _records.insert(_records.end(), header.value.begin(),
+                      header.value.end());
+      _records.push_back(0);
+    }
+    endRecordLocked(at);
+    if (endStream)
+      endRemoteLocked(id, *stream);
+  }
+
+  // Malformed fields (RFC 9113 8.2.1, 8.3): names with uppercase letters,
+  // controls, spaces, non-ASCII bytes or a ':' past the first byte; unknown,
+  // repeated or misplaced pseudo-headers (none in trailers, none after a
+  // regular field); connection-specific fields; NUL/CR/LF in values.
+  // Records are NUL-delimited, so none of this may reach JS.
+  bool validHeadersLocked(bool trailers) const {
+    bool regular = false;
+    uint32_t seen = 0; // Pseudo-headers present, by bit
+    for (const HpackHeader &header : _headers) {
+      const std::string_view name = header.name;
+      if (name.empty())
+        return false;
+      for (size_t i = 0; i < name.size(); i++) {
+        const auto c = static_cast<uint8_t>(name[i]);
+        if (c <= 0x20 || c >= 0x7F || (c >= 'A' && c <= 'Z') ||
+            (c == ':' && i > 0))
+          return false;
+      }
+      for (const char c : header.value) {
+        if (c == '\0' || c == '\r' || c == '\n')
+          return false;
+      }
+      if (name[0] == ':') {
+        const uint32_t bit = pseudoHeaderBit(name);
+        if (regular || trailers || bit == 0 || (seen & bit) != 0)
+          return false;
+        seen |= bit;
+        continue;
+      }
+      regular = true;
+      if (name == "connection" || name == "keep-alive" ||
+          name == "proxy-connection" || name == "transfer-encoding" ||
+          name == "upgrade" || (name == "te" && header.value != "trailers"))
+        return false;
+    }
+    return true;
+  }
+
+  // The pseudo-headers a peer may send us: response ones to a client,
+  // request ones (with RFC 8441's :protocol) to a server. 0 for any other.
+  uint32_t pseudoHeaderBit(std::string_view name) const {
+    if (_config.client)
+      return name == ":status" ? 1 : 0;
+    if (name == ":method")
+      return 1;
+    if (name == ":scheme")
+      return 2;
+    if (name == ":authority")
+      return 4;
+    if (name == ":path")
+      return 8;
+    if (name == ":protocol")
+      return 16;
+    return 0;
+  }
+
+  // Whether the decoded block is a 1xx response, after which the final
+  // response headers still follow.
+  bool informationalLocked() const {
+    for (const HpackHeader &header : _headers) {
+      if (header.name == ":status")
+        return header.value.size() == 3 && header.value[0] == '1';
+    }
+    return false;
+  }
+
+  // RFC 9218 Priority field: "u=<0-7>" and "i" (or "i=?1"), comma-separated.
+  static void parsePriority(std::string_view value, Stream &stream) {
+    while (!value.empty()) {
+      const size_t comma = value.find(',');
+      std::string_view item = value.substr(0, comma);
+      value = comma == std::string_view::npos ? std::string_view()
+                                              : value.substr(comma + 1);
+      while (!item.empty() && item.front() == ' ')
+        item.remove_prefix(1);
+      while (!item.empty() && item.back() == ' ')
+        item.remove_suffix(1);
+      if (item.size() == 3 && item.substr(0, 2) == "u=" && item[2] >= '0' &&
+          item[2] <= '7')
+        stream.urgency = static_cast<uint8_t>(item[2] - '0');
+      else if (item == "i" || item == "i=?1")
+        stream.incremental = true;
+      else if (item == "i=?0")
+        stream.incremental = false;
+    }
+  }
+
+  void applyPriorityHeaderLocked(Stream &stream) {
+    for (const HpackHeader &header : _headers) {
+      if (header.name == "priority")
+        parsePriority(header.value, stream);
+    }
+  }
+
+  void rstStreamLocked(uint32_t id, const uint8_t *payload, size_t len) {
+    if (len != 4) {
+      failLocked(kHttp2FrameSizeError, "Invalid RST_STREAM");
+      return;
+    }
+    if (id == 0 || (findLocked(id) == nullptr && !wasOpenedLocked(id))) {
+      failLocked(kHttp2ProtocolError, "RST_STREAM on an idle stream");
+      return;
+    }
+    if (findLocked(id) != nullptr)
+      closeStreamLocked(id, load32(payload), kHttp2ByPeer);
+  }
+
+  void settingsLocked(uint8_t flags, uint32_t id, const uint8_t *payload,
+                      size_t len) {
+    if (id != 0) {
+      failLocked(kHttp2ProtocolError, "SETTINGS on a stream");
+      return;
+    }
+    if ((flags & kFlagAck) != 0) {
+      if (len != 0)
+        failLocked(kHttp2FrameSizeError, "Invalid SETTINGS ACK");
+      return;
+    }
+    if (len % 6 != 0) {
+      failLocked(kHttp2FrameSizeError, "Invalid SETTINGS");
+      return;
+    }
+    for (size_t at = 0; at < len; at += 6) {
+      const uint16_t setting =
+          static_cast<uint16_t>(payload[at] << 8 | payload[at + 1]);
+      const uint32_t value = load32(payload + at + 2);
+      switch (setting) {
+      case kSettingsHeaderTableSize:
+        _encoder.setPeerMaxTableSize(value);
+        break;
+      case kSettingsEnablePush:
+        if (value > 1 || (_config.client && value == 1)) {
+          failLocked(kHttp2ProtocolError, "Invalid ENABLE_PUSH");
+          return;
+        }
+        break;
+      case kSettingsMaxConcurrentStreams:
+        _peerMaxConcurrentStreams = value;
+        break;
+      case kSettingsInitialWindowSize: {
+        if (value > kMaxWindow) {
+          failLocked(kHttp2FlowControlError, "Invalid INITIAL_WINDOW_SIZE");
+          return;
+        }
+        // Applies to the open streams too (RFC 9113 6.9.2)
+        const int64_t delta = static_cast<int64_t>(value) - _peerInitialWindow;
+        _peerInitialWindow = value;
+        for (auto &[streamId, stream] : _streams) {
+          stream.sendWindow += delta;
+          if (stream.sendWindow > kMaxWindow) {
+            failLocked(kHttp2FlowControlError, "Stream window overflow");
+            return;
+          }
+        }
+        break;
+      }
+      case kSettingsMaxFrameSize:
+        if (value < 16384 || value > 16777215) {
+          failLocked(kHttp2ProtocolError, "Invalid MAX_FRAME_SIZE");
+          return;
+        }
+        _peerMaxFrameSize = value;
+        break;
+      default:
+        break; // MAX_HEADER_LIST_SIZE is advisory; others are ignored
+      }
+    }
+    _settingsSeen = true;
+    frameHeaderLocked(0, kFrameSettings, kFlagAck, 0);
+    recordWordsLocked(kHttp2Settings, 0, 0, {_peerMaxConcurrentStreams});
+  }
+
+  void goAwayFrameLocked(uint32_t id, const uint8_t *payload, size_t len) {
+    if (id != 0) {
+      failLocked(kHttp2ProtocolError, "GOAWAY on a stream");
+      return;
+    }
+    if (len < 8) {
+      failLocked(kHttp2FrameSizeError, "Invalid GOAWAY");
+      return;
+    }
+    const uint32_t last = load32(payload) & kMaxStreamId;
+    const uint32_t code = load32(payload + 4);
+    _goAwayReceived = true;
+    // Our streams past `last` were never processed and can be retried.
+    if (_config.client) {
+      std::vector<uint32_t> refused;
+      for (const auto &[streamId, stream] : _streams) {
+        if (streamId > last)
+          refused.push_back(streamId);
+      }
+      for (const uint32_t streamId : refused) {
+        closeStreamLocked(streamId, kHttp2RefusedStream, kHttp2ByPeer);
+      }
+    }
+    recordWordsLocked(
+        kHttp2GoAway, kHttp2ByPeer, 0, {last, code},
+        std::string_view(reinterpret_cast<const char *>(payload + 8),
+                         len - 8));
+  }
+
+  void windowUpdateFrameLocked(uint32_t id, const uint8_t *payload,
+                               size_t len) {
+    if (len != 4) {
+      failLocked(kHttp2FrameSizeError, "Invalid WINDOW_UPDATE");
+      return;
+    }
+    const int64_t increment = load32(payload) & kMaxStreamId;
+    if (id == 0) {
+      if (increment == 0 || _sendWindow + increment > kMaxWindow) {
+        failLocked(increment == 0 ? kHttp2ProtocolError
+                                  : kHttp2FlowControlError,
+                   "Invalid connection WINDOW_UPDATE");
+        return;
+      }
+      _sendWindow += increment;
+      return;
+    }
+    Stream *stream = findLocked(id);
+    if (stream == nullptr) {
+      if (!wasOpenedLocked(id))
+        failLocked(kHttp2ProtocolError, "WINDOW_UPDATE on an idle stream");
+      return;
+    }
+    if (increment == 0) {
+      resetLocked(id, kHttp2ProtocolError);
+    } else if (stream->sendWindow + increment > kMaxWindow) {
+      resetLocked(id, kHttp2FlowControlError);
+    } else {
+      stream->sendWindow += increment;
+    }
+  }
+
+  void priorityUpdateLocked(uint32_t id, const uint8_t *payload, size_t len) {
+    // Only clients send PRIORITY_UPDATE (RFC 9218 7.1).
+    if (_config.client || id != 0 || len < 4) {
+      failLocked(kHttp2ProtocolError, "Invalid PRIORITY_UPDATE");
+      return;
+    }
+    Stream *stream = findLocked(load32(payload) & kMaxStreamId);
+    if (stream != nullptr)
+      parsePriority(std::string_view(
+                        reinterpret_cast<const char *>(payload + 4), len - 4),
+                    *stream);
+  }
+
+  static constexpr size_t kRetainedBufferSize = 256 * 1024;
+
+  const Http2Config _config;
+  std::mutex _mutex;
+  HpackDecoder _decoder;
+  HpackEncoder _encoder;
+  const Output _write;
+  const Output _deliver;
+
+  bool _started = false;
+  std::vector<uint8_t> _held; // Bytes before start
+  std::vector<uint8_t> _in;   // Incomplete frame
+  size_t _magicSeen = 0;      // Server: preface bytes matched so far
+  bool _settingsSeen = false;
+  bool _failed = false;
+  bool _goAwaySent = false;
+  bool _goAwayReceived = false;
+
+  std::map<uint32_t, Stream> _streams;
+  uint32_t _nextStreamId = 1;     // Client
+  uint32_t _lastPeerStreamId = 0; // Server
+  uint32_t _lastScheduled = 0;
+  uint32_t _peerMaxConcurrentStreams = kDefaultPeerStreams;
+  int64_t _peerInitialWindow = kDefaultWindow;
+  size_t _peerMaxFrameSize = kMaxFrameSize;
+  int64_t _sendWindow = kDefaultWindow;
+  int64_t _receiveWindow = kConnectionWindow;
+  int64_t _unacknowledged = 0;
+
+  // Header block being received, across CONTINUATION frames
+  uint32_t _blockStreamId = 0;
+  bool _blockEndStream = false;
+  std::vector<uint8_t> _block;
+  std::vector<HpackHeader> _headers;
+  std::vector<uint8_t> _encoded; // Header block being sent
+
+  std::vector<uint8_t> _out;     // Frames to write at the end of the call
+  std::vector<uint8_t> _records; // Records for JS, likewise
+};
+
+} // namespace margelo::nitro::net
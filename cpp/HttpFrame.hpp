@@ -0,0 +1,370 @@
+#pragma once
+
+#include "HttpHeaders.hpp"
+#include "NetJson.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// Binary HTTP parser frame (little-endian), produced by HttpStreamParser
+/// and from the Rust parser's JSON output, so JS can skip JSON.parse and the
+/// byte-array body encoding.
+///
+///   0  u8   format version (kHttpFrameVersion)
+///   1  u8   flags (HttpFrameFlag)
+///   2  u8   HTTP minor version
+///   3  u8   reserved
+///   4  u16  status code (responses), 0 otherwise
+///   6  u16  reserved
+///   8  u32  header count
+///   12 u32  trailer count
+///   16 u32  method offset, u32 method length
+///   24 u32  path offset,   u32 path length
+///   32 u32  body offset,   u32 body length
+///   40 u32  error offset,  u32 error length
+///   48 (header count + trailer count) entries of
+///      u32 name offset, u32 name length, u32 value offset, u32 value length
+///
+/// A name length with kHttpFrameInternedName set carries a common header ID
+/// (HttpHeaders.hpp) in its low 16 bits instead of a string. A value length
+/// with kHttpFrameArrayValue set marks a value of an array-valued name (even
+/// a single one), which JS keeps as a string[]. Offsets are
+/// relative to the start of the frame and point into the string
+/// and body bytes that follow the table. Strings are UTF-8; when the ASCII
+/// flag is set every string byte is < 0x80, so the whole region can be
+/// decoded once and sliced by offset.
+constexpr uint8_t kHttpFrameVersion = 4;
+constexpr size_t kHttpFrameHeaderSize = 48;
+constexpr size_t kHttpFrameEntrySize = 16;
+
+enum HttpFrameFlag : uint8_t {
+  kHttpFrameIsHeaders = 1 << 0,
+  kHttpFrameIsConnect = 1 << 1,
+  kHttpFrameComplete = 1 << 2,
+  kHttpFrameAscii = 1 << 3,
+  kHttpFrameError = 1 << 4,
+  // The parser stopped after this message (CONNECT, upgrade); the bytes
+  // after its head follow in a kHttpFrameTail frame.
+  kHttpFrameUpgrade = 1 << 5,
+  // Body holds input after an upgrade, left unparsed for the new protocol.
+  kHttpFrameTail = 1 << 6,
+};
+
+constexpr uint32_t kHttpFrameInternedName = 0x80000000U;
+constexpr uint32_t kHttpFrameArrayValue = 0x80000000U;
+
+/// One message (or message piece) to encode as a frame.
+struct HttpFrameMessage {
+  struct Span {
+    uint32_t offset = 0;
+    uint32_t length = 0;
+  };
+
+  struct Entry {
+    Span name;
+    Span value;
+    uint16_t nameId = 0; // Common header ID; `name` is unused when set
+    bool array = false;  // Value of an array-valued name
+  };
+
+  uint8_t flags = 0;
+  uint8_t minor = 0;
+  uint16_t status = 0;
+  Span method, path;
+  std::vector<Entry> headers;
+  std::vector<Entry> trailers;
+  // String bytes, referenced by the spans above.
+  std::vector<uint8_t> strings;
+  bool ascii = true;
+  const uint8_t *body = nullptr;
+  size_t bodyLength = 0;
+};
+
+namespace detail {
+
+/// Minimal reader for the parser's JSON schema: a flat object with string,
+/// number, boolean and null members, header objects (string or string-array
+/// values) and a body array of byte values. Anything else is skipped.
+class HttpJsonReader {
+public:
+  explicit HttpJsonReader(std::string_view json) : _json(json) {}
+
+  using Span = HttpFrameMessage::Span;
+  using Entry = HttpFrameMessage::Entry;
+
+  struct Result : HttpFrameMessage {
+    std::vector<uint8_t> bodyBytes; // What `body` points at
+  };
+
+  bool read(Result &out) {
+    _json.skipSpace();
+    if (!_json.consume('{'))
+      return false;
+    _json.skipSpace();
+    if (_json.consume('}'))
+      return true;
+    for (;;) {
+      std::string_view key;
+      if (!readKey(key))
+        return false;
+      if (!readMember(key, out))
+        return false;
+      _json.skipSpace();
+      if (_json.consume(','))
+        continue;
+      if (!_json.consume('}'))
+        return false;
+      out.body = out.bodyBytes.data();
+      out.bodyLength = out.bodyBytes.size();
+      return true;
+    }
+  }
+
+private:
+  bool readMember(std::string_view key, Result &out) {
+    _json.skipSpace();
+    if (key == "method")
+      return readStringOrNull(out, out.method);
+    if (key == "path")
+      return readStringOrNull(out, out.path);
+    if (key == "version") {
+      double v = 0;
+      if (!readNumberOrNull(v))
+        return false;
+      out.minor = static_cast<uint8_t>(v);
+      return true;
+    }
+    if (key == "status") {
+      double v = 0;
+      if (!readNumberOrNull(v))
+        return false;
+      out.status = static_cast<uint16_t>(v);
+      return true;
+    }
+    if (key == "is_headers")
+      return readFlag(out.flags, kHttpFrameIsHeaders);
+    if (key == "is_connect")
+      return readFlag(out.flags, kHttpFrameIsConnect);
+    if (key == "complete")
+      return readFlag(out.flags, kHttpFrameComplete);
+    if (key == "headers")
+      return readHeaderMap(out, out.headers);
+    if (key == "trailers")
+      return readHeaderMap(out, out.trailers);
+    if (key == "body")
+      return readBytes(out.bodyBytes);
+    return _json.skipValue();
+  }
+
+  // Keys in this schema never contain escapes.
+  bool readKey(std::string_view &key) {
+    _json.skipSpace();
+    if (!_json.plainString(key))
+      return false;
+    _json.skipSpace();
+    return _json.consume(':');
+  }
+
+  bool readFlag(uint8_t &flags, uint8_t bit) {
+    if (_json.literal("true")) {
+      flags |= bit;
+      return true;
+    }
+    return _json.literal("false") || _json.literal("null");
+  }
+
+  bool readNumberOrNull(double &value) {
+    return _json.literal("null") || _json.number(value);
+  }
+
+  bool readStringOrNull(Result &out, Span &span) {
+    if (_json.literal("null"))
+      return true;
+    return readString(out, span);
+  }
+
+  // Appends the decoded string to out.strings and records its span.
+  bool readString(Result &out, Span &span) {
+    span.offset = static_cast<uint32_t>(out.strings.size());
+    if (!_json.string(out.strings, out.ascii))
+      return false;
+    span.length = static_cast<uint32_t>(out.strings.size() - span.offset);
+    return true;
+  }
+
+  bool readHeaderMap(Result &out, std::vector<Entry> &entries) {
+    if (_json.literal("null"))
+      return true;
+    if (!_json.consume('{'))
+      return false;
+    _json.skipSpace();
+    if (_json.consume('}'))
+      return true;
+    for (;;) {
+      _json.skipSpace();
+      Span name;
+      if (!readString(out, name))
+        return false;
+      // Common names travel as IDs; drop their bytes from the string area.
+      const uint16_t nameId = internHeaderName(std::string_view(
+          reinterpret_cast<const char *>(out.strings.data()) + name.offset,
+          name.length));
+      if (nameId != 0) {
+        out.strings.resize(name.offset);
+        name = Span{};
+      }
+      _json.skipSpace();
+      if (!_json.consume(':'))
+        return false;
+      _json.skipSpace();
+      if (_json.consume('[')) {
+        // Repeated header: one entry per value, sharing the name.
+        _json.skipSpace();
+        if (!_json.consume(']')) {
+          for (;;) {
+            _json.skipSpace();
+            Span value;
+            if (!readString(out, value))
+              return false;
+            entries.push_back({name, value, nameId, true});
+            _json.skipSpace();
+            if (_json.consume(','))
+              continue;
+            if (!_json.consume(']'))
+              return false;
+            break;
+          }
+        }
+      } else {
+        Span value;
+        if (!readString(out, value))
+          return false;
+        entries.push_back({name, value, nameId});
+      }
+      _json.skipSpace();
+      if (_json.consume(','))
+        continue;
+      return _json.consume('}');
+    }
+  }
+
+  bool readBytes(std::vector<uint8_t> &dst) {
+    if (_json.literal("null"))
+      return true;
+    if (!_json.consume('['))
+      return false;
+    // Roughly one byte per 2-4 characters of JSON.
+    dst.reserve(dst.size() + _json.remaining() / 3);
+    _json.skipSpace();
+    if (_json.consume(']'))
+      return true;
+    for (;;) {
+      _json.skipSpace();
+      unsigned value = 0;
+      if (!_json.digits(value) || value > 0xFF)
+        return false;
+      dst.push_back(static_cast<uint8_t>(value));
+      if (_json.consume(','))
+        continue;
+      _json.skipSpace();
+      if (_json.consume(','))
+        continue;
+      return _json.consume(']');
+    }
+  }
+
+  JsonCursor _json;
+};
+
+inline void putU16(uint8_t *p, uint16_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+inline void putU32(uint8_t *p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+  p[2] = static_cast<uint8_t>(v >> 16);
+  p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+} // namespace detail
+
+/// Writes an error frame carrying `message` into `out`.
+inline void encodeHttpErrorFrame(std::string_view message,
+                                 std::vector<uint8_t> &out) {
+  out.assign(kHttpFrameHeaderSize + message.size(), 0);
+  uint8_t *frame = out.data();
+  frame[0] = kHttpFrameVersion;
+  frame[1] = kHttpFrameError | kHttpFrameAscii;
+  detail::putU32(frame + 40, static_cast<uint32_t>(kHttpFrameHeaderSize));
+  detail::putU32(frame + 44, static_cast<uint32_t>(message.size()));
+  memcpy(frame + kHttpFrameHeaderSize, message.data(), message.size());
+}
+
+/// Encodes `msg` as a binary frame in `out`.
+inline void encodeHttpFrame(const HttpFrameMessage &msg,
+                            std::vector<uint8_t> &out) {
+  using detail::putU32;
+  const size_t entryCount = msg.headers.size() + msg.trailers.size();
+  const size_t stringsAt =
+      kHttpFrameHeaderSize + entryCount * kHttpFrameEntrySize;
+  const size_t bodyAt = stringsAt + msg.strings.size();
+  out.assign(bodyAt + msg.bodyLength, 0);
+  uint8_t *frame = out.data();
+
+  frame[0] = kHttpFrameVersion;
+  frame[1] = msg.flags | (msg.ascii ? kHttpFrameAscii : 0);
+  frame[2] = msg.minor;
+  detail::putU16(frame + 4, msg.status);
+  putU32(frame + 8, static_cast<uint32_t>(msg.headers.size()));
+  putU32(frame + 12, static_cast<uint32_t>(msg.trailers.size()));
+
+  const auto base = static_cast<uint32_t>(stringsAt);
+  auto putSpan = [&](uint8_t *at, const HttpFrameMessage::Span &span) {
+    putU32(at, span.length > 0 ? base + span.offset : 0);
+    putU32(at + 4, span.length);
+  };
+  putSpan(frame + 16, msg.method);
+  putSpan(frame + 24, msg.path);
+  putU32(frame + 32, msg.bodyLength == 0 ? 0 : static_cast<uint32_t>(bodyAt));
+  putU32(frame + 36, static_cast<uint32_t>(msg.bodyLength));
+
+  uint8_t *entry = frame + kHttpFrameHeaderSize;
+  for (const auto *list : {&msg.headers, &msg.trailers}) {
+    for (const auto &e : *list) {
+      if (e.nameId != 0) {
+        putU32(entry, 0);
+        putU32(entry + 4, kHttpFrameInternedName | e.nameId);
+      } else {
+        putSpan(entry, e.name);
+      }
+      putSpan(entry + 8, e.value);
+      if (e.array)
+        putU32(entry + 12, kHttpFrameArrayValue | e.value.length);
+      entry += kHttpFrameEntrySize;
+    }
+  }
+
+  if (!msg.strings.empty())
+    memcpy(frame + stringsAt, msg.strings.data(), msg.strings.size());
+  if (msg.bodyLength > 0)
+    memcpy(frame + bodyAt, msg.body, msg.bodyLength);
+}
+
+/// Converts one parser JSON message into a binary frame in `out`.
+/// Returns false if the JSON does not match the parser schema.
+inline bool encodeHttpFrame(std::string_view json, std::vector<uint8_t> &out) {
+  detail::HttpJsonReader::Result msg;
+  detail::HttpJsonReader reader(json);
+  if (!reader.read(msg))
+    return false;
+  encodeHttpFrame(msg, out);
+  return true;
+}
+
+} // namespace margelo::nitro::net
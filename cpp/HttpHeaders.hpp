@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace margelo::nitro::net {
+
+/// Common HTTP header names with stable small-integer IDs, shared by the
+/// parser frames and the serializer so the most frequent names cross the
+/// bridge as numbers instead of strings. IDs are 1-based (0 = not interned)
+/// and must stay in sync with COMMON_HEADERS in src/http.ts; append only.
+inline constexpr std::array<std::string_view, 32> kCommonHeaders = {
+    "host",
+    "content-length",
+    "content-type",
+    "connection",
+    "transfer-encoding",
+    "accept",
+    "accept-encoding",
+    "accept-language",
+    "user-agent",
+    "cookie",
+    "set-cookie",
+    "cache-control",
+    "date",
+    "server",
+    "location",
+    "authorization",
+    "origin",
+    "referer",
+    "upgrade",
+    "content-encoding",
+    "etag",
+    "last-modified",
+    "if-none-match",
+    "if-modified-since",
+    "expect",
+    "keep-alive",
+    "x-forwarded-for",
+    "vary",
+    "pragma",
+    "range",
+    "accept-ranges",
+    "access-control-allow-origin",
+};
+
+/// Returns the ID of `name` (exact, lowercase match) or 0.
+/// Buckets by length and first byte, so a miss costs one or two compares.
+inline uint16_t internHeaderName(std::string_view name) {
+  struct Index {
+    // For each (length, first byte) bucket: bit mask of candidate IDs.
+    std::array<std::array<uint32_t, 26>, 32> buckets{};
+    constexpr Index() {
+      for (size_t i = 0; i < kCommonHeaders.size(); i++) {
+        const std::string_view header = kCommonHeaders[i];
+        buckets[header.size()][header[0] - 'a'] |= 1U << i;
+      }
+    }
+  };
+  static constexpr Index index;
+
+  if (name.size() >= index.buckets.size() || name.empty() || name[0] < 'a' ||
+      name[0] > 'z')
+    return 0;
+  uint32_t candidates = index.buckets[name.size()][name[0] - 'a'];
+  while (candidates != 0) {
+    const int i = __builtin_ctz(candidates);
+    if (kCommonHeaders[i] == name)
+      return static_cast<uint16_t>(i + 1);
+    candidates &= candidates - 1;
+  }
+  return 0;
+}
+
+/// Flag on a header ID selecting the Title-Case spelling ("Content-Type")
+/// over the lowercase one the table stores.
+constexpr uint16_t kHeaderTitleCase = 0x100;
+
+/// Appends the wire spelling of header `id` (optionally with
+/// kHeaderTitleCase) to `out`. Returns false for an unknown ID.
+inline bool appendHeaderName(std::string &out, uint16_t id) {
+  const uint16_t index = (id & ~kHeaderTitleCase) - 1;
+  if (index >= kCommonHeaders.size())
+    return false;
+  const std::string_view name = kCommonHeaders[index];
+  if ((id & kHeaderTitleCase) == 0) {
+    out.append(name);
+    return true;
+  }
+  bool upper = true;
+  for (const char c : name) {
+    out.push_back(upper ? static_cast<char>(c - 'a' + 'A') : c);
+    upper = c == '-';
+  }
+  return true;
+}
+
+} // namespace margelo::nitro::net
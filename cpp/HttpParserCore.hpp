@@ -0,0 +1,100 @@
+#pragma once
+
+#include "HttpFrame.hpp"
+#include "NetBindings.hpp"
+#include <string_view>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// The JSI-free half of HybridHttpParser: feeds bytes to a core parser and
+/// encodes complete messages as binary frames (see HttpFrame.hpp). Backs
+/// feed and feedBinary; feedAll streams through HttpStreamParser instead.
+class HttpParserCore {
+public:
+  /// `mode` 0 parses requests, 1 responses.
+  explicit HttpParserCore(int mode) : _id(net_http_parser_create(mode)) {}
+  ~HttpParserCore() { net_http_parser_destroy(_id); }
+
+  HttpParserCore(const HttpParserCore &) = delete;
+  HttpParserCore &operator=(const HttpParserCore &) = delete;
+
+  // Feeds bytes and points `json` at a complete message in the reusable
+  // output buffer (valid until the next feed). Returns the JSON length, 0 for
+  // a partial message, or a negative error code.
+  int feed(const uint8_t *data, size_t len, std::string_view &json) {
+    if (_output.size() > kRetainedOutputSize &&
+        _lastMessageSize < kInitialOutputSize) {
+      _output.resize(kInitialOutputSize);
+      _output.shrink_to_fit();
+    }
+
+    int res =
+        net_http_parser_feed(_id, data, len, _output.data(), _output.size());
+
+    if (res < -3) {
+      // Buffer too small, required size is -res. The message stays pending
+      // in the core; grow the buffer (it is kept for later messages, so
+      // similar-sized messages succeed on the first call) and fetch it.
+      const size_t requiredSize = static_cast<size_t>(-res) + 1;
+      size_t size = _output.size();
+      while (size < requiredSize)
+        size *= 2;
+      _output.resize(size);
+      res = net_http_parser_feed(_id, nullptr, 0, _output.data(),
+                                 _output.size());
+      if (res <= 0)
+        return kReparseFailed;
+    }
+    if (res > 0) {
+      json = std::string_view(_output.data(), static_cast<size_t>(res));
+      _lastMessageSize = static_cast<size_t>(res);
+    }
+    return res;
+  }
+
+  /// Encodes the next complete message (or the parse error) into `frame`.
+  /// Returns false if no message is complete yet.
+  bool feedFrame(const uint8_t *data, size_t len, std::vector<uint8_t> &frame) {
+    std::string_view json;
+    const int res = feed(data, len, json);
+    if (res == 0)
+      return false;
+    if (res < 0) {
+      encodeHttpErrorFrame(errorMessage(res), frame);
+    } else if (!encodeHttpFrame(json, frame)) {
+      encodeHttpErrorFrame("Malformed parser output", frame);
+    }
+    return true;
+  }
+
+  static const char *errorMessage(int res) {
+    switch (res) {
+    case -1:
+      return "JSON serialization failed";
+    case -2:
+      return "HTTP parse failed";
+    case -3:
+      return "Parser not found";
+    case kReparseFailed:
+      return "Re-parse failed after enlarging buffer";
+    default:
+      return "Unknown error";
+    }
+  }
+
+private:
+  static constexpr size_t kInitialOutputSize = 4096;
+  // Output buffers above this are released once a message fits the initial
+  // size again, so one large upload doesn't pin memory for the connection.
+  static constexpr size_t kRetainedOutputSize = 256 * 1024;
+
+  // Local code for a failed re-parse; the core only returns -1..-3 as errors.
+  static constexpr int kReparseFailed = -1000;
+
+  const uint32_t _id;
+  std::vector<char> _output = std::vector<char>(kInitialOutputSize);
+  size_t _lastMessageSize = 0;
+};
+
+} // namespace margelo::nitro::net
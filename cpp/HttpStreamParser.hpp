@@ -0,0 +1,635 @@
+#pragma once
+
+#include "HttpFrame.hpp"
+#include "HttpHeaders.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// Appends `frame` to a feedAll batch as u32 length + frame, padded to 4
+/// bytes.
+inline void appendHttpFrameRecord(std::vector<uint8_t> &batch,
+                                  const std::vector<uint8_t> &frame) {
+  const size_t at = batch.size();
+  const size_t padded = (frame.size() + 3) & ~static_cast<size_t>(3);
+  batch.resize(at + 4 + padded, 0);
+  detail::putU32(batch.data() + at, static_cast<uint32_t>(frame.size()));
+  memcpy(batch.data() + at + 4, frame.data(), frame.size());
+}
+
+/// Incremental HTTP/1.1 parser (RFC 9112). Bytes are consumed as they
+/// arrive and each feed emits, per message it touched, one frame with
+/// whatever became known: the head once it is complete (kHttpFrameIsHeaders),
+/// the body bytes of this feed, and kHttpFrameComplete with the trailers at
+/// the end. Only the head, a chunk-size line and the trailers are buffered,
+/// so the memory of a message in flight is bounded by kMaxHeaderSize plus
+/// one read, whatever the size of its body.
+///
+/// A CONNECT request, a 101 response, a 2xx answer to CONNECT (see
+/// expectConnectResponse) and an accepted upgrade request (see
+/// acceptUpgrades) end parsing: their frame carries kHttpFrameUpgrade, and
+/// every byte after the head, in this feed or later ones, comes back as a
+/// kHttpFrameTail frame for the new protocol. Parsing also stops for good
+/// after an error (reported as an error frame) and finish().
+class HttpStreamParser {
+public:
+  /// Bound of a head (start line and fields) and of a trailer section.
+  static constexpr size_t kMaxHeaderSize = 64 * 1024;
+
+  /// `mode` 0 parses requests, 1 responses.
+  explicit HttpStreamParser(int mode) : _response(mode == 1) {}
+
+  /// The next final response answers a HEAD request, so it has no body
+  /// whatever its framing fields say.
+  void expectHeadResponse() { _headResponse = true; }
+
+  /// The next final response answers a CONNECT request: a 2xx one opens a
+  /// tunnel, so it has no body and parsing stops after its head.
+  void expectConnectResponse() { _connectResponse = true; }
+
+  /// Whether requests asking for a protocol upgrade (Upgrade plus
+  /// Connection: upgrade) end parsing like CONNECT. Servers set it while
+  /// something handles upgrades; otherwise such a request is an ordinary
+  /// one (RFC 9110 7.8).
+  void acceptUpgrades(bool accept) { _acceptUpgrades = accept; }
+
+  /// Parses `data` and appends the resulting frames to `batch` (see
+  /// appendHttpFrameRecord).
+  void feed(const uint8_t *data, size_t len, std::vector<uint8_t> &batch) {
+    const uint8_t *p = data;
+    const uint8_t *const end = data + len;
+    while (p < end && _state != State::Tunnel && _state != State::Stopped &&
+           step(p, end, batch)) {
+    }
+    // A message still in flight reports what this feed added to it.
+    if (_pending)
+      emit(batch);
+    if (_state == State::Tunnel && p < end) {
+      _message.flags = kHttpFrameTail;
+      _message.body = p;
+      _message.bodyLength = static_cast<size_t>(end - p);
+      emit(batch);
+    }
+    releaseBuffers();
+  }
+
+  /// The connection ended: completes a response whose body runs until the
+  /// close (RFC 9112 6.3) and stops parsing.
+  void finish(std::vector<uint8_t> &batch) {
+    if (_state == State::BodyUntilEof)
+      complete(batch);
+    _state = State::Stopped;
+    releaseBuffers();
+  }
+
+private:
+  enum class State : uint8_t {
+    Head,
+    Body,          // Content-Length bytes left in _remaining
+    BodyUntilEof,  // Response without framing: ends with the connection
+    ChunkSize,     // Reading a chunk-size line into _line
+    ChunkData,     // _remaining bytes of the current chunk
+    ChunkDataEnd,  // The CRLF after chunk data
+    Trailers,      // Trailer section into _head
+    Tunnel,        // After an upgrade: input comes back as tail frames
+    Stopped,       // After an error or finish(): input is ignored
+  };
+
+  // Bytes a chunk-size line may take, extensions included.
+  static constexpr size_t kMaxChunkLine = 4096;
+  // Buffers above this are released between feeds.
+  static constexpr size_t kRetainedBufferSize = 256 * 1024;
+  // Largest Content-Length and chunk size (what a JS number holds exactly).
+  static constexpr uint64_t kMaxLength = (1ULL << 53) - 1;
+
+  // Consumes some of [p, end); false if more input is needed.
+  bool step(const uint8_t *&p, const uint8_t *end,
+            std::vector<uint8_t> &batch) {
+    switch (_state) {
+    case State::Head: {
+      if (!collectSection(p, end, batch))
+        return false;
+      return parseHead(batch);
+    }
+    case State::Body: {
+      const size_t n = take(p, end, _remaining);
+      addBody(p, n);
+      p += n;
+      _remaining -= n;
+      if (_remaining == 0)
+        complete(batch);
+      return true;
+    }
+    case State::BodyUntilEof:
+      addBody(p, static_cast<size_t>(end - p));
+      p = end;
+      return true;
+    case State::ChunkSize:
+      return readChunkSize(p, end, batch);
+    case State::ChunkData: {
+      const size_t n = take(p, end, _remaining);
+      addBody(p, n);
+      p += n;
+      _remaining -= n;
+      if (_remaining == 0)
+        _state = State::ChunkDataEnd;
+      return true;
+    }
+    case State::ChunkDataEnd:
+      // Two bytes, possibly split across reads.
+      while (p < end && _line.size() < 2)
+        _line.push_back(static_cast<char>(*p++));
+      if (_line.size() < 2)
+        return false;
+      if (_line != "\r\n")
+        return fail("Invalid chunk terminator", batch);
+      _line.clear();
+      _state = State::ChunkSize;
+      return true;
+    case State::Trailers: {
+      if (!collectSection(p, end, batch))
+        return false;
+      // _head starts with the CRLF that ended the last-chunk line.
+      const std::string_view section =
+          std::string_view(_head).substr(2, _head.size() - 4);
+      if (!parseFields(section, _message.trailers, true))
+        return fail("Invalid trailer field", batch);
+      _head.clear();
+      complete(batch);
+      return true;
+    }
+    case State::Tunnel:
+    case State::Stopped:
+      return false;
+    }
+    return false;
+  }
+
+  static size_t take(const uint8_t *p, const uint8_t *end, uint64_t limit) {
+    const auto available = static_cast<uint64_t>(end - p);
+    return static_cast<size_t>(available < limit ? available : limit);
+  }
+
+  // Appends input to _head until it holds a section ending in an empty
+  // line, and advances `p` past the bytes taken. _head then ends with that
+  // section's CRLF CRLF.
+  bool collectSection(const uint8_t *&p, const uint8_t *end,
+                      std::vector<uint8_t> &batch) {
+    if (_state == State::Head && _head.empty()) {
+      // RFC 9112 2.2: empty lines before the start line are ignored.
+      while (p < end && (*p == '\r' || *p == '\n'))
+        p++;
+      if (p == end)
+        return false;
+    }
+    const size_t before = _head.size();
+    const size_t room = kMaxHeaderSize + 4 - before;
+    const size_t n = std::min(static_cast<size_t>(end - p), room);
+    _head.append(reinterpret_cast<const char *>(p), n);
+    const size_t at = _head.find("\r\n\r\n", before >= 3 ? before - 3 : 0);
+    if (at == std::string::npos) {
+      p += n;
+      if (_head.size() >= kMaxHeaderSize + 4)
+        fail("Header section too large", batch);
+      return false;
+    }
+    _head.resize(at + 4);
+    p += _head.size() - before;
+    return true;
+  }
+
+  // ---- Head
+
+  bool parseHead(std::vector<uint8_t> &batch) {
+    const std::string_view head(_head.data(), _head.size() - 4);
+    const size_t lineEnd = head.find("\r\n");
+    const std::string_view startLine = head.substr(0, lineEnd);
+    const std::string_view fields =
+        lineEnd == std::string_view::npos ? std::string_view()
+                                          : head.substr(lineEnd + 2);
+    _message = HttpFrameMessage{};
+    _framing = Framing{};
+    const bool started =
+        _response ? parseStatusLine(startLine) : parseRequestLine(startLine);
+    if (!started)
+      return fail(_response ? "Invalid status line" : "Invalid request line",
+                  batch);
+    if (!parseFields(fields, _message.headers, false))
+      return fail("Invalid header field", batch);
+    _head.clear();
+    if (_framing.invalid)
+      return fail("Invalid message framing", batch);
+    _message.flags |= kHttpFrameIsHeaders;
+    _pending = true;
+    return startBody(batch);
+  }
+
+  bool parseRequestLine(std::string_view line) {
+    const size_t methodEnd = line.find(' ');
+    if (methodEnd == std::string_view::npos || methodEnd == 0)
+      return false;
+    const std::string_view method = line.substr(0, methodEnd);
+    for (const char c : method) {
+      if (!isTokenChar(c))
+        return false;
+    }
+    const size_t targetEnd = line.find(' ', methodEnd + 1);
+    if (targetEnd == std::string_view::npos || targetEnd == methodEnd + 1)
+      return false;
+    const std::string_view target =
+        line.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+    for (const char c : target) {
+      const auto byte = static_cast<uint8_t>(c);
+      if (byte <= 0x20 || byte == 0x7F)
+        return false;
+    }
+    if (!parseVersion(line.substr(targetEnd + 1)))
+      return false;
+    _message.method = addString(method);
+    _message.path = addString(target);
+    if (method == "CONNECT")
+      _message.flags |= kHttpFrameIsConnect;
+    return true;
+  }
+
+  bool parseStatusLine(std::string_view line) {
+    if (line.size() < 12 || !parseVersion(line.substr(0, 8)) ||
+        line[8] != ' ')
+      return false;
+    uint16_t status = 0;
+    for (size_t i = 9; i < 12; i++) {
+      if (line[i] < '0' || line[i] > '9')
+        return false;
+      status = static_cast<uint16_t>(status * 10 + (line[i] - '0'));
+    }
+    if (status < 100 || (line.size() > 12 && line[12] != ' '))
+      return false;
+    for (const char c : line.substr(12)) {
+      if (!isFieldValueChar(c))
+        return false;
+    }
+    _message.status = status;
+    return true;
+  }
+
+  bool parseVersion(std::string_view version) {
+    if (version.size() != 8 || version.substr(0, 7) != "HTTP/1." ||
+        version[7] < '0' || version[7] > '9')
+      return false;
+    _message.minor = static_cast<uint8_t>(version[7] - '0');
+    return true;
+  }
+
+  // Field lines (RFC 9112 5): names are tokens directly followed by ':',
+  // values lose surrounding whitespace. Obsolete line folding is rejected.
+  bool parseFields(std::string_view fields,
+                   std::vector<HttpFrameMessage::Entry> &entries,
+                   bool trailers) {
+    static const uint16_t setCookie = internHeaderName("set-cookie");
+    while (!fields.empty()) {
+      const size_t lineEnd = fields.find("\r\n");
+      const std::string_view line = fields.substr(0, lineEnd);
+      fields = lineEnd == std::string_view::npos
+                   ? std::string_view()
+                   : fields.substr(lineEnd + 2);
+      const size_t colon = line.find(':');
+      if (colon == std::string_view::npos || colon == 0)
+        return false;
+      const std::string_view name = line.substr(0, colon);
+      std::string_view value = line.substr(colon + 1);
+      while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+        value.remove_prefix(1);
+      while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+        value.remove_suffix(1);
+      for (const char c : name) {
+        if (!isTokenChar(c))
+          return false;
+      }
+      for (const char c : value) {
+        if (!isFieldValueChar(c))
+          return false;
+      }
+
+      HttpFrameMessage::Entry entry;
+      entry.name = addLowercase(name);
+      const std::string_view lower(
+          reinterpret_cast<const char *>(_message.strings.data()) +
+              entry.name.offset,
+          entry.name.length);
+      if (!trailers)
+        noteFraming(lower, value);
+      entry.nameId = internHeaderName(lower);
+      if (entry.nameId != 0) {
+        _message.strings.resize(entry.name.offset);
+        entry.name = HttpFrameMessage::Span{};
+      }
+      // As in Node, set-cookie is always an array.
+      entry.array = entry.nameId == setCookie;
+      entry.value = addString(value);
+      entries.push_back(entry);
+    }
+    return true;
+  }
+
+  // ---- Framing (RFC 9112 6.3)
+
+  struct Framing {
+    bool hasLength = false;
+    uint64_t length = 0;
+    bool hasTransferEncoding = false;
+    bool chunked = false; // Chunked is the final transfer coding
+    bool upgrade = false; // Upgrade field present
+    bool connectionUpgrade = false; // "upgrade" among the Connection options
+    bool invalid = false;
+  };
+
+  void noteFraming(std::string_view name, std::string_view value) {
+    if (name == "content-length") {
+      // A list of identical values is one length (RFC 9110 8.6).
+      while (!value.empty()) {
+        const size_t comma = value.find(',');
+        std::string_view item = trim(value.substr(0, comma));
+        value = comma == std::string_view::npos ? std::string_view()
+                                                : value.substr(comma + 1);
+        uint64_t length = 0;
+        if (!parseDecimal(item, length) ||
+            (_framing.hasLength && length != _framing.length)) {
+          _framing.invalid = true;
+          return;
+        }
+        _framing.hasLength = true;
+        _framing.length = length;
+      }
+    } else if (name == "transfer-encoding") {
+      _framing.hasTransferEncoding = true;
+      const size_t comma = value.rfind(',');
+      const std::string_view last = trim(
+          comma == std::string_view::npos ? value : value.substr(comma + 1));
+      _framing.chunked = equalsIgnoringCase(last, "chunked");
+    } else if (name == "upgrade") {
+      _framing.upgrade = !value.empty();
+    } else if (name == "connection") {
+      while (!value.empty()) {
+        const size_t comma = value.find(',');
+        if (equalsIgnoringCase(trim(value.substr(0, comma)), "upgrade"))
+          _framing.connectionUpgrade = true;
+        value = comma == std::string_view::npos ? std::string_view()
+                                                : value.substr(comma + 1);
+      }
+    }
+  }
+
+  bool startBody(std::vector<uint8_t> &batch) {
+    if (_response) {
+      const uint16_t status = _message.status;
+      if (status == 101)
+        return tunnel(batch);
+      if (status < 200) {
+        // Informational; the final response follows.
+        complete(batch);
+        return true;
+      }
+      const bool headResponse = std::exchange(_headResponse, false);
+      if (std::exchange(_connectResponse, false) && status < 300)
+        return tunnel(batch);
+      if (headResponse || status == 204 || status == 304) {
+        complete(batch);
+        return true;
+      }
+      if (_framing.hasTransferEncoding) {
+        _state = _framing.chunked ? State::ChunkSize : State::BodyUntilEof;
+        return true;
+      }
+      if (!_framing.hasLength) {
+        _state = State::BodyUntilEof;
+        return true;
+      }
+    } else {
+      if ((_message.flags & kHttpFrameIsConnect) != 0 ||
+          (_acceptUpgrades && _framing.upgrade && _framing.connectionUpgrade))
+        return tunnel(batch);
+      if (_framing.hasTransferEncoding) {
+        // A request body must end in chunked framing, and a length next to
+        // it is how requests get smuggled (RFC 9112 6.1, 6.3).
+        if (!_framing.chunked || _framing.hasLength)
+          return fail("Invalid message framing", batch);
+        _state = State::ChunkSize;
+        return true;
+      }
+    }
+    if (_framing.length == 0) {
+      complete(batch);
+      return true;
+    }
+    _remaining = _framing.length;
+    _state = State::Body;
+    return true;
+  }
+
+  // Ends the message at its head: what follows speaks another protocol.
+  bool tunnel(std::vector<uint8_t> &batch) {
+    _message.flags |= kHttpFrameUpgrade;
+    complete(batch);
+    _state = State::Tunnel;
+    return true;
+  }
+
+  bool readChunkSize(const uint8_t *&p, const uint8_t *end,
+                     std::vector<uint8_t> &batch) {
+    while (p < end) {
+      const char c = static_cast<char>(*p++);
+      _line.push_back(c);
+      if (c == '\n')
+        break;
+      if (_line.size() > kMaxChunkLine)
+        return fail("Chunk size line too long", batch);
+    }
+    if (_line.empty() || _line.back() != '\n')
+      return false;
+    if (_line.size() < 2 || _line[_line.size() - 2] != '\r')
+      return fail("Invalid chunk size", batch);
+    // Extensions after ';' are allowed and ignored.
+    std::string_view size(_line.data(), _line.size() - 2);
+    size = trim(size.substr(0, size.find(';')));
+    uint64_t value = 0;
+    if (!parseHex(size, value))
+      return fail("Invalid chunk size", batch);
+    _line.clear();
+    if (value == 0) {
+      _head.assign("\r\n");
+      _state = State::Trailers;
+    } else {
+      _remaining = value;
+      _state = State::ChunkData;
+    }
+    return true;
+  }
+
+  // ---- Output
+
+  void addBody(const uint8_t *data, size_t len) {
+    if (len == 0)
+      return;
+    _pending = true;
+    if (_message.bodyLength == 0) {
+      // Usually one piece per feed: the frame copies it from the input.
+      _message.body = data;
+      _message.bodyLength = len;
+      return;
+    }
+    if (_body.empty())
+      _body.assign(_message.body, _message.body + _message.bodyLength);
+    _body.insert(_body.end(), data, data + len);
+    _message.body = _body.data();
+    _message.bodyLength = _body.size();
+  }
+
+  void complete(std::vector<uint8_t> &batch) {
+    _message.flags |= kHttpFrameComplete;
+    _pending = true;
+    emit(batch);
+    _state = State::Head;
+  }
+
+  // Appends the frame of what is pending and starts the next piece (the
+  // same message's next body bytes, or a new message).
+  void emit(std::vector<uint8_t> &batch) {
+    encodeHttpFrame(_message, _frame);
+    appendHttpFrameRecord(batch, _frame);
+    _message = HttpFrameMessage{};
+    _body.clear();
+    _pending = false;
+  }
+
+  bool fail(const char *message, std::vector<uint8_t> &batch) {
+    if (_pending)
+      emit(batch);
+    encodeHttpErrorFrame(message, _frame);
+    appendHttpFrameRecord(batch, _frame);
+    _state = State::Stopped;
+    _head.clear();
+    _line.clear();
+    return false;
+  }
+
+  void releaseBuffers() {
+    for (auto *buffer : {&_body, &_frame}) {
+      if (buffer->capacity() > kRetainedBufferSize)
+        std::vector<uint8_t>().swap(*buffer);
+    }
+  }
+
+  // ---- Strings
+
+  HttpFrameMessage::Span addString(std::string_view text) {
+    HttpFrameMessage::Span span{static_cast<uint32_t>(_message.strings.size()),
+                                static_cast<uint32_t>(text.size())};
+    for (const char c : text) {
+      _message.ascii = _message.ascii && static_cast<uint8_t>(c) < 0x80;
+    }
+    _message.strings.insert(_message.strings.end(), text.begin(), text.end());
+    return span;
+  }
+
+  // Tokens are ASCII, so lowercasing cannot affect the ASCII flag.
+  HttpFrameMessage::Span addLowercase(std::string_view text) {
+    HttpFrameMessage::Span span{static_cast<uint32_t>(_message.strings.size()),
+                                static_cast<uint32_t>(text.size())};
+    for (const char c : text) {
+      _message.strings.push_back(static_cast<uint8_t>(
+          c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c));
+    }
+    return span;
+  }
+
+  static bool isTokenChar(char c) {
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+        (c >= '0' && c <= '9'))
+      return true;
+    return std::string_view("!#$%&'*+-.^_`|~").find(c) !=
+           std::string_view::npos;
+  }
+
+  // VCHAR, obs-text, SP and HTAB; no controls (RFC 9110 5.5).
+  static bool isFieldValueChar(char c) {
+    const auto byte = static_cast<uint8_t>(c);
+    return byte == '\t' || (byte >= 0x20 && byte != 0x7F);
+  }
+
+  static std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+      text.remove_prefix(1);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t'))
+      text.remove_suffix(1);
+    return text;
+  }
+
+  static bool equalsIgnoringCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size())
+      return false;
+    for (size_t i = 0; i < a.size(); i++) {
+      const char c = a[i] >= 'A' && a[i] <= 'Z' ? a[i] - 'A' + 'a' : a[i];
+      if (c != b[i])
+        return false;
+    }
+    return true;
+  }
+
+  static bool parseDecimal(std::string_view text, uint64_t &value) {
+    if (text.empty())
+      return false;
+    value = 0;
+    for (const char c : text) {
+      if (c < '0' || c > '9')
+        return false;
+      value = value * 10 + static_cast<uint64_t>(c - '0');
+      if (value > kMaxLength)
+        return false;
+    }
+    return true;
+  }
+
+  static bool parseHex(std::string_view text, uint64_t &value) {
+    if (text.empty())
+      return false;
+    value = 0;
+    for (const char c : text) {
+      int digit;
+      if (c >= '0' && c <= '9')
+        digit = c - '0';
+      else if (c >= 'a' && c <= 'f')
+        digit = c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        digit = c - 'A' + 10;
+      else
+        return false;
+      value = value * 16 + static_cast<uint64_t>(digit);
+      if (value > kMaxLength)
+        return false;
+    }
+    return true;
+  }
+
+  const bool _response;
+  bool _headResponse = false;
+  bool _connectResponse = false;
+  bool _acceptUpgrades = false;
+  State _state = State::Head;
+  bool _pending = false; // _message holds something not yet emitted
+  uint64_t _remaining = 0;
+  Framing _framing;
+  HttpFrameMessage _message;
+  std::string _head; // Head or trailer section being collected
+  std::string _line; // Chunk-size line or chunk terminator
+  std::vector<uint8_t> _body; // Body pieces of this feed, once there are two
+  std::vector<uint8_t> _frame;
+};
+
+} // namespace margelo::nitro::net
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../nitrogen/generated/shared/c++/HybridConnectionPoolSpec.hpp"
+#include "HybridNetSocketDriver.hpp"
+#include "NetSocketPool.hpp"
+#include <NitroModules/ArrayBuffer.hpp>
+#include <algorithm>
+#include <optional>
+#include <string>
+
+namespace margelo {
+namespace nitro {
+namespace net {
+
+using namespace margelo::nitro;
+
+/// One Agent's view of the shared SocketPool. Destroying it closes the
+/// Agent's idle sockets.
+class HybridConnectionPool : public HybridConnectionPoolSpec {
+public:
+  HybridConnectionPool()
+      : HybridObject(TAG), _pool(SocketPool::shared().createPool()) {}
+
+  ~HybridConnectionPool() override { SocketPool::shared().clear(_pool); }
+
+  double getIdleCount() override {
+    return static_cast<double>(SocketPool::shared().idleCount(_pool));
+  }
+
+  bool release(const std::shared_ptr<HybridNetSocketDriverSpec> &socket,
+               const std::string &host, double port, double secureContextId,
+               double idleTimeoutMs, double keepAliveMsecs,
+               double maxIdle) override {
+    auto driver = std::dynamic_pointer_cast<HybridNetSocketDriver>(socket);
+    if (!driver)
+      return false;
+    const auto id = static_cast<uint32_t>(driver->getId());
+    if (id == 0)
+      return false;
+
+    const SocketPool::ParkOptions options{
+        std::chrono::milliseconds(
+            static_cast<int64_t>(std::max(idleTimeoutMs, 0.0))),
+        static_cast<uint64_t>(std::max(keepAliveMsecs, 0.0)),
+        static_cast<size_t>(std::max(maxIdle, 0.0)),
+        driver->sessionContext(), driver->sessionName()};
+    const std::string key = keyOf(host, port, secureContextId);
+    if (!SocketPool::shared().beginPark(_pool, key, id, options))
+      return false;
+    driver->detach();
+    SocketPool::shared().finishPark(id, options);
+    return true;
+  }
+
+  std::optional<std::shared_ptr<HybridNetSocketDriverSpec>>
+  acquire(const std::string &host, double port, double secureContextId,
+          bool lifo) override {
+    auto driver = take(_pool, keyOf(host, port, secureContextId), lifo);
+    if (!driver)
+      return std::nullopt;
+    return driver;
+  }
+
+  void clear() override { SocketPool::shared().clear(_pool); }
+
+  /// Connection key of a pooled socket; TLS sockets are keyed by their
+  /// secure context ID, plain TCP ones by -1.
+  static std::string keyOf(const std::string &host, double port,
+                           double secureContextId) {
+    return host + ':' + std::to_string(static_cast<int>(port)) + '/' +
+           std::to_string(static_cast<int64_t>(secureContextId));
+  }
+
+  /// Takes a live idle socket of `pool` for `key` as a new driver, or
+  /// returns nullptr if none is idle.
+  static std::shared_ptr<HybridNetSocketDriver>
+  take(uint32_t pool, const std::string &key, bool lifo) {
+    for (;;) {
+      const uint32_t id = SocketPool::shared().beginTake(pool, key, lifo);
+      if (id == 0)
+        return nullptr;
+      // Registers the driver's handler, replacing the pool's.
+      auto driver = std::make_shared<HybridNetSocketDriver>(id);
+      if (SocketPool::shared().finishTake(id))
+        return driver;
+      driver->destroy(); // Closed by the peer during the handoff
+    }
+  }
+
+private:
+  const uint32_t _pool;
+};
+
+} // namespace net
+} // namespace nitro
+} // namespace margelo
@@ -1,9 +1,14 @@
 #pragma once
 
 #include "../nitrogen/generated/shared/c++/HybridHttpParserSpec.hpp"
-#include "NetBindings.hpp"
+#include "HttpParserCore.hpp"
+#include "HttpStreamParser.hpp"
+#include "NetBuffers.hpp"
 #include <NitroModules/ArrayBuffer.hpp>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace margelo {
 namespace nitro {
@@ -13,53 +18,79 @@ using namespace margelo::nitro;
 
 class HybridHttpParser : public HybridHttpParserSpec {
 public:
-  HybridHttpParser(int mode) : HybridObject(TAG) {
-    _id = net_http_parser_create(mode);
-  }
-
-  ~HybridHttpParser() { net_http_parser_destroy(_id); }
+  HybridHttpParser(int mode)
+      : HybridObject(TAG), _mode(mode), _stream(mode) {}
 
   std::string feed(const std::shared_ptr<ArrayBuffer> &data) override {
     if (!data)
       return "";
 
-    char buf[4096];
-    int res =
-        net_http_parser_feed(_id, data->data(), data->size(), buf, sizeof(buf));
-
-    if (res > 0) {
-      // Complete message
-      return std::string(buf, res);
-    } else if (res == 0) {
-      // Partial message
+    std::string_view json;
+    const int res = core().feed(data->data(), data->size(), json);
+    if (res > 0)
+      return std::string(json);
+    if (res == 0)
       return "";
-    } else if (res < -3) {
-      // Buffer too small, required size is -res
-      size_t requiredSize = static_cast<size_t>(-res);
-      std::string largerBuf(requiredSize, '\0');
-      res = net_http_parser_feed(_id, nullptr, 0, &largerBuf[0],
-                                 requiredSize + 1);
-      if (res > 0) {
-        return std::string(largerBuf.data(), res);
-      }
-      return "ERROR: Re-parse failed after enlarging buffer";
-    } else {
-      // Error
-      switch (res) {
-      case -1:
-        return "ERROR: JSON serialization failed";
-      case -2:
-        return "ERROR: HTTP parse failed";
-      case -3:
-        return "ERROR: Parser not found";
-      default:
-        return "ERROR: Unknown error";
-      }
+    return std::string("ERROR: ") + HttpParserCore::errorMessage(res);
+  }
+
+  std::shared_ptr<ArrayBuffer>
+  feedBinary(const std::shared_ptr<ArrayBuffer> &data) override {
+    if (!data)
+      return emptyBuffer();
+
+    auto *frame = new std::vector<uint8_t>();
+    if (!core().feedFrame(data->data(), data->size(), *frame)) {
+      delete frame;
+      return emptyBuffer();
     }
+    return ArrayBuffer::wrap(frame->data(), frame->size(),
+                             [frame] { delete frame; });
+  }
+
+  std::shared_ptr<ArrayBuffer>
+  feedAll(const std::shared_ptr<ArrayBuffer> &data) override {
+    if (!data)
+      return emptyBuffer();
+
+    auto *batch = new std::vector<uint8_t>();
+    _stream.feed(data->data(), data->size(), *batch);
+    return wrapBatch(batch);
   }
 
+  std::shared_ptr<ArrayBuffer> finish() override {
+    auto *batch = new std::vector<uint8_t>();
+    _stream.finish(*batch);
+    return wrapBatch(batch);
+  }
+
+  void expectHeadResponse() override { _stream.expectHeadResponse(); }
+
+  void expectConnectResponse() override { _stream.expectConnectResponse(); }
+
+  void acceptUpgrades(bool accept) override { _stream.acceptUpgrades(accept); }
+
 private:
-  uint32_t _id;
+  static std::shared_ptr<ArrayBuffer> wrapBatch(std::vector<uint8_t> *batch) {
+    if (batch->empty()) {
+      delete batch;
+      return emptyBuffer();
+    }
+    return ArrayBuffer::wrap(batch->data(), batch->size(),
+                             [batch] { delete batch; });
+  }
+
+  // feed and feedBinary return whole messages from the core parser, made on
+  // first use: connections that only use feedAll never allocate one.
+  HttpParserCore &core() {
+    if (!_core)
+      _core = std::make_unique<HttpParserCore>(_mode);
+    return *_core;
+  }
+
+  const int _mode;
+  std::unique_ptr<HttpParserCore> _core;
+  HttpStreamParser _stream;
 };
 
 } // namespace net
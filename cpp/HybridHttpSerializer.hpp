@@ -0,0 +1,172 @@
+#pragma once
+
+#include "../nitrogen/generated/shared/c++/HybridHttpSerializerSpec.hpp"
+#include "../nitrogen/generated/shared/c++/HybridNetSocketDriverSpec.hpp"
+#include "HttpHeaders.hpp"
+#include "NetBuffers.hpp"
+#include <NitroModules/ArrayBuffer.hpp>
+#include <charconv>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace margelo {
+namespace nitro {
+namespace net {
+
+using namespace margelo::nitro;
+
+/// Stateless HTTP/1.1 serializer. Each call renders the framing into a
+/// scratch buffer and hands it, together with the caller's body buffer, to
+/// the socket's writev as one gather write, so the body is never copied into
+/// an intermediate JS string or Buffer.
+class HybridHttpSerializer : public HybridHttpSerializerSpec {
+public:
+  HybridHttpSerializer() : HybridObject(TAG) {}
+
+  double writeHead(const std::shared_ptr<HybridNetSocketDriverSpec> &socket,
+                   double statusCode, const std::string &statusMessage,
+                   const std::vector<double> &headerIds,
+                   const std::vector<std::string> &headers, bool chunked,
+                   const std::optional<std::shared_ptr<ArrayBuffer>> &body,
+                   std::optional<double> bodyOffset,
+                   std::optional<double> bodyLength) override {
+    if (!socket)
+      return 0;
+
+    std::string &head = scratch();
+    head.append("HTTP/1.1 ");
+    appendNumber(head, clampToSize(statusCode, 999), 10);
+    head.push_back(' ');
+    head.append(statusMessage);
+    head.append("\r\n");
+    appendHeaders(head, headerIds, headers);
+    head.append("\r\n");
+
+    const ByteRange range =
+        rangeOf(body.value_or(nullptr), bodyOffset, bodyLength);
+    if (chunked && range.size > 0) {
+      appendNumber(head, range.size, 16);
+      head.append("\r\n");
+    }
+    return send(socket, head, body.value_or(nullptr), range,
+                chunked && range.size > 0);
+  }
+
+  double writeChunk(const std::shared_ptr<HybridNetSocketDriverSpec> &socket,
+                    const std::shared_ptr<ArrayBuffer> &data,
+                    std::optional<double> offset,
+                    std::optional<double> length) override {
+    // An empty chunk would read as the terminator, so it is skipped.
+    const ByteRange range = rangeOf(data, offset, length);
+    if (!socket || range.size == 0)
+      return 0;
+
+    std::string &head = scratch();
+    appendNumber(head, range.size, 16);
+    head.append("\r\n");
+    return send(socket, head, data, range, true);
+  }
+
+  double
+  writeLastChunk(const std::shared_ptr<HybridNetSocketDriverSpec> &socket,
+                 const std::optional<std::vector<std::string>> &trailers)
+      override {
+    if (!socket)
+      return 0;
+
+    std::string &head = scratch();
+    head.append("0\r\n");
+    if (trailers.has_value()) {
+      for (size_t i = 0; i + 1 < trailers->size(); i += 2) {
+        appendField(head, (*trailers)[i], (*trailers)[i + 1]);
+      }
+    }
+    head.append("\r\n");
+    return send(socket, head, nullptr, {nullptr, 0}, false);
+  }
+
+private:
+  static constexpr size_t kMaxRetainedScratch = 64 * 1024;
+
+  // Framing is rendered on the JS thread; the socket's writev copies it
+  // synchronously, so one buffer per thread can be reused across calls.
+  static std::string &scratch() {
+    thread_local std::string buffer;
+    if (buffer.capacity() > kMaxRetainedScratch) {
+      std::string().swap(buffer);
+    }
+    buffer.clear();
+    return buffer;
+  }
+
+  static void appendNumber(std::string &out, size_t value, int base) {
+    char digits[24];
+    const auto result =
+        std::to_chars(digits, digits + sizeof(digits), value, base);
+    out.append(digits, result.ptr);
+  }
+
+  static void appendField(std::string &out, std::string_view name,
+                          std::string_view value) {
+    out.append(name);
+    out.append(": ");
+    out.append(value);
+    out.append("\r\n");
+  }
+
+  // See HttpSerializer in Net.nitro.ts for the (headerIds, headers) layout.
+  static void appendHeaders(std::string &out, const std::vector<double> &ids,
+                            const std::vector<std::string> &strings) {
+    size_t next = 0;
+    for (const double value : ids) {
+      const auto id = static_cast<uint16_t>(value);
+      if (id != 0 && next < strings.size()) {
+        if (appendHeaderName(out, id)) {
+          out.append(": ");
+          out.append(strings[next]);
+          out.append("\r\n");
+        }
+        next += 1;
+      } else if (id == 0 && next + 1 < strings.size()) {
+        appendField(out, strings[next], strings[next + 1]);
+        next += 2;
+      } else {
+        break;
+      }
+    }
+  }
+
+  // Writes `head`, then the body window, then (for a chunk) its closing
+  // CRLF, which rides in the same scratch buffer after the head.
+  static double send(const std::shared_ptr<HybridNetSocketDriverSpec> &socket,
+                     std::string &head,
+                     const std::shared_ptr<ArrayBuffer> &body,
+                     const ByteRange &range, bool closeChunk) {
+    const size_t headSize = head.size();
+    if (closeChunk) {
+      head.append("\r\n");
+    }
+    auto framing = ArrayBuffer::wrap(reinterpret_cast<uint8_t *>(head.data()),
+                                     head.size(), [] {});
+
+    std::vector<std::shared_ptr<ArrayBuffer>> buffers{framing};
+    std::vector<double> ranges{0, static_cast<double>(headSize)};
+    if (range.size > 0) {
+      buffers.push_back(body);
+      ranges.push_back(static_cast<double>(range.data - body->data()));
+      ranges.push_back(static_cast<double>(range.size));
+    }
+    if (closeChunk) {
+      buffers.push_back(framing);
+      ranges.push_back(static_cast<double>(headSize));
+      ranges.push_back(2);
+    }
+    socket->writev(buffers, ranges);
+    return static_cast<double>(head.size() + range.size);
+  }
+};
+
+} // namespace net
+} // namespace nitro
+} // namespace margelo
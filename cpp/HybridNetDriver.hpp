@@ -1,14 +1,34 @@
 #pragma once
 
+#include "../nitrogen/generated/shared/c++/HybridConnectionPoolSpec.hpp"
 #include "../nitrogen/generated/shared/c++/HybridHttpParserSpec.hpp"
+#include "../nitrogen/generated/shared/c++/HybridHttpSerializerSpec.hpp"
 #include "../nitrogen/generated/shared/c++/HybridNetDriverSpec.hpp"
+#include "HybridConnectionPool.hpp"
 #include "HybridHttpParser.hpp"
+#include "HybridHttpSerializer.hpp"
 #include "HybridNetServerDriver.hpp"
 #include "HybridNetSocketDriver.hpp"
+#include "NetAdmission.hpp"
+#include "NetBuffers.hpp"
+#include "NetDnsCache.hpp"
+#include "NetEventPump.hpp"
+#include "NetLanes.hpp"
+#include "NetLog.hpp"
 #include "NetManager.hpp"
+#include "NetPrewarm.hpp"
+#include "NetSecureContextCache.hpp"
+#include "NetSessionCache.hpp"
+#include "NetStats.hpp"
 #include <NitroModules/ArrayBuffer.hpp>
+#include <NitroModules/Promise.hpp>
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <optional>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace margelo {
 namespace nitro {
@@ -21,27 +41,61 @@ public:
   HybridNetDriver() : HybridObject(TAG) {}
 
   std::shared_ptr<HybridNetSocketDriverSpec>
-  createSocket(const std::optional<std::string> &id) override {
+  createSocket(const std::optional<std::string> &id,
+               const std::optional<std::string> &lane) override {
     if (id.has_value()) {
       // Existing socket from server accept
       try {
         uint32_t socketId = static_cast<uint32_t>(std::stoul(id.value()));
-        return std::make_shared<HybridNetSocketDriver>(socketId);
+        AdmissionControl::pickedUp(socketId);
+        return std::make_shared<HybridNetSocketDriver>(socketId, lane);
       } catch (...) {
-        return std::make_shared<HybridNetSocketDriver>();
+        return std::make_shared<HybridNetSocketDriver>(lane);
       }
     }
-    return std::make_shared<HybridNetSocketDriver>();
+    return std::make_shared<HybridNetSocketDriver>(lane);
   }
 
-  std::shared_ptr<HybridNetServerDriverSpec> createServer() override {
-    return std::make_shared<HybridNetServerDriver>();
+  std::shared_ptr<HybridNetServerDriverSpec>
+  createServer(const std::optional<std::string> &lane) override {
+    return std::make_shared<HybridNetServerDriver>(lane);
+  }
+
+  void configureLane(const std::string &name,
+                     const LaneOptions &options) override {
+    LaneSettings settings;
+    if (options.priority.has_value())
+      settings.priority =
+          std::clamp(static_cast<int>(*options.priority), -20, 19);
+    if (options.cpus.has_value()) {
+      for (const double cpu : *options.cpus)
+        settings.cpus.push_back(static_cast<int>(cpu));
+    }
+    ExecutorLanes::shared().configure(name, std::move(settings));
+  }
+
+  void setEventPump(
+      const std::optional<std::function<void()>> &onWake) override {
+    EventPump::shared().setWake(onWake.value_or(nullptr));
+  }
+
+  PumpedEvents drainEvents() override {
+    EventPump::Batch batch = EventPump::shared().drain();
+    return PumpedEvents(std::move(batch.descriptors), std::move(batch.data));
   }
 
   std::shared_ptr<HybridHttpParserSpec> createHttpParser(double mode) override {
     return std::make_shared<HybridHttpParser>(static_cast<int>(mode));
   }
 
+  std::shared_ptr<HybridHttpSerializerSpec> createHttpSerializer() override {
+    return std::make_shared<HybridHttpSerializer>();
+  }
+
+  std::shared_ptr<HybridConnectionPoolSpec> createConnectionPool() override {
+    return std::make_shared<HybridConnectionPool>();
+  }
+
   double
   createSecureContext(const std::string &cert, const std::string &key,
                       const std::optional<std::string> &passphrase) override {
@@ -55,6 +109,7 @@ public:
   }
 
   void addCACertToSecureContext(double scId, const std::string &ca) override {
+    SecureContextCache::shared().forget(static_cast<uint32_t>(scId));
     net_secure_context_add_ca(static_cast<uint32_t>(scId), ca.c_str());
   }
 
@@ -62,6 +117,7 @@ public:
       double scId, const std::string &hostname, const std::string &cert,
       const std::string &key,
       const std::optional<std::string> &passphrase) override {
+    SecureContextCache::shared().forget(static_cast<uint32_t>(scId));
     net_secure_context_add_context(
         static_cast<uint32_t>(scId), hostname.c_str(), cert.c_str(),
         key.c_str(),
@@ -72,6 +128,7 @@ public:
   setPFXToSecureContext(double scId, const std::shared_ptr<ArrayBuffer> &pfx,
                         const std::optional<std::string> &passphrase) override {
     if (pfx) {
+      SecureContextCache::shared().forget(static_cast<uint32_t>(scId));
       net_secure_context_set_pfx(
           static_cast<uint32_t>(scId), pfx->data(), pfx->size(),
           passphrase.has_value() ? passphrase.value().c_str() : nullptr);
@@ -81,6 +138,7 @@ public:
   void setOCSPResponseToSecureContext(
       double scId, const std::shared_ptr<ArrayBuffer> &ocsp) override {
     if (ocsp) {
+      SecureContextCache::shared().forget(static_cast<uint32_t>(scId));
       net_secure_context_set_ocsp_response(static_cast<uint32_t>(scId),
                                            ocsp->data(), ocsp->size());
     }
@@ -88,27 +146,237 @@ public:
 
   std::optional<std::shared_ptr<ArrayBuffer>>
   getTicketKeys(double scId) override {
-    uint8_t buf[256];
-    size_t len = net_server_get_ticket_keys(static_cast<uint32_t>(scId), buf,
-                                            sizeof(buf));
-    if (len > 0) {
-      return ArrayBuffer::copy(buf, len);
-    }
-    return std::nullopt;
+    const uint32_t id = static_cast<uint32_t>(scId);
+    return readCoreBytes([id](uint8_t *buf, size_t len) {
+      return net_server_get_ticket_keys(id, buf, len);
+    });
   }
 
   void setTicketKeys(double scId,
                      const std::shared_ptr<ArrayBuffer> &keys) override {
     if (keys) {
+      SecureContextCache::shared().forget(static_cast<uint32_t>(scId));
       net_server_set_ticket_keys(static_cast<uint32_t>(scId), keys->data(),
                                  keys->size());
     }
   }
 
+  double createSecureContextFromBundle(const SecureContextBundle &bundle,
+                                       bool cached) override {
+    return static_cast<double>(
+        SecureContextCache::shared().obtain(materialOf(bundle), cached));
+  }
+
+  std::shared_ptr<Promise<double>>
+  createSecureContextFromBundleAsync(const SecureContextBundle &bundle,
+                                     bool cached) override {
+    auto promise = Promise<double>::create();
+    SecureContextCache::shared().obtainAsync(
+        materialOf(bundle), cached, [promise](uint32_t id) {
+          if (id != 0) {
+            promise->resolve(static_cast<double>(id));
+          } else {
+            promise->reject(std::make_exception_ptr(std::runtime_error(
+                "Invalid certificate, key or PFX")));
+          }
+        });
+    return promise;
+  }
+
+  std::shared_ptr<Promise<void>> addContextToSecureContextAsync(
+      double scId, const std::string &hostname, const std::string &cert,
+      const std::string &key,
+      const std::optional<std::string> &passphrase) override {
+    const uint32_t id = static_cast<uint32_t>(scId);
+    SecureContextCache::shared().forget(id);
+    auto promise = Promise<void>::create();
+    SecureContextCache::shared().run(
+        [promise, id, hostname, cert, key, passphrase] {
+          net_secure_context_add_context(
+              id, hostname.c_str(), cert.c_str(), key.c_str(),
+              passphrase.has_value() ? passphrase->c_str() : nullptr);
+          promise->resolve();
+        });
+    return promise;
+  }
+
+  std::shared_ptr<Promise<void>> setPFXToSecureContextAsync(
+      double scId, const std::shared_ptr<ArrayBuffer> &pfx,
+      const std::optional<std::string> &passphrase) override {
+    const uint32_t id = static_cast<uint32_t>(scId);
+    auto promise = Promise<void>::create();
+    if (!pfx) {
+      promise->resolve();
+      return promise;
+    }
+    SecureContextCache::shared().forget(id);
+    // The JS buffer must not be touched off the JS thread.
+    std::vector<uint8_t> data(pfx->data(), pfx->data() + pfx->size());
+    SecureContextCache::shared().run(
+        [promise, id, data = std::move(data), passphrase] {
+          net_secure_context_set_pfx(
+              id, data.data(), data.size(),
+              passphrase.has_value() ? passphrase->c_str() : nullptr);
+          promise->resolve();
+        });
+    return promise;
+  }
+
+  SecureContextCacheStats getSecureContextCacheStats() override {
+    const SecureContextCache::Stats stats =
+        SecureContextCache::shared().stats();
+    return SecureContextCacheStats(static_cast<double>(stats.hits),
+                                   static_cast<double>(stats.misses),
+                                   static_cast<double>(stats.entries));
+  }
+
+  void clearSecureContextCache() override {
+    SecureContextCache::shared().clear();
+  }
+
   void initWithConfig(const NetConfig &config) override {
+    // The log level is a runtime setting and applies even if the runtime is
+    // already up.
+    if (config.logLevel.has_value()) {
+      int level = std::clamp(static_cast<int>(config.logLevel.value()),
+                             static_cast<int>(LogLevel::None),
+                             static_cast<int>(LogLevel::Debug));
+      NetLog::shared().setLevel(static_cast<LogLevel>(level));
+    } else if (config.debug.value_or(false)) {
+      NetLog::shared().setLevel(LogLevel::Debug);
+    }
+
+    // Connect and DNS settings are runtime settings as well.
+    ConnectConfig &connect = ConnectConfig::shared();
+    if (config.happyEyeballs.has_value()) {
+      connect.happyEyeballs.store(config.happyEyeballs.value());
+    }
+    if (config.connectionAttemptDelay.has_value()) {
+      connect.attemptDelayMillis.store(static_cast<uint32_t>(
+          std::max(config.connectionAttemptDelay.value(), 10.0)));
+    }
+    DnsCache &dns = DnsCache::shared();
+    dns.configure(millisOr(config.dnsCacheTtl, dns.ttl()),
+                  millisOr(config.dnsNegativeTtl, dns.negativeTtl()),
+                  config.dnsCacheSize.has_value()
+                      ? static_cast<size_t>(
+                            std::max(config.dnsCacheSize.value(), 1.0))
+                      : dns.capacity());
+
     uint32_t workerThreads = config.workerThreads.value_or(0);
     NetManager::shared().initWithConfig(workerThreads);
   }
+
+  BufferPoolStats getBufferPoolStats() override {
+    const BufferPool::Stats stats = BufferPool::shared().stats();
+    return BufferPoolStats(static_cast<double>(stats.hits),
+                           static_cast<double>(stats.misses),
+                           static_cast<double>(stats.oversize),
+                           static_cast<double>(stats.inUseBytes),
+                           static_cast<double>(stats.cachedBytes));
+  }
+
+  void setSessionCacheSize(double secureContextId, double maxEntries) override {
+    TlsSessionCache::shared().setCapacity(
+        static_cast<uint32_t>(secureContextId),
+        static_cast<size_t>(std::max(maxEntries, 0.0)));
+  }
+
+  TlsSessionCacheStats getSessionCacheStats(double secureContextId) override {
+    const TlsSessionCache::Stats stats = TlsSessionCache::shared().stats(
+        static_cast<uint32_t>(secureContextId));
+    return TlsSessionCacheStats(static_cast<double>(stats.hits),
+                                static_cast<double>(stats.misses),
+                                static_cast<double>(stats.evictions),
+                                static_cast<double>(stats.entries),
+                                static_cast<double>(stats.capacity));
+  }
+
+  void prefetchDns(const std::string &host) override {
+    if (ipLiteralFamily(host) == 0) {
+      DnsCache::shared().prefetch(host);
+    }
+  }
+
+  std::shared_ptr<Promise<bool>> prewarm(const std::string &host, double port,
+                                         bool tls) override {
+    auto promise = Promise<bool>::create();
+    Prewarmer::shared().start(host, static_cast<int>(port), tls,
+                              [promise](bool parked) {
+                                promise->resolve(parked);
+                              });
+    return promise;
+  }
+
+  std::optional<std::shared_ptr<HybridNetSocketDriverSpec>>
+  takePrewarmed(const std::string &host, double port, bool tls) override {
+    auto driver = Prewarmer::take(host, static_cast<int>(port), tls);
+    if (!driver)
+      return std::nullopt;
+    return driver;
+  }
+
+  void clearDnsCache() override { DnsCache::shared().clear(); }
+
+  DnsCacheStats getDnsCacheStats() override {
+    const DnsCache::Stats stats = DnsCache::shared().stats();
+    return DnsCacheStats(static_cast<double>(stats.hits),
+                         static_cast<double>(stats.misses),
+                         static_cast<double>(stats.negativeHits),
+                         static_cast<double>(stats.prefetches),
+                         static_cast<double>(stats.entries));
+  }
+
+  NetRuntimeStats getRuntimeStats() override {
+    RuntimeStats &stats = RuntimeStats::shared();
+    return NetRuntimeStats(
+        static_cast<double>(stats.traffic.bytesRead.load()),
+        static_cast<double>(stats.traffic.bytesWritten.load()),
+        static_cast<double>(stats.traffic.events.load()),
+        static_cast<double>(stats.traffic.bufferBytes.load()),
+        static_cast<double>(stats.openSockets.load()),
+        static_cast<double>(stats.openServers.load()),
+        static_cast<double>(std::max<int64_t>(stats.writeQueueBytes.load(), 0)),
+        static_cast<double>(NetScheduler::shared().pending()),
+        latencyOf(stats.dispatchLatency), latencyOf(stats.connectTime),
+        latencyOf(stats.handshakeTime), latencyOf(stats.dnsTime));
+  }
+
+private:
+  static LatencyStats latencyOf(const LatencyHistogram &histogram) {
+    const LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+    const auto millis = [](double micros) { return micros / 1000.0; };
+    return LatencyStats(static_cast<double>(snapshot.count),
+                        millis(static_cast<double>(snapshot.min)),
+                        millis(snapshot.mean),
+                        millis(static_cast<double>(snapshot.p50)),
+                        millis(static_cast<double>(snapshot.p90)),
+                        millis(static_cast<double>(snapshot.p99)),
+                        millis(static_cast<double>(snapshot.max)));
+  }
+
+  static std::chrono::milliseconds
+  millisOr(std::optional<double> value, std::chrono::milliseconds fallback) {
+    if (!value.has_value())
+      return fallback;
+    return std::chrono::milliseconds(
+        static_cast<int64_t>(std::max(value.value(), 0.0)));
+  }
+
+  // Copies the bundle off the JS heap, so it may be parsed on any thread.
+  static SecureContextMaterial materialOf(const SecureContextBundle &bundle) {
+    SecureContextMaterial material;
+    material.cert = bundle.cert.value_or("");
+    material.key = bundle.key.value_or("");
+    material.passphrase = bundle.passphrase;
+    if (bundle.pfx.has_value() && bundle.pfx.value()) {
+      const auto &pfx = bundle.pfx.value();
+      material.pfx.assign(pfx->data(), pfx->data() + pfx->size());
+    }
+    if (bundle.ca.has_value())
+      material.ca = bundle.ca.value();
+    return material;
+  }
 };
 
 } // namespace net
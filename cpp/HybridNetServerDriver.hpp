@@ -1,11 +1,27 @@
 #pragma once
 
 #include "../nitrogen/generated/shared/c++/HybridNetServerDriverSpec.hpp"
+#include "NetAdmission.hpp"
 #include "NetBindings.hpp"
+#include "NetBuffers.hpp"
+#include "NetEventBatcher.hpp"
+#include "NetEventPump.hpp"
+#include "NetLanes.hpp"
+#include "NetLog.hpp"
 #include "NetManager.hpp"
+#include "NetScheduler.hpp"
+#include "NetStats.hpp"
 #include <NitroModules/ArrayBuffer.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace margelo {
 namespace nitro {
@@ -13,15 +29,22 @@ namespace net {
 
 class HybridNetServerDriver : public HybridNetServerDriverSpec {
 public:
-  HybridNetServerDriver() : HybridObject(TAG) {
+  /// `lane` names the executor lane running the server's timers (see
+  /// ExecutorLanes); none is the default lane.
+  explicit HybridNetServerDriver(
+      const std::optional<std::string> &lane = std::nullopt)
+      : HybridObject(TAG), _scheduler(ExecutorLanes::shared().scheduler(lane)) {
+    NetManager::shared().start();
     _id = net_create_server();
-    NetManager::shared().registerHandler(
-        _id, [this](int type, const uint8_t *data, size_t len) {
-          this->onNativeEvent(type, data, len);
-        });
+    _group->owner = this;
+    RuntimeStats::shared().openServers++;
+    NetManager::shared().registerHandler(_id, this, onNativeEventThunk);
   }
 
-  ~HybridNetServerDriver() override { destroy(); }
+  ~HybridNetServerDriver() override {
+    destroy();
+    RuntimeStats::shared().openServers--;
+  }
 
   // Properties
   std::function<void(double, const std::shared_ptr<ArrayBuffer> &)>
@@ -34,95 +57,559 @@ public:
     _onEvent = onEvent;
   }
 
-  double getMaxConnections() override { return _maxConnections; }
+  std::function<void(const std::shared_ptr<ArrayBuffer> &,
+                     const std::shared_ptr<ArrayBuffer> &)>
+  getOnEventBatch() override {
+    return _batcher->callback();
+  }
+  void setOnEventBatch(
+      const std::function<void(const std::shared_ptr<ArrayBuffer> &,
+                               const std::shared_ptr<ArrayBuffer> &)>
+          &onEventBatch) override {
+    _batcher->setCallback(onEventBatch);
+  }
+
+  double getMaxConnections() override {
+    std::lock_guard lock(_group->mutex);
+    return _group->maxConnections;
+  }
   void setMaxConnections(double maxConnections) override {
-    _maxConnections = maxConnections;
-    net_server_set_max_connections(_id, static_cast<int>(maxConnections));
+    std::vector<uint32_t> ids;
+    {
+      std::lock_guard lock(_group->mutex);
+      _group->maxConnections = maxConnections;
+      ids.push_back(_id);
+      for (const auto &shard : _group->shards) {
+        ids.push_back(shard->id);
+      }
+    }
+    // Each listener enforces its share of the limit.
+    const int limit = shareOf(maxConnections, ids.size());
+    for (const uint32_t id : ids) {
+      net_server_set_max_connections(id, limit);
+    }
+  }
+
+  double getAcceptRate() override { return _admission->config().rate; }
+  void setAcceptRate(double acceptRate) override {
+    updateAdmission([&](AdmissionControl::Config &config) {
+      config.rate = std::max(acceptRate, 0.0);
+    });
+  }
+
+  double getAcceptBurst() override { return _admission->config().burst; }
+  void setAcceptBurst(double acceptBurst) override {
+    updateAdmission([&](AdmissionControl::Config &config) {
+      config.burst = std::max(acceptBurst, 0.0);
+    });
+  }
+
+  double getMaxPendingAccepts() override {
+    return static_cast<double>(_admission->config().maxBacklog);
+  }
+  void setMaxPendingAccepts(double maxPendingAccepts) override {
+    updateAdmission([&](AdmissionControl::Config &config) {
+      config.maxBacklog =
+          maxPendingAccepts > 0 ? static_cast<size_t>(maxPendingAccepts) : 0;
+    });
+  }
+
+  double getShedMode() override {
+    return static_cast<double>(_admission->config().shedMode);
+  }
+  void setShedMode(double shedMode) override {
+    updateAdmission([&](AdmissionControl::Config &config) {
+      config.shedMode = shedMode == 1 ? AdmissionControl::ShedMode::Http503
+                                      : AdmissionControl::ShedMode::Reset;
+    });
+  }
+
+  ServerStats getStats() override {
+    const AdmissionControl::Report admission = _admission->current();
+    return ServerStats(static_cast<double>(_accepted.load()),
+                       static_cast<double>(admission.shed),
+                       static_cast<double>(admission.backlog),
+                       static_cast<double>(_traffic->events.load()),
+                       static_cast<double>(_traffic->bufferBytes.load()));
   }
 
   // Methods
   void listen(double port, std::optional<double> backlog,
-              std::optional<bool> ipv6Only,
-              std::optional<bool> reusePort) override {
-    net_listen(_id, static_cast<int>(port),
-               static_cast<int>(backlog.value_or(128)),
-               ipv6Only.value_or(false), reusePort.value_or(false));
+              std::optional<bool> ipv6Only, std::optional<bool> reusePort,
+              std::optional<double> listeners) override {
+    startListening(ListenParams{static_cast<int>(port),
+                                static_cast<int>(backlog.value_or(128)),
+                                ipv6Only.value_or(false),
+                                reusePort.value_or(false), std::nullopt},
+                   listeners);
   }
 
   void listenTLS(double port, double secureContextId,
                  std::optional<double> backlog, std::optional<bool> ipv6Only,
-                 std::optional<bool> reusePort) override {
-    net_listen_tls(_id, static_cast<int>(port),
-                   static_cast<int>(backlog.value_or(128)),
-                   ipv6Only.value_or(false), reusePort.value_or(false),
-                   static_cast<uint32_t>(secureContextId));
+                 std::optional<bool> reusePort,
+                 std::optional<double> listeners) override {
+    startListening(ListenParams{static_cast<int>(port),
+                                static_cast<int>(backlog.value_or(128)),
+                                ipv6Only.value_or(false),
+                                reusePort.value_or(false),
+                                static_cast<uint32_t>(secureContextId)},
+                   listeners);
   }
 
   void listenUnix(const std::string &path,
                   std::optional<double> backlog) override {
+    _localAddress.clear();
     net_listen_unix(_id, path.c_str(), static_cast<int>(backlog.value_or(128)));
   }
 
   void listenTLSUnix(const std::string &path, double secureContextId,
                      std::optional<double> backlog) override {
+    _localAddress.clear();
     net_listen_tls_unix(_id, path.c_str(),
                         static_cast<int>(backlog.value_or(128)),
                         static_cast<uint32_t>(secureContextId));
   }
 
   void listenHandle(double fd, std::optional<double> backlog) override {
+    _localAddress.clear();
     net_listen_handle(_id, static_cast<int>(fd),
                       static_cast<int>(backlog.value_or(128)));
   }
 
   std::string getLocalAddress() override {
-    char buf[256];
-    size_t len = net_get_server_local_address(_id, buf, sizeof(buf));
-    if (len > 0 && len < sizeof(buf)) {
-      buf[len] = '\0';
-      return std::string(buf);
+    // Fixed while listening; read from the core once per listen.
+    if (!_localAddress.empty())
+      return _localAddress;
+    const uint32_t id = _id;
+    _localAddress = readCoreString([id](char *buf, size_t len) {
+      return net_get_server_local_address(id, buf, len);
+    });
+    return _localAddress;
+  }
+
+  void setEventBatching(bool enabled, std::optional<double> intervalMicros,
+                        std::optional<double> maxBatchBytes) override {
+    _batchingConfigured = true;
+    _batcher->configure(
+        enabled,
+        static_cast<uint32_t>(
+            intervalMicros.value_or(EventBatcher::kDefaultIntervalMicros)),
+        static_cast<size_t>(
+            maxBatchBytes.value_or(EventBatcher::kDefaultMaxBatchBytes)));
+  }
+
+  double attachEventPump() override {
+    uint32_t key = _pumpKey.load(std::memory_order_acquire);
+    if (key == 0) {
+      key = EventPump::shared().newKey();
+      _pumpKey.store(key, std::memory_order_release);
     }
-    return "";
+    return static_cast<double>(key);
   }
 
   void close() override {
-    if (_id != 0) {
-      net_server_close(_id);
+    _localAddress.clear();
+    std::vector<uint32_t> ids;
+    {
+      std::lock_guard lock(_group->mutex);
+      _group->closing = true;
+      if (_id != 0)
+        ids.push_back(_id);
+      for (const auto &shard : _group->shards) {
+        ids.push_back(shard->id);
+      }
+    }
+    for (const uint32_t id : ids) {
+      net_server_close(id);
+    }
+    // Connections still waiting for the rate limiter never reach JS.
+    for (const uint32_t id : _admission->takeQueued()) {
+      AdmissionControl::shed(id, AdmissionControl::ShedMode::Reset);
     }
   }
 
 private:
+  struct ListenParams {
+    int port;
+    int backlog;
+    bool ipv6Only;
+    bool reusePort;
+    std::optional<uint32_t> secureContextId; // Set for TLS listeners
+  };
+
+  // An extra SO_REUSEPORT listener on the primary's port.
+  struct Shard {
+    HybridNetServerDriver *owner;
+    uint32_t id;
+    bool listening = false;
+  };
+
+  // Listener bookkeeping shared with deferred tasks, which may outlive the
+  // driver; `owner` is cleared (under `mutex`) once the driver is gone.
+  struct Group {
+    std::mutex mutex;
+    HybridNetServerDriver *owner = nullptr;
+    ListenParams params{};
+    double maxConnections = 0; // Split evenly across the listeners
+    uint32_t wanted = 0;  // Shards still to be started
+    uint32_t pending = 0; // Started shards that have not answered yet
+    uint32_t open = 1;    // Listeners that have not reported CLOSE
+    bool holdingListening = false;
+    bool closing = false;
+    bool draining = false; // A drain of queued accepts is scheduled
+    std::vector<std::unique_ptr<Shard>> shards;
+  };
+
+  template <typename Update> void updateAdmission(Update update) {
+    AdmissionControl::Config config = _admission->config();
+    update(config);
+    _admission->configure(config);
+    // Lifting the rate limit releases connections already queued.
+    scheduleDrain();
+  }
+
+  static void listenOn(uint32_t id, const ListenParams &params) {
+    if (params.secureContextId.has_value()) {
+      net_listen_tls(id, params.port, params.backlog, params.ipv6Only,
+                     params.reusePort, *params.secureContextId);
+    } else {
+      net_listen(id, params.port, params.backlog, params.ipv6Only,
+                 params.reusePort);
+    }
+  }
+
+  static int shareOf(double limit, size_t listeners) {
+    if (limit <= 0 || listeners == 0)
+      return static_cast<int>(limit);
+    return static_cast<int>((static_cast<size_t>(limit) + listeners - 1) /
+                            listeners);
+  }
+
+  // With `listeners` > 1 (0 = one per runtime worker), the primary binds
+  // first and, once it listens, as many SO_REUSEPORT listeners as needed
+  // join it on the same (possibly kernel-chosen) port. The kernel spreads
+  // incoming connections across them, so accepts run on several workers
+  // instead of funnelling through one accept loop. 'listening' is reported
+  // once every listener has answered.
+  void startListening(ListenParams params, std::optional<double> listeners) {
+    _localAddress.clear();
+    uint32_t count = 1;
+    if (listeners.has_value()) {
+      count = *listeners <= 0 ? NetManager::shared().workerThreads()
+                              : static_cast<uint32_t>(*listeners);
+    }
+    if (count > 1) {
+      params.reusePort = true;
+      std::lock_guard lock(_group->mutex);
+      _group->params = params;
+      _group->wanted = count - 1;
+      // Accept bursts from several listeners reach JS as one call.
+      if (!_batchingConfigured) {
+        _batcher->configure(true, EventBatcher::kDefaultIntervalMicros,
+                            EventBatcher::kDefaultMaxBatchBytes);
+      }
+    }
+    listenOn(_id, params);
+  }
+
+  // Runs on the scheduler thread once the primary listens.
+  static void startShards(const std::shared_ptr<Group> &group) {
+    std::lock_guard lock(group->mutex);
+    HybridNetServerDriver *owner = group->owner;
+    if (owner == nullptr || group->closing || group->wanted == 0) {
+      group->wanted = 0;
+      if (owner != nullptr && group->holdingListening) {
+        group->holdingListening = false;
+        owner->deliverListening();
+      }
+      return;
+    }
+
+    ListenParams params = group->params;
+    params.port = boundPort(owner->_id, params.port);
+    const uint32_t count = group->wanted;
+    const int limit = shareOf(group->maxConnections, count + 1);
+    group->wanted = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      auto shard = std::make_unique<Shard>(Shard{owner, net_create_server()});
+      NetManager::shared().registerHandler(shard->id, shard.get(),
+                                           onShardEventThunk);
+      if (limit > 0)
+        net_server_set_max_connections(shard->id, limit);
+      listenOn(shard->id, params);
+      group->shards.push_back(std::move(shard));
+      group->pending++;
+    }
+    if (limit > 0)
+      net_server_set_max_connections(owner->_id, limit);
+    NET_LOGI(Server, "Server %u: started %u reuse-port listeners on port %d",
+             owner->_id, count, params.port);
+  }
+
+  // The port listener `id` bound, or `fallback`. Asks the core directly:
+  // _localAddress is the JS thread's cache.
+  static int boundPort(uint32_t id, int fallback) {
+    const std::string address = readCoreString([id](char *buf, size_t len) {
+      return net_get_server_local_address(id, buf, len);
+    });
+    const size_t colon = address.rfind(':');
+    if (colon == std::string::npos)
+      return fallback;
+    return std::atoi(address.c_str() + colon + 1);
+  }
+
+  void deliverListening() {
+    static constexpr char kSuccess[] = "success";
+    deliver(6, reinterpret_cast<const uint8_t *>(kSuccess),
+            sizeof(kSuccess) - 1);
+  }
+
   void destroy() {
-    if (_id != 0) {
-      NetManager::shared().unregisterHandler(_id);
-      net_destroy_server(_id);
+    std::vector<std::unique_ptr<Shard>> shards;
+    uint32_t id = 0;
+    {
+      std::lock_guard lock(_group->mutex);
+      _group->owner = nullptr;
+      shards = std::move(_group->shards);
+      _group->shards.clear();
+      id = _id;
       _id = 0;
     }
+    for (const uint32_t queued : _admission->takeQueued()) {
+      AdmissionControl::shed(queued, AdmissionControl::ShedMode::Reset);
+    }
+    for (const auto &shard : shards) {
+      NetManager::shared().unregisterHandler(shard->id);
+      net_destroy_server(shard->id);
+    }
+    if (id != 0) {
+      NetManager::shared().unregisterHandler(id);
+      _batcher->close();
+      net_destroy_server(id);
+    }
   }
 
-  void onNativeEvent(int type, const uint8_t *data, size_t len) {
-    if (!_onEvent)
+  static void onShardEventThunk(void *context, int type, const uint8_t *data,
+                                size_t len) {
+    auto *shard = static_cast<Shard *>(context);
+    shard->owner->onShardEvent(*shard, type, data, len);
+  }
+
+  void onShardEvent(Shard &shard, int type, const uint8_t *data, size_t len) {
+    if (type == 6 && isListening(data, len)) {
+      std::lock_guard lock(_group->mutex);
+      shard.listening = true;
+      _group->open++;
+      shardAnsweredLocked();
+      return;
+    }
+    if (type == 3) { // ERROR
+      std::unique_lock lock(_group->mutex);
+      if (!shard.listening) {
+        // A listener that failed to bind is dropped; the others carry on.
+        NET_LOGW(Server, "Reuse-port listener %u failed: %.*s", shard.id,
+                 static_cast<int>(len), reinterpret_cast<const char *>(data));
+        shardAnsweredLocked();
+        return;
+      }
+    }
+    if (type == 4) { // CLOSE
+      // Only listeners that came up were counted as open.
+      if (shard.listening)
+        listenerClosed();
+      return;
+    }
+    if (type == 6) {
+      admit(data, len);
       return;
+    }
+    deliver(type, data, len);
+  }
 
-    std::shared_ptr<ArrayBuffer> ab;
-    if (data && len > 0) {
-      ab = ArrayBuffer::copy(data, len);
-    } else {
-      static uint8_t empty = 0;
-      ab = ArrayBuffer::copy(&empty, 0);
+  // Caller holds _group->mutex.
+  void shardAnsweredLocked() {
+    if (_group->pending > 0)
+      _group->pending--;
+    if (_group->pending == 0 && _group->holdingListening) {
+      _group->holdingListening = false;
+      deliverListening();
     }
+  }
 
-    _onEvent(static_cast<double>(type), ab);
+  static bool isListening(const uint8_t *data, size_t len) {
+    return len == 7 && std::memcmp(data, "success", 7) == 0;
+  }
 
-    if (type == 4) { // CLOSE
-      LOGI("Server %u received CLOSE event, destroying...", _id);
+  void listenerClosed() {
+    bool last = false;
+    {
+      std::lock_guard lock(_group->mutex);
+      last = --_group->open == 0;
+    }
+    if (last) {
+      static constexpr uint8_t kEmpty = 0;
+      deliver(4, &kEmpty, 0);
+      NET_LOGI(Server, "Server %u received CLOSE event, destroying...", _id);
       destroy();
     }
   }
 
+  static void onNativeEventThunk(void *context, int type, const uint8_t *data,
+                                 size_t len) {
+    static_cast<HybridNetServerDriver *>(context)->onNativeEvent(type, data,
+                                                                 len);
+  }
+
+  void onNativeEvent(int type, const uint8_t *data, size_t len) {
+    if (type == 6 && isListening(data, len)) {
+      std::lock_guard lock(_group->mutex);
+      if (_group->wanted > 0) {
+        // Hold 'listening' until the reuse-port listeners have answered.
+        _group->holdingListening = true;
+        _scheduler.schedule(std::chrono::microseconds(0),
+                            [group = _group] { startShards(group); });
+        return;
+      }
+    }
+    if (type == 4) { // CLOSE
+      listenerClosed();
+      return;
+    }
+    if (type == 6) {
+      admit(data, len);
+      return;
+    }
+    deliver(type, data, len);
+  }
+
+  // Runs accepted connection events (payload: the client ID) through
+  // admission control before they reach JS.
+  void admit(const uint8_t *data, size_t len) {
+    if (isListening(data, len)) {
+      deliver(6, data, len);
+      return;
+    }
+    _accepted.fetch_add(1, std::memory_order_relaxed);
+    if (!_admission->enabled()) {
+      deliver(6, data, len);
+      return;
+    }
+    const std::string payload(reinterpret_cast<const char *>(data), len);
+    const auto id =
+        static_cast<uint32_t>(std::strtoul(payload.c_str(), nullptr, 10));
+    switch (_admission->offer(id)) {
+    case AdmissionControl::Decision::Admit:
+      deliver(6, data, len);
+      break;
+    case AdmissionControl::Decision::Queue:
+      scheduleDrain();
+      break;
+    case AdmissionControl::Decision::Shed:
+      NET_LOGD(Server, "Server %u: shedding connection %u", _id, id);
+      AdmissionControl::shed(id, _admission->config().shedMode);
+      break;
+    }
+    reportPressure();
+  }
+
+  void scheduleDrain() {
+    std::lock_guard lock(_group->mutex);
+    scheduleDrainLocked();
+  }
+
+  // Caller holds _group->mutex.
+  void scheduleDrainLocked() {
+    if (_group->draining)
+      return;
+    const auto delay = _admission->nextDrain();
+    if (!delay.has_value())
+      return;
+    _group->draining = true;
+    _scheduler.schedule(*delay, [group = _group] {
+      std::lock_guard lock(group->mutex);
+      group->draining = false;
+      if (group->owner != nullptr)
+        group->owner->drainAdmittedLocked();
+    });
+  }
+
+  // Hands queued connections whose tokens arrived to JS.
+  void drainAdmittedLocked() {
+    for (const uint32_t id : _admission->drain()) {
+      const std::string payload = std::to_string(id);
+      deliver(6, reinterpret_cast<const uint8_t *>(payload.data()),
+              payload.size());
+    }
+    reportPressure();
+    scheduleDrainLocked();
+  }
+
+  // SERVER_PRESSURE (12) payload: "level,pending,shed". While the level is
+  // raised it is re-checked periodically, so relief is reported even when
+  // no further connections arrive.
+  void reportPressure() {
+    const auto report = _admission->pressureChange();
+    if (report.has_value()) {
+      const std::string payload =
+          std::to_string(static_cast<int>(report->level)) + ',' +
+          std::to_string(report->backlog) + ',' + std::to_string(report->shed);
+      NET_LOGI(Server, "Server %u: pressure %s", _id, payload.c_str());
+      deliver(12, reinterpret_cast<const uint8_t *>(payload.data()),
+              payload.size());
+    }
+    if (_admission->pressure() == AdmissionControl::Pressure::Normal ||
+        _pressureCheck.exchange(true))
+      return;
+    _scheduler.schedule(kPressureCheck, [group = _group] {
+      std::lock_guard lock(group->mutex);
+      if (group->owner == nullptr)
+        return;
+      group->owner->_pressureCheck = false;
+      group->owner->reportPressure();
+    });
+  }
+
+  void deliver(int type, const uint8_t *data, size_t len) {
+    if (const uint32_t key = _pumpKey.load(std::memory_order_acquire)) {
+      EventPump::shared().push(key, type, data, len,
+                               NetScheduler::Clock::now());
+      countTraffic(*_traffic, &TrafficCounters::events, 1);
+      countTraffic(*_traffic, &TrafficCounters::bufferBytes, len);
+      return;
+    }
+    if (_batcher->push(type, data, len)) {
+      countTraffic(*_traffic, &TrafficCounters::events, 1);
+      return;
+    }
+    if (!_onEvent)
+      return;
+    const auto arrived = NetScheduler::Clock::now();
+    auto buffer = makeEventBuffer(data, len);
+    const size_t size = buffer->size();
+    _onEvent(static_cast<double>(type), buffer);
+    countTraffic(*_traffic, &TrafficCounters::events, 1);
+    countTraffic(*_traffic, &TrafficCounters::bufferBytes, size);
+    RuntimeStats::shared().dispatchLatency.record(NetScheduler::Clock::now() -
+                                                  arrived);
+  }
+
+  static constexpr std::chrono::milliseconds kPressureCheck{250};
+
   uint32_t _id;
-  double _maxConnections = 0;
+  NetScheduler &_scheduler; // Of the server's lane
+  std::string _localAddress; // JS thread only; "" until read while listening
+  bool _batchingConfigured = false;
+  std::shared_ptr<AdmissionControl> _admission = AdmissionControl::create();
+  std::atomic<bool> _pressureCheck{false}; // A re-check is scheduled
+  std::atomic<uint64_t> _accepted{0};       // Connections the core accepted
+  std::shared_ptr<Group> _group = std::make_shared<Group>();
   std::function<void(double, const std::shared_ptr<ArrayBuffer> &)> _onEvent;
+  std::atomic<uint32_t> _pumpKey{0}; // Set by attachEventPump
+  std::shared_ptr<TrafficCounters> _traffic =
+      std::make_shared<TrafficCounters>();
+  // CONNECTION (6) may wait for a batch flush, so accept bursts coalesce.
+  std::shared_ptr<EventBatcher> _batcher =
+      std::make_shared<EventBatcher>(1U << 6, _traffic, _scheduler);
 };
 
 } // namespace net
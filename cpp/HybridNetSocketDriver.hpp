@@ -1,12 +1,31 @@
 #pragma once
 
 #include "../nitrogen/generated/shared/c++/HybridNetSocketDriverSpec.hpp"
+#include "HybridPeerCertificate.hpp"
+#include "Http2Codec.hpp"
 #include "NetBindings.hpp"
+#include "NetBuffers.hpp"
+#include "NetConnectRace.hpp"
+#include "NetDnsCache.hpp"
+#include "NetEventBatcher.hpp"
+#include "NetEventPump.hpp"
+#include "NetLanes.hpp"
 #include "NetManager.hpp"
+#include "NetReadCoalescer.hpp"
+#include "NetScheduler.hpp"
+#include "NetSessionCache.hpp"
+#include "NetStats.hpp"
+#include "WebSocketCodec.hpp"
 #include <NitroModules/ArrayBuffer.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace margelo {
@@ -15,29 +34,72 @@ namespace net {
 
 using namespace margelo::nitro;
 
-class HybridNetSocketDriver : public HybridNetSocketDriverSpec {
+/// Process-wide connect settings from NetConfig.
+struct ConnectConfig {
+  // Resolve host names in the bridge (DnsCache) and race their addresses;
+  // false hands them to the core unchanged.
+  std::atomic<bool> happyEyeballs{true};
+  std::atomic<uint32_t> attemptDelayMillis{250}; // RFC 8305 default
+
+  static ConnectConfig &shared() {
+    static ConnectConfig *instance = new ConnectConfig();
+    return *instance;
+  }
+};
+
+class HybridNetSocketDriver : public HybridNetSocketDriverSpec,
+                              private ConnectRace::Owner {
 public:
-  HybridNetSocketDriver() : HybridObject(TAG) {
+  /// `lane` names the executor lane running the socket's timers (see
+  /// ExecutorLanes); none is the default lane.
+  explicit HybridNetSocketDriver(
+      const std::optional<std::string> &lane = std::nullopt)
+      : HybridObject(TAG), _scheduler(ExecutorLanes::shared().scheduler(lane)) {
+    NetManager::shared().start();
     _id = net_create_socket();
-    NetManager::shared().registerHandler(
-        _id, [this](int type, const uint8_t *data, size_t len) {
-          this->onNativeEvent(type, data, len);
-        });
+    RuntimeStats::shared().openSockets++;
+    NetManager::shared().registerHandler(_id, this, onNativeEventThunk);
   }
 
   // For server connections (created with existing ID)
-  explicit HybridNetSocketDriver(uint32_t id) : HybridObject(TAG), _id(id) {
-    NetManager::shared().registerHandler(
-        _id, [this](int type, const uint8_t *data, size_t len) {
-          this->onNativeEvent(type, data, len);
-        });
+  explicit HybridNetSocketDriver(
+      uint32_t id, const std::optional<std::string> &lane = std::nullopt)
+      : HybridObject(TAG), _id(id),
+        _scheduler(ExecutorLanes::shared().scheduler(lane)) {
+    RuntimeStats::shared().openSockets++;
+    NetManager::shared().registerHandler(_id, this, onNativeEventThunk);
   }
 
-  ~HybridNetSocketDriver() override { destroy(); }
+  ~HybridNetSocketDriver() override {
+    destroy();
+    RuntimeStats::shared().openSockets--;
+  }
 
   // Properties
   double getId() override { return static_cast<double>(_id); }
 
+  double getWriteQueueBytes() override {
+    return static_cast<double>(queuedBytes());
+  }
+
+  SocketStats getStats() override {
+    const auto millis = [](int64_t micros) {
+      return micros < 0 ? std::nullopt
+                        : std::optional<double>(static_cast<double>(micros) /
+                                                1000.0);
+    };
+    const int64_t connect = _connectMicros.load(std::memory_order_relaxed);
+    const bool tls = _tls.load(std::memory_order_relaxed);
+    return SocketStats(
+        static_cast<double>(_traffic->bytesRead.load()),
+        static_cast<double>(_traffic->bytesWritten.load()),
+        static_cast<double>(_traffic->events.load()),
+        static_cast<double>(_traffic->bufferBytes.load()),
+        getWriteQueueBytes(),
+        millis(_dnsMicros.load(std::memory_order_relaxed)),
+        millis(tls ? -1 : connect), millis(tls ? connect : -1));
+  }
+
   std::function<void(double, const std::shared_ptr<ArrayBuffer> &)>
   getOnEvent() override {
     return _onEvent;
@@ -48,139 +110,485 @@ public:
     _onEvent = onEvent;
   }
 
+  std::function<void(const std::shared_ptr<ArrayBuffer> &,
+                     const std::shared_ptr<ArrayBuffer> &)>
+  getOnEventBatch() override {
+    return _batcher->callback();
+  }
+  void setOnEventBatch(
+      const std::function<void(const std::shared_ptr<ArrayBuffer> &,
+                               const std::shared_ptr<ArrayBuffer> &)>
+          &onEventBatch) override {
+    _batcher->setCallback(onEventBatch);
+  }
+
   // Methods
+  void setAutoSelectFamily(bool enabled,
+                           std::optional<double> attemptTimeout) override {
+    _autoSelectFamily = enabled;
+    _attemptDelayMillis =
+        attemptTimeout.has_value()
+            ? std::optional<uint32_t>(
+                  static_cast<uint32_t>(std::max(*attemptTimeout, 10.0)))
+            : std::nullopt;
+  }
+
   void connect(const std::string &host, double port) override {
-    net_connect(_id, host.c_str(), static_cast<int>(port));
+    const int p = static_cast<int>(port);
+    beginConnect(false);
+    startConnect(host, [p](uint32_t id, const std::string &address) {
+      net_connect(id, address.c_str(), p);
+    });
   }
 
   void connectTLS(const std::string &host, double port,
                   const std::optional<std::string> &serverName,
                   std::optional<bool> rejectUnauthorized) override {
-    const char *sni = serverName.has_value() ? serverName->c_str() : nullptr;
-    bool ru = rejectUnauthorized.value_or(true);
-    net_connect_tls(_id, host.c_str(), static_cast<int>(port), sni,
-                    static_cast<int>(ru));
+    connectTLSWithContext(host, port, serverName, rejectUnauthorized,
+                          std::nullopt);
   }
 
   void connectTLSWithContext(const std::string &host, double port,
                              const std::optional<std::string> &serverName,
                              std::optional<bool> rejectUnauthorized,
                              std::optional<double> secureContextId) override {
-    const char *sni = serverName.has_value() ? serverName->c_str() : nullptr;
-    bool ru = rejectUnauthorized.value_or(true);
-    if (secureContextId.has_value()) {
-      net_connect_tls_with_context(
-          _id, host.c_str(), static_cast<int>(port), sni, static_cast<int>(ru),
-          static_cast<uint32_t>(secureContextId.value()));
-    } else {
-      net_connect_tls(_id, host.c_str(), static_cast<int>(port), sni,
-                      static_cast<int>(ru));
-    }
+    // Attempts connect to literal addresses, so the SNI name (and hence
+    // certificate verification) falls back to the host name given here.
+    const std::string sni =
+        serverName.value_or(ipLiteralFamily(host) != 0 ? "" : host);
+    const int p = static_cast<int>(port);
+    const int ru = static_cast<int>(rejectUnauthorized.value_or(true));
+    const std::optional<uint32_t> context =
+        secureContextId.has_value()
+            ? std::optional<uint32_t>(
+                  static_cast<uint32_t>(secureContextId.value()))
+            : std::nullopt;
+    std::vector<uint8_t> ticket =
+        resumeSession(context.value_or(0), sni, ru != 0);
+    const bool keylog = _keylog;
+    beginConnect(true);
+    startConnect(host, [sni, p, ru, context, ticket = std::move(ticket),
+                        keylog](uint32_t id, const std::string &address) {
+      if (!ticket.empty())
+        net_set_session(id, ticket.data(), ticket.size());
+      if (keylog)
+        net_socket_enable_keylog(id);
+      const char *name = sni.empty() ? nullptr : sni.c_str();
+      if (context.has_value()) {
+        net_connect_tls_with_context(id, address.c_str(), p, name, ru,
+                                     *context);
+      } else {
+        net_connect_tls(id, address.c_str(), p, name, ru);
+      }
+    });
   }
 
   std::optional<std::string> getAuthorizationError() override {
-    char buf[1024];
-    size_t len = net_get_authorization_error(_id, buf, sizeof(buf));
-    if (len > 0) {
-      return std::string(buf);
-    }
-    return std::nullopt;
+    return readOptionalString(net_get_authorization_error);
   }
 
   std::optional<std::string> getProtocol() override {
-    char buf[128];
-    size_t len = net_get_protocol(_id, buf, sizeof(buf));
-    if (len > 0) {
-      return std::string(buf);
-    }
-    return std::nullopt;
+    return readOptionalString(net_get_protocol);
   }
 
   std::optional<std::string> getCipher() override {
-    char buf[256];
-    size_t len = net_get_cipher(_id, buf, sizeof(buf));
-    if (len > 0) {
-      return std::string(buf);
-    }
-    return std::nullopt;
+    return readOptionalString(net_get_cipher);
   }
 
   std::optional<std::string> getALPN() override {
-    char buf[64];
-    size_t len = net_get_alpn(_id, buf, sizeof(buf));
-    if (len > 0) {
-      return std::string(buf);
-    }
-    return std::nullopt;
+    return readOptionalString(net_get_alpn);
   }
 
   std::optional<std::string> getPeerCertificateJSON() override {
-    char buf[16384];
-    size_t len = net_get_peer_certificate_json(_id, buf, sizeof(buf));
-    if (len > 0) {
-      return std::string(buf, len);
+    return readOptionalString(net_get_peer_certificate_json);
+  }
+
+  std::optional<std::shared_ptr<HybridPeerCertificateSpec>>
+  getPeerCertificate() override {
+    const uint32_t id = _id;
+    if (id == 0)
+      return std::nullopt;
+    if (_peerCertificate.id != id) {
+      std::optional<std::string> json = getPeerCertificateJSON();
+      if (!json.has_value())
+        return std::nullopt; // No handshake yet; ask again later
+      _peerCertificate.id = id;
+      _peerCertificate.value =
+          std::make_shared<HybridPeerCertificate>(std::move(*json));
     }
-    return std::nullopt;
+    return _peerCertificate.value;
   }
 
   std::optional<std::string> getEphemeralKeyInfo() override {
-    char buf[512];
-    size_t len = net_get_ephemeral_key_info(_id, buf, sizeof(buf));
-    if (len > 0) {
-      return std::string(buf, len);
-    }
-    return std::nullopt;
+    return readOptionalString(net_get_ephemeral_key_info);
   }
 
   std::optional<std::string> getSharedSigalgs() override {
-    char buf[1024];
-    size_t len = net_get_shared_sigalgs(_id, buf, sizeof(buf));
-    if (len > 0) {
-      return std::string(buf, len);
-    }
-    return std::nullopt;
+    return readOptionalString(net_get_shared_sigalgs);
   }
 
   bool isSessionReused() override { return net_is_session_reused(_id); }
 
   std::optional<std::shared_ptr<ArrayBuffer>> getSession() override {
-    uint8_t buf[2048];
-    size_t len = net_get_session(_id, buf, sizeof(buf));
-    if (len > 0) {
-      return ArrayBuffer::copy(buf, len);
-    }
-    return std::nullopt;
+    return readCoreBytes(
+        [this](uint8_t *buf, size_t len) {
+          return net_get_session(_id, buf, len);
+        },
+        TlsSessionCache::kMaxTicketSize);
   }
 
   void setSession(const std::shared_ptr<ArrayBuffer> &session) override {
     if (session && session->size() > 0) {
+      // An explicit ticket takes precedence over the shared cache.
+      _explicitSession.assign(session->data(),
+                              session->data() + session->size());
       net_set_session(_id, session->data(), session->size());
     }
   }
 
-  void write(const std::shared_ptr<ArrayBuffer> &data) override {
-    if (!data)
+  void setEventBatching(bool enabled, std::optional<double> intervalMicros,
+                        std::optional<double> maxBatchBytes) override {
+    _batcher->configure(
+        enabled,
+        static_cast<uint32_t>(
+            intervalMicros.value_or(EventBatcher::kDefaultIntervalMicros)),
+        static_cast<size_t>(
+            maxBatchBytes.value_or(EventBatcher::kDefaultMaxBatchBytes)));
+  }
+
+  double attachEventPump() override {
+    uint32_t key = _pumpKey.load(std::memory_order_acquire);
+    if (key == 0) {
+      key = EventPump::shared().newKey();
+      _pumpKey.store(key, std::memory_order_release);
+    }
+    return static_cast<double>(key);
+  }
+
+  void setReadCoalescing(
+      bool enabled,
+      const std::optional<ReadCoalescingOptions> &options) override {
+    const ReadCoalescingOptions o = options.value_or(ReadCoalescingOptions());
+    _coalescer->configure(
+        enabled,
+        static_cast<size_t>(
+            o.minBytes.value_or(ReadCoalescer::kDefaultMinBytes)),
+        static_cast<uint32_t>(
+            o.maxDelayMicros.value_or(ReadCoalescer::kDefaultMaxDelayMicros)),
+        static_cast<size_t>(
+            o.maxReadSize.value_or(ReadCoalescer::kDefaultMaxReadSize)),
+        o.adaptive.value_or(true));
+  }
+
+  double getReadCoalescingThreshold() override {
+    return static_cast<double>(_coalescer->threshold());
+  }
+
+  void attachWebSocket(const WebSocketOptions &options) override {
+    if (_webSocketAttached.load(std::memory_order_acquire) ||
+        _http2Attached.load(std::memory_order_acquire))
+      return;
+    WebSocketConfig config;
+    config.client = options.client;
+    if (options.maxMessageSize.has_value())
+      config.maxMessageSize = static_cast<size_t>(*options.maxMessageSize);
+    config.deflate = options.perMessageDeflate.value_or(false);
+    config.serverNoContextTakeover =
+        options.serverNoContextTakeover.value_or(false);
+    config.clientNoContextTakeover =
+        options.clientNoContextTakeover.value_or(false);
+    config.serverMaxWindowBits =
+        static_cast<int>(options.serverMaxWindowBits.value_or(15));
+    config.clientMaxWindowBits =
+        static_cast<int>(options.clientMaxWindowBits.value_or(15));
+    if (options.compressThreshold.has_value())
+      config.compressThreshold =
+          static_cast<size_t>(*options.compressThreshold);
+    config.autoPong = options.autoPong.value_or(true);
+
+    _webSocket = std::make_unique<WebSocketSession>(
+        config, [this](const uint8_t *data, size_t len) { send(data, len); },
+        [this](const uint8_t *data, size_t len) {
+          deliver(kWebSocketEvent, data, len, NetScheduler::Clock::now());
+        });
+    _webSocketAttached.store(true, std::memory_order_release);
+    const uint8_t marker = kWebSocketAttached;
+    deliverAttachMarker(kWebSocketEvent, &marker, 1);
+  }
+
+  void startWebSocket(
+      const std::optional<std::shared_ptr<ArrayBuffer>> &head) override {
+    if (!_webSocketAttached.load(std::memory_order_acquire))
+      return;
+    const ByteRange range = rangeOf(head.value_or(nullptr), std::nullopt,
+                                    std::nullopt);
+    _webSocket->start(range.data, range.size);
+  }
+
+  bool sendWebSocket(double opcode, const std::shared_ptr<ArrayBuffer> &data,
+                     std::optional<double> offset,
+                     std::optional<double> length) override {
+    if (!_webSocketAttached.load(std::memory_order_acquire))
+      return false;
+    const ByteRange range = rangeOf(data, offset, length);
+    return _webSocket->send(static_cast<uint8_t>(opcode), range.data,
+                            range.size);
+  }
+
+  void attachHttp2(const Http2Options &options) override {
+    if (_http2Attached.load(std::memory_order_acquire) ||
+        _webSocketAttached.load(std::memory_order_acquire))
+      return;
+    Http2Config config;
+    config.client = options.client;
+    if (options.maxConcurrentStreams.has_value())
+      config.maxConcurrentStreams =
+          static_cast<uint32_t>(std::max(*options.maxConcurrentStreams, 0.0));
+    if (options.initialWindowSize.has_value())
+      config.initialWindowSize = static_cast<uint32_t>(
+          std::clamp(*options.initialWindowSize, 0.0, 2147483647.0));
+    if (options.headerTableSize.has_value())
+      config.headerTableSize =
+          static_cast<uint32_t>(std::max(*options.headerTableSize, 0.0));
+    if (options.maxHeaderListSize.has_value())
+      config.maxHeaderListSize =
+          static_cast<uint32_t>(std::max(*options.maxHeaderListSize, 0.0));
+
+    _http2 = std::make_unique<Http2Session>(
+        config, [this](const uint8_t *data, size_t len) { send(data, len); },
+        [this](const uint8_t *data, size_t len) {
+          deliver(kHttp2Event, data, len, NetScheduler::Clock::now());
+        });
+    _http2->open();
+    _http2Attached.store(true, std::memory_order_release);
+    const uint8_t marker[kHttp2RecordHeaderSize] = {kHttp2Attached};
+    deliverAttachMarker(kHttp2Event, marker, sizeof(marker));
+  }
+
+  void startHttp2(const std::optional<std::shared_ptr<ArrayBuffer>> &head)
+      override {
+    if (!_http2Attached.load(std::memory_order_acquire))
+      return;
+    const ByteRange range = rangeOf(head.value_or(nullptr), std::nullopt,
+                                    std::nullopt);
+    _http2->start(range.data, range.size);
+  }
+
+  double openHttp2Stream(const std::vector<std::string> &headers,
+                         bool endStream, std::optional<double> urgency,
+                         std::optional<bool> incremental) override {
+    if (!_http2Attached.load(std::memory_order_acquire))
+      return 0;
+    const double level = std::clamp(
+        urgency.value_or(Http2Session::kDefaultUrgency), 0.0, 7.0);
+    return static_cast<double>(_http2->openStream(
+        toHttp2Headers(headers), endStream, static_cast<uint8_t>(level),
+        incremental.value_or(false)));
+  }
+
+  bool sendHttp2Headers(double streamId,
+                        const std::vector<std::string> &headers,
+                        bool endStream) override {
+    if (!_http2Attached.load(std::memory_order_acquire))
+      return false;
+    return _http2->sendHeaders(static_cast<uint32_t>(streamId),
+                               toHttp2Headers(headers), endStream);
+  }
+
+  bool sendHttp2Data(double streamId, bool endStream,
+                     const std::shared_ptr<ArrayBuffer> &data,
+                     std::optional<double> offset,
+                     std::optional<double> length) override {
+    if (!_http2Attached.load(std::memory_order_acquire))
+      return false;
+    const ByteRange range = rangeOf(data, offset, length);
+    return _http2->sendData(static_cast<uint32_t>(streamId), range.data,
+                            range.size, endStream);
+  }
+
+  void resetHttp2Stream(double streamId, double code) override {
+    if (_http2Attached.load(std::memory_order_acquire))
+      _http2->resetStream(static_cast<uint32_t>(streamId),
+                          static_cast<uint32_t>(code));
+  }
+
+  void setHttp2StreamPaused(double streamId, bool paused) override {
+    if (_http2Attached.load(std::memory_order_acquire))
+      _http2->setStreamPaused(static_cast<uint32_t>(streamId), paused);
+  }
+
+  void closeHttp2(double code) override {
+    if (_http2Attached.load(std::memory_order_acquire))
+      _http2->close(static_cast<uint32_t>(code));
+  }
+
+  void pipeTo(const std::shared_ptr<HybridNetSocketDriverSpec> &destination,
+              const std::optional<PipeOptions> &options) override {
+    auto target =
+        std::dynamic_pointer_cast<HybridNetSocketDriver>(destination);
+    if (!target || target.get() == this || _id == 0 ||
+        _webSocketAttached.load(std::memory_order_acquire) ||
+        _http2Attached.load(std::memory_order_acquire))
+      return;
+    unpipe();
+    auto self = std::dynamic_pointer_cast<HybridNetSocketDriver>(
+        shared_from_this());
+    target->addPipeSource(self);
+    {
+      std::lock_guard lock(_pipeMutex);
+      _pipe = Pipe{};
+      _pipe.destination = std::move(target);
+      _pipe.self = self;
+      if (options.has_value()) {
+        if (options->highWaterMark.has_value())
+          _pipe.highWaterMark = static_cast<uint64_t>(
+              std::max(*options->highWaterMark, 1.0));
+        _pipe.end = options->end.value_or(true);
+      }
+      _pipeUsed.store(true, std::memory_order_release);
+    }
+    deliverAttachMarker(kPipeEvent, nullptr, 0);
+  }
+
+  void startPipe() override {
+    std::lock_guard lock(_pipeMutex);
+    if (!_pipe.destination || _pipe.started)
+      return;
+    _pipe.started = true;
+    if (!_pipe.held.empty())
+      forwardLocked(_pipe.held.data(), _pipe.held.size());
+    std::vector<uint8_t>().swap(_pipe.held);
+    if (_pipe.ended) {
+      _pipe.shutdownPending = true;
+      schedulePipeFlushLocked();
+    }
+  }
+
+  void unpipe() override {
+    std::shared_ptr<HybridNetSocketDriver> target;
+    {
+      // Held bytes go back to JS under the lock, ahead of any later DATA.
+      std::lock_guard lock(_pipeMutex);
+      target = releasePipeLocked();
+      if (!_pipe.held.empty())
+        deliverData(_pipe.held.data(), _pipe.held.size(),
+                    NetScheduler::Clock::now());
+      std::vector<uint8_t>().swap(_pipe.held);
+      _pipe.started = _pipe.ended = false;
+    }
+    if (target)
+      target->removePipeSource(this);
+  }
+
+  PipeStats getPipeStats() override {
+    std::lock_guard lock(_pipeMutex);
+    return PipeStats(static_cast<double>(_pipe.bytesForwarded),
+                     static_cast<double>(_pipe.pauses), _pipe.paused,
+                     _pipe.destination != nullptr);
+  }
+
+  void write(const std::shared_ptr<ArrayBuffer> &data,
+             std::optional<double> offset,
+             std::optional<double> length) override {
+    // Writing a range of the caller's buffer lets JS pass a Buffer's backing
+    // store directly instead of slicing it into a fresh ArrayBuffer first.
+    const ByteRange range = rangeOf(data, offset, length);
+    if (range.size == 0)
       return;
-    net_write(_id, data->data(), data->size());
+    send(range.data, range.size);
+  }
+
+  void writev(const std::vector<std::shared_ptr<ArrayBuffer>> &buffers,
+              const std::optional<std::vector<double>> &ranges) override {
+    // Gather into one contiguous buffer so the whole batch crosses the FFI
+    // once and reaches the Rust writer (and TLS) as a single record.
+    thread_local std::vector<ByteRange> views;
+    views.clear();
+    size_t total = 0;
+    for (size_t i = 0; i < buffers.size(); i++) {
+      std::optional<double> offset, length;
+      if (ranges.has_value() && ranges->size() >= 2 * i + 2) {
+        offset = (*ranges)[2 * i];
+        length = (*ranges)[2 * i + 1];
+      }
+      const ByteRange range = rangeOf(buffers[i], offset, length);
+      if (range.size > 0) {
+        views.push_back(range);
+        total += range.size;
+      }
+    }
+    if (views.empty())
+      return;
+    if (views.size() == 1) {
+      send(views[0].data, views[0].size);
+      return;
+    }
+
+    // net_write copies synchronously, so the scratch buffer can be reused.
+    thread_local std::vector<uint8_t> scratch;
+    scratch.clear();
+    scratch.reserve(total);
+    for (const ByteRange &range : views) {
+      scratch.insert(scratch.end(), range.data, range.data + range.size);
+    }
+    send(scratch.data(), scratch.size());
+    // Don't let one oversized gather pin memory on the JS thread.
+    if (scratch.capacity() > kMaxRetainedScratch) {
+      std::vector<uint8_t>().swap(scratch);
+    }
   }
 
   void destroy() override {
+    dropPipe();
+    cancelRace();
+    forgetQueuedBytes();
     if (_id != 0) {
       NetManager::shared().unregisterHandler(_id);
+      _coalescer->close();
+      _batcher->close();
       net_destroy_socket(_id);
       _id = 0;
     }
   }
 
   void resetAndDestroy() override {
+    dropPipe();
+    cancelRace();
+    forgetQueuedBytes();
     if (_id != 0) {
       net_socket_reset_and_destroy(_id);
       NetManager::shared().unregisterHandler(_id);
+      _coalescer->close();
+      _batcher->close();
       _id = 0;
     }
   }
 
-  void enableKeylog() override { net_socket_enable_keylog(_id); }
+  /// TLS session cache key the socket's tickets are stored under, for a new
+  /// owner that keeps storing them; -1 if they are not cached.
+  int64_t sessionContext() const {
+    return _sessionName.empty() ? -1 : static_cast<int64_t>(_sessionContext);
+  }
+  const std::string &sessionName() const { return _sessionName; }
+
+  /// Gives up the native socket without closing it, for a new owner that
+  /// has already registered its own handler for the ID (replacing ours).
+  /// The driver is inert afterwards. Returns the released ID.
+  uint32_t detach() {
+    const uint32_t id = _id;
+    forgetQueuedBytes();
+    _coalescer->flush();
+    _coalescer->close();
+    _batcher->close();
+    _onEvent = nullptr;
+    _id = 0;
+    return id;
+  }
+
+  void enableKeylog() override {
+    _keylog = true;
+    net_socket_enable_keylog(_id);
+  }
 
   void enableTrace() override { net_socket_enable_trace(_id); }
 
@@ -207,40 +615,55 @@ public:
     return std::nullopt;
   }
 
-  void setNoDelay(bool enable) override { net_set_nodelay(_id, enable); }
+  void setNoDelay(bool enable) override {
+    if (deferWhileRacing([&] { _deferred.noDelay = enable; }))
+      return;
+    net_set_nodelay(_id, enable);
+  }
 
   void setKeepAlive(bool enable, double delay) override {
-    net_set_keepalive(_id, enable, static_cast<uint64_t>(delay));
+    const auto millis = static_cast<uint64_t>(delay);
+    if (deferWhileRacing(
+            [&] { _deferred.keepAlive = std::make_pair(enable, millis); }))
+      return;
+    net_set_keepalive(_id, enable, millis);
   }
 
   void setTimeout(double timeout) override {
-    net_set_timeout(_id, static_cast<uint64_t>(timeout));
+    const auto millis = static_cast<uint64_t>(timeout);
+    if (deferWhileRacing([&] { _deferred.timeout = millis; }))
+      return;
+    net_set_timeout(_id, millis);
   }
 
   std::string getLocalAddress() override {
-    char buf[256];
-    size_t len = net_get_local_address(_id, buf, sizeof(buf));
-    if (len > 0 && len < sizeof(buf)) {
-      return std::string(buf);
-    }
-    return "";
+    return cachedAddress(_localAddress, net_get_local_address);
   }
 
   std::string getRemoteAddress() override {
-    char buf[256];
-    size_t len = net_get_remote_address(_id, buf, sizeof(buf));
-    if (len == 0)
-      return "";
-    return std::string(buf);
+    return cachedAddress(_remoteAddress, net_get_remote_address);
   }
 
-  void pause() override { net_pause(_id); }
+  void pause() override {
+    if (deferWhileRacing([&] { _deferred.paused = true; }))
+      return;
+    net_pause(_id);
+  }
 
-  void resume() override { net_resume(_id); }
+  void resume() override {
+    if (deferWhileRacing([&] { _deferred.paused = false; }))
+      return;
+    net_resume(_id);
+  }
 
-  void shutdown() override { net_shutdown(_id); }
+  void shutdown() override {
+    if (deferWhileRacing([&] { _deferred.shutdown = true; }))
+      return;
+    net_shutdown(_id);
+  }
 
   void connectUnix(const std::string &path) override {
+    beginConnect(false);
     net_connect_unix(_id, path.c_str());
   }
 
@@ -250,6 +673,8 @@ public:
 #if !defined(__ANDROID__)
     const char *sni = serverName.has_value() ? serverName->c_str() : "";
     bool ru = rejectUnauthorized.value_or(true);
+    beginConnect(true);
+    offerSession(resumeSession(0, *sni != '\0' ? sni : path, ru));
     net_connect_unix_tls(_id, path.c_str(), sni, static_cast<int>(ru));
 #else
     // Unix TLS not supported on Android
@@ -267,6 +692,10 @@ public:
 #if !defined(__ANDROID__)
     const char *sni = serverName.has_value() ? serverName->c_str() : "";
     bool ru = rejectUnauthorized.value_or(true);
+    beginConnect(true);
+    offerSession(
+        resumeSession(static_cast<uint32_t>(secureContextId.value_or(0)),
+                      *sni != '\0' ? sni : path, ru));
     if (secureContextId.has_value()) {
       net_connect_unix_tls_with_context(
           _id, path.c_str(), sni, static_cast<int>(ru),
@@ -284,23 +713,591 @@ public:
   }
 
 private:
+  static void onNativeEventThunk(void *context, int type, const uint8_t *data,
+                                 size_t len) {
+    static_cast<HybridNetSocketDriver *>(context)->onNativeEvent(type, data,
+                                                                 len);
+  }
+
+  using StringGetter = size_t (*)(uint32_t, char *, size_t);
+
+  std::optional<std::string> readOptionalString(StringGetter getter) {
+    const uint32_t id = _id;
+    std::string value = readCoreString(
+        [&](char *buf, size_t len) { return getter(id, buf, len); });
+    if (value.empty())
+      return std::nullopt;
+    return value;
+  }
+
+  // Addresses are fixed once connected, so each is read from the core once
+  // per native socket. Empty answers (not connected yet) are not kept.
+  struct CachedAddress {
+    uint32_t id = 0;
+    std::string value;
+  };
+
+  std::string cachedAddress(CachedAddress &cache, StringGetter getter) {
+    const uint32_t id = _id;
+    if (id != 0 && cache.id == id)
+      return cache.value;
+    std::string value = readCoreString(
+        [&](char *buf, size_t len) { return getter(id, buf, len); });
+    if (!value.empty()) {
+      cache.id = id;
+      cache.value = value;
+    }
+    return value;
+  }
+
+  // Bytes handed to the core since it last reported DRAIN. The core copies
+  // writes into its own queue and exposes no depth query, so DRAIN (5) is
+  // the only signal that the queue has emptied. Counting starts with the
+  // first DRAIN: a core that never reports one would leave nothing to
+  // count the bytes down again. See queuedBytes() for a core that reports
+  // DRAIN only after backpressure.
+  void send(const uint8_t *data, size_t len) {
+    queuedBytes(); // Retires a stale count before adding to it
+    if (_drainSeen.load(std::memory_order_relaxed)) {
+      if (_queuedBytes.fetch_add(len, std::memory_order_relaxed) == 0)
+        _countingSince.store(NetScheduler::Clock::now().time_since_epoch()
+                                 .count(),
+                             std::memory_order_relaxed);
+      RuntimeStats::shared().writeQueueBytes.fetch_add(
+          static_cast<int64_t>(len), std::memory_order_relaxed);
+    }
+    countTraffic(*_traffic, &TrafficCounters::bytesWritten, len);
+    if (deferWhileRacing([&] {
+          _deferred.writes.insert(_deferred.writes.end(), data, data + len);
+        }))
+      return;
+    net_write(_id, data, len);
+  }
+
+  // Tells JS that DATA now goes to a native consumer (WebSocket or HTTP/2
+  // codec, or a pipe) whose flag the caller has just set. Re-registering
+  // waits for DATA dispatches that missed the switch, and the coalescer
+  // hands over what it holds, so the marker follows every raw DATA event
+  // on its way to JS.
+  void deliverAttachMarker(int event, const uint8_t *marker, size_t len) {
+    NetManager::shared().registerHandler(_id, this, onNativeEventThunk);
+    _coalescer->flush();
+    deliver(event, marker, len, NetScheduler::Clock::now());
+  }
+
+  // Queues piped bytes for the destination. Writing them, and pausing or
+  // resuming this socket, happens in a scheduler task rather than inside
+  // the core's callback.
+  void forwardLocked(const uint8_t *data, size_t len) {
+    _pipe.pending.insert(_pipe.pending.end(), data, data + len);
+    _pipe.bytesForwarded += len;
+    schedulePipeFlushLocked();
+  }
+
+  void schedulePipeFlushLocked() {
+    if (_pipe.flushScheduled)
+      return;
+    _pipe.flushScheduled = true;
+    _scheduler.schedule(std::chrono::microseconds(0), [self = _pipe.self] {
+      if (auto source = self.lock())
+        source->flushPipe();
+    });
+  }
+
+  // Runs on the scheduler: hands the queued bytes (and a pending end) to the
+  // destination, then pauses or resumes this socket. It stays paused while
+  // the destination has more than the high-water mark written since its
+  // last DRAIN (which resumes us, as does a re-check once that count goes
+  // stale, see queuedBytes), and for one more scheduler turn when more than
+  // that piled up here, i.e. reads outran this task. The core's own write
+  // queue has no depth to observe, so that is all the bound there is.
+  void flushPipe() {
+    std::lock_guard lock(_pipeMutex);
+    _pipe.flushScheduled = false;
+    if (!_pipe.destination)
+      return;
+    HybridNetSocketDriver &target = *_pipe.destination;
+    const bool overflow = _pipe.pending.size() > _pipe.highWaterMark;
+    writePendingLocked(target);
+    if (overflow)
+      schedulePipeFlushLocked();
+    const bool waiting = target.queuedBytes() > _pipe.highWaterMark;
+    if (waiting && !_pipe.recheckScheduled) {
+      _pipe.recheckScheduled = true;
+      _scheduler.schedule(kDrainTimeout, [self = _pipe.self] {
+        if (auto source = self.lock())
+          source->recheckPipe();
+      });
+    }
+    const bool full = overflow || waiting;
+    if (full && !_pipe.paused)
+      _pipe.pauses++;
+    _pipe.paused = full;
+    if (_pipe.paused != _pipe.nativePaused && _id != 0) {
+      _pipe.paused ? net_pause(_id) : net_resume(_id);
+      _pipe.nativePaused = _pipe.paused;
+    }
+  }
+
+  void recheckPipe() {
+    {
+      std::lock_guard lock(_pipeMutex);
+      _pipe.recheckScheduled = false;
+    }
+    flushPipe();
+  }
+
+  void writePendingLocked(HybridNetSocketDriver &target) {
+    // Bytes for a destroyed destination have nowhere to go.
+    if (!_pipe.pending.empty() && target._id.load() != 0)
+      target.send(_pipe.pending.data(), _pipe.pending.size());
+    _pipe.pending.clear();
+    if (_pipe.pending.capacity() > kDefaultPipeHighWaterMark)
+      std::vector<uint8_t>().swap(_pipe.pending);
+    if (_pipe.shutdownPending) {
+      _pipe.shutdownPending = false;
+      target.shutdown();
+    }
+  }
+
+  // Called by a destination reporting DRAIN (on a core thread).
+  void resumePipe() {
+    std::lock_guard lock(_pipeMutex);
+    if (_pipe.paused)
+      schedulePipeFlushLocked();
+  }
+
+  // Detaches the destination, after handing it the bytes still queued for
+  // it, and undoes a backpressure pause. The caller removes us from the
+  // destination's sources after dropping the lock.
+  std::shared_ptr<HybridNetSocketDriver> releasePipeLocked() {
+    if (_pipe.destination)
+      writePendingLocked(*_pipe.destination);
+    if (_pipe.nativePaused && _id != 0)
+      net_resume(_id);
+    _pipe.paused = _pipe.nativePaused = false;
+    return std::move(_pipe.destination);
+  }
+
+  // Ends piping without handing held bytes back (the socket is closing).
+  void dropPipe() {
+    if (!_pipeUsed.load(std::memory_order_acquire))
+      return;
+    std::shared_ptr<HybridNetSocketDriver> target;
+    {
+      std::lock_guard lock(_pipeMutex);
+      target = releasePipeLocked();
+      std::vector<uint8_t>().swap(_pipe.held);
+    }
+    if (target)
+      target->removePipeSource(this);
+  }
+
+  void addPipeSource(const std::shared_ptr<HybridNetSocketDriver> &source) {
+    std::lock_guard lock(_pipeSourcesMutex);
+    _pipeSources.push_back(source);
+    _hasPipeSources.store(true, std::memory_order_release);
+  }
+
+  void removePipeSource(const HybridNetSocketDriver *source) {
+    std::lock_guard lock(_pipeSourcesMutex);
+    std::erase_if(_pipeSources, [source](const auto &weak) {
+      const auto locked = weak.lock();
+      return !locked || locked.get() == source;
+    });
+    _hasPipeSources.store(!_pipeSources.empty(), std::memory_order_release);
+  }
+
+  void resumePipeSources() {
+    std::vector<std::shared_ptr<HybridNetSocketDriver>> sources;
+    {
+      std::lock_guard lock(_pipeSourcesMutex);
+      for (const auto &weak : _pipeSources) {
+        if (auto source = weak.lock())
+          sources.push_back(std::move(source));
+      }
+    }
+    bool last = false;
+    for (const auto &source : sources) {
+      source->resumePipe();
+      last = last || source.use_count() == 1;
+    }
+    // A source JS let go of meanwhile must not be destroyed on this (core)
+    // thread, so its final release moves to the scheduler.
+    if (last)
+      NetScheduler::shared().schedule(
+          std::chrono::microseconds(0),
+          [sources = std::move(sources)] { (void)sources; });
+  }
+
+  // The count from send(). DRAIN may only follow backpressure rather than
+  // every flush, so a count that no DRAIN settled within kDrainTimeout is
+  // taken as flushed, and counting waits for the next DRAIN: parked writes
+  // and paused pipes never wait on a DRAIN that isn't coming.
+  uint64_t queuedBytes() {
+    const uint64_t queued = _queuedBytes.load(std::memory_order_relaxed);
+    if (queued == 0)
+      return 0;
+    const NetScheduler::Clock::duration since(
+        _countingSince.load(std::memory_order_relaxed));
+    if (NetScheduler::Clock::now() - NetScheduler::Clock::time_point(since) <
+        kDrainTimeout)
+      return queued;
+    _drainSeen.store(false, std::memory_order_relaxed);
+    forgetQueuedBytes();
+    return 0;
+  }
+
+  // Drops this socket's unflushed bytes from the runtime-wide queue depth.
+  void forgetQueuedBytes() {
+    const uint64_t queued = _queuedBytes.exchange(0, std::memory_order_relaxed);
+    RuntimeStats::shared().writeQueueBytes.fetch_sub(
+        static_cast<int64_t>(queued), std::memory_order_relaxed);
+  }
+
+  // Starts timing a connect; CONNECT reports how long it took.
+  void beginConnect(bool tls) {
+    _tls.store(tls, std::memory_order_relaxed);
+    _dnsMicros.store(-1, std::memory_order_relaxed);
+    _connectMicros.store(-1, std::memory_order_relaxed);
+    _connectStart.store(NetScheduler::Clock::now().time_since_epoch().count(),
+                        std::memory_order_release);
+  }
+
+  int64_t sinceConnectStart() {
+    const NetScheduler::Clock::duration start(
+        _connectStart.load(std::memory_order_acquire));
+    const auto elapsed =
+        NetScheduler::Clock::now() - NetScheduler::Clock::time_point(start);
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+        .count();
+  }
+
+  // Returns the ticket to offer for (context, serverName): the app's, or
+  // else the cached one. Remembers the key so new tickets get cached, but
+  // only for a connect that verifies the peer: resuming skips the
+  // certificate check, so a ticket from an unverified session must never
+  // reach a verifying connect.
+  std::vector<uint8_t> resumeSession(uint32_t context,
+                                     const std::string &serverName,
+                                     bool verified) {
+    _sessionContext = context;
+    _sessionName = verified ? serverName : std::string();
+    if (!_explicitSession.empty())
+      return _explicitSession;
+    return TlsSessionCache::shared().lookup(context, serverName);
+  }
+
+  void offerSession(const std::vector<uint8_t> &ticket) {
+    if (!ticket.empty()) {
+      net_set_session(_id, ticket.data(), ticket.size());
+    }
+  }
+
+  // Connects directly when the host is an address (or racing is off), and
+  // otherwise races the host's addresses. Socket calls made while the race
+  // runs are replayed on the winning socket.
+  void startConnect(const std::string &host, ConnectRace::Connector connect) {
+    ConnectConfig &config = ConnectConfig::shared();
+    if (!config.happyEyeballs.load(std::memory_order_relaxed) ||
+        ipLiteralFamily(host) != 0) {
+      connect(_id, host);
+      return;
+    }
+    std::optional<std::chrono::milliseconds> delay;
+    if (_autoSelectFamily) {
+      delay = std::chrono::milliseconds(_attemptDelayMillis.value_or(
+          config.attemptDelayMillis.load(std::memory_order_relaxed)));
+    }
+    _host = host;
+    std::lock_guard lock(_raceMutex);
+    _racing.store(true, std::memory_order_release);
+    _race = ConnectRace::start(this, _id, host, delay, std::move(connect),
+                               _scheduler);
+  }
+
+  // Runs `record` (under the race lock) instead of the direct call while
+  // the socket is still racing; returns whether it did.
+  template <typename Record> bool deferWhileRacing(Record &&record) {
+    if (!_racing.load(std::memory_order_acquire))
+      return false;
+    std::lock_guard lock(_raceMutex);
+    if (!_racing.load(std::memory_order_relaxed))
+      return false;
+    record();
+    return true;
+  }
+
+  void cancelRace() {
+    std::shared_ptr<ConnectRace> race;
+    {
+      std::lock_guard lock(_raceMutex);
+      race = std::move(_race);
+      _racing.store(false, std::memory_order_release);
+      _deferred = Deferred{};
+    }
+    if (race)
+      race->cancel();
+  }
+
+  void onRaceAttempt(const DnsAddress &address) override {
+    int64_t unset = -1;
+    _dnsMicros.compare_exchange_strong(unset, sinceConnectStart(),
+                                       std::memory_order_relaxed);
+    // Reported like the core's LOOKUP: "address,family,host".
+    const std::string lookup =
+        address.ip + ',' + std::to_string(address.family) + ',' + _host;
+    onNativeEvent(8, reinterpret_cast<const uint8_t *>(lookup.data()),
+                  lookup.size());
+  }
+
+  void onRaceWon(uint32_t id, const uint8_t *data, size_t len) override {
+    NetManager::shared().registerHandler(id, this, onNativeEventThunk);
+    {
+      std::lock_guard lock(_raceMutex);
+      _id = id;
+      if (_deferred.noDelay.has_value())
+        net_set_nodelay(id, *_deferred.noDelay);
+      if (_deferred.keepAlive.has_value())
+        net_set_keepalive(id, _deferred.keepAlive->first,
+                          _deferred.keepAlive->second);
+      if (_deferred.timeout.has_value())
+        net_set_timeout(id, *_deferred.timeout);
+      if (!_deferred.writes.empty())
+        net_write(id, _deferred.writes.data(), _deferred.writes.size());
+      if (_deferred.shutdown)
+        net_shutdown(id);
+      if (_deferred.paused.value_or(false))
+        net_pause(id);
+      _deferred = Deferred{};
+      _racing.store(false, std::memory_order_release);
+    }
+    onNativeEvent(1, data, len);
+  }
+
+  void onRaceFailed(const std::string &error) override {
+    NetManager::shared().registerHandler(_id, this, onNativeEventThunk);
+    {
+      std::lock_guard lock(_raceMutex);
+      _deferred = Deferred{};
+      _racing.store(false, std::memory_order_release);
+    }
+    onNativeEvent(3, reinterpret_cast<const uint8_t *>(error.data()),
+                  error.size());
+  }
+
   void onNativeEvent(int type, const uint8_t *data, size_t len) {
-    if (!_onEvent)
+    const auto arrived = NetScheduler::Clock::now();
+    if (type == 2) { // DATA
+      countTraffic(*_traffic, &TrafficCounters::bytesRead, len);
+      if (_webSocketAttached.load(std::memory_order_acquire)) {
+        _webSocket->onData(data, len);
+        return;
+      }
+      if (_http2Attached.load(std::memory_order_acquire)) {
+        _http2->onData(data, len);
+        return;
+      }
+      if (_pipeUsed.load(std::memory_order_acquire)) {
+        // Under the pipe lock, so DATA handed back by unpipe stays in order
+        std::lock_guard lock(_pipeMutex);
+        if (!_pipe.destination) {
+          deliverData(data, len, arrived);
+        } else if (_pipe.started) {
+          forwardLocked(data, len);
+        } else {
+          _pipe.held.insert(_pipe.held.end(), data, data + len);
+        }
+        return;
+      }
+    } else if (type == 5) { // DRAIN
+      forgetQueuedBytes();
+      _drainSeen.store(true, std::memory_order_relaxed);
+      if (_hasPipeSources.load(std::memory_order_acquire))
+        resumePipeSources();
+    } else if (type == 4 && _pipeUsed.load(std::memory_order_acquire)) {
+      std::lock_guard lock(_pipeMutex); // CLOSE: end the destination
+      if (_pipe.destination && _pipe.end) {
+        if (_pipe.started) {
+          _pipe.shutdownPending = true; // After the queued bytes
+          schedulePipeFlushLocked();
+        } else {
+          _pipe.ended = true; // After the held bytes, in startPipe
+        }
+      }
+    } else if (type == 1) { // CONNECT
+      recordConnected();
+    } else if (type == 9 && !_sessionName.empty()) { // SESSION
+      TlsSessionCache::shared().store(_sessionContext, _sessionName, data, len);
+    }
+    if (type == 2) {
+      deliverData(data, len, arrived);
       return;
+    }
+    _coalescer->flush(); // Reads before this event go first
+    deliver(type, data, len, arrived);
+  }
 
-    std::shared_ptr<ArrayBuffer> ab;
-    if (data && len > 0) {
-      ab = ArrayBuffer::copy(data, len);
-    } else {
-      static uint8_t empty = 0;
-      ab = ArrayBuffer::copy(&empty, 0);
+  // A flat name, value list from JS; HTTP/2 field names are lowercase.
+  static std::vector<HpackHeader>
+  toHttp2Headers(const std::vector<std::string> &flat) {
+    std::vector<HpackHeader> headers;
+    headers.reserve(flat.size() / 2);
+    for (size_t i = 0; i + 1 < flat.size(); i += 2) {
+      HpackHeader header{flat[i], flat[i + 1]};
+      for (char &c : header.name)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      headers.push_back(std::move(header));
     }
+    return headers;
+  }
 
-    _onEvent(static_cast<double>(type), ab);
+  void deliverData(const uint8_t *data, size_t len,
+                   NetScheduler::Clock::time_point arrived) {
+    if (!_coalescer->push(data, len, arrived))
+      deliver(2, data, len, arrived);
   }
 
-  uint32_t _id;
+  // Hands one event to JS, through the event pump once attached to it, or
+  // the batcher when batching is on.
+  void deliver(int type, const uint8_t *data, size_t len,
+               NetScheduler::Clock::time_point arrived) {
+    if (const uint32_t key = _pumpKey.load(std::memory_order_acquire)) {
+      EventPump::shared().push(key, type, data, len, arrived);
+      countTraffic(*_traffic, &TrafficCounters::events, 1);
+      countTraffic(*_traffic, &TrafficCounters::bufferBytes, len);
+      return;
+    }
+    if (_batcher->push(type, data, len)) {
+      countTraffic(*_traffic, &TrafficCounters::events, 1);
+      return;
+    }
+    if (!_onEvent)
+      return;
+
+    auto buffer = makeEventBuffer(data, len);
+    const size_t size = buffer->size();
+    _onEvent(static_cast<double>(type), buffer);
+    countTraffic(*_traffic, &TrafficCounters::events, 1);
+    countTraffic(*_traffic, &TrafficCounters::bufferBytes, size);
+    RuntimeStats::shared().dispatchLatency.record(NetScheduler::Clock::now() -
+                                                  arrived);
+  }
+
+  void recordConnected() {
+    if (_connectStart.load(std::memory_order_acquire) == 0)
+      return; // Accepted by a server
+    int64_t unset = -1;
+    const int64_t elapsed = sinceConnectStart();
+    if (!_connectMicros.compare_exchange_strong(unset, elapsed,
+                                                std::memory_order_relaxed))
+      return;
+    RuntimeStats &stats = RuntimeStats::shared();
+    (_tls.load(std::memory_order_relaxed) ? stats.handshakeTime
+                                          : stats.connectTime)
+        .record(static_cast<uint64_t>(std::max<int64_t>(elapsed, 0)));
+  }
+
+  static constexpr size_t kMaxRetainedScratch = 256 * 1024;
+  static constexpr int kWebSocketEvent = 13; // WEBSOCKET
+  static constexpr int kPipeEvent = 14;      // PIPE
+  static constexpr int kHttp2Event = 15;     // HTTP2
+  static constexpr uint64_t kDefaultPipeHighWaterMark = 1024 * 1024;
+  // How long a queue count may wait for DRAIN; see queuedBytes().
+  static constexpr auto kDrainTimeout = std::chrono::milliseconds(250);
+
+  // Changes once, when a connect race hands over its winning socket.
+  std::atomic<uint32_t> _id;
+  NetScheduler &_scheduler; // Of the socket's lane
+  std::atomic<uint64_t> _queuedBytes{0};
+  // When send() counted the first of _queuedBytes (Clock ticks)
+  std::atomic<int64_t> _countingSince{0};
+  // Session cache key; written before connecting, read by the worker thread.
+  uint32_t _sessionContext = 0;
+  std::string _sessionName;
+  std::vector<uint8_t> _explicitSession; // Ticket from setSession
+  bool _keylog = false;
+  // JS thread only
+  CachedAddress _localAddress;
+  CachedAddress _remoteAddress;
+  struct {
+    uint32_t id = 0;
+    std::shared_ptr<HybridPeerCertificate> value;
+  } _peerCertificate;
+
+  // Connect timing (steady clock ticks; 0 = never connected by this driver)
+  std::atomic<int64_t> _connectStart{0};
+  std::atomic<int64_t> _dnsMicros{-1};
+  std::atomic<int64_t> _connectMicros{-1};
+  std::atomic<bool> _tls{false};
+
+  // Happy Eyeballs state. Calls that reach the driver while the race runs
+  // are recorded in _deferred and replayed on the winner.
+  struct Deferred {
+    std::optional<bool> noDelay;
+    std::optional<std::pair<bool, uint64_t>> keepAlive;
+    std::optional<uint64_t> timeout;
+    std::optional<bool> paused;
+    bool shutdown = false;
+    std::vector<uint8_t> writes;
+  };
+  bool _autoSelectFamily = true;
+  std::optional<uint32_t> _attemptDelayMillis;
+  std::string _host;
+  std::mutex _raceMutex;
+  std::atomic<bool> _racing{false};
+  std::shared_ptr<ConnectRace> _race;
+  Deferred _deferred;
   std::function<void(double, const std::shared_ptr<ArrayBuffer> &)> _onEvent;
+  std::atomic<uint32_t> _pumpKey{0}; // Set by attachEventPump
+  std::shared_ptr<TrafficCounters> _traffic =
+      std::make_shared<TrafficCounters>();
+  // DATA (2), DRAIN (5), WEBSOCKET (13) and HTTP2 (15) may wait for a
+  // batch flush.
+  std::shared_ptr<EventBatcher> _batcher = std::make_shared<EventBatcher>(
+      (1U << 2) | (1U << 5) | (1U << kWebSocketEvent) | (1U << kHttp2Event),
+      _traffic, _scheduler);
+  // DATA for JS passes through here first; immediate until configured.
+  std::shared_ptr<ReadCoalescer> _coalescer = std::make_shared<ReadCoalescer>(
+      [this](const uint8_t *data, size_t len,
+             NetScheduler::Clock::time_point arrived) {
+        deliver(2, data, len, arrived);
+      },
+      _scheduler);
+  // Set once, by attachWebSocket; DATA then goes through the codec.
+  std::unique_ptr<WebSocketSession> _webSocket;
+  std::atomic<bool> _webSocketAttached{false};
+  // Set once, by attachHttp2; DATA then goes through the HTTP/2 engine.
+  std::unique_ptr<Http2Session> _http2;
+  std::atomic<bool> _http2Attached{false};
+
+  // Native pipe from this socket into another (see pipeTo). DATA is held
+  // until startPipe, then written straight to the destination.
+  struct Pipe {
+    std::shared_ptr<HybridNetSocketDriver> destination;
+    uint64_t highWaterMark = kDefaultPipeHighWaterMark;
+    bool end = true;
+    bool started = false;
+    bool ended = false;  // CLOSE arrived before startPipe
+    bool paused = false;       // By backpressure
+    bool nativePaused = false; // What the core was last told
+    bool flushScheduled = false;
+    bool recheckScheduled = false; // For a destination count to go stale
+    bool shutdownPending = false; // End the destination after `pending`
+    uint64_t bytesForwarded = 0;
+    uint64_t pauses = 0;
+    std::vector<uint8_t> held;
+    std::vector<uint8_t> pending; // For the next flush task
+    std::weak_ptr<HybridNetSocketDriver> self;
+  };
+  std::mutex _pipeMutex;
+  Pipe _pipe;
+  std::atomic<bool> _pipeUsed{false}; // Set by the first pipeTo
+  // Sockets piping into this one, resumed when it reports DRAIN
+  std::mutex _pipeSourcesMutex;
+  std::vector<std::weak_ptr<HybridNetSocketDriver>> _pipeSources;
+  std::atomic<bool> _hasPipeSources{false};
+  std::atomic<bool> _drainSeen{false};
 };
 
 } // namespace net
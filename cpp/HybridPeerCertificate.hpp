@@ -0,0 +1,274 @@
+#pragma once
+
+#include "../nitrogen/generated/shared/c++/HybridPeerCertificateSpec.hpp"
+#include "NetJson.hpp"
+#include <NitroModules/ArrayBuffer.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace margelo {
+namespace nitro {
+namespace net {
+
+using namespace margelo::nitro;
+
+namespace detail {
+
+/// Renders a scalar as a string; a list (Node's form for repeated attributes
+/// like OU) becomes its items, one per line.
+inline std::string flatten(const JsonValue &value) {
+  switch (value.type) {
+  case JsonValue::Type::String:
+    return value.string;
+  case JsonValue::Type::Boolean:
+    return value.boolean ? "true" : "false";
+  case JsonValue::Type::Number: {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.17g", value.number);
+    return buf;
+  }
+  case JsonValue::Type::Array: {
+    std::string joined;
+    for (const JsonValue &item : value.items) {
+      if (!joined.empty())
+        joined += '\n';
+      joined += flatten(item);
+    }
+    return joined;
+  }
+  default:
+    return "";
+  }
+}
+
+/// DER bytes from `raw`: hex (colons allowed) or base64 text, an array of
+/// byte values, or a serialized Node Buffer ({type: "Buffer", data}).
+inline std::optional<std::vector<uint8_t>> decodeRaw(const JsonValue &raw) {
+  std::vector<uint8_t> bytes;
+  if (raw.type == JsonValue::Type::Object) {
+    const JsonValue *data = raw.find("data");
+    return data ? decodeRaw(*data) : std::nullopt;
+  }
+  if (raw.type == JsonValue::Type::Array) {
+    for (const JsonValue &item : raw.items) {
+      if (item.type != JsonValue::Type::Number || item.number < 0 ||
+          item.number > 255)
+        return std::nullopt;
+      bytes.push_back(static_cast<uint8_t>(item.number));
+    }
+    return bytes;
+  }
+  if (raw.type != JsonValue::Type::String || raw.string.empty())
+    return std::nullopt;
+
+  const std::string &text = raw.string;
+  const auto hex = [](char c) -> int {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  };
+  bool isHex = true;
+  size_t digits = 0;
+  for (const char c : text) {
+    if (c == ':')
+      continue;
+    if (hex(c) < 0) {
+      isHex = false;
+      break;
+    }
+    digits++;
+  }
+  if (isHex && digits % 2 == 0) {
+    int high = -1;
+    for (const char c : text) {
+      if (c == ':')
+        continue;
+      if (high < 0) {
+        high = hex(c);
+      } else {
+        bytes.push_back(static_cast<uint8_t>((high << 4) | hex(c)));
+        high = -1;
+      }
+    }
+    return bytes;
+  }
+
+  const auto sextet = [](char c) -> int {
+    if (c >= 'A' && c <= 'Z')
+      return c - 'A';
+    if (c >= 'a' && c <= 'z')
+      return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+      return c - '0' + 52;
+    if (c == '+' || c == '-')
+      return 62;
+    if (c == '/' || c == '_')
+      return 63;
+    return -1;
+  };
+  uint32_t buffer = 0;
+  int bits = 0;
+  for (const char c : text) {
+    if (c == '=' || c == '\n' || c == '\r')
+      continue;
+    const int v = sextet(c);
+    if (v < 0)
+      return std::nullopt;
+    buffer = (buffer << 6) | static_cast<uint32_t>(v);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      bytes.push_back(static_cast<uint8_t>(buffer >> bits));
+    }
+  }
+  return bytes;
+}
+
+} // namespace detail
+
+/// A peer certificate as reported by the core. The JSON is read once per
+/// connection (see HybridNetSocketDriver::getPeerCertificate) and parsed on
+/// first field access; every field is then served from memory, so repeated
+/// checks such as fingerprint pinning cost no FFI or JSON work. Nested
+/// `issuerCertificate` entries share the parsed tree.
+class HybridPeerCertificate : public HybridPeerCertificateSpec {
+public:
+  explicit HybridPeerCertificate(std::string json)
+      : HybridObject(TAG), _tree(std::make_shared<Tree>()) {
+    _tree->json = std::move(json);
+  }
+
+  std::unordered_map<std::string, std::string> getSubject() override {
+    return names("subject");
+  }
+
+  std::unordered_map<std::string, std::string> getIssuer() override {
+    return names("issuer");
+  }
+
+  std::string getValidFrom() override { return text("valid_from"); }
+  std::string getValidTo() override { return text("valid_to"); }
+  std::string getFingerprint() override { return text("fingerprint"); }
+  std::string getFingerprint256() override { return text("fingerprint256"); }
+  std::string getSerialNumber() override { return text("serialNumber"); }
+
+  std::optional<std::string> getSubjectAltName() override {
+    const detail::JsonValue *value = field("subjectaltname");
+    if (value == nullptr || value->type == detail::JsonValue::Type::Null)
+      return std::nullopt;
+    return detail::flatten(*value);
+  }
+
+  std::optional<std::shared_ptr<ArrayBuffer>> getRaw() override {
+    std::call_once(_rawOnce, [this] {
+      const detail::JsonValue *value = field("raw");
+      if (value == nullptr)
+        return;
+      auto bytes = detail::decodeRaw(*value);
+      if (bytes.has_value() && !bytes->empty())
+        _raw = ArrayBuffer::copy(*bytes);
+    });
+    if (!_raw)
+      return std::nullopt;
+    return _raw;
+  }
+
+  std::optional<std::shared_ptr<HybridPeerCertificateSpec>>
+  getIssuerCertificate() override {
+    std::call_once(_issuerOnce, [this] {
+      const detail::JsonValue *value = field("issuerCertificate");
+      // A self-signed root may list itself; the chain ends there.
+      if (value != nullptr && value->type == detail::JsonValue::Type::Object &&
+          issuerIsAnother(*value)) {
+        _issuer = std::shared_ptr<HybridPeerCertificate>(
+            new HybridPeerCertificate(_tree, value));
+      }
+    });
+    if (!_issuer)
+      return std::nullopt;
+    return _issuer;
+  }
+
+  std::string toJSON() override {
+    const detail::JsonValue *root = node();
+    if (root == nullptr)
+      return _tree->json;
+    return _tree->json.substr(root->begin, root->end - root->begin);
+  }
+
+private:
+  struct Tree {
+    std::string json;
+    detail::JsonValue root;
+    std::once_flag parsed;
+    bool valid = false;
+  };
+
+  HybridPeerCertificate(std::shared_ptr<Tree> tree,
+                        const detail::JsonValue *node)
+      : HybridObject(TAG), _tree(std::move(tree)), _node(node) {}
+
+  // The certificate's object in the tree, or null if the JSON is malformed.
+  const detail::JsonValue *node() {
+    Tree &tree = *_tree;
+    std::call_once(tree.parsed, [&tree] {
+      tree.valid = detail::JsonReader(tree.json).read(tree.root) &&
+                   tree.root.type == detail::JsonValue::Type::Object;
+    });
+    if (!tree.valid)
+      return nullptr;
+    return _node != nullptr ? _node : &tree.root;
+  }
+
+  const detail::JsonValue *field(std::string_view name) {
+    const detail::JsonValue *certificate = node();
+    return certificate != nullptr ? certificate->find(name) : nullptr;
+  }
+
+  bool issuerIsAnother(const detail::JsonValue &issuer) {
+    const detail::JsonValue *theirs = issuer.find("fingerprint256");
+    const detail::JsonValue *ours = field("fingerprint256");
+    return theirs == nullptr || ours == nullptr ||
+           theirs->string != ours->string;
+  }
+
+  std::string text(std::string_view name) {
+    const detail::JsonValue *value = field(name);
+    return value != nullptr ? detail::flatten(*value) : "";
+  }
+
+  std::unordered_map<std::string, std::string> names(std::string_view name) {
+    std::unordered_map<std::string, std::string> result;
+    const detail::JsonValue *value = field(name);
+    if (value == nullptr)
+      return result;
+    for (const auto &[key, member] : value->members) {
+      result.emplace(key, detail::flatten(member));
+    }
+    return result;
+  }
+
+  const std::shared_ptr<Tree> _tree;
+  const detail::JsonValue *const _node = nullptr; // Null for the leaf
+  std::once_flag _rawOnce;
+  std::shared_ptr<ArrayBuffer> _raw;
+  std::once_flag _issuerOnce;
+  std::shared_ptr<HybridPeerCertificate> _issuer;
+};
+
+} // namespace net
+} // namespace nitro
+} // namespace margelo
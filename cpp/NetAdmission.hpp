@@ -0,0 +1,307 @@
+#pragma once
+
+#include "NetBindings.hpp"
+#include "NetLog.hpp"
+#include "NetManager.hpp"
+#include "NetScheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// Native admission control for one server.
+/// Accepted connections are handed to JS at most `rate` per second (a token
+/// bucket holding up to `burst` tokens); the excess waits in a queue. The
+/// backlog is that queue plus connections handed to JS but not yet picked
+/// up by a socket driver, so a JS thread falling behind shows up here too.
+/// Once the backlog reaches `maxBacklog`, new connections are shed (reset,
+/// or answered with a canned HTTP 503) without ever reaching JS.
+class AdmissionControl {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class ShedMode : uint8_t { Reset = 0, Http503 = 1 };
+  enum class Decision : uint8_t { Admit, Queue, Shed };
+  enum class Pressure : uint8_t { Normal = 0, Shaping = 1, Shedding = 2 };
+
+  struct Config {
+    double rate = 0;       // Connections per second, 0 = unlimited
+    double burst = 0;      // Bucket size, 0 = `rate`
+    size_t maxBacklog = 0; // 0 = never shed
+    ShedMode shedMode = ShedMode::Reset;
+  };
+
+  struct Report {
+    Pressure level;
+    size_t backlog;
+    uint64_t shed; // Connections shed so far
+  };
+
+  // Handed-over connections not picked up after this long no longer count;
+  // JS may have dropped them without creating a driver.
+  static constexpr std::chrono::seconds kPickupTimeout{5};
+  // A peer that never closes after its 503 is dropped after this long.
+  static constexpr std::chrono::seconds kShedLinger{5};
+
+  static std::shared_ptr<AdmissionControl> create() {
+    auto control = std::shared_ptr<AdmissionControl>(new AdmissionControl());
+    control->_self = control;
+    return control;
+  }
+
+  bool enabled() {
+    std::lock_guard lock(_mutex);
+    return isEnabledLocked();
+  }
+
+  Config config() {
+    std::lock_guard lock(_mutex);
+    return _config;
+  }
+
+  void configure(const Config &config) {
+    std::lock_guard lock(_mutex);
+    const bool limited = _config.rate > 0;
+    _config = config;
+    // A newly enabled limit starts with a full bucket.
+    _tokens = limited ? std::min(_tokens, capacityLocked()) : capacityLocked();
+  }
+
+  /// Decides the fate of accepted connection `id`. Admitted connections
+  /// must be delivered by the caller; queued ones come back from drain().
+  Decision offer(uint32_t id) {
+    std::lock_guard lock(_mutex);
+    const auto now = Clock::now();
+    refillLocked(now);
+    expireLocked(now);
+    if (_config.maxBacklog > 0 && backlogLocked() >= _config.maxBacklog) {
+      _shed++;
+      _overloaded = true;
+      return Decision::Shed;
+    }
+    if (_config.rate <= 0 || (_queue.empty() && _tokens >= 1)) {
+      if (_config.rate > 0)
+        _tokens -= 1;
+      handOverLocked(id, now);
+      return Decision::Admit;
+    }
+    _queue.push_back(id);
+    return Decision::Queue;
+  }
+
+  /// Queued connections whose tokens are now available, in accept order.
+  std::vector<uint32_t> drain() {
+    std::lock_guard lock(_mutex);
+    const auto now = Clock::now();
+    refillLocked(now);
+    std::vector<uint32_t> ready;
+    while (!_queue.empty() && (_config.rate <= 0 || _tokens >= 1)) {
+      if (_config.rate > 0)
+        _tokens -= 1;
+      ready.push_back(_queue.front());
+      handOverLocked(_queue.front(), now);
+      _queue.pop_front();
+    }
+    return ready;
+  }
+
+  /// Time until the next queued connection can be admitted, if any waits.
+  std::optional<std::chrono::microseconds> nextDrain() {
+    std::lock_guard lock(_mutex);
+    if (_queue.empty())
+      return std::nullopt;
+    if (_config.rate <= 0 || _tokens >= 1)
+      return std::chrono::microseconds(0);
+    return std::chrono::microseconds(
+        static_cast<int64_t>((1 - _tokens) / _config.rate * 1e6) + 1);
+  }
+
+  /// Drops every queued connection (on close); returns them for closing.
+  std::vector<uint32_t> takeQueued() {
+    std::lock_guard lock(_mutex);
+    std::vector<uint32_t> queued(_queue.begin(), _queue.end());
+    _queue.clear();
+    return queued;
+  }
+
+  /// The pressure level, if it changed since the last call. Shedding ends
+  /// once the backlog is back to half of maxBacklog.
+  std::optional<Report> pressureChange() {
+    std::lock_guard lock(_mutex);
+    expireLocked(Clock::now());
+    const size_t backlog = backlogLocked();
+    if (_overloaded && backlog * 2 <= _config.maxBacklog)
+      _overloaded = false;
+    Pressure level = Pressure::Normal;
+    if (_overloaded) {
+      level = Pressure::Shedding;
+    } else if (!_queue.empty()) {
+      level = Pressure::Shaping;
+    }
+    if (level == _reported)
+      return std::nullopt;
+    _reported = level;
+    return Report{level, backlog, _shed};
+  }
+
+  /// The current backlog and shed count, with the last reported level.
+  Report current() {
+    std::lock_guard lock(_mutex);
+    expireLocked(Clock::now());
+    return Report{_reported, backlogLocked(), _shed};
+  }
+
+  /// The level last returned by pressureChange().
+  Pressure pressure() {
+    std::lock_guard lock(_mutex);
+    return _reported;
+  }
+
+  /// Called when a socket driver is created for an accepted connection.
+  static void pickedUp(uint32_t id) {
+    std::shared_ptr<AdmissionControl> owner;
+    {
+      std::lock_guard lock(registryMutex());
+      auto it = registry().find(id);
+      if (it == registry().end())
+        return;
+      owner = it->second.lock();
+      registry().erase(it);
+    }
+    if (owner) {
+      std::lock_guard lock(owner->_mutex);
+      owner->_handedOver.erase(id);
+    }
+  }
+
+  /// Turns connection `id` away without involving JS.
+  static void shed(uint32_t id, ShedMode mode) {
+    // Don't re-enter the core from the accepting callback.
+    NetScheduler::shared().schedule(std::chrono::microseconds(0), [id, mode] {
+      if (mode == ShedMode::Reset) {
+        net_socket_reset_and_destroy(id);
+        return;
+      }
+      static constexpr char kResponse[] =
+          "HTTP/1.1 503 Service Unavailable\r\n"
+          "Connection: close\r\nContent-Length: 0\r\nRetry-After: 1\r\n\r\n";
+      {
+        std::lock_guard lock(registryMutex());
+        closing().insert(id);
+      }
+      NetManager::shared().registerHandler(id, contextFor(id), onShedEvent);
+      net_write(id, reinterpret_cast<const uint8_t *>(kResponse),
+                sizeof(kResponse) - 1);
+      net_shutdown(id);
+      // Read on, so the peer's FIN (or its request bytes) are noticed.
+      net_resume(id);
+      NetScheduler::shared().schedule(kShedLinger, [id] { finish(id); });
+    });
+  }
+
+private:
+  AdmissionControl() = default;
+
+  // Accepted IDs handed to JS, mapped to their server, until picked up.
+  static std::mutex &registryMutex() {
+    static std::mutex *mutex = new std::mutex();
+    return *mutex;
+  }
+  static std::unordered_map<uint32_t, std::weak_ptr<AdmissionControl>> &
+  registry() {
+    static auto *map =
+        new std::unordered_map<uint32_t, std::weak_ptr<AdmissionControl>>();
+    return *map;
+  }
+  // Shed connections still flushing their 503.
+  static std::unordered_set<uint32_t> &closing() {
+    static auto *set = new std::unordered_set<uint32_t>();
+    return *set;
+  }
+
+  static void *contextFor(uint32_t id) {
+    return reinterpret_cast<void *>(static_cast<uintptr_t>(id));
+  }
+
+  static void onShedEvent(void *context, int type, const uint8_t *, size_t) {
+    if (type == 3 || type == 4) { // ERROR, CLOSE
+      const auto id =
+          static_cast<uint32_t>(reinterpret_cast<uintptr_t>(context));
+      NetScheduler::shared().schedule(std::chrono::microseconds(0),
+                                      [id] { finish(id); });
+    }
+  }
+
+  static void finish(uint32_t id) {
+    {
+      std::lock_guard lock(registryMutex());
+      if (closing().erase(id) == 0)
+        return;
+    }
+    NetManager::shared().unregisterHandler(id);
+    net_destroy_socket(id);
+  }
+
+  bool isEnabledLocked() const {
+    return _config.rate > 0 || _config.maxBacklog > 0;
+  }
+
+  double capacityLocked() const {
+    return std::max(_config.burst > 0 ? _config.burst : _config.rate, 1.0);
+  }
+
+  void refillLocked(Clock::time_point now) {
+    if (_config.rate > 0) {
+      const double elapsed =
+          std::chrono::duration<double>(now - _lastRefill).count();
+      _tokens = std::min(_tokens + elapsed * _config.rate, capacityLocked());
+    }
+    _lastRefill = now;
+  }
+
+  void handOverLocked(uint32_t id, Clock::time_point now) {
+    if (_config.maxBacklog == 0)
+      return;
+    _handedOver[id] = now;
+    std::lock_guard lock(registryMutex());
+    registry()[id] = _self;
+  }
+
+  void expireLocked(Clock::time_point now) {
+    for (auto it = _handedOver.begin(); it != _handedOver.end();) {
+      if (now - it->second < kPickupTimeout) {
+        ++it;
+        continue;
+      }
+      {
+        std::lock_guard lock(registryMutex());
+        registry().erase(it->first);
+      }
+      it = _handedOver.erase(it);
+    }
+  }
+
+  size_t backlogLocked() const { return _queue.size() + _handedOver.size(); }
+
+  std::mutex _mutex;
+  std::weak_ptr<AdmissionControl> _self;
+  Config _config;
+  double _tokens = 1;
+  Clock::time_point _lastRefill = Clock::now();
+  std::deque<uint32_t> _queue;
+  std::unordered_map<uint32_t, Clock::time_point> _handedOver;
+  uint64_t _shed = 0;
+  bool _overloaded = false;
+  Pressure _reported = Pressure::Normal;
+};
+
+} // namespace margelo::nitro::net
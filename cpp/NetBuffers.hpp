@@ -0,0 +1,297 @@
+#pragma once
+
+#include <NitroModules/ArrayBuffer.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+using namespace margelo::nitro;
+
+/// Shared zero-length buffer handed to JS for events without a payload
+/// (CONNECT, END, DRAIN, ...). Nothing can be written through a zero-length
+/// view, so a single instance is safe to share across events and threads.
+inline const std::shared_ptr<ArrayBuffer> &emptyBuffer() {
+  static uint8_t storage = 0;
+  // Intentionally leaked: events may still be delivered during teardown.
+  static auto *empty =
+      new std::shared_ptr<ArrayBuffer>(ArrayBuffer::wrap(&storage, 0, [] {}));
+  return *empty;
+}
+
+/// Size-classed pool backing the ArrayBuffers produced for native events.
+/// Payloads are copied into fixed 4K/16K/64K blocks instead of exact-size
+/// heap allocations, which keeps the native heap from fragmenting under
+/// sustained traffic. Blocks return to the pool when JS garbage-collects the
+/// ArrayBuffer. Allocating threads (Rust workers) keep a small thread-local
+/// magazine per class and refill it from a shared free list in batches.
+/// Releases usually happen on the JS thread and go straight to the free list.
+class BufferPool {
+public:
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t oversize;
+    uint64_t inUseBytes;
+    uint64_t cachedBytes;
+  };
+
+  static BufferPool &shared() {
+    // Intentionally leaked: buffers may be released by JS after static
+    // destructors have run.
+    static BufferPool *instance = new BufferPool();
+    return *instance;
+  }
+
+  /// Copy `len` bytes into a pooled block and wrap it as an ArrayBuffer.
+  /// Payloads larger than the biggest size class are copied as before.
+  std::shared_ptr<ArrayBuffer> copy(const uint8_t *data, size_t len) {
+    const int sizeClass = classFor(len);
+    if (sizeClass < 0) {
+      _oversize.fetch_add(1, std::memory_order_relaxed);
+      return ArrayBuffer::copy(data, len);
+    }
+
+    uint8_t *block = acquire(sizeClass);
+    if (block == nullptr) {
+      return ArrayBuffer::copy(data, len);
+    }
+    memcpy(block, data, len);
+    return ArrayBuffer::wrap(block, len, [this, block, sizeClass] {
+      release(sizeClass, block);
+    });
+  }
+
+  Stats stats() const {
+    return {_hits.load(std::memory_order_relaxed),
+            _misses.load(std::memory_order_relaxed),
+            _oversize.load(std::memory_order_relaxed),
+            _inUseBytes.load(std::memory_order_relaxed),
+            _cachedBytes.load(std::memory_order_relaxed)};
+  }
+
+private:
+  static constexpr size_t kClassCount = 3;
+  static constexpr std::array<size_t, kClassCount> kClassSizes = {
+      4 * 1024, 16 * 1024, 64 * 1024};
+  // Upper bound on idle blocks kept per class (1 MiB / 2 MiB / 4 MiB).
+  static constexpr std::array<size_t, kClassCount> kMaxCached = {256, 128, 64};
+  static constexpr size_t kMagazineSize = 16;
+
+  struct FreeList {
+    std::mutex mutex;
+    std::vector<uint8_t *> blocks;
+  };
+
+  struct Magazine {
+    std::array<uint8_t *, kMagazineSize> blocks{};
+    size_t count = 0;
+  };
+
+  // Per-thread cache; handed back to the shared lists when the thread exits.
+  struct ThreadCache {
+    std::array<Magazine, kClassCount> magazines;
+
+    ~ThreadCache() {
+      for (size_t c = 0; c < kClassCount; c++) {
+        Magazine &magazine = magazines[c];
+        while (magazine.count > 0) {
+          BufferPool::shared().reclaim(static_cast<int>(c),
+                                       magazine.blocks[--magazine.count]);
+        }
+      }
+    }
+  };
+
+  BufferPool() = default;
+
+  static int classFor(size_t len) {
+    for (size_t c = 0; c < kClassCount; c++) {
+      if (len <= kClassSizes[c])
+        return static_cast<int>(c);
+    }
+    return -1;
+  }
+
+  static ThreadCache &threadCache() {
+    thread_local ThreadCache cache;
+    return cache;
+  }
+
+  uint8_t *acquire(int sizeClass) {
+    const size_t size = kClassSizes[sizeClass];
+    Magazine &magazine = threadCache().magazines[sizeClass];
+    if (magazine.count == 0) {
+      FreeList &list = _free[sizeClass];
+      std::lock_guard lock(list.mutex);
+      while (magazine.count < kMagazineSize / 2 && !list.blocks.empty()) {
+        magazine.blocks[magazine.count++] = list.blocks.back();
+        list.blocks.pop_back();
+      }
+    }
+
+    _inUseBytes.fetch_add(size, std::memory_order_relaxed);
+    if (magazine.count > 0) {
+      _hits.fetch_add(1, std::memory_order_relaxed);
+      _cachedBytes.fetch_sub(size, std::memory_order_relaxed);
+      return magazine.blocks[--magazine.count];
+    }
+    _misses.fetch_add(1, std::memory_order_relaxed);
+    auto *block = static_cast<uint8_t *>(malloc(size));
+    if (block == nullptr) {
+      _inUseBytes.fetch_sub(size, std::memory_order_relaxed);
+    }
+    return block;
+  }
+
+  void release(int sizeClass, uint8_t *block) {
+    _inUseBytes.fetch_sub(kClassSizes[sizeClass], std::memory_order_relaxed);
+    giveBack(sizeClass, block);
+  }
+
+  // Returns an idle block held by a thread cache (already counted as cached).
+  void reclaim(int sizeClass, uint8_t *block) {
+    _cachedBytes.fetch_sub(kClassSizes[sizeClass], std::memory_order_relaxed);
+    giveBack(sizeClass, block);
+  }
+
+  void giveBack(int sizeClass, uint8_t *block) {
+    FreeList &list = _free[sizeClass];
+    {
+      std::lock_guard lock(list.mutex);
+      if (list.blocks.size() < kMaxCached[sizeClass]) {
+        list.blocks.push_back(block);
+        block = nullptr;
+      }
+    }
+    if (block == nullptr) {
+      _cachedBytes.fetch_add(kClassSizes[sizeClass],
+                             std::memory_order_relaxed);
+    } else {
+      free(block);
+    }
+  }
+
+  std::array<FreeList, kClassCount> _free;
+  std::atomic<uint64_t> _hits{0};
+  std::atomic<uint64_t> _misses{0};
+  std::atomic<uint64_t> _oversize{0};
+  std::atomic<uint64_t> _inUseBytes{0};
+  std::atomic<uint64_t> _cachedBytes{0};
+};
+
+/// Build the ArrayBuffer delivered to JS for a native event payload.
+/// `data` is only valid for the duration of the Rust callback, so the payload
+/// is copied exactly once here into a pooled block; JS wraps that buffer
+/// as-is (Buffer.from(ab)) without copying again.
+inline std::shared_ptr<ArrayBuffer> makeEventBuffer(const uint8_t *data,
+                                                    size_t len) {
+  if (data == nullptr || len == 0) {
+    return emptyBuffer();
+  }
+  return BufferPool::shared().copy(data, len);
+}
+
+/// A window into a caller-owned buffer.
+struct ByteRange {
+  const uint8_t *data;
+  size_t size;
+};
+
+/// Clamps a JS number to [0, limit]; NaN maps to 0.
+inline size_t clampToSize(double value, size_t limit) {
+  if (!(value > 0))
+    return 0;
+  if (value >= static_cast<double>(limit))
+    return limit;
+  return static_cast<size_t>(value);
+}
+
+/// Resolves an optional (offset, length) window into `buffer`, clamped to
+/// its bounds. A missing window means the whole buffer.
+inline ByteRange rangeOf(const std::shared_ptr<ArrayBuffer> &buffer,
+                         std::optional<double> offset,
+                         std::optional<double> length) {
+  if (!buffer)
+    return {nullptr, 0};
+  const size_t size = buffer->size();
+  const size_t start = clampToSize(offset.value_or(0), size);
+  size_t count = size - start;
+  if (length.has_value()) {
+    count = clampToSize(*length, count);
+  }
+  return {buffer->data() + start, count};
+}
+
+/// Values the core copies into a caller buffer (`getter(buf, capacity)`
+/// returns the value's full length) are read through a thread-local arena
+/// that grows to the largest value seen on the thread. Nothing is truncated,
+/// and once the arena fits, each read is a single FFI call. Arenas grown past
+/// the retained size are released after the read.
+inline constexpr size_t kGetterArenaInitialSize = 1024;
+inline constexpr size_t kGetterArenaRetainedSize = 256 * 1024;
+inline constexpr size_t kGetterArenaMaxSize = 4 * 1024 * 1024;
+
+/// The calling thread's arena for values of `T` (char or uint8_t).
+template <typename T> inline std::vector<T> &getterArena() {
+  thread_local std::vector<T> arena;
+  return arena;
+}
+
+template <typename T> inline void trimGetterArena(std::vector<T> &arena) {
+  if (arena.size() > kGetterArenaRetainedSize)
+    std::vector<T>().swap(arena);
+}
+
+/// Reads one value into the arena, growing it up to `limit`. Returns the
+/// value's length; 0 if there is none or it exceeds `limit`.
+template <typename T, typename Getter>
+inline size_t readIntoArena(std::vector<T> &arena, Getter &&getter,
+                            size_t limit = kGetterArenaMaxSize) {
+  if (arena.empty())
+    arena.resize(kGetterArenaInitialSize);
+  for (;;) {
+    const size_t len = getter(arena.data(), arena.size());
+    // A value filling the whole arena may have been cut short.
+    if (len < arena.size())
+      return len;
+    if (len > limit || arena.size() >= limit)
+      return 0;
+    arena.resize(std::min(limit, std::max(arena.size() * 2, len + 1)));
+  }
+}
+
+/// A string getter's value, or "" if there is none.
+template <typename Getter> inline std::string readCoreString(Getter &&getter) {
+  std::vector<char> &arena = getterArena<char>();
+  const size_t len = readIntoArena(arena, getter);
+  // Some getters count the terminator; stop at it either way.
+  std::string value(arena.data(), strnlen(arena.data(), len));
+  trimGetterArena(arena);
+  return value;
+}
+
+/// A binary getter's value as an ArrayBuffer, or nullopt if there is none.
+template <typename Getter>
+inline std::optional<std::shared_ptr<ArrayBuffer>>
+readCoreBytes(Getter &&getter, size_t limit = kGetterArenaMaxSize) {
+  std::vector<uint8_t> &arena = getterArena<uint8_t>();
+  const size_t len = readIntoArena(arena, getter, limit);
+  std::optional<std::shared_ptr<ArrayBuffer>> value;
+  if (len > 0)
+    value = ArrayBuffer::copy(arena.data(), len);
+  trimGetterArena(arena);
+  return value;
+}
+
+} // namespace margelo::nitro::net
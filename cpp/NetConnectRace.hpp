@@ -0,0 +1,365 @@
+#pragma once
+
+#include "NetBindings.hpp"
+#include "NetDnsCache.hpp"
+#include "NetLog.hpp"
+#include "NetManager.hpp"
+#include "NetScheduler.hpp"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// Happy Eyeballs (RFC 8305) for one client connect: resolves the host
+/// through the DnsCache, then starts attempts to its addresses in
+/// interleaved family order, one every attempt delay (or at once when the
+/// previous attempt fails). The first attempt to report CONNECT wins and is
+/// handed to the owner; the others are closed. The first attempt runs on the
+/// owner's own socket ID, later ones on sockets created for the race.
+class ConnectRace : public std::enable_shared_from_this<ConnectRace> {
+public:
+  /// Receives the outcome. Calls are serialized and stop once cancel()
+  /// returns.
+  class Owner {
+  public:
+    virtual ~Owner() = default;
+    /// An attempt to `address` is starting.
+    virtual void onRaceAttempt(const DnsAddress &address) = 0;
+    /// Socket `id` connected first. Runs inside the CONNECT dispatch for
+    /// `id`; the owner registers its own handler for `id` and then delivers
+    /// the event as its own.
+    virtual void onRaceWon(uint32_t id, const uint8_t *data, size_t len) = 0;
+    /// No address could be reached; the owner's socket is back in its hands.
+    virtual void onRaceFailed(const std::string &error) = 0;
+  };
+
+  /// Starts one attempt: connects socket `id` to the literal `address`.
+  using Connector =
+      std::function<void(uint32_t id, const std::string &address)>;
+
+  /// `attemptDelay` of nullopt starts the next attempt only on failure.
+  /// Attempt timers run on `scheduler` (the owner's lane).
+  static std::shared_ptr<ConnectRace>
+  start(Owner *owner, uint32_t id, const std::string &host,
+        std::optional<std::chrono::milliseconds> attemptDelay,
+        Connector connector,
+        NetScheduler &scheduler = NetScheduler::shared()) {
+    auto race = std::shared_ptr<ConnectRace>(new ConnectRace(
+        owner, id, host, attemptDelay, std::move(connector), scheduler));
+    // Resolved from the scheduler thread so that a cached answer (or
+    // failure) never reaches the owner from inside its connect call.
+    scheduler.schedule(std::chrono::microseconds(0), [race] {
+      DnsCache::shared().resolve(race->_host,
+                                 [race](const DnsCache::Result &result) {
+                                   race->onResolved(result);
+                                 });
+    });
+    return race;
+  }
+
+  /// Stops the race. The owner's socket ID is left registered to nobody (the
+  /// owner closes it); every other attempt is closed.
+  void cancel() {
+    {
+      std::lock_guard lock(_ownerMutex);
+      _owner = nullptr;
+    }
+    std::vector<uint32_t> attempts;
+    {
+      std::lock_guard lock(_mutex);
+      if (_done)
+        return;
+      _done = true;
+      attempts = takeAttemptsLocked();
+    }
+    for (const uint32_t id : attempts) {
+      release(id, id != _primary);
+    }
+  }
+
+  /// RFC 8305 section 4: alternate families, starting with the family of
+  /// the resolver's first (most preferred) address.
+  static std::vector<DnsAddress>
+  interleave(const std::vector<DnsAddress> &addresses) {
+    if (addresses.empty())
+      return {};
+    std::vector<DnsAddress> first, second;
+    for (const DnsAddress &address : addresses) {
+      (address.family == addresses[0].family ? first : second)
+          .push_back(address);
+    }
+    std::vector<DnsAddress> ordered;
+    ordered.reserve(addresses.size());
+    for (size_t i = 0; i < first.size() || i < second.size(); i++) {
+      if (i < first.size())
+        ordered.push_back(first[i]);
+      if (i < second.size())
+        ordered.push_back(second[i]);
+    }
+    return ordered;
+  }
+
+private:
+  struct Attempt {
+    uint32_t id;
+    bool failed = false;
+    bool registered = true; // Events for the ID still come to the race
+  };
+
+  ConnectRace(Owner *owner, uint32_t id, const std::string &host,
+              std::optional<std::chrono::milliseconds> attemptDelay,
+              Connector connector, NetScheduler &scheduler)
+      : _owner(owner), _primary(id), _host(host), _attemptDelay(attemptDelay),
+        _connector(std::move(connector)), _scheduler(scheduler) {}
+
+  // Attempt IDs map to their race here rather than through the handler
+  // context, so a late dispatch racing with release() finds nothing instead
+  // of a freed race.
+  static std::mutex &registryMutex() {
+    static std::mutex *mutex = new std::mutex();
+    return *mutex;
+  }
+  static std::unordered_map<uint32_t, std::shared_ptr<ConnectRace>> &
+  registry() {
+    static auto *map =
+        new std::unordered_map<uint32_t, std::shared_ptr<ConnectRace>>();
+    return *map;
+  }
+
+  static void *contextFor(uint32_t id) {
+    return reinterpret_cast<void *>(static_cast<uintptr_t>(id));
+  }
+
+  static void onEventThunk(void *context, int type, const uint8_t *data,
+                           size_t len) {
+    const auto id = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(context));
+    std::shared_ptr<ConnectRace> race;
+    {
+      std::lock_guard lock(registryMutex());
+      auto it = registry().find(id);
+      if (it == registry().end())
+        return;
+      race = it->second;
+    }
+    race->onAttemptEvent(id, type, data, len);
+  }
+
+  static void forget(uint32_t id) {
+    std::lock_guard lock(registryMutex());
+    registry().erase(id);
+  }
+
+  // Unregisters an attempt and (unless it is the owner's) closes it.
+  static void release(uint32_t id, bool close) {
+    forget(id);
+    NetManager::shared().unregisterHandler(id);
+    if (close) {
+      // Don't re-enter the core from its own callback.
+      NetScheduler::shared().schedule(std::chrono::microseconds(0),
+                                      [id] { net_destroy_socket(id); });
+    }
+  }
+
+  std::vector<uint32_t> takeAttemptsLocked(uint32_t except = 0) {
+    std::vector<uint32_t> ids;
+    for (Attempt &attempt : _attempts) {
+      if (attempt.registered && attempt.id != except) {
+        attempt.registered = false;
+        ids.push_back(attempt.id);
+      }
+    }
+    return ids;
+  }
+
+  void onResolved(const DnsCache::Result &result) {
+    {
+      std::lock_guard lock(_mutex);
+      if (_done)
+        return;
+      if (result.addresses.empty()) {
+        _done = true;
+      } else {
+        _addresses = interleave(result.addresses);
+      }
+    }
+    if (result.addresses.empty()) {
+      std::lock_guard lock(_ownerMutex);
+      if (_owner)
+        _owner->onRaceFailed(result.error);
+      return;
+    }
+    startNext(0);
+  }
+
+  // Starts attempt `index` unless it is already running (its predecessor
+  // failed before the delay elapsed) or the race is over.
+  void startNext(size_t index) {
+    DnsAddress address;
+    uint32_t id = 0;
+    {
+      std::lock_guard lock(_mutex);
+      if (_done || _next != index || _next >= _addresses.size())
+        return;
+      address = _addresses[_next];
+      id = _next == 0 ? _primary : net_create_socket();
+      _next++;
+      _attempts.push_back(Attempt{id});
+      _inflight++;
+      {
+        std::lock_guard registryLock(registryMutex());
+        registry()[id] = shared_from_this();
+      }
+      NetManager::shared().registerHandler(id, contextFor(id), onEventThunk);
+    }
+    {
+      std::lock_guard lock(_ownerMutex);
+      if (_owner)
+        _owner->onRaceAttempt(address);
+    }
+    NET_LOGD(Socket, "Connect race for %s: attempt %zu to %s on socket %u",
+             _host.c_str(), index + 1, address.ip.c_str(), id);
+    _connector(id, address.ip);
+
+    if (_attemptDelay.has_value()) {
+      auto self = shared_from_this();
+      _scheduler.schedule(*_attemptDelay,
+                          [self, index] { self->startNext(index + 1); });
+    }
+  }
+
+  void onAttemptEvent(uint32_t id, int type, const uint8_t *data,
+                      size_t len) {
+    switch (type) {
+    case 1: // CONNECT
+      onConnected(id, data, len);
+      return;
+    case 3: // ERROR
+      onFailed(id, std::string(reinterpret_cast<const char *>(data), len));
+      return;
+    case 4: // CLOSE
+      onFailed(id, {});
+      return;
+    default:
+      // Core LOOKUPs, timeouts and TLS side events of attempts that may
+      // still lose are not reported.
+      return;
+    }
+  }
+
+  void onConnected(uint32_t id, const uint8_t *data, size_t len) {
+    std::vector<uint32_t> losers;
+    {
+      std::lock_guard lock(_mutex);
+      if (_done)
+        return;
+      _done = true;
+      losers = takeAttemptsLocked(id);
+      for (Attempt &attempt : _attempts) {
+        attempt.registered = false;
+      }
+    }
+    bool adopted = false;
+    {
+      std::lock_guard lock(_ownerMutex);
+      if (_owner) {
+        _owner->onRaceWon(id, data, len);
+        adopted = true;
+      }
+    }
+    if (adopted) {
+      forget(id);
+    } else {
+      // Cancelled while deciding: the owner still holds (and closes) its
+      // own ID, so only the others are closed here.
+      losers.push_back(id);
+    }
+    for (const uint32_t loser : losers) {
+      release(loser, adopted || loser != _primary);
+    }
+  }
+
+  void onFailed(uint32_t id, const std::string &error) {
+    bool exhausted = false;
+    bool startAnother = false;
+    std::vector<uint32_t> closing;
+    size_t next = 0;
+    {
+      std::lock_guard lock(_mutex);
+      if (_done)
+        return;
+      Attempt *attempt = nullptr;
+      for (Attempt &candidate : _attempts) {
+        if (candidate.id == id)
+          attempt = &candidate;
+      }
+      if (attempt == nullptr || attempt->failed)
+        return;
+      attempt->failed = true;
+      _inflight--;
+      if (!error.empty())
+        _error = error;
+      NET_LOGD(Socket, "Connect race for %s: socket %u failed: %s",
+               _host.c_str(), id, error.c_str());
+
+      if (_next < _addresses.size()) {
+        startAnother = true;
+        next = _next;
+      } else if (_inflight == 0) {
+        exhausted = true;
+        _done = true;
+      }
+      if (exhausted) {
+        closing = takeAttemptsLocked(_primary);
+        for (Attempt &candidate : _attempts) {
+          candidate.registered = false;
+        }
+      } else if (id != _primary) {
+        // The owner's own ID stays with the race until the outcome is known.
+        attempt->registered = false;
+        closing.push_back(id);
+      }
+    }
+
+    if (exhausted) {
+      std::lock_guard lock(_ownerMutex);
+      if (_owner) {
+        _owner->onRaceFailed(_error.empty() ? "connect failed: " + _host
+                                            : _error);
+        forget(_primary);
+      } else {
+        release(_primary, false);
+      }
+    }
+    for (const uint32_t attemptId : closing) {
+      release(attemptId, true);
+    }
+    if (startAnother)
+      startNext(next);
+  }
+
+  std::mutex _ownerMutex; // Serializes owner calls against cancel()
+  Owner *_owner;
+
+  const uint32_t _primary;
+  const std::string _host;
+  const std::optional<std::chrono::milliseconds> _attemptDelay;
+  const Connector _connector;
+  NetScheduler &_scheduler;
+
+  std::mutex _mutex;
+  bool _done = false;
+  std::vector<DnsAddress> _addresses;
+  size_t _next = 0; // Index of the next address to try
+  size_t _inflight = 0;
+  std::vector<Attempt> _attempts;
+  std::string _error; // Last attempt failure
+};
+
+} // namespace margelo::nitro::net
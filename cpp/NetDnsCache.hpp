@@ -0,0 +1,313 @@
+#pragma once
+
+#include "NetLog.hpp"
+#include "NetStats.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// One resolved address of a host.
+struct DnsAddress {
+  std::string ip;
+  int family; // 4 or 6
+};
+
+/// Returns 4 or 6 if `host` is an IP literal, else 0.
+inline int ipLiteralFamily(const std::string &host) {
+  in6_addr addr;
+  if (inet_pton(AF_INET, host.c_str(), &addr) == 1)
+    return 4;
+  if (inet_pton(AF_INET6, host.c_str(), &addr) == 1)
+    return 6;
+  return 0;
+}
+
+/// Host name cache shared by every client socket, so repeated connects to
+/// the same host skip the resolver. Answers come from getaddrinfo (in the
+/// system's RFC 6724 order) on a few resolver threads; concurrent lookups of
+/// one name share a single query. getaddrinfo does not report record TTLs,
+/// so answers live for the configured TTL, failures for the negative TTL.
+/// An answer used during the last quarter of its lifetime is refreshed in
+/// the background, so busy hosts never wait on an expired entry.
+class DnsCache {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Result {
+    std::vector<DnsAddress> addresses;
+    std::string error; // Set if resolution failed
+  };
+  using Callback = std::function<void(const Result &)>;
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t negativeHits = 0; // Lookups answered by a cached failure
+    uint64_t prefetches = 0;   // Background refreshes started
+    size_t entries = 0;
+  };
+
+  static constexpr std::chrono::milliseconds kDefaultTtl{30000};
+  static constexpr std::chrono::milliseconds kDefaultNegativeTtl{1000};
+  static constexpr size_t kDefaultCapacity = 256;
+
+  static DnsCache &shared() {
+    // Intentionally leaked: resolver threads may finish during teardown.
+    static DnsCache *instance = new DnsCache();
+    return *instance;
+  }
+
+  /// A zero TTL disables caching of answers (or failures); lookups still
+  /// share in-flight queries.
+  void configure(std::chrono::milliseconds ttl,
+                 std::chrono::milliseconds negativeTtl, size_t capacity) {
+    std::lock_guard lock(_mutex);
+    _ttl = ttl;
+    _negativeTtl = negativeTtl;
+    _capacity = std::max<size_t>(capacity, 1);
+  }
+
+  std::chrono::milliseconds ttl() {
+    std::lock_guard lock(_mutex);
+    return _ttl;
+  }
+  std::chrono::milliseconds negativeTtl() {
+    std::lock_guard lock(_mutex);
+    return _negativeTtl;
+  }
+  size_t capacity() {
+    std::lock_guard lock(_mutex);
+    return _capacity;
+  }
+
+  /// Resolves `host`. A cached answer is delivered before this returns,
+  /// anything else on a resolver thread. `callback` may be empty (prefetch).
+  void resolve(const std::string &host, Callback callback) {
+    std::unique_lock lock(_mutex);
+    const auto now = Clock::now();
+    auto it = _entries.find(host);
+    if (it != _entries.end() && it->second.cached && now < it->second.expires) {
+      Entry &entry = it->second;
+      entry.lastUsed = now;
+      const bool negative = entry.result.addresses.empty();
+      negative ? _stats.negativeHits++ : _stats.hits++;
+      if (!negative && !entry.querying && now >= entry.refreshAt) {
+        entry.querying = true;
+        _stats.prefetches++;
+        enqueueLocked(host);
+      }
+      if (!callback)
+        return;
+      const Result result = entry.result;
+      lock.unlock();
+      callback(result);
+      return;
+    }
+
+    _stats.misses++;
+    if (it == _entries.end()) {
+      makeRoomLocked(now);
+      it = _entries.emplace(host, Entry{}).first;
+    }
+    Entry &entry = it->second;
+    entry.lastUsed = now;
+    if (callback)
+      entry.waiters.push_back(std::move(callback));
+    if (!entry.querying) {
+      entry.querying = true;
+      enqueueLocked(host);
+    }
+  }
+
+  /// Starts resolving `host` unless a fresh answer is already cached.
+  void prefetch(const std::string &host) { resolve(host, nullptr); }
+
+  /// Drops every cached answer; lookups in flight still complete.
+  void clear() {
+    std::lock_guard lock(_mutex);
+    for (auto it = _entries.begin(); it != _entries.end();) {
+      if (it->second.querying) {
+        it->second.cached = false;
+        ++it;
+      } else {
+        it = _entries.erase(it);
+      }
+    }
+  }
+
+  Stats stats() {
+    std::lock_guard lock(_mutex);
+    Stats stats = _stats;
+    stats.entries = 0;
+    for (const auto &[host, entry] : _entries) {
+      stats.entries += entry.cached;
+    }
+    return stats;
+  }
+
+private:
+  static constexpr size_t kMaxResolvers = 4;
+
+  struct Entry {
+    Result result;
+    bool cached = false;   // `result` holds an answer or failure
+    bool querying = false; // A resolver owns this name
+    Clock::time_point expires;
+    Clock::time_point refreshAt;
+    Clock::time_point lastUsed;
+    std::vector<Callback> waiters;
+  };
+
+  DnsCache() = default;
+
+  // Evicts expired entries, then the least recently used idle one.
+  void makeRoomLocked(Clock::time_point now) {
+    if (_entries.size() < _capacity)
+      return;
+    auto victim = _entries.end();
+    for (auto it = _entries.begin(); it != _entries.end();) {
+      Entry &entry = it->second;
+      if (entry.querying) {
+        ++it;
+        continue;
+      }
+      if (!entry.cached || now >= entry.expires) {
+        it = _entries.erase(it);
+        continue;
+      }
+      if (victim == _entries.end() ||
+          entry.lastUsed < victim->second.lastUsed) {
+        victim = it;
+      }
+      ++it;
+    }
+    if (_entries.size() >= _capacity && victim != _entries.end())
+      _entries.erase(victim);
+  }
+
+  void enqueueLocked(const std::string &host) {
+    _queue.push_back(host);
+    if (_resolvers < kMaxResolvers && _resolvers < _queue.size()) {
+      _resolvers++;
+      std::thread([this] { runResolver(); }).detach();
+    }
+  }
+
+  void runResolver() {
+    std::unique_lock lock(_mutex);
+    while (!_queue.empty()) {
+      const std::string host = std::move(_queue.front());
+      _queue.pop_front();
+      lock.unlock();
+      const auto started = Clock::now();
+      Result result = query(host);
+      RuntimeStats::shared().dnsTime.record(Clock::now() - started);
+      lock.lock();
+      complete(host, std::move(result), lock);
+    }
+    _resolvers--;
+  }
+
+  void complete(const std::string &host, Result result,
+                std::unique_lock<std::mutex> &lock) {
+    auto it = _entries.find(host);
+    if (it == _entries.end())
+      return;
+    Entry &entry = it->second;
+    entry.querying = false;
+    std::vector<Callback> waiters = std::move(entry.waiters);
+    entry.waiters.clear();
+
+    const auto now = Clock::now();
+    const bool failed = result.addresses.empty();
+    if (failed && entry.cached && !entry.result.addresses.empty() &&
+        now < entry.expires) {
+      // A failed refresh keeps serving the previous answer until it expires.
+      result = entry.result;
+    } else {
+      const auto ttl = failed ? _negativeTtl : _ttl;
+      if (ttl.count() > 0) {
+        entry.result = result;
+        entry.cached = true;
+        entry.expires = now + ttl;
+        entry.refreshAt = now + ttl * 3 / 4;
+      } else {
+        _entries.erase(it);
+      }
+    }
+
+    if (waiters.empty())
+      return;
+    lock.unlock();
+    for (const Callback &callback : waiters) {
+      callback(result);
+    }
+    lock.lock();
+  }
+
+  static Result query(const std::string &host) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+    addrinfo *info = nullptr;
+    const int rc = getaddrinfo(host.c_str(), nullptr, &hints, &info);
+    if (rc != 0) {
+      NET_LOGD(Socket, "getaddrinfo(%s) failed: %s", host.c_str(),
+               gai_strerror(rc));
+      return Result{{}, std::string("getaddrinfo ") + gai_strerror(rc) + ' ' +
+                            host};
+    }
+
+    Result result;
+    char buf[INET6_ADDRSTRLEN];
+    for (addrinfo *ai = info; ai != nullptr; ai = ai->ai_next) {
+      const void *addr = nullptr;
+      int family = 0;
+      if (ai->ai_family == AF_INET) {
+        addr = &reinterpret_cast<sockaddr_in *>(ai->ai_addr)->sin_addr;
+        family = 4;
+      } else if (ai->ai_family == AF_INET6) {
+        addr = &reinterpret_cast<sockaddr_in6 *>(ai->ai_addr)->sin6_addr;
+        family = 6;
+      }
+      if (addr == nullptr ||
+          inet_ntop(ai->ai_family, addr, buf, sizeof(buf)) == nullptr)
+        continue;
+      bool seen = false;
+      for (const DnsAddress &known : result.addresses) {
+        seen = seen || known.ip == buf;
+      }
+      if (!seen)
+        result.addresses.push_back(DnsAddress{buf, family});
+    }
+    freeaddrinfo(info);
+    if (result.addresses.empty())
+      result.error = "getaddrinfo ENOTFOUND " + host;
+    return result;
+  }
+
+  std::mutex _mutex;
+  std::chrono::milliseconds _ttl = kDefaultTtl;
+  std::chrono::milliseconds _negativeTtl = kDefaultNegativeTtl;
+  size_t _capacity = kDefaultCapacity;
+  std::unordered_map<std::string, Entry> _entries;
+  std::deque<std::string> _queue;
+  size_t _resolvers = 0;
+  Stats _stats;
+};
+
+} // namespace margelo::nitro::net
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "NetBuffers.hpp"
+#include "NetScheduler.hpp"
+#include "NetStats.hpp"
+#include <NitroModules/ArrayBuffer.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+using namespace margelo::nitro;
+
+/// Opt-in batched event delivery for one socket/server driver.
+/// Events are queued natively and flushed to JS as a single call carrying a
+/// packed Uint32 array of (type, offset, length) descriptors and one backing
+/// buffer holding all payloads. Deferrable events (e.g. DATA, DRAIN) wait up
+/// to `interval` for company; any other event flushes the queue immediately
+/// (after everything queued before it), so relative order is preserved.
+class EventBatcher : public std::enable_shared_from_this<EventBatcher> {
+public:
+  using BatchCallback =
+      std::function<void(const std::shared_ptr<ArrayBuffer> &descriptors,
+                         const std::shared_ptr<ArrayBuffer> &data)>;
+
+  static constexpr uint32_t kDefaultIntervalMicros = 1000;
+  static constexpr size_t kDefaultMaxBatchBytes = 256 * 1024;
+
+  /// `deferrableMask` has bit N set if event type N may wait for a flush.
+  /// Buffer bytes handed to JS are counted into `counters`. Flushes run on
+  /// `scheduler` (the owner's lane).
+  EventBatcher(uint32_t deferrableMask,
+               std::shared_ptr<TrafficCounters> counters,
+               NetScheduler &scheduler = NetScheduler::shared())
+      : _deferrableMask(deferrableMask), _counters(std::move(counters)),
+        _scheduler(scheduler) {}
+
+  void setCallback(BatchCallback callback) {
+    std::lock_guard lock(_mutex);
+    _callback = std::move(callback);
+  }
+
+  BatchCallback callback() {
+    std::lock_guard lock(_mutex);
+    return _callback;
+  }
+
+  /// Turn batching on or off. Turning it off flushes anything still queued.
+  void configure(bool enabled, uint32_t intervalMicros, size_t maxBatchBytes) {
+    std::lock_guard lock(_mutex);
+    if (!enabled) {
+      deliverLocked();
+    }
+    _interval = std::chrono::microseconds(intervalMicros);
+    _maxBatchBytes = maxBatchBytes;
+    _enabled.store(enabled, std::memory_order_release);
+  }
+
+  /// Queue an event. Returns false if batching is off (or no JS callback is
+  /// set), in which case the caller delivers the event directly.
+  bool push(int type, const uint8_t *data, size_t len) {
+    if (!_enabled.load(std::memory_order_acquire))
+      return false;
+
+    std::lock_guard lock(_mutex);
+    if (!_enabled.load(std::memory_order_relaxed) || !_callback)
+      return false;
+
+    const auto offset = static_cast<uint32_t>(_bytes.size());
+    _descriptors.push_back(static_cast<uint32_t>(type));
+    _descriptors.push_back(offset);
+    _descriptors.push_back(static_cast<uint32_t>(len));
+    if (data != nullptr && len > 0) {
+      _bytes.insert(_bytes.end(), data, data + len);
+    }
+    _queuedAt.push_back(NetScheduler::Clock::now());
+
+    const bool deferrable =
+        type >= 0 && type < 32 && ((_deferrableMask >> type) & 1U) != 0;
+    if (!deferrable || _bytes.size() >= _maxBatchBytes) {
+      deliverLocked();
+    } else if (!_flushScheduled) {
+      _flushScheduled = true;
+      std::weak_ptr<EventBatcher> weak = weak_from_this();
+      _scheduler.schedule(_interval, [weak] {
+        if (auto self = weak.lock()) {
+          self->flush();
+        }
+      });
+    }
+    return true;
+  }
+
+  void flush() {
+    std::lock_guard lock(_mutex);
+    _flushScheduled = false;
+    deliverLocked();
+  }
+
+  /// Drop queued events and the JS callback; used when the driver is
+  /// destroyed.
+  void close() {
+    std::lock_guard lock(_mutex);
+    _enabled.store(false, std::memory_order_release);
+    _descriptors.clear();
+    _bytes.clear();
+    _queuedAt.clear();
+    _callback = nullptr;
+  }
+
+private:
+  // Delivery happens under the lock so batches can never overtake each other;
+  // the Nitro callback only enqueues the call onto the JS thread.
+  void deliverLocked() {
+    if (_descriptors.empty() || !_callback)
+      return;
+
+    auto *descriptors = new std::vector<uint32_t>(std::move(_descriptors));
+    auto descriptorBuffer = ArrayBuffer::wrap(
+        reinterpret_cast<uint8_t *>(descriptors->data()),
+        descriptors->size() * sizeof(uint32_t), [descriptors] {
+          delete descriptors;
+        });
+
+    std::shared_ptr<ArrayBuffer> dataBuffer;
+    if (_bytes.empty()) {
+      dataBuffer = emptyBuffer();
+    } else {
+      auto *bytes = new std::vector<uint8_t>(std::move(_bytes));
+      dataBuffer = ArrayBuffer::wrap(bytes->data(), bytes->size(),
+                                     [bytes] { delete bytes; });
+    }
+    _descriptors.clear();
+    _bytes.clear();
+
+    _callback(descriptorBuffer, dataBuffer);
+
+    countTraffic(*_counters, &TrafficCounters::bufferBytes,
+                 descriptorBuffer->size() + dataBuffer->size());
+    const auto now = NetScheduler::Clock::now();
+    LatencyHistogram &latency = RuntimeStats::shared().dispatchLatency;
+    for (const auto queuedAt : _queuedAt) {
+      latency.record(now - queuedAt);
+    }
+    _queuedAt.clear();
+  }
+
+  const uint32_t _deferrableMask;
+  const std::shared_ptr<TrafficCounters> _counters;
+  NetScheduler &_scheduler;
+  std::atomic<bool> _enabled{false};
+
+  std::mutex _mutex;
+  BatchCallback _callback;
+  std::chrono::microseconds _interval{kDefaultIntervalMicros};
+  size_t _maxBatchBytes = kDefaultMaxBatchBytes;
+  bool _flushScheduled = false;
+  std::vector<uint32_t> _descriptors;
+  std::vector<uint8_t> _bytes;
+  std::vector<NetScheduler::Clock::time_point> _queuedAt; // Per event
+};
+
+} // namespace margelo::nitro::net
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "NetBuffers.hpp"
+#include "NetScheduler.hpp"
+#include "NetStats.hpp"
+#include <NitroModules/ArrayBuffer.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+using namespace margelo::nitro;
+
+/// Opt-in event queue shared by every socket and server driver of the
+/// runtime. Drivers attached to the pump enqueue their events here instead
+/// of calling JS; the first event after a drain schedules one wake-up call
+/// on the JS thread, which then drains everything queued so far in a single
+/// hop. A drained batch holds (key, type, offset, length) descriptors, with
+/// the key naming the driver, and one buffer holding all payloads. Within a
+/// batch, terminal events (ERROR, CLOSE) come after all other events, so a
+/// socket's last reads are never handed over after it has closed.
+class EventPump {
+public:
+  using Wake = std::function<void()>;
+
+  struct Batch {
+    std::shared_ptr<ArrayBuffer> descriptors;
+    std::shared_ptr<ArrayBuffer> data;
+  };
+
+  static constexpr size_t kDescriptorWords = 4;
+
+  static EventPump &shared() {
+    // Intentionally leaked: drivers may push from worker threads at exit.
+    static EventPump *instance = new EventPump();
+    return *instance;
+  }
+
+  /// Sets the JS callback that triggers a drain.
+  void setWake(Wake wake) {
+    std::lock_guard lock(_mutex);
+    _wake = std::move(wake);
+    _wakePending = false;
+  }
+
+  bool enabled() {
+    std::lock_guard lock(_mutex);
+    return static_cast<bool>(_wake);
+  }
+
+  /// A new driver key; never 0.
+  uint32_t newKey() { return _nextKey.fetch_add(1, std::memory_order_relaxed); }
+
+  void push(uint32_t key, int type, const uint8_t *data, size_t len,
+            NetScheduler::Clock::time_point arrived) {
+    Wake wake;
+    {
+      std::lock_guard lock(_mutex);
+      _descriptors.push_back(key);
+      _descriptors.push_back(static_cast<uint32_t>(type));
+      _descriptors.push_back(static_cast<uint32_t>(_bytes.size()));
+      _descriptors.push_back(static_cast<uint32_t>(len));
+      if (data != nullptr && len > 0)
+        _bytes.insert(_bytes.end(), data, data + len);
+      _arrived.push_back(arrived);
+      _terminal = _terminal || isTerminal(type);
+      if (!_wakePending && _wake) {
+        _wakePending = true;
+        wake = _wake;
+      }
+    }
+    // Only enqueues the call onto the JS thread; a drain that runs first
+    // picks up this event and the wake-up then finds an empty queue.
+    if (wake)
+      wake();
+  }
+
+  /// Everything queued so far; called on the JS thread.
+  Batch drain() {
+    std::vector<uint32_t> descriptors;
+    std::vector<uint8_t> bytes;
+    std::vector<NetScheduler::Clock::time_point> arrived;
+    bool terminal;
+    {
+      std::lock_guard lock(_mutex);
+      _wakePending = false;
+      descriptors.swap(_descriptors);
+      bytes.swap(_bytes);
+      arrived.swap(_arrived);
+      terminal = std::exchange(_terminal, false);
+    }
+    if (terminal)
+      moveTerminalLast(descriptors);
+
+    Batch batch;
+    if (descriptors.empty()) {
+      batch.descriptors = emptyBuffer();
+    } else {
+      auto *owned = new std::vector<uint32_t>(std::move(descriptors));
+      batch.descriptors = ArrayBuffer::wrap(
+          reinterpret_cast<uint8_t *>(owned->data()),
+          owned->size() * sizeof(uint32_t), [owned] { delete owned; });
+    }
+    if (bytes.empty()) {
+      batch.data = emptyBuffer();
+    } else {
+      auto *owned = new std::vector<uint8_t>(std::move(bytes));
+      batch.data = ArrayBuffer::wrap(owned->data(), owned->size(),
+                                     [owned] { delete owned; });
+    }
+
+    // The events reach JS now, so this is their full dispatch latency.
+    const auto now = NetScheduler::Clock::now();
+    LatencyHistogram &latency = RuntimeStats::shared().dispatchLatency;
+    for (const auto time : arrived)
+      latency.record(now - time);
+    return batch;
+  }
+
+private:
+  EventPump() = default;
+
+  static bool isTerminal(int type) {
+    return type == 3 || type == 4; // ERROR, CLOSE
+  }
+
+  // Stable: events keep their order within each of the two groups.
+  static void moveTerminalLast(std::vector<uint32_t> &descriptors) {
+    std::vector<uint32_t> ordered;
+    ordered.reserve(descriptors.size());
+    for (const bool terminal : {false, true}) {
+      for (size_t i = 0; i < descriptors.size(); i += kDescriptorWords) {
+        if (isTerminal(static_cast<int>(descriptors[i + 1])) != terminal)
+          continue;
+        ordered.insert(ordered.end(), descriptors.begin() + i,
+                       descriptors.begin() + i + kDescriptorWords);
+      }
+    }
+    descriptors.swap(ordered);
+  }
+
+  std::atomic<uint32_t> _nextKey{1};
+
+  std::mutex _mutex;
+  Wake _wake;
+  bool _wakePending = false;
+  bool _terminal = false; // A terminal event is queued
+  std::vector<uint32_t> _descriptors;
+  std::vector<uint8_t> _bytes;
+  std::vector<NetScheduler::Clock::time_point> _arrived; // Per event
+};
+
+} // namespace margelo::nitro::net
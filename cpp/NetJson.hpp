@@ -0,0 +1,439 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace margelo::nitro::net {
+namespace detail {
+
+/// Returns the first '"' or '\\' in [p, end) (or end), and sets `highBit` if
+/// any byte scanned before it is >= 0x80. Uses 16-byte SSE2/NEON compares.
+inline const char *scanJsonString(const char *p, const char *end,
+                                  bool &highBit) {
+#if defined(__SSE2__)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  while (end - p >= 16) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const int stops = _mm_movemask_epi8(_mm_or_si128(
+        _mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+    const int high = _mm_movemask_epi8(chunk);
+    if (stops != 0) {
+      const int at = __builtin_ctz(static_cast<unsigned>(stops));
+      highBit |= (high & ((1 << at) - 1)) != 0;
+      return p + at;
+    }
+    highBit |= high != 0;
+    p += 16;
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  while (end - p >= 16) {
+    const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+    const uint8x16_t stops =
+        vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash));
+    // Narrow each 8-bit lane to 4 bits: a 64-bit mask, 4 bits per byte.
+    const uint64_t stopMask = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(stops), 4)), 0);
+    const uint8x16_t high = vcltq_s8(vreinterpretq_s8_u8(chunk), vdupq_n_s8(0));
+    const uint64_t highMask = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(high), 4)), 0);
+    if (stopMask != 0) {
+      const int at = __builtin_ctzll(stopMask) >> 2;
+      highBit |= at > 0 && (highMask & (~0ULL >> (64 - 4 * at))) != 0;
+      return p + at;
+    }
+    highBit |= highMask != 0;
+    p += 16;
+  }
+#endif
+  while (p < end && *p != '"' && *p != '\\') {
+    highBit |= static_cast<uint8_t>(*p) >= 0x80;
+    p++;
+  }
+  return p;
+}
+
+/// Tokenizer shared by the JSON readers of the bridge: the parser frame
+/// encoder (HttpFrame.hpp) and the certificate reader below. Every method
+/// returns false on malformed input and leaves the cursor where it stopped.
+class JsonCursor {
+public:
+  static constexpr int kMaxDepth = 32;
+
+  explicit JsonCursor(std::string_view text)
+      : _begin(text.data()), _p(text.data()), _end(text.data() + text.size()) {
+  }
+
+  bool atEnd() const { return _p >= _end; }
+  char peek() const { return _p < _end ? *_p : '\0'; }
+  size_t offset() const { return static_cast<size_t>(_p - _begin); }
+  size_t remaining() const { return static_cast<size_t>(_end - _p); }
+
+  void skipSpace() {
+    while (_p < _end &&
+           (*_p == ' ' || *_p == '\n' || *_p == '\r' || *_p == '\t'))
+      _p++;
+  }
+
+  bool consume(char c) {
+    if (_p < _end && *_p == c) {
+      _p++;
+      return true;
+    }
+    return false;
+  }
+
+  bool literal(std::string_view word) {
+    if (static_cast<size_t>(_end - _p) < word.size() ||
+        std::string_view(_p, word.size()) != word)
+      return false;
+    _p += word.size();
+    return true;
+  }
+
+  /// Decodes the string at the cursor and appends its UTF-8 bytes to `out`
+  /// (a std::string or byte vector). Clears `ascii` if any byte is >= 0x80.
+  template <typename Out> bool string(Out &out, bool &ascii) {
+    if (!consume('"'))
+      return false;
+    for (;;) {
+      const char *run = _p;
+      bool highBit = false;
+      _p = scanJsonString(_p, _end, highBit);
+      ascii = ascii && !highBit;
+      out.insert(out.end(), run, _p);
+      if (_p >= _end)
+        return false;
+      if (*_p++ == '"')
+        return true;
+      if (_p >= _end)
+        return false;
+      const char escape = *_p++;
+      switch (escape) {
+      case '"':
+      case '\\':
+      case '/':
+        out.push_back(static_cast<typename Out::value_type>(escape));
+        break;
+      case 'b':
+        out.push_back('\b');
+        break;
+      case 'f':
+        out.push_back('\f');
+        break;
+      case 'n':
+        out.push_back('\n');
+        break;
+      case 'r':
+        out.push_back('\r');
+        break;
+      case 't':
+        out.push_back('\t');
+        break;
+      case 'u': {
+        uint32_t cp = 0;
+        if (!codeUnit(cp))
+          return false;
+        if (cp >= 0xD800 && cp < 0xDC00 && _end - _p >= 2 && _p[0] == '\\' &&
+            _p[1] == 'u') {
+          _p += 2;
+          uint32_t low = 0;
+          if (!codeUnit(low) || low < 0xDC00 || low >= 0xE000)
+            return false;
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+        ascii = ascii && cp < 0x80;
+        appendUtf8(out, cp);
+        break;
+      }
+      default:
+        return false;
+      }
+    }
+  }
+
+  /// A string without escapes, as a view into the text (object keys of a
+  /// known schema).
+  bool plainString(std::string_view &out) {
+    if (_p >= _end || *_p != '"')
+      return false;
+    const char *start = _p + 1;
+    bool highBit = false;
+    const char *stop = scanJsonString(start, _end, highBit);
+    if (stop >= _end || *stop != '"')
+      return false; // Escaped: the cursor stays at the opening quote
+    out = std::string_view(start, static_cast<size_t>(stop - start));
+    _p = stop + 1;
+    return true;
+  }
+
+  /// Leading decimal digits as an unsigned integer, for byte arrays.
+  bool digits(unsigned &value) {
+    const char *start = _p;
+    value = 0;
+    while (_p < _end && *_p >= '0' && *_p <= '9' && _p - start < 9) {
+      value = value * 10 + static_cast<unsigned>(*_p - '0');
+      _p++;
+    }
+    return _p != start && (_p >= _end || *_p < '0' || *_p > '9');
+  }
+
+  bool number(double &value) {
+    const char *start = _p;
+    const bool negative = consume('-');
+    double integral = 0;
+    while (_p < _end && *_p >= '0' && *_p <= '9') {
+      integral = integral * 10 + (*_p - '0');
+      _p++;
+    }
+    if (_p < _end && (*_p == '.' || *_p == 'e' || *_p == 'E')) {
+      // Rare in the core's output; strtod needs a terminated copy.
+      while (_p < _end && std::string_view("+-0123456789.eE").find(*_p) !=
+                              std::string_view::npos)
+        _p++;
+      const std::string text(start, _p);
+      char *parsed = nullptr;
+      value = std::strtod(text.c_str(), &parsed);
+      return parsed == text.c_str() + text.size();
+    }
+    if (_p == start + (negative ? 1 : 0))
+      return false;
+    value = negative ? -integral : integral;
+    return true;
+  }
+
+  /// Skips one value of any type, nested at most kMaxDepth deep.
+  bool skipValue(int depth = 0) {
+    if (depth > kMaxDepth)
+      return false;
+    skipSpace();
+    switch (peek()) {
+    case '"': {
+      std::string_view ignored;
+      if (plainString(ignored))
+        return true;
+      std::string decoded;
+      bool ascii = true;
+      return string(decoded, ascii);
+    }
+    case '{':
+    case '[': {
+      const char close = *_p++ == '{' ? '}' : ']';
+      skipSpace();
+      if (consume(close))
+        return true;
+      for (;;) {
+        if (close == '}') {
+          if (!skipValue(depth + 1)) // key
+            return false;
+          skipSpace();
+          if (!consume(':'))
+            return false;
+        }
+        if (!skipValue(depth + 1))
+          return false;
+        skipSpace();
+        if (consume(','))
+          continue;
+        return consume(close);
+      }
+    }
+    case 't':
+      return literal("true");
+    case 'f':
+      return literal("false");
+    case 'n':
+      return literal("null");
+    default: {
+      double ignored;
+      return number(ignored);
+    }
+    }
+  }
+
+private:
+  bool codeUnit(uint32_t &unit) {
+    if (_end - _p < 4)
+      return false;
+    unit = 0;
+    for (int i = 0; i < 4; i++) {
+      const char c = *_p++;
+      unit <<= 4;
+      if (c >= '0' && c <= '9')
+        unit |= static_cast<uint32_t>(c - '0');
+      else if (c >= 'a' && c <= 'f')
+        unit |= static_cast<uint32_t>(c - 'a' + 10);
+      else if (c >= 'A' && c <= 'F')
+        unit |= static_cast<uint32_t>(c - 'A' + 10);
+      else
+        return false;
+    }
+    return true;
+  }
+
+  template <typename Out> static void appendUtf8(Out &out, uint32_t cp) {
+    using Byte = typename Out::value_type;
+    if (cp < 0x80) {
+      out.push_back(static_cast<Byte>(cp));
+      return;
+    }
+    if (cp < 0x800) {
+      out.push_back(static_cast<Byte>(0xC0 | (cp >> 6)));
+    } else if (cp < 0x10000) {
+      out.push_back(static_cast<Byte>(0xE0 | (cp >> 12)));
+      out.push_back(static_cast<Byte>(0x80 | ((cp >> 6) & 0x3F)));
+    } else {
+      out.push_back(static_cast<Byte>(0xF0 | (cp >> 18)));
+      out.push_back(static_cast<Byte>(0x80 | ((cp >> 12) & 0x3F)));
+      out.push_back(static_cast<Byte>(0x80 | ((cp >> 6) & 0x3F)));
+    }
+    out.push_back(static_cast<Byte>(0x80 | (cp & 0x3F)));
+  }
+
+  const char *_begin;
+  const char *_p;
+  const char *_end;
+};
+
+/// Parsed JSON document. Values keep their span in the source text, so a
+/// nested certificate can hand out its own JSON.
+struct JsonValue {
+  enum class Type : uint8_t { Null, Boolean, Number, String, Array, Object };
+  Type type = Type::Null;
+  bool boolean = false;
+  double number = 0;
+  std::string string;
+  std::vector<JsonValue> items;
+  std::vector<std::pair<std::string, JsonValue>> members;
+  size_t begin = 0;
+  size_t end = 0;
+
+  const JsonValue *find(std::string_view name) const {
+    for (const auto &[key, value] : members) {
+      if (key == name)
+        return &value;
+    }
+    return nullptr;
+  }
+};
+
+/// Small recursive-descent JSON reader (RFC 8259, depth-limited). Returns
+/// false on malformed input.
+class JsonReader {
+public:
+  explicit JsonReader(std::string_view text) : _json(text) {}
+
+  bool read(JsonValue &out) {
+    if (!value(out, 0))
+      return false;
+    _json.skipSpace();
+    return _json.atEnd();
+  }
+
+private:
+  bool value(JsonValue &out, int depth) {
+    if (depth > JsonCursor::kMaxDepth)
+      return false;
+    _json.skipSpace();
+    if (_json.atEnd())
+      return false;
+    out.begin = _json.offset();
+    bool ascii = true;
+    bool ok;
+    switch (_json.peek()) {
+    case '{':
+      ok = object(out, depth);
+      break;
+    case '[':
+      ok = array(out, depth);
+      break;
+    case '"':
+      out.type = JsonValue::Type::String;
+      ok = _json.string(out.string, ascii);
+      break;
+    case 't':
+      out.type = JsonValue::Type::Boolean;
+      out.boolean = true;
+      ok = _json.literal("true");
+      break;
+    case 'f':
+      out.type = JsonValue::Type::Boolean;
+      ok = _json.literal("false");
+      break;
+    case 'n':
+      ok = _json.literal("null");
+      break;
+    default:
+      out.type = JsonValue::Type::Number;
+      ok = _json.number(out.number);
+      break;
+    }
+    out.end = _json.offset();
+    return ok;
+  }
+
+  bool object(JsonValue &out, int depth) {
+    out.type = JsonValue::Type::Object;
+    _json.consume('{');
+    _json.skipSpace();
+    if (_json.consume('}'))
+      return true;
+    for (;;) {
+      _json.skipSpace();
+      std::string key;
+      bool ascii = true;
+      if (!_json.string(key, ascii))
+        return false;
+      _json.skipSpace();
+      if (!_json.consume(':'))
+        return false;
+      JsonValue member;
+      if (!value(member, depth + 1))
+        return false;
+      out.members.emplace_back(std::move(key), std::move(member));
+      _json.skipSpace();
+      if (_json.consume('}'))
+        return true;
+      if (!_json.consume(','))
+        return false;
+    }
+  }
+
+  bool array(JsonValue &out, int depth) {
+    out.type = JsonValue::Type::Array;
+    _json.consume('[');
+    _json.skipSpace();
+    if (_json.consume(']'))
+      return true;
+    for (;;) {
+      JsonValue item;
+      if (!value(item, depth + 1))
+        return false;
+      out.items.push_back(std::move(item));
+      _json.skipSpace();
+      if (_json.consume(']'))
+        return true;
+      if (!_json.consume(','))
+        return false;
+    }
+  }
+
+  JsonCursor _json;
+};
+
+} // namespace detail
+} // namespace margelo::nitro::net
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "NetLog.hpp"
+#include "NetScheduler.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__ANDROID__) || defined(__linux__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace margelo::nitro::net {
+
+/// Scheduling of one lane's threads.
+struct LaneSettings {
+  std::optional<int> priority; // Nice value, -20 (highest) to 19
+  std::vector<int> cpus;       // CPUs to run on; empty leaves it unchanged
+};
+
+/// Applies `settings` to the calling thread. Only Android (and Linux) let a
+/// thread set its own nice value and affinity; elsewhere this is a no-op.
+inline bool applyThreadSettings(const LaneSettings &settings) {
+#if defined(__ANDROID__) || defined(__linux__)
+  bool applied = true;
+  if (settings.priority.has_value()) {
+    const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+    applied = setpriority(PRIO_PROCESS, tid, *settings.priority) == 0;
+  }
+  if (!settings.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : settings.cpus) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &set);
+    }
+    applied = sched_setaffinity(0, sizeof(set), &set) == 0 && applied;
+  }
+  return applied;
+#else
+  return !settings.priority.has_value() && settings.cpus.empty();
+#endif
+}
+
+/// Named executor lanes of the C++ bridge. Each lane other than the default
+/// one has its own scheduler thread for the timers of the sockets and
+/// servers created in it (connect-race attempts, batch and coalescing
+/// flushes, admission drains), so a latency-critical socket's timers never
+/// wait behind those of bulk transfers. The default lane is the shared
+/// NetScheduler plus the core's worker threads, which pick up the default
+/// lane's settings the next time they deliver an event.
+class ExecutorLanes {
+public:
+  static constexpr const char *kDefaultLane = "default";
+  /// Lanes with their own thread; names configured beyond this stay on the
+  /// default lane.
+  static constexpr size_t kMaxLanes = 8;
+
+  static ExecutorLanes &shared() {
+    // Intentionally leaked, like the schedulers it owns.
+    static ExecutorLanes *instance = new ExecutorLanes();
+    return *instance;
+  }
+
+  /// Scheduler of `lane`. Only lanes created by configure() have their own;
+  /// no name or an unknown one is the default lane.
+  NetScheduler &scheduler(const std::optional<std::string> &lane) {
+    if (isDefault(lane))
+      return NetScheduler::shared();
+    std::lock_guard lock(_mutex);
+    auto it = _lanes.find(*lane);
+    return it == _lanes.end() ? NetScheduler::shared() : *it->second.scheduler;
+  }
+
+  void configure(const std::string &lane, LaneSettings settings) {
+    NetScheduler *scheduler = &NetScheduler::shared();
+    {
+      std::lock_guard lock(_mutex);
+      if (isDefault(lane)) {
+        _coreSettings = settings;
+        _coreGeneration.fetch_add(1, std::memory_order_release);
+      } else {
+        Lane *entry = laneLocked(lane);
+        if (entry == nullptr) {
+          NET_LOGW(Manager, "Lane %s: more than %zu lanes, using default",
+                   lane.c_str(), kMaxLanes);
+          return;
+        }
+        entry->settings = settings;
+        scheduler = entry->scheduler;
+      }
+    }
+    // Lane threads apply their settings themselves.
+    scheduler->schedule(std::chrono::microseconds(0),
+                        [lane, settings = std::move(settings)] {
+                          if (!applyThreadSettings(settings))
+                            NET_LOGW(Manager,
+                                     "Lane %s: thread settings not applied",
+                                     lane.c_str());
+                        });
+  }
+
+  /// Called by the core's worker threads on each dispatch; applies the
+  /// default lane's settings once per change.
+  void adoptCoreThread() {
+    thread_local uint32_t adopted = 0;
+    const uint32_t generation =
+        _coreGeneration.load(std::memory_order_acquire);
+    if (adopted == generation)
+      return;
+    adopted = generation;
+    LaneSettings settings;
+    {
+      std::lock_guard lock(_mutex);
+      settings = _coreSettings;
+    }
+    if (!applyThreadSettings(settings))
+      NET_LOGW(Manager, "Core worker: thread settings not applied");
+  }
+
+private:
+  struct Lane {
+    LaneSettings settings;
+    NetScheduler *scheduler = nullptr; // Leaked: its thread never exits
+  };
+
+  ExecutorLanes() = default;
+
+  static bool isDefault(const std::optional<std::string> &lane) {
+    return !lane.has_value() || lane->empty() || *lane == kDefaultLane;
+  }
+
+  // The lane called `name`, created if there is room; nullptr otherwise.
+  Lane *laneLocked(const std::string &name) {
+    auto it = _lanes.find(name);
+    if (it != _lanes.end())
+      return &it->second;
+    if (_lanes.size() >= kMaxLanes)
+      return nullptr;
+    Lane &lane = _lanes[name];
+    lane.scheduler = new NetScheduler();
+    return &lane;
+  }
+
+  std::mutex _mutex;
+  std::unordered_map<std::string, Lane> _lanes;
+  LaneSettings _coreSettings;
+  std::atomic<uint32_t> _coreGeneration{0};
+};
+
+} // namespace margelo::nitro::net
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+
+// Compile-time log ceiling. Anything above it is compiled out entirely, so the
+// per-event debug logs on the data path cost nothing in production builds.
+// Override with -DNITRO_NET_LOG_LEVEL=4 to build with debug logging.
+#define NET_LOG_LEVEL_NONE 0
+#define NET_LOG_LEVEL_ERROR 1
+#define NET_LOG_LEVEL_WARN 2
+#define NET_LOG_LEVEL_INFO 3
+#define NET_LOG_LEVEL_DEBUG 4
+
+#ifndef NITRO_NET_LOG_LEVEL
+#define NITRO_NET_LOG_LEVEL NET_LOG_LEVEL_WARN
+#endif
+
+namespace margelo::nitro::net {
+
+enum class LogLevel : int {
+  None = NET_LOG_LEVEL_NONE,
+  Error = NET_LOG_LEVEL_ERROR,
+  Warn = NET_LOG_LEVEL_WARN,
+  Info = NET_LOG_LEVEL_INFO,
+  Debug = NET_LOG_LEVEL_DEBUG,
+};
+
+enum class LogTag : uint8_t { Manager, Socket, Server, Tls, Http };
+
+/// Leveled logger with a runtime filter and asynchronous output.
+/// Callers format into a fixed-size ring buffer; a background thread drains
+/// it to logcat/stdout, so logging never blocks a network worker on I/O.
+/// When the ring is full new lines are dropped (and counted) rather than
+/// stalling the caller.
+class NetLog {
+public:
+  static NetLog &shared() {
+    // Intentionally leaked: Rust worker threads may still log during process
+    // teardown, after static destructors have run.
+    static NetLog *instance = new NetLog();
+    return *instance;
+  }
+
+  void setLevel(LogLevel level) {
+    _level.store(static_cast<int>(level), std::memory_order_relaxed);
+  }
+
+  LogLevel level() const {
+    return static_cast<LogLevel>(_level.load(std::memory_order_relaxed));
+  }
+
+  bool enabled(LogLevel level) const {
+    return static_cast<int>(level) <= _level.load(std::memory_order_relaxed);
+  }
+
+  __attribute__((format(printf, 4, 5))) void
+  write(LogLevel level, LogTag tag, const char *format, ...) {
+    Record *record = claim();
+    if (!record) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    va_list args;
+    va_start(args, format);
+    vsnprintf(record->text, sizeof(record->text), format, args);
+    va_end(args);
+    record->level = level;
+    record->tag = tag;
+    record->sequence.store(record->claimedAt + 1, std::memory_order_release);
+
+    ensureWriter();
+    if (level <= LogLevel::Warn) {
+      _wake.notify_one();
+    }
+  }
+
+  static const char *tagName(LogTag tag) {
+    switch (tag) {
+    case LogTag::Manager:
+      return "NetManager";
+    case LogTag::Socket:
+      return "NetSocket";
+    case LogTag::Server:
+      return "NetServer";
+    case LogTag::Tls:
+      return "NetTLS";
+    case LogTag::Http:
+      return "NetHTTP";
+    }
+    return "Net";
+  }
+
+private:
+  static constexpr size_t kCapacity = 256; // Power of two
+  static constexpr size_t kLineLength = 240;
+
+  struct Record {
+    std::atomic<uint64_t> sequence{0};
+    uint64_t claimedAt = 0;
+    LogLevel level = LogLevel::Info;
+    LogTag tag = LogTag::Manager;
+    char text[kLineLength];
+  };
+
+  NetLog() {
+    for (size_t i = 0; i < kCapacity; i++) {
+      _ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Bounded MPSC claim (Vyukov): a slot is free when its sequence equals the
+  // producer position, and readable when it equals position + 1.
+  Record *claim() {
+    uint64_t pos = _head.load(std::memory_order_relaxed);
+    for (;;) {
+      Record &record = _ring[pos & (kCapacity - 1)];
+      const uint64_t seq = record.sequence.load(std::memory_order_acquire);
+      const auto diff =
+          static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+      if (diff == 0) {
+        if (_head.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          record.claimedAt = pos;
+          return &record;
+        }
+      } else if (diff < 0) {
+        return nullptr; // Full
+      } else {
+        pos = _head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void ensureWriter() {
+    if (_writerStarted.load(std::memory_order_acquire))
+      return;
+    std::call_once(_writerOnce, [this] {
+      std::thread([this] { drainLoop(); }).detach();
+      _writerStarted.store(true, std::memory_order_release);
+    });
+  }
+
+  void drainLoop() {
+    uint64_t tail = 0;
+    for (;;) {
+      {
+        std::unique_lock lock(_wakeMutex);
+        _wake.wait_for(lock, std::chrono::milliseconds(50));
+      }
+      for (;;) {
+        Record &record = _ring[tail & (kCapacity - 1)];
+        if (record.sequence.load(std::memory_order_acquire) != tail + 1)
+          break;
+        emit(record.level, record.tag, record.text);
+        record.sequence.store(tail + kCapacity, std::memory_order_release);
+        tail++;
+      }
+      const uint64_t dropped =
+          _dropped.exchange(0, std::memory_order_relaxed);
+      if (dropped > 0) {
+        char text[64];
+        snprintf(text, sizeof(text), "%llu log lines dropped",
+                 static_cast<unsigned long long>(dropped));
+        emit(LogLevel::Warn, LogTag::Manager, text);
+      }
+    }
+  }
+
+  static void emit(LogLevel level, LogTag tag, const char *text) {
+#ifdef __ANDROID__
+    int priority = ANDROID_LOG_INFO;
+    switch (level) {
+    case LogLevel::Error:
+      priority = ANDROID_LOG_ERROR;
+      break;
+    case LogLevel::Warn:
+      priority = ANDROID_LOG_WARN;
+      break;
+    case LogLevel::Debug:
+      priority = ANDROID_LOG_DEBUG;
+      break;
+    default:
+      break;
+    }
+    __android_log_write(priority, tagName(tag), text);
+#else
+    const char *prefix = "";
+    if (level == LogLevel::Error)
+      prefix = "ERROR: ";
+    else if (level == LogLevel::Warn)
+      prefix = "WARN: ";
+    printf("[%s] %s%s\n", tagName(tag), prefix, text);
+#endif
+  }
+
+  std::atomic<int> _level{static_cast<int>(LogLevel::Warn)};
+  std::array<Record, kCapacity> _ring;
+  std::atomic<uint64_t> _head{0};
+  std::atomic<uint64_t> _dropped{0};
+
+  std::once_flag _writerOnce;
+  std::atomic<bool> _writerStarted{false};
+  std::mutex _wakeMutex;
+  std::condition_variable _wake;
+};
+
+namespace detail {
+// Keeps arguments of compiled-out log statements type-checked and "used".
+__attribute__((format(printf, 1, 2))) inline void logDiscard(const char *,
+                                                             ...) {}
+} // namespace detail
+
+} // namespace margelo::nitro::net
+
+#define NET_LOG_AT(level, tag, ...)                                            \
+  do {                                                                         \
+    auto &netLog_ = ::margelo::nitro::net::NetLog::shared();                   \
+    if (netLog_.enabled(::margelo::nitro::net::LogLevel::level)) {             \
+      netLog_.write(::margelo::nitro::net::LogLevel::level,                    \
+                    ::margelo::nitro::net::LogTag::tag, __VA_ARGS__);          \
+    }                                                                          \
+  } while (0)
+
+#define NET_LOG_OFF(...)                                                       \
+  do {                                                                         \
+    if (false) {                                                               \
+      ::margelo::nitro::net::detail::logDiscard(__VA_ARGS__);                  \
+    }                                                                          \
+  } while (0)
+
+#if NITRO_NET_LOG_LEVEL >= NET_LOG_LEVEL_ERROR
+#define NET_LOGE(tag, ...) NET_LOG_AT(Error, tag, __VA_ARGS__)
+#else
+#define NET_LOGE(tag, ...) NET_LOG_OFF(__VA_ARGS__)
+#endif
+
+#if NITRO_NET_LOG_LEVEL >= NET_LOG_LEVEL_WARN
+#define NET_LOGW(tag, ...) NET_LOG_AT(Warn, tag, __VA_ARGS__)
+#else
+#define NET_LOGW(tag, ...) NET_LOG_OFF(__VA_ARGS__)
+#endif
+
+#if NITRO_NET_LOG_LEVEL >= NET_LOG_LEVEL_INFO
+#define NET_LOGI(tag, ...) NET_LOG_AT(Info, tag, __VA_ARGS__)
+#else
+#define NET_LOGI(tag, ...) NET_LOG_OFF(__VA_ARGS__)
+#endif
+
+#if NITRO_NET_LOG_LEVEL >= NET_LOG_LEVEL_DEBUG
+#define NET_LOGD(tag, ...) NET_LOG_AT(Debug, tag, __VA_ARGS__)
+#else
+#define NET_LOGD(tag, ...) NET_LOG_OFF(__VA_ARGS__)
+#endif
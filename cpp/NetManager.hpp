@@ -1,160 +1,392 @@
 #pragma once
 
 #include "NetBindings.hpp"
-#include <functional>
+#include "NetLanes.hpp"
+#include "NetLog.hpp"
+#include <algorithm>
+#include <atomic>
 #include <memory>
-#include <shared_mutex>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
-#define NM_TAG "NetManager"
-
-#ifdef __ANDROID__
-#include <android/log.h>
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, NM_TAG, __VA_ARGS__)
-#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, NM_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, NM_TAG, __VA_ARGS__)
-#else
-#include <cstdio>
-#define LOGI(...)                                                              \
-  printf("[" NM_TAG "] " __VA_ARGS__);                                         \
-  printf("\n")
-#define LOGW(...)                                                              \
-  printf("[" NM_TAG "] WARN: " __VA_ARGS__);                                   \
-  printf("\n")
-#define LOGE(...)                                                              \
-  printf("[" NM_TAG "] ERROR: " __VA_ARGS__);                                  \
-  printf("\n")
-#endif
-
 namespace margelo::nitro::net {
 
 class NetManager {
 public:
-  using EventHandler =
-      std::function<void(int eventType, const uint8_t *data, size_t len)>;
+  /// Event handler invoked on the Rust worker thread that produced the event.
+  /// `context` is the pointer given to registerHandler (usually the driver).
+  using EventCallback = void (*)(void *context, int eventType,
+                                 const uint8_t *data, size_t len);
 
   static NetManager &shared() {
     static NetManager instance;
     return instance;
   }
 
-  NetManager() {
-    LOGI("Initializing NetManager with default config...");
-    initializeRuntime(0); // 0 = use default (CPU core count)
+  // The runtime starts on first use (see start), not here, so touching the
+  // manager during app launch costs nothing.
+  NetManager() = default;
+
+  ~NetManager() {
+    for (auto &chunk : _chunks) {
+      delete[] chunk.load(std::memory_order_acquire);
+    }
   }
 
-  /// Initialize with custom worker thread count
-  /// Must be called before any other operations, or the config will be ignored
+  /// Worker threads used when none are configured. Small, since a phone app
+  /// rarely keeps more than a few sockets busy and every thread costs
+  /// startup time and memory.
+  static constexpr uint32_t kDefaultWorkerThreads = 2;
+
+  /// Sets the worker thread count for the runtime (0 = the default).
+  /// Must be called before the first socket or server is created, or the
+  /// config will be ignored.
   void initWithConfig(uint32_t workerThreads) {
-    if (!_initialized) {
-      LOGI("Initializing NetManager with %u worker threads...", workerThreads);
-      initializeRuntime(workerThreads);
+    std::lock_guard lock(_startMutex);
+    if (!_started.load(std::memory_order_relaxed)) {
+      NET_LOGI(Manager, "Runtime will start with %u worker threads",
+               workerThreads);
+      _configuredThreads = workerThreads;
     } else {
-      LOGW("NetManager already initialized, config ignored. Call "
-           "initWithConfig before any socket/server operations.");
+      NET_LOGW(Manager, "NetManager already initialized, config ignored. Call "
+                        "initWithConfig before any socket/server operations.");
     }
   }
 
+  /// Starts the runtime if it isn't running yet. Called before the first
+  /// socket or server is created.
+  void start() {
+    if (_started.load(std::memory_order_acquire))
+      return;
+    std::lock_guard lock(_startMutex);
+    if (_started.load(std::memory_order_relaxed))
+      return;
+    initializeRuntime(_configuredThreads);
+    _started.store(true, std::memory_order_release);
+  }
+
 private:
   void initializeRuntime(uint32_t workerThreads) {
-    if (_initialized)
-      return;
-    _initialized = true;
-
-    if (workerThreads > 0) {
-      net_init_with_config(
-          [](uint32_t id, int event_type, const uint8_t *data, size_t len,
-             void *context) {
-            auto mgr = static_cast<NetManager *>(context);
-            mgr->dispatch(id, event_type, data, len);
-          },
-          this, workerThreads);
-    } else {
-      net_init(
-          [](uint32_t id, int event_type, const uint8_t *data, size_t len,
-             void *context) {
-            auto mgr = static_cast<NetManager *>(context);
-            mgr->dispatch(id, event_type, data, len);
-          },
-          this);
-    }
+    _workerThreads =
+        workerThreads > 0
+            ? workerThreads
+            : std::clamp(std::thread::hardware_concurrency(), 1U,
+                         kDefaultWorkerThreads);
+    NET_LOGI(Manager, "Starting runtime with %u worker threads",
+             _workerThreads);
+    net_init_with_config(
+        [](uint32_t id, int event_type, const uint8_t *data, size_t len,
+           void *context) {
+          auto mgr = static_cast<NetManager *>(context);
+          mgr->dispatch(id, event_type, data, len);
+        },
+        this, _workerThreads);
   }
 
-  bool _initialized = false;
+  std::mutex _startMutex;
+  std::atomic<bool> _started{false};
+  uint32_t _configuredThreads = 0; // Guarded by _startMutex until started
+  uint32_t _workerThreads = 1;
 
 public:
-  void registerHandler(uint32_t id, EventHandler handler) {
-    LOGI("Registering handler for ID %u", id);
-    std::unique_lock lock(_mutex);
-    _handlers[id] = handler;
+  /// Worker threads of the runtime (the configured count, or
+  /// kDefaultWorkerThreads when it was left at 0); valid once started.
+  uint32_t workerThreads() const { return _workerThreads; }
+
+  /// Register (or replace) the handler for a socket/server ID.
+  /// Safe to call while events for the same ID are in flight: a replaced
+  /// handler is never invoked again once this returns.
+  void registerHandler(uint32_t id, void *context, EventCallback callback) {
+    NET_LOGD(Manager, "Registering handler for ID %u", id);
+    if (id == 0 || id == kBusy || callback == nullptr)
+      return;
+
+    if (_overflowCount.load(std::memory_order_acquire) > 0) {
+      std::lock_guard lock(_overflowMutex);
+      auto it = _overflow.find(id);
+      if (it != _overflow.end()) {
+        publish(*it->second, id, context, callback);
+        return;
+      }
+    }
+
+    HandlerSlot *slot = slotFor(id, true);
+    for (;;) {
+      uint32_t owner = slot->owner.load(std::memory_order_acquire);
+      if (owner == kBusy) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (owner != 0 && owner != id)
+        break; // Slot taken by a live ID with the same low bits
+      if (!slot->owner.compare_exchange_weak(owner, kBusy))
+        continue;
+      if (owner == id)
+        waitForQuiescence(*slot);
+      slot->context.store(context, std::memory_order_relaxed);
+      slot->callback.store(callback, std::memory_order_relaxed);
+      slot->owner.store(id);
+      return;
+    }
+
+    // Collision: park the handler in the (rarely used) overflow table.
+    std::lock_guard lock(_overflowMutex);
+    if (_overflow.count(id) == 0) {
+      _overflow.emplace(id, acquireOverflowSlot());
+      _overflowCount.fetch_add(1, std::memory_order_release);
+    }
+    publish(*_overflow[id], id, context, callback);
   }
 
+  /// Remove the handler for an ID. When this returns no other thread is still
+  /// running the handler, so the caller may free the context. Calling it from
+  /// inside the handler itself is allowed.
   void unregisterHandler(uint32_t id) {
-    LOGI("Unregistering handler for ID %u", id);
-    std::unique_lock lock(_mutex);
-    _handlers.erase(id);
+    NET_LOGD(Manager, "Unregistering handler for ID %u", id);
+    if (id == 0 || id == kBusy)
+      return;
+
+    if (HandlerSlot *slot = slotFor(id, false)) {
+      for (;;) {
+        uint32_t owner = slot->owner.load(std::memory_order_acquire);
+        if (owner == kBusy) {
+          // Another thread is replacing/removing this slot. If we are inside
+          // its handler we must not wait for it (it is waiting for us).
+          if (dispatchDepth(*slot) > 0)
+            return;
+          std::this_thread::yield();
+          continue;
+        }
+        if (owner != id)
+          break;
+        if (!slot->owner.compare_exchange_weak(owner, kBusy))
+          continue;
+        waitForQuiescence(*slot);
+        slot->context.store(nullptr, std::memory_order_relaxed);
+        slot->callback.store(nullptr, std::memory_order_relaxed);
+        slot->owner.store(0);
+        return;
+      }
+    }
+
+    if (_overflowCount.load(std::memory_order_acquire) == 0)
+      return;
+    std::unique_ptr<HandlerSlot> slot;
+    {
+      std::lock_guard lock(_overflowMutex);
+      auto it = _overflow.find(id);
+      if (it == _overflow.end())
+        return;
+      slot = std::move(it->second);
+      _overflow.erase(it);
+      _overflowCount.fetch_sub(1, std::memory_order_release);
+    }
+    slot->owner.store(0);
+    waitForQuiescence(*slot);
+    // Recycled rather than freed: if we are running inside this very handler
+    // the slot must stay alive until the dispatch unwinds.
+    std::lock_guard lock(_overflowMutex);
+    _overflowFree.push_back(std::move(slot));
   }
 
 private:
-  void dispatch(uint32_t id, int eventType, const uint8_t *data, size_t len) {
-    // Log all events for debugging
-    const char *eventName = "UNKNOWN";
+  // Sentinel owner value while a slot is being (re)written.
+  static constexpr uint32_t kBusy = UINT32_MAX;
+  // Dense table: IDs map to slot `id & (kSlotCount - 1)`. The Rust side hands
+  // out IDs sequentially, so live IDs only collide once more than kSlotCount
+  // IDs separate them; those go to the overflow table.
+  static constexpr uint32_t kSlotBits = 14;
+  static constexpr uint32_t kSlotCount = 1u << kSlotBits;
+  static constexpr uint32_t kChunkBits = 8;
+  static constexpr uint32_t kChunkSize = 1u << kChunkBits;
+  static constexpr uint32_t kChunkCount = kSlotCount / kChunkSize;
+
+  // One cache line per slot so that busy sockets do not false-share their
+  // in-flight counters.
+  struct alignas(64) HandlerSlot {
+    std::atomic<uint32_t> owner{0};    // Registered ID, 0 = free
+    std::atomic<uint32_t> inflight{0}; // Dispatches currently inside the slot
+    std::atomic<void *> context{nullptr};
+    std::atomic<EventCallback> callback{nullptr};
+  };
+
+  // Slots the current thread is dispatching into (innermost first), so that
+  // a handler can unregister itself without waiting on its own dispatch.
+  struct DispatchScope {
+    const HandlerSlot *slot;
+    DispatchScope *prev;
+  };
+  static inline thread_local DispatchScope *tDispatchScope = nullptr;
+
+  static uint32_t dispatchDepth(const HandlerSlot &slot) {
+    uint32_t depth = 0;
+    for (auto *scope = tDispatchScope; scope; scope = scope->prev) {
+      if (scope->slot == &slot)
+        depth++;
+    }
+    return depth;
+  }
+
+  static void waitForQuiescence(const HandlerSlot &slot) {
+    const uint32_t self = dispatchDepth(slot);
+    while (slot.inflight.load() > self) {
+      std::this_thread::yield();
+    }
+  }
+
+  // Caller holds either ownership of the slot through kBusy or _overflowMutex.
+  static void publish(HandlerSlot &slot, uint32_t id, void *context,
+                      EventCallback callback) {
+    uint32_t owner = slot.owner.exchange(kBusy);
+    if (owner == id)
+      waitForQuiescence(slot);
+    slot.context.store(context, std::memory_order_relaxed);
+    slot.callback.store(callback, std::memory_order_relaxed);
+    slot.owner.store(id);
+  }
+
+  HandlerSlot *slotFor(uint32_t id, bool create) {
+    const uint32_t index = id & (kSlotCount - 1);
+    auto &chunkRef = _chunks[index >> kChunkBits];
+    HandlerSlot *chunk = chunkRef.load(std::memory_order_acquire);
+    if (!chunk) {
+      if (!create)
+        return nullptr;
+      auto *fresh = new HandlerSlot[kChunkSize];
+      if (chunkRef.compare_exchange_strong(chunk, fresh,
+                                           std::memory_order_acq_rel)) {
+        chunk = fresh;
+      } else {
+        delete[] fresh;
+      }
+    }
+    return &chunk[index & (kChunkSize - 1)];
+  }
+
+  // Caller holds _overflowMutex.
+  std::unique_ptr<HandlerSlot> acquireOverflowSlot() {
+    for (auto it = _overflowFree.begin(); it != _overflowFree.end(); ++it) {
+      if ((*it)->inflight.load() == 0) {
+        auto slot = std::move(*it);
+        _overflowFree.erase(it);
+        return slot;
+      }
+    }
+    return std::make_unique<HandlerSlot>();
+  }
+
+  enum class InvokeResult { Handled, Missing, Busy };
+
+  // Runs the handler if `slot` is registered to `id`. The caller has already
+  // raised slot.inflight (before the owner check, pairing with
+  // waitForQuiescence); it is lowered again here.
+  static InvokeResult invokePinned(HandlerSlot &slot, uint32_t id,
+                                   int eventType, const uint8_t *data,
+                                   size_t len) {
+    const uint32_t owner = slot.owner.load();
+    if (owner == id) {
+      auto callback = slot.callback.load(std::memory_order_relaxed);
+      auto context = slot.context.load(std::memory_order_relaxed);
+      DispatchScope scope{&slot, tDispatchScope};
+      tDispatchScope = &scope;
+      callback(context, eventType, data, len);
+      tDispatchScope = scope.prev;
+      slot.inflight.fetch_sub(1, std::memory_order_release);
+      return InvokeResult::Handled;
+    }
+    slot.inflight.fetch_sub(1, std::memory_order_release);
+    return owner == kBusy ? InvokeResult::Busy : InvokeResult::Missing;
+  }
+
+  static bool invoke(HandlerSlot &slot, uint32_t id, int eventType,
+                     const uint8_t *data, size_t len) {
+    for (;;) {
+      slot.inflight.fetch_add(1);
+      auto result = invokePinned(slot, id, eventType, data, len);
+      if (result != InvokeResult::Busy)
+        return result == InvokeResult::Handled;
+      std::this_thread::yield(); // Handler is being swapped, retry
+    }
+  }
+
+  bool invokeOverflow(uint32_t id, int eventType, const uint8_t *data,
+                      size_t len) {
+    for (;;) {
+      HandlerSlot *slot = nullptr;
+      {
+        std::lock_guard lock(_overflowMutex);
+        auto it = _overflow.find(id);
+        if (it == _overflow.end())
+          return false;
+        slot = it->second.get();
+        // Pin before dropping the lock; unregisterHandler waits on it.
+        slot->inflight.fetch_add(1);
+      }
+      auto result = invokePinned(*slot, id, eventType, data, len);
+      if (result != InvokeResult::Busy)
+        return result == InvokeResult::Handled;
+      std::this_thread::yield();
+    }
+  }
+
+  static const char *eventName(int eventType) {
     switch (eventType) {
     case 1:
-      eventName = "CONNECT";
-      break;
+      return "CONNECT";
     case 2:
-      eventName = "DATA";
-      break;
+      return "DATA";
     case 3:
-      eventName = "ERROR";
-      break;
+      return "ERROR";
     case 4:
-      eventName = "CLOSE";
-      break;
+      return "CLOSE";
     case 5:
-      eventName = "DRAIN";
-      break;
+      return "DRAIN";
     case 6:
-      eventName = "CONNECTION";
-      break;
+      return "CONNECTION";
     case 7:
-      eventName = "TIMEOUT";
-      break;
+      return "TIMEOUT";
     case 8:
-      eventName = "LOOKUP";
-      break;
+      return "LOOKUP";
     case 9:
-      eventName = "DEBUG";
-      break;
+      return "DEBUG";
+    case 10:
+      return "KEYLOG";
+    case 11:
+      return "OCSP";
     }
+    return "UNKNOWN";
+  }
 
-    LOGI("dispatch: id=%u, event=%s(%d), len=%zu", id, eventName, eventType,
-         len);
+  void dispatch(uint32_t id, int eventType, const uint8_t *data, size_t len) {
+    ExecutorLanes::shared().adoptCoreThread();
+    // Compiled out unless NITRO_NET_LOG_LEVEL includes debug logs.
+    NET_LOGD(Manager, "dispatch: id=%u, event=%s(%d), len=%zu", id,
+             eventName(eventType), eventType, len);
 
-    // Copy handler outside of lock to avoid deadlock
-    // (handler may call unregisterHandler which needs unique_lock)
-    EventHandler handler;
-    {
-      std::shared_lock lock(_mutex);
-      auto it = _handlers.find(id);
-      if (it != _handlers.end()) {
-        handler = it->second;
-      }
+    // Lock-free fast path; the handler runs in place (no copy), and may call
+    // unregisterHandler for its own ID.
+    if (HandlerSlot *slot = slotFor(id, false)) {
+      if (invoke(*slot, id, eventType, data, len))
+        return;
     }
+    if (_overflowCount.load(std::memory_order_acquire) > 0 &&
+        invokeOverflow(id, eventType, data, len))
+      return;
 
-    // Call handler outside of lock
-    if (handler) {
-      handler(eventType, data, len);
-    } else {
-      LOGW("No handler found for id=%u, event=%s", id, eventName);
-    }
+    // Expected for events that race with destroy()
+    NET_LOGD(Manager, "No handler found for id=%u, event=%s", id,
+             eventName(eventType));
   }
 
-  std::shared_mutex _mutex;
-  std::unordered_map<uint32_t, EventHandler> _handlers;
+  std::atomic<HandlerSlot *> _chunks[kChunkCount]{};
+
+  std::mutex _overflowMutex;
+  std::atomic<uint32_t> _overflowCount{0};
+  std::unordered_map<uint32_t, std::unique_ptr<HandlerSlot>> _overflow;
+  std::vector<std::unique_ptr<HandlerSlot>> _overflowFree;
 };
 
 } // namespace margelo::nitro::net
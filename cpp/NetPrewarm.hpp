@@ -0,0 +1,136 @@
+#pragma once
+
+#include "HybridConnectionPool.hpp"
+#include "HybridNetSocketDriver.hpp"
+#include "NetLog.hpp"
+#include "NetScheduler.hpp"
+#include "NetSocketPool.hpp"
+#include <NitroModules/ArrayBuffer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace margelo::nitro::net {
+
+/// Connections opened ahead of the first request. A prewarm resolves the
+/// host through the DnsCache, connects (racing addresses like any client
+/// socket) and, for TLS, completes the handshake and caches the session
+/// ticket, all without waking JS. The connected socket is parked in the
+/// SocketPool's prewarm pool, where any Agent's next request to the same
+/// host, port and protocol picks it up (see take).
+class Prewarmer {
+public:
+  /// Receives whether a connection was parked.
+  using Callback = std::function<void(bool)>;
+
+  static constexpr auto kConnectTimeout = std::chrono::seconds(10);
+  static constexpr auto kIdleTimeout = std::chrono::seconds(30);
+  static constexpr size_t kMaxIdle = 4; // Per host, port and protocol
+
+  static Prewarmer &shared() {
+    // Intentionally leaked: connect events may arrive during teardown.
+    static Prewarmer *instance = new Prewarmer();
+    return *instance;
+  }
+
+  void start(const std::string &host, int port, bool tls, Callback done) {
+    auto driver = std::make_shared<HybridNetSocketDriver>();
+    uint64_t token = 0;
+    {
+      std::lock_guard lock(_mutex);
+      token = ++_lastToken;
+      _connecting.emplace(token,
+                          Attempt{driver, host, port, tls, std::move(done)});
+    }
+    // Runs on a worker thread; parking re-registers the socket's handler,
+    // which must not happen from inside that handler.
+    driver->setOnEvent(
+        [token](double type, const std::shared_ptr<ArrayBuffer> &) {
+          const int event = static_cast<int>(type);
+          if (event != 1 && event != 3 && event != 4 && event != 7)
+            return; // Only CONNECT, ERROR, CLOSE and TIMEOUT matter
+          NetScheduler::shared().schedule(
+              std::chrono::microseconds(0),
+              [token, event] { shared().finish(token, event == 1); });
+        });
+    NetScheduler::shared().schedule(kConnectTimeout, [token] {
+      shared().finish(token, false);
+    });
+    if (tls) {
+      driver->connectTLS(host, port, std::nullopt, true);
+    } else {
+      driver->connect(host, port);
+    }
+  }
+
+  /// A prewarmed connection to `host`:`port`, or nullptr if none is idle.
+  static std::shared_ptr<HybridNetSocketDriver>
+  take(const std::string &host, int port, bool tls) {
+    return HybridConnectionPool::take(SocketPool::kPrewarmPool,
+                                      keyOf(host, port, tls), true);
+  }
+
+private:
+  struct Attempt {
+    std::shared_ptr<HybridNetSocketDriver> driver;
+    std::string host;
+    int port;
+    bool tls;
+    Callback done;
+  };
+
+  Prewarmer() = default;
+
+  // Keyed like an Agent's pooled sockets: https uses the default context.
+  static std::string keyOf(const std::string &host, int port, bool tls) {
+    return HybridConnectionPool::keyOf(host, port, tls ? 0 : -1);
+  }
+
+  // Runs on the scheduler thread, once per attempt.
+  void finish(uint64_t token, bool connected) {
+    Attempt attempt;
+    {
+      std::lock_guard lock(_mutex);
+      auto it = _connecting.find(token);
+      if (it == _connecting.end())
+        return;
+      attempt = std::move(it->second);
+      _connecting.erase(it);
+    }
+    const bool parked = connected && park(attempt);
+    if (!parked) {
+      NET_LOGD(Socket, "Prewarm of %s:%d %s", attempt.host.c_str(),
+               attempt.port, connected ? "not needed" : "failed");
+      attempt.driver->destroy();
+    }
+    if (attempt.done)
+      attempt.done(parked);
+  }
+
+  static bool park(const Attempt &attempt) {
+    const uint32_t id = static_cast<uint32_t>(attempt.driver->getId());
+    if (id == 0)
+      return false;
+    // Tickets arriving while parked go where the handshake's would have.
+    const SocketPool::ParkOptions options{kIdleTimeout, 0, kMaxIdle,
+                                          attempt.driver->sessionContext(),
+                                          attempt.driver->sessionName()};
+    const std::string key = keyOf(attempt.host, attempt.port, attempt.tls);
+    if (!SocketPool::shared().beginPark(SocketPool::kPrewarmPool, key, id,
+                                        options))
+      return false; // Enough connections are waiting already
+    attempt.driver->detach();
+    SocketPool::shared().finishPark(id, options);
+    return true;
+  }
+
+  std::mutex _mutex;
+  uint64_t _lastToken = 0;
+  std::unordered_map<uint64_t, Attempt> _connecting;
+};
+
+} // namespace margelo::nitro::net
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "NetScheduler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// Opt-in coalescing of one socket's reads. Reads are merged until
+/// `threshold` bytes are pending or the oldest has waited `maxDelay`, and
+/// handed on in pieces of at most `maxReadSize` bytes. Adaptive coalescing
+/// derives the threshold from the observed read rate: while the bytes
+/// expected within `maxDelay` stay below `minBytes` the socket looks
+/// interactive and every read goes out immediately; above that, reads wait
+/// for about `maxDelay` worth of data. The rate falls immediately when reads
+/// slow down and rises gradually, and resets after an idle pause, so the
+/// first reads of a new burst are not held.
+class ReadCoalescer : public std::enable_shared_from_this<ReadCoalescer> {
+public:
+  using Clock = NetScheduler::Clock;
+  /// Receives merged reads, in order, with the arrival time of the oldest.
+  using Sink =
+      std::function<void(const uint8_t *, size_t, Clock::time_point)>;
+
+  static constexpr size_t kDefaultMinBytes = 16 * 1024;
+  static constexpr uint32_t kDefaultMaxDelayMicros = 2000;
+  // Largest event block of the BufferPool, so merged reads stay pooled
+  static constexpr size_t kDefaultMaxReadSize = 64 * 1024;
+  static constexpr auto kRateWindow = std::chrono::milliseconds(20);
+
+  /// Flushes run on `scheduler` (the owner's lane).
+  explicit ReadCoalescer(Sink sink,
+                         NetScheduler &scheduler = NetScheduler::shared())
+      : _sink(std::move(sink)), _scheduler(scheduler) {}
+
+  /// Turn coalescing on or off. Turning it off hands on what is pending.
+  void configure(bool enabled, size_t minBytes, uint32_t maxDelayMicros,
+                 size_t maxReadSize, bool adaptive) {
+    std::lock_guard lock(_mutex);
+    if (!enabled)
+      deliverLocked();
+    _minBytes = std::max<size_t>(minBytes, 1);
+    _maxDelay = std::chrono::microseconds(maxDelayMicros);
+    _maxReadSize = std::max<size_t>(maxReadSize, 1);
+    _adaptive = adaptive;
+    _threshold = adaptive ? 0 : std::min(_minBytes, _maxReadSize);
+    _rate = 0;
+    _windowBytes = 0;
+    _windowStart = _lastRead = Clock::now();
+    _enabled.store(enabled, std::memory_order_release);
+  }
+
+  /// Queue a read. Returns false if coalescing is off, in which case the
+  /// caller delivers the read itself.
+  bool push(const uint8_t *data, size_t len, Clock::time_point arrived) {
+    if (!_enabled.load(std::memory_order_acquire))
+      return false;
+    std::lock_guard lock(_mutex);
+    if (!_enabled.load(std::memory_order_relaxed))
+      return false;
+    if (_adaptive)
+      observeLocked(len, arrived);
+    if (_pending.empty())
+      _pendingSince = arrived;
+    _pending.insert(_pending.end(), data, data + len);
+    if (_pending.size() >= _threshold) {
+      deliverLocked();
+    } else if (!_flushScheduled) {
+      _flushScheduled = true;
+      std::weak_ptr<ReadCoalescer> weak = weak_from_this();
+      _scheduler.schedule(_maxDelay, [weak] {
+        if (auto self = weak.lock()) {
+          self->flush();
+        }
+      });
+    }
+    return true;
+  }
+
+  /// Hands on pending reads; called before any other event of the socket.
+  void flush() {
+    if (!_enabled.load(std::memory_order_acquire))
+      return;
+    std::lock_guard lock(_mutex);
+    _flushScheduled = false;
+    deliverLocked();
+  }
+
+  /// Bytes the socket currently waits for before handing reads on.
+  size_t threshold() {
+    std::lock_guard lock(_mutex);
+    return _enabled.load(std::memory_order_relaxed) ? _threshold : 0;
+  }
+
+  /// Drop pending reads; used when the driver is destroyed.
+  void close() {
+    std::lock_guard lock(_mutex);
+    _enabled.store(false, std::memory_order_release);
+    _pending.clear();
+  }
+
+private:
+  // Measures the read rate over windows of kRateWindow and re-derives the
+  // threshold from it.
+  void observeLocked(size_t len, Clock::time_point now) {
+    const auto elapsed = now - _windowStart;
+    if (now - _lastRead >= kRateWindow) {
+      // Idle for a whole window: start over as an interactive socket
+      _rate = 0;
+      _threshold = 0;
+      _windowBytes = 0;
+      _windowStart = now;
+    } else if (elapsed >= kRateWindow) {
+      const double micros =
+          std::chrono::duration<double, std::micro>(elapsed).count();
+      const double sample = static_cast<double>(_windowBytes) / micros;
+      _rate = sample < _rate ? sample : (_rate * 3 + sample) / 4;
+      _windowBytes = 0;
+      _windowStart = now;
+      const double expected =
+          _rate * static_cast<double>(_maxDelay.count());
+      _threshold =
+          expected < static_cast<double>(_minBytes)
+              ? 0
+              : std::min(static_cast<size_t>(expected), _maxReadSize);
+    }
+    _windowBytes += len;
+    _lastRead = now;
+  }
+
+  // Delivery happens under the lock so merged reads never overtake each
+  // other (the sink only enqueues the call onto the JS thread).
+  void deliverLocked() {
+    if (_pending.empty())
+      return;
+    for (size_t offset = 0; offset < _pending.size();
+         offset += _maxReadSize) {
+      const size_t size = std::min(_maxReadSize, _pending.size() - offset);
+      _sink(_pending.data() + offset, size, _pendingSince);
+    }
+    _pending.clear();
+    // Keep one full event of capacity around, not a past burst
+    if (_pending.capacity() > 2 * _maxReadSize)
+      std::vector<uint8_t>().swap(_pending);
+  }
+
+  const Sink _sink;
+  NetScheduler &_scheduler;
+  std::atomic<bool> _enabled{false};
+
+  std::mutex _mutex;
+  size_t _minBytes = kDefaultMinBytes;
+  std::chrono::microseconds _maxDelay{kDefaultMaxDelayMicros};
+  size_t _maxReadSize = kDefaultMaxReadSize;
+  bool _adaptive = true;
+  size_t _threshold = 0;
+  bool _flushScheduled = false;
+  std::vector<uint8_t> _pending;
+  Clock::time_point _pendingSince;
+  // Read rate in bytes per microsecond, and the window being measured
+  double _rate = 0;
+  size_t _windowBytes = 0;
+  Clock::time_point _windowStart;
+  Clock::time_point _lastRead;
+};
+
+} // namespace margelo::nitro::net
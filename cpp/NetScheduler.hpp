@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// Single background thread running deferred tasks for the C++ bridge
+/// (batch flushes, timers). Tasks run in deadline order; they must be short
+/// and must not block, since every deferred task shares this one thread.
+/// Executor lanes (NetLanes.hpp) own further instances, so timers of
+/// latency-critical sockets don't queue behind bulk ones.
+class NetScheduler {
+public:
+  using Clock = std::chrono::steady_clock;
+  using Task = std::function<void()>;
+
+  NetScheduler() = default;
+  NetScheduler(const NetScheduler &) = delete;
+  NetScheduler &operator=(const NetScheduler &) = delete;
+
+  static NetScheduler &shared() {
+    // Intentionally leaked: tasks may still be scheduled during teardown.
+    static NetScheduler *instance = new NetScheduler();
+    return *instance;
+  }
+
+  /// Run `task` on the scheduler thread once `delay` has elapsed.
+  void schedule(std::chrono::microseconds delay, Task task) {
+    {
+      std::lock_guard lock(_mutex);
+      if (!_started) {
+        _started = true;
+        std::thread([this] { run(); }).detach();
+      }
+      _tasks.push({Clock::now() + delay, _nextSequence++, std::move(task)});
+    }
+    _wake.notify_one();
+  }
+
+  /// Tasks waiting to run, due or not.
+  size_t pending() {
+    std::lock_guard lock(_mutex);
+    return _tasks.size();
+  }
+
+private:
+  struct Entry {
+    Clock::time_point deadline;
+    uint64_t sequence; // FIFO among equal deadlines
+    Task task;
+  };
+
+  struct Later {
+    bool operator()(const Entry &a, const Entry &b) const {
+      if (a.deadline != b.deadline)
+        return a.deadline > b.deadline;
+      return a.sequence > b.sequence;
+    }
+  };
+
+  void run() {
+    std::unique_lock lock(_mutex);
+    for (;;) {
+      if (_tasks.empty()) {
+        _wake.wait(lock);
+        continue;
+      }
+      const auto deadline = _tasks.top().deadline;
+      if (Clock::now() < deadline) {
+        _wake.wait_until(lock, deadline);
+        continue;
+      }
+      // priority_queue::top() is const; the entry is popped right after.
+      Task task = std::move(const_cast<Entry &>(_tasks.top()).task);
+      _tasks.pop();
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::priority_queue<Entry, std::vector<Entry>, Later> _tasks;
+  uint64_t _nextSequence = 0;
+  bool _started = false;
+};
+
+} // namespace margelo::nitro::net
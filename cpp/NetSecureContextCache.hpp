@@ -0,0 +1,299 @@
+#pragma once
+
+#include "NetBindings.hpp"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// Key material of one secure context, copied off the JS heap so it can be
+/// parsed on a builder thread.
+struct SecureContextMaterial {
+  std::string cert;
+  std::string key;
+  std::optional<std::string> passphrase;
+  std::vector<uint8_t> pfx;
+  std::vector<std::string> ca;
+};
+
+/// Secure contexts built from key material, shared by every caller passing
+/// identical material so certificates, keys and CA bundles are parsed once
+/// per process. Entries are keyed by a 128-bit digest of the material (the
+/// passphrase included); the material itself is not retained. A context
+/// that changes after creation (SNI entries, CAs, PFX, OCSP, ticket keys)
+/// leaves the cache, so later lookups never see those changes.
+///
+/// Parsing can also run on a few builder threads; concurrent builds of the
+/// same material share a single parse. The core never destroys contexts, so
+/// entries are not evicted: each one stands for a context that exists anyway.
+class SecureContextCache {
+public:
+  /// Receives the context ID, or 0 if the material was rejected.
+  using Callback = std::function<void(uint32_t)>;
+
+  struct Stats {
+    uint64_t hits = 0;   // Contexts handed out without parsing
+    uint64_t misses = 0; // Contexts parsed for the cache
+    size_t entries = 0;
+  };
+
+  static constexpr size_t kMaxBuilders = 2;
+
+  static SecureContextCache &shared() {
+    // Intentionally leaked: builder threads may finish during teardown.
+    static SecureContextCache *instance = new SecureContextCache();
+    return *instance;
+  }
+
+  /// Context for `material`, parsed on the calling thread unless a cached
+  /// one exists. Uncached contexts are private to the caller.
+  uint32_t obtain(const SecureContextMaterial &material, bool cached) {
+    if (!cached || !cacheable(material))
+      return build(material);
+    const Digest digest = digestOf(material);
+    {
+      std::lock_guard lock(_mutex);
+      auto it = _entries.find(digest);
+      if (it != _entries.end() && it->second.id != 0) {
+        _stats.hits++;
+        return it->second.id;
+      }
+      _stats.misses++;
+    }
+    const uint32_t id = build(material);
+    std::lock_guard lock(_mutex);
+    Entry &entry = _entries[digest];
+    if (entry.id != 0)
+      return entry.id; // Published meanwhile; keep every caller on one
+    if (id != 0) {
+      entry.id = id;
+      _digests[id] = digest;
+    } else if (!entry.building) {
+      _entries.erase(digest);
+    }
+    return id;
+  }
+
+  /// Like `obtain`, with parsing on a builder thread. `callback` runs on
+  /// that thread, or on the calling one for a cache hit.
+  void obtainAsync(SecureContextMaterial material, bool cached,
+                   Callback callback) {
+    if (!cached || !cacheable(material)) {
+      run([material = std::move(material), callback = std::move(callback)] {
+        callback(build(material));
+      });
+      return;
+    }
+    const Digest digest = digestOf(material);
+    std::unique_lock lock(_mutex);
+    Entry &entry = _entries[digest];
+    if (entry.id != 0) {
+      _stats.hits++;
+      const uint32_t id = entry.id;
+      lock.unlock();
+      callback(id);
+      return;
+    }
+    entry.waiters.push_back(std::move(callback));
+    if (entry.building) {
+      _stats.hits++; // Shares the parse already under way
+      return;
+    }
+    _stats.misses++;
+    entry.building = true;
+    enqueueLocked([this, digest, material = std::move(material)] {
+      finish(digest, build(material));
+    });
+  }
+
+  /// Runs `job` on a builder thread (for changes to existing contexts).
+  void run(std::function<void()> job) {
+    std::lock_guard lock(_mutex);
+    enqueueLocked(std::move(job));
+  }
+
+  /// Stops handing out `id`; called before the context is changed.
+  void forget(uint32_t id) {
+    std::lock_guard lock(_mutex);
+    auto it = _digests.find(id);
+    if (it == _digests.end())
+      return;
+    _entries.erase(it->second);
+    _digests.erase(it);
+  }
+
+  /// Drops every entry; contexts already handed out stay valid.
+  void clear() {
+    std::lock_guard lock(_mutex);
+    for (auto it = _entries.begin(); it != _entries.end();) {
+      if (it->second.building) {
+        ++it;
+        continue;
+      }
+      _digests.erase(it->second.id);
+      it = _entries.erase(it);
+    }
+  }
+
+  Stats stats() {
+    std::lock_guard lock(_mutex);
+    Stats stats = _stats;
+    stats.entries = _digests.size();
+    return stats;
+  }
+
+private:
+  struct Digest {
+    uint64_t a = 0;
+    uint64_t b = 0;
+    bool operator==(const Digest &other) const {
+      return a == other.a && b == other.b;
+    }
+  };
+
+  struct DigestHash {
+    size_t operator()(const Digest &digest) const {
+      return static_cast<size_t>(digest.a ^ (digest.b * 0x9E3779B97F4A7C15ULL));
+    }
+  };
+
+  struct Entry {
+    uint32_t id = 0;
+    bool building = false;
+    std::vector<Callback> waiters;
+  };
+
+  /// Two independent 64-bit hashes over tagged, length-prefixed fields, so
+  /// no two different bundles serialize alike.
+  class Hasher {
+  public:
+    void field(char tag, const uint8_t *data, size_t len) {
+      byte(static_cast<uint8_t>(tag));
+      for (int shift = 0; shift < 64; shift += 8)
+        byte(static_cast<uint8_t>(static_cast<uint64_t>(len) >> shift));
+      for (size_t i = 0; i < len; i++)
+        byte(data[i]);
+    }
+    void field(char tag, const std::string &value) {
+      field(tag, reinterpret_cast<const uint8_t *>(value.data()),
+            value.size());
+    }
+    Digest digest() const {
+      uint64_t b = _b ^ (_b >> 31);
+      b *= 0xBF58476D1CE4E5B9ULL;
+      return {_a, b ^ (b >> 27)};
+    }
+
+  private:
+    void byte(uint8_t value) {
+      _a = (_a ^ value) * 0x100000001B3ULL; // FNV-1a
+      _b = (_b + value + 1) * 0x9E3779B97F4A7C15ULL;
+      _b ^= _b >> 29;
+    }
+    uint64_t _a = 0xCBF29CE484222325ULL;
+    uint64_t _b = 0x243F6A8885A308D3ULL;
+  };
+
+  SecureContextCache() = default;
+
+  static bool cacheable(const SecureContextMaterial &material) {
+    return !material.pfx.empty() ||
+           (!material.cert.empty() && !material.key.empty()) ||
+           !material.ca.empty();
+  }
+
+  static Digest digestOf(const SecureContextMaterial &material) {
+    Hasher hasher;
+    hasher.field('c', material.cert);
+    hasher.field('k', material.key);
+    if (material.passphrase.has_value())
+      hasher.field('p', *material.passphrase);
+    hasher.field('x', material.pfx.data(), material.pfx.size());
+    for (const std::string &ca : material.ca)
+      hasher.field('a', ca);
+    return hasher.digest();
+  }
+
+  static uint32_t build(const SecureContextMaterial &material) {
+    const char *passphrase =
+        material.passphrase.has_value() ? material.passphrase->c_str()
+                                        : nullptr;
+    uint32_t id;
+    if (!material.pfx.empty()) {
+      id = net_secure_context_create();
+      if (id != 0)
+        net_secure_context_set_pfx(id, material.pfx.data(),
+                                   material.pfx.size(), passphrase);
+    } else if (!material.cert.empty() && !material.key.empty()) {
+      id = net_create_secure_context(material.cert.c_str(),
+                                     material.key.c_str(), passphrase);
+    } else {
+      id = net_secure_context_create();
+    }
+    if (id == 0)
+      return 0;
+    for (const std::string &ca : material.ca)
+      net_secure_context_add_ca(id, ca.c_str());
+    return id;
+  }
+
+  void finish(const Digest &digest, uint32_t id) {
+    std::unique_lock lock(_mutex);
+    std::vector<Callback> waiters;
+    auto it = _entries.find(digest);
+    if (it != _entries.end()) {
+      Entry &entry = it->second;
+      entry.building = false;
+      waiters = std::move(entry.waiters);
+      entry.waiters.clear();
+      if (entry.id != 0) {
+        id = entry.id; // A synchronous build published first
+      } else if (id != 0) {
+        entry.id = id;
+        _digests[id] = digest;
+      } else {
+        _entries.erase(it);
+      }
+    }
+    lock.unlock();
+    for (const Callback &callback : waiters) {
+      callback(id);
+    }
+  }
+
+  void enqueueLocked(std::function<void()> job) {
+    _queue.push_back(std::move(job));
+    if (_builders < kMaxBuilders && _builders < _queue.size()) {
+      _builders++;
+      std::thread([this] { runBuilder(); }).detach();
+    }
+  }
+
+  void runBuilder() {
+    std::unique_lock lock(_mutex);
+    while (!_queue.empty()) {
+      std::function<void()> job = std::move(_queue.front());
+      _queue.pop_front();
+      lock.unlock();
+      job();
+      lock.lock();
+    }
+    _builders--;
+  }
+
+  std::mutex _mutex;
+  std::unordered_map<Digest, Entry, DigestHash> _entries;
+  std::unordered_map<uint32_t, Digest> _digests; // Published IDs
+  std::deque<std::function<void()>> _queue;
+  size_t _builders = 0;
+  Stats _stats;
+};
+
+} // namespace margelo::nitro::net
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// Client-side TLS session tickets, shared by every socket connecting with
+/// the same secure context (0 = the default client context) and server name.
+/// Each context holds a size-bounded LRU of the latest ticket per name; the
+/// socket driver offers a cached ticket before connecting and stores the
+/// tickets the core reports through SESSION events. Only connects that
+/// verify the peer's certificate store tickets.
+class TlsSessionCache {
+public:
+  static constexpr size_t kDefaultCapacity = 64;
+  static constexpr size_t kMaxTicketSize = 16 * 1024;
+
+  struct Stats {
+    uint64_t hits = 0;   // Connects that were offered a cached ticket
+    uint64_t misses = 0; // Connects with nothing cached for the name
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t capacity = kDefaultCapacity;
+  };
+
+  static TlsSessionCache &shared() {
+    // Intentionally leaked: tickets may be stored from worker threads during
+    // teardown.
+    static TlsSessionCache *instance = new TlsSessionCache();
+    return *instance;
+  }
+
+  /// Sets the number of server names cached for a context; 0 disables it.
+  void setCapacity(uint32_t context, size_t capacity) {
+    std::lock_guard lock(_mutex);
+    Context &ctx = _contexts[context];
+    ctx.stats.capacity = capacity;
+    trimLocked(ctx);
+  }
+
+  /// Ticket to resume with for (context, serverName), or empty.
+  std::vector<uint8_t> lookup(uint32_t context, const std::string &serverName) {
+    std::lock_guard lock(_mutex);
+    Context &ctx = _contexts[context];
+    if (ctx.stats.capacity == 0)
+      return {};
+    auto it = ctx.index.find(serverName);
+    if (it == ctx.index.end()) {
+      ctx.stats.misses++;
+      return {};
+    }
+    ctx.stats.hits++;
+    ctx.lru.splice(ctx.lru.begin(), ctx.lru, it->second);
+    return it->second->ticket;
+  }
+
+  void store(uint32_t context, const std::string &serverName,
+             const uint8_t *ticket, size_t len) {
+    if (ticket == nullptr || len == 0 || len > kMaxTicketSize ||
+        serverName.empty())
+      return;
+    std::lock_guard lock(_mutex);
+    Context &ctx = _contexts[context];
+    if (ctx.stats.capacity == 0)
+      return;
+    auto it = ctx.index.find(serverName);
+    if (it != ctx.index.end()) {
+      it->second->ticket.assign(ticket, ticket + len);
+      ctx.lru.splice(ctx.lru.begin(), ctx.lru, it->second);
+      return;
+    }
+    ctx.lru.push_front(Entry{serverName, {ticket, ticket + len}});
+    ctx.index.emplace(serverName, ctx.lru.begin());
+    trimLocked(ctx);
+  }
+
+  Stats stats(uint32_t context) {
+    std::lock_guard lock(_mutex);
+    Context &ctx = _contexts[context];
+    Stats stats = ctx.stats;
+    stats.entries = ctx.index.size();
+    return stats;
+  }
+
+private:
+  struct Entry {
+    std::string serverName;
+    std::vector<uint8_t> ticket;
+  };
+
+  struct Context {
+    std::list<Entry> lru; // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    Stats stats;
+  };
+
+  TlsSessionCache() = default;
+
+  static void trimLocked(Context &ctx) {
+    while (ctx.index.size() > ctx.stats.capacity) {
+      ctx.index.erase(ctx.lru.back().serverName);
+      ctx.lru.pop_back();
+      ctx.stats.evictions++;
+    }
+  }
+
+  std::mutex _mutex;
+  std::unordered_map<uint32_t, Context> _contexts;
+};
+
+} // namespace margelo::nitro::net
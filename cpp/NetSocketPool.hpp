@@ -0,0 +1,299 @@
+#pragma once
+
+#include "NetBindings.hpp"
+#include "NetLog.hpp"
+#include "NetManager.hpp"
+#include "NetScheduler.hpp"
+#include "NetSessionCache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace margelo::nitro::net {
+
+/// Native keep-alive pool for idle client connections.
+/// A parked socket's events are routed to the pool instead of a JS driver, so
+/// a peer closing an idle connection (or sending anything unsolicited) evicts
+/// it without waking JS, and idle timeouts run on the NetScheduler thread
+/// instead of as per-socket JS timers. Every JS Agent owns a separate pool
+/// ID; sockets are grouped by a connection key within it.
+class SocketPool {
+public:
+  struct ParkOptions {
+    std::chrono::milliseconds idleTimeout;
+    uint64_t keepAliveMillis; // 0 = leave TCP keep-alive as is
+    size_t maxIdle;           // Per key
+    // TLS session cache key for tickets arriving while parked (-1 = none);
+    // the socket driver's own, so a ticket sent right after the handshake
+    // is stored whether it reaches the driver or the pool.
+    int64_t secureContextId;
+    std::string serverName;
+  };
+
+  /// Pool of the connections opened by prewarm (see Prewarmer); never
+  /// returned by createPool.
+  static constexpr uint32_t kPrewarmPool = 0;
+
+  static SocketPool &shared() {
+    // Intentionally leaked: expiry tasks may still run during teardown.
+    static SocketPool *instance = new SocketPool();
+    return *instance;
+  }
+
+  uint32_t createPool() {
+    std::lock_guard lock(_mutex);
+    return ++_lastPool;
+  }
+
+  /// Step one of parking socket `id`: reserves a place under `key` and routes
+  /// the socket's events to the pool. Returns false (and leaves the socket
+  /// alone) if the key is full. On success the previous owner must drop the
+  /// ID and then call finishPark().
+  bool beginPark(uint32_t pool, const std::string &key, uint32_t id,
+                 const ParkOptions &options) {
+    {
+      std::lock_guard lock(_mutex);
+      auto &idle = _idle[poolKey(pool, key)];
+      if (idle.size() >= options.maxIdle || _sockets.count(id) != 0)
+        return false;
+      idle.push_back(id);
+      _sockets[id] = Parked{pool,
+                            key,
+                            options.secureContextId,
+                            options.serverName,
+                            ++_generation,
+                            State::Parking};
+    }
+    // Replaces the driver's handler; the driver is never called again.
+    NetManager::shared().registerHandler(id, contextFor(id), onEventThunk);
+    return true;
+  }
+
+  void finishPark(uint32_t id, const ParkOptions &options) {
+    net_set_timeout(id, 0);
+    if (options.keepAliveMillis > 0)
+      net_set_keepalive(id, true, options.keepAliveMillis);
+    // Keep reading so that EOF from the peer is noticed while idle.
+    net_resume(id);
+
+    uint64_t generation = 0;
+    bool dead = false;
+    {
+      std::lock_guard lock(_mutex);
+      auto it = _sockets.find(id);
+      if (it == _sockets.end())
+        return;
+      dead = it->second.state == State::Dead;
+      if (dead) {
+        eraseLocked(id);
+      } else {
+        it->second.state = State::Idle;
+        generation = it->second.generation;
+      }
+    }
+    if (dead) {
+      release(id);
+      return;
+    }
+    NetScheduler::shared().schedule(options.idleTimeout, [id, generation] {
+      shared().expire(id, generation);
+    });
+  }
+
+  /// Takes the most (`lifo`) or least recently parked live socket for `key`.
+  /// The socket is paused and still routed to the pool; the caller must
+  /// register its own handler and then call finishTake(), which reports
+  /// whether the socket died during the handoff. Returns 0 if none is idle.
+  uint32_t beginTake(uint32_t pool, const std::string &key, bool lifo) {
+    uint32_t id = 0;
+    {
+      std::lock_guard lock(_mutex);
+      auto it = _idle.find(poolKey(pool, key));
+      if (it == _idle.end() || it->second.empty())
+        return 0;
+      auto &idle = it->second;
+      // Sockets still being parked are left to their owners; the nearest
+      // idle one behind them is taken instead.
+      const size_t count = idle.size();
+      for (size_t i = 0; i < count && id == 0; ++i) {
+        const size_t index = lifo ? count - 1 - i : i;
+        auto parked = _sockets.find(idle[index]);
+        if (parked == _sockets.end() || parked->second.state != State::Idle)
+          continue;
+        parked->second.state = State::Handoff;
+        id = idle[index];
+        idle.erase(idle.begin() + static_cast<std::ptrdiff_t>(index));
+      }
+      if (idle.empty())
+        _idle.erase(it);
+    }
+    if (id != 0)
+      net_pause(id);
+    return id;
+  }
+
+  /// Completes a take. Returns false if the peer closed the socket before
+  /// the new handler was registered; the caller then destroys it.
+  bool finishTake(uint32_t id) {
+    std::lock_guard lock(_mutex);
+    auto it = _sockets.find(id);
+    if (it == _sockets.end())
+      return false;
+    const bool alive = it->second.state != State::Dead;
+    _sockets.erase(it);
+    return alive;
+  }
+
+  size_t idleCount(uint32_t pool) {
+    std::lock_guard lock(_mutex);
+    size_t count = 0;
+    for (const auto &[id, parked] : _sockets) {
+      count += parked.pool == pool && parked.state == State::Idle;
+    }
+    return count;
+  }
+
+  /// Closes every idle socket of `pool`.
+  void clear(uint32_t pool) {
+    std::vector<uint32_t> closing;
+    {
+      std::lock_guard lock(_mutex);
+      for (auto &[id, parked] : _sockets) {
+        if (parked.pool != pool)
+          continue;
+        if (parked.state == State::Idle) {
+          closing.push_back(id);
+        } else {
+          parked.state = State::Dead; // Its owner finishes the cleanup
+        }
+      }
+      for (const uint32_t id : closing) {
+        eraseLocked(id);
+      }
+    }
+    for (const uint32_t id : closing) {
+      release(id);
+    }
+  }
+
+private:
+  enum class State : uint8_t { Parking, Idle, Handoff, Dead };
+
+  struct Parked {
+    uint32_t pool;
+    std::string key;
+    int64_t secureContextId;
+    std::string serverName;
+    uint64_t generation; // Guards expiry tasks against reuse of the ID
+    State state;
+  };
+
+  SocketPool() = default;
+
+  static std::string poolKey(uint32_t pool, const std::string &key) {
+    return std::to_string(pool) + '|' + key;
+  }
+
+  // The handler context carries the socket ID, so no per-socket allocation
+  // has to outlive a dispatch that races with eviction.
+  static void *contextFor(uint32_t id) {
+    return reinterpret_cast<void *>(static_cast<uintptr_t>(id));
+  }
+
+  static void onEventThunk(void *context, int type, const uint8_t *data,
+                           size_t len) {
+    shared().onEvent(
+        static_cast<uint32_t>(reinterpret_cast<uintptr_t>(context)), type,
+        data, len);
+  }
+
+  void onEvent(uint32_t id, int type, const uint8_t *data, size_t len) {
+    switch (type) {
+    case 9: { // SESSION: a (new) ticket arrived while idle
+      std::unique_lock lock(_mutex);
+      auto it = _sockets.find(id);
+      if (it == _sockets.end() || it->second.secureContextId < 0)
+        return;
+      const auto context = static_cast<uint32_t>(it->second.secureContextId);
+      const std::string serverName = it->second.serverName;
+      lock.unlock();
+      TlsSessionCache::shared().store(context, serverName, data, len);
+      return;
+    }
+    case 2:   // DATA: unsolicited bytes on an idle HTTP connection
+    case 3:   // ERROR
+    case 4:   // CLOSE
+    case 7: { // TIMEOUT
+      bool evict = false;
+      {
+        std::lock_guard lock(_mutex);
+        auto it = _sockets.find(id);
+        if (it == _sockets.end())
+          return;
+        if (it->second.state == State::Idle) {
+          eraseLocked(id);
+          evict = true;
+        } else {
+          it->second.state = State::Dead;
+        }
+      }
+      if (evict) {
+        NET_LOGD(Socket, "Pooled socket %u closed while idle (event %d)", id,
+                 type);
+        NetManager::shared().unregisterHandler(id);
+        // Don't re-enter the core from its own callback.
+        NetScheduler::shared().schedule(std::chrono::microseconds(0),
+                                        [id] { net_destroy_socket(id); });
+      }
+      return;
+    }
+    default:
+      return;
+    }
+  }
+
+  void expire(uint32_t id, uint64_t generation) {
+    {
+      std::lock_guard lock(_mutex);
+      auto it = _sockets.find(id);
+      if (it == _sockets.end() || it->second.generation != generation ||
+          it->second.state != State::Idle)
+        return;
+      eraseLocked(id);
+    }
+    release(id);
+  }
+
+  static void release(uint32_t id) {
+    NetManager::shared().unregisterHandler(id);
+    net_destroy_socket(id);
+  }
+
+  void eraseLocked(uint32_t id) {
+    auto it = _sockets.find(id);
+    if (it == _sockets.end())
+      return;
+    auto idle = _idle.find(poolKey(it->second.pool, it->second.key));
+    if (idle != _idle.end()) {
+      auto &ids = idle->second;
+      ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+      if (ids.empty())
+        _idle.erase(idle);
+    }
+    _sockets.erase(it);
+  }
+
+  std::mutex _mutex;
+  uint32_t _lastPool = 0;
+  uint64_t _generation = 0;
+  std::unordered_map<uint32_t, Parked> _sockets;
+  std::unordered_map<std::string, std::deque<uint32_t>> _idle;
+};
+
+} // namespace margelo::nitro::net
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace margelo::nitro::net {
+
+/// Lock-free latency histogram in the spirit of HdrHistogram: values (in
+/// microseconds) fall into log-linear buckets, 8 per power of two, so any
+/// recorded value is reported within 12.5% of what was measured. Recording
+/// is a handful of relaxed atomic operations and never blocks.
+class LatencyHistogram {
+public:
+  struct Snapshot {
+    uint64_t count = 0;
+    uint64_t min = 0; // Microseconds
+    uint64_t max = 0;
+    double mean = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+  };
+
+  void record(uint64_t micros) {
+    micros = std::min(micros, kMaxValue);
+    _buckets[indexOf(micros)].fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(micros, std::memory_order_relaxed);
+    uint64_t seen = _min.load(std::memory_order_relaxed);
+    while (micros < seen &&
+           !_min.compare_exchange_weak(seen, micros, std::memory_order_relaxed))
+      ;
+    seen = _max.load(std::memory_order_relaxed);
+    while (micros > seen &&
+           !_max.compare_exchange_weak(seen, micros, std::memory_order_relaxed))
+      ;
+  }
+
+  void record(std::chrono::steady_clock::duration elapsed) {
+    const auto micros =
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    record(static_cast<uint64_t>(std::max<int64_t>(micros, 0)));
+  }
+
+  /// Recordings racing with a snapshot may be partially included.
+  Snapshot snapshot() const {
+    Snapshot snapshot;
+    std::array<uint64_t, kBucketCount> counts;
+    for (size_t i = 0; i < kBucketCount; i++) {
+      counts[i] = _buckets[i].load(std::memory_order_relaxed);
+      snapshot.count += counts[i];
+    }
+    if (snapshot.count == 0)
+      return snapshot;
+    snapshot.min = _min.load(std::memory_order_relaxed);
+    snapshot.max = _max.load(std::memory_order_relaxed);
+    snapshot.mean = static_cast<double>(_sum.load(std::memory_order_relaxed)) /
+                    static_cast<double>(snapshot.count);
+    snapshot.p50 = percentile(counts, snapshot, 0.50);
+    snapshot.p90 = percentile(counts, snapshot, 0.90);
+    snapshot.p99 = percentile(counts, snapshot, 0.99);
+    return snapshot;
+  }
+
+private:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr uint64_t kSubBuckets = 1U << kSubBucketBits;
+  // About 76 hours; longer values are clamped.
+  static constexpr int kMaxMagnitude = 38;
+  static constexpr uint64_t kMaxValue = (uint64_t{1} << kMaxMagnitude) - 1;
+  static constexpr size_t kBucketCount =
+      (kMaxMagnitude - kSubBucketBits + 1) * kSubBuckets;
+
+  static size_t indexOf(uint64_t value) {
+    if (value < kSubBuckets)
+      return static_cast<size_t>(value);
+    const int magnitude = 63 - __builtin_clzll(value);
+    const int shift = magnitude - kSubBucketBits;
+    return static_cast<size_t>((shift + 1) * kSubBuckets +
+                               ((value >> shift) & (kSubBuckets - 1)));
+  }
+
+  // Largest value that falls into bucket `index`.
+  static uint64_t upperBoundOf(size_t index) {
+    if (index < kSubBuckets)
+      return index;
+    const size_t shift = index / kSubBuckets - 1;
+    const uint64_t base = (kSubBuckets + index % kSubBuckets) << shift;
+    return base + (uint64_t{1} << shift) - 1;
+  }
+
+  static uint64_t percentile(const std::array<uint64_t, kBucketCount> &counts,
+                             const Snapshot &snapshot, double quantile) {
+    const auto rank = std::max<uint64_t>(
+        static_cast<uint64_t>(
+            std::ceil(quantile * static_cast<double>(snapshot.count))),
+        1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+      seen += counts[i];
+      if (seen >= rank)
+        return std::clamp(upperBoundOf(i), snapshot.min, snapshot.max);
+    }
+    return snapshot.max;
+  }
+
+  std::array<std::atomic<uint64_t>, kBucketCount> _buckets{};
+  std::atomic<uint64_t> _sum{0};
+  std::atomic<uint64_t> _min{std::numeric_limits<uint64_t>::max()};
+  std::atomic<uint64_t> _max{0};
+};
+
+/// Traffic counters of one driver, or of the whole runtime.
+struct TrafficCounters {
+  std::atomic<uint64_t> bytesRead{0};    // DATA payload received
+  std::atomic<uint64_t> bytesWritten{0}; // Bytes handed to the core
+  std::atomic<uint64_t> events{0};       // Events delivered to JS
+  std::atomic<uint64_t> bufferBytes{0};  // ArrayBuffer bytes handed to JS
+
+  void add(std::atomic<uint64_t> TrafficCounters::*counter, uint64_t value) {
+    (this->*counter).fetch_add(value, std::memory_order_relaxed);
+  }
+};
+
+/// Process-wide counters and latency histograms, fed by every driver.
+class RuntimeStats {
+public:
+  static RuntimeStats &shared() {
+    // Intentionally leaked: worker threads record until teardown.
+    static RuntimeStats *instance = new RuntimeStats();
+    return *instance;
+  }
+
+  TrafficCounters traffic;
+  std::atomic<int64_t> openSockets{0};
+  std::atomic<int64_t> openServers{0};
+  // Bytes written to open sockets since each last reported DRAIN.
+  std::atomic<int64_t> writeQueueBytes{0};
+
+  // From the core's callback until the event is handed to JS, with any time
+  // spent waiting in an event batch.
+  LatencyHistogram dispatchLatency;
+  LatencyHistogram connectTime;   // Plain TCP connects, including DNS
+  LatencyHistogram handshakeTime; // TLS connects, including TCP and DNS
+  LatencyHistogram dnsTime;       // Resolver queries (cache misses)
+
+private:
+  RuntimeStats() = default;
+};
+
+/// Adds `value` to a driver's counter and to the runtime total.
+inline void countTraffic(TrafficCounters &driver,
+                         std::atomic<uint64_t> TrafficCounters::*counter,
+                         uint64_t value) {
+  driver.add(counter, value);
+  RuntimeStats::shared().traffic.add(counter, value);
+}
+
+} // namespace margelo::nitro::net
@@ -0,0 +1,710 @@
+#pragma once
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#if defined(__APPLE__) || defined(__ANDROID__)
+#include <stdlib.h>
+#elif defined(__linux__)
+#include <sys/random.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace margelo::nitro::net {
+
+/// Settings of one WebSocket connection, from the opening handshake.
+/// Window bits below 9 are raised to 9 (zlib cannot produce raw 8-bit
+/// windows).
+struct WebSocketConfig {
+  bool client = false; // Mask outgoing frames; expect unmasked ones
+  size_t maxMessageSize = 64 * 1024 * 1024;
+  // permessage-deflate (RFC 7692)
+  bool deflate = false;
+  bool serverNoContextTakeover = false;
+  bool clientNoContextTakeover = false;
+  int serverMaxWindowBits = 15;
+  int clientMaxWindowBits = 15;
+  size_t compressThreshold = 1024; // Smaller messages are sent as-is
+  bool autoPong = true;
+};
+
+/// Kind byte leading every codec event: a frame opcode, kWebSocketAttached,
+/// or kWebSocketClose | kWebSocketFailed for a close the codec sent itself.
+enum WebSocketKind : uint8_t {
+  kWebSocketAttached = 0,
+  kWebSocketText = 1,
+  kWebSocketBinary = 2,
+  kWebSocketClose = 8,
+  kWebSocketPing = 9,
+  kWebSocketPong = 10,
+  kWebSocketFailed = 0x80,
+};
+
+namespace detail {
+
+/// dst[i] = src[i] ^ key[(phase + i) % 4], 16 bytes at a time with
+/// SSE2/NEON. `dst` may equal `src`. Advances `phase` past the bytes.
+inline void maskCopy(uint8_t *dst, const uint8_t *src, size_t len,
+                     const uint8_t key[4], uint32_t &phase) {
+  // The key rotated so that k[0] applies to dst[0]; every block length below
+  // is a multiple of 4, so the rotation holds for each block.
+  uint8_t k[16];
+  for (size_t i = 0; i < sizeof(k); i++) {
+    k[i] = key[(phase + i) & 3];
+  }
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(k));
+  for (; i + 16 <= len; i += 16) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                     _mm_xor_si128(chunk, mask));
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t mask = vld1q_u8(k);
+  for (; i + 16 <= len; i += 16) {
+    vst1q_u8(dst + i, veorq_u8(vld1q_u8(src + i), mask));
+  }
+#endif
+  uint64_t wide;
+  memcpy(&wide, k, sizeof(wide));
+  for (; i + 8 <= len; i += 8) {
+    uint64_t chunk;
+    memcpy(&chunk, src + i, sizeof(chunk));
+    chunk ^= wide;
+    memcpy(dst + i, &chunk, sizeof(chunk));
+  }
+  for (; i < len; i++) {
+    dst[i] = src[i] ^ k[i & 3];
+  }
+  phase = static_cast<uint32_t>((phase + len) & 3);
+}
+
+/// Strict UTF-8 check (no overlongs, surrogates or code points past
+/// U+10FFFF), skipping ASCII runs 8 bytes at a time.
+inline bool isValidUtf8(const uint8_t *p, size_t len) {
+  size_t i = 0;
+  while (i < len) {
+    if (len - i >= 8) {
+      uint64_t chunk;
+      memcpy(&chunk, p + i, sizeof(chunk));
+      if ((chunk & 0x8080808080808080ULL) == 0) {
+        i += 8;
+        continue;
+      }
+    }
+    const uint8_t lead = p[i];
+    if (lead < 0x80) {
+      i++;
+      continue;
+    }
+    size_t extra;
+    uint32_t cp;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+      extra = 1;
+      cp = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+      extra = 2;
+      cp = lead & 0x0F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+      extra = 3;
+      cp = lead & 0x07;
+    } else {
+      return false;
+    }
+    if (len - i <= extra)
+      return false;
+    for (size_t j = 1; j <= extra; j++) {
+      const uint8_t next = p[i + j];
+      if ((next & 0xC0) != 0x80)
+        return false;
+      cp = cp << 6 | (next & 0x3F);
+    }
+    if ((extra == 2 && (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF))) ||
+        (extra == 3 && (cp < 0x10000 || cp > 0x10FFFF)))
+      return false;
+    i += extra + 1;
+  }
+  return true;
+}
+
+inline int windowBits(int bits) { return std::clamp(bits, 9, 15); }
+
+} // namespace detail
+
+/// Incremental WebSocket frame parser (RFC 6455). Feeds raw socket bytes,
+/// unmasks payloads straight into the message buffer, reassembles fragments
+/// and inflates permessage-deflate messages. Every complete message or
+/// control frame is reported as one event: its kind byte followed by the
+/// payload, contiguous. Not thread-safe.
+class WebSocketDecoder {
+public:
+  explicit WebSocketDecoder(const WebSocketConfig &config)
+      : _config(config),
+        _peerResetsContext(config.client ? config.serverNoContextTakeover
+                                         : config.clientNoContextTakeover) {}
+
+  ~WebSocketDecoder() {
+    if (_inflating)
+      inflateEnd(&_inflater);
+  }
+
+  WebSocketDecoder(const WebSocketDecoder &) = delete;
+  WebSocketDecoder &operator=(const WebSocketDecoder &) = delete;
+
+  /// Why decoding stopped (RFC 6455 close code and reason), if it failed.
+  uint16_t failureCode() const { return _failureCode; }
+  const char *failureReason() const { return _failureReason; }
+
+  /// Set once a close frame was decoded; later bytes are ignored.
+  bool closed() const { return _closed; }
+
+  /// Decodes `data`, calling onEvent(event, size) for each complete message
+  /// or control frame. Returns false once the stream violates the protocol.
+  template <typename OnEvent>
+  bool feed(const uint8_t *data, size_t len, OnEvent &&onEvent) {
+    while (len > 0 && _failureCode == 0 && !_closed) {
+      if (!_inFrame) {
+        const size_t used = fillHeader(data, len);
+        data += used;
+        len -= used;
+        if (_headerLen < headerLength())
+          break;
+        if (!beginFrame())
+          break;
+      }
+      const size_t n =
+          static_cast<size_t>(std::min<uint64_t>(_remaining, len));
+      std::vector<uint8_t> &payload = isControl() ? _control : _message;
+      const size_t at = payload.size();
+      payload.resize(at + n);
+      if (_masked) {
+        detail::maskCopy(payload.data() + at, data, n, _mask, _phase);
+      } else if (n > 0) {
+        memcpy(payload.data() + at, data, n);
+      }
+      data += n;
+      len -= n;
+      _remaining -= n;
+      if (_remaining == 0)
+        endFrame(onEvent);
+    }
+    return _failureCode == 0;
+  }
+
+private:
+  // Buffers above this are released after the message that needed them.
+  static constexpr size_t kRetainedBufferSize = 256 * 1024;
+  static constexpr size_t kMaxControlPayload = 125;
+
+  bool isControl() const { return (_opcode & 0x08) != 0; }
+
+  size_t headerLength() const {
+    if (_headerLen < 2)
+      return 2;
+    const uint8_t code = _header[1] & 0x7F;
+    return 2 + (code == 126 ? 2 : code == 127 ? 8 : 0) +
+           ((_header[1] & 0x80) != 0 ? 4 : 0);
+  }
+
+  size_t fillHeader(const uint8_t *data, size_t len) {
+    size_t used = 0;
+    while (used < len && _headerLen < headerLength()) {
+      const size_t n = std::min(headerLength() - _headerLen, len - used);
+      memcpy(_header + _headerLen, data + used, n);
+      _headerLen += n;
+      used += n;
+    }
+    return used;
+  }
+
+  bool fail(uint16_t code, const char *reason) {
+    _failureCode = code;
+    _failureReason = reason;
+    return false;
+  }
+
+  bool beginFrame() {
+    const uint8_t first = _header[0];
+    const bool fin = (first & 0x80) != 0;
+    const bool rsv1 = (first & 0x40) != 0;
+    _opcode = first & 0x0F;
+    _masked = (_header[1] & 0x80) != 0;
+    _fin = fin;
+
+    uint64_t length = _header[1] & 0x7F;
+    size_t at = 2;
+    if (length == 126) {
+      length = static_cast<uint64_t>(_header[2]) << 8 | _header[3];
+      at = 4;
+    } else if (length == 127) {
+      length = 0;
+      for (size_t i = 2; i < 10; i++) {
+        length = length << 8 | _header[i];
+      }
+      at = 10;
+      if ((length >> 63) != 0)
+        return fail(1002, "Invalid frame length");
+    }
+    if (_masked)
+      memcpy(_mask, _header + at, sizeof(_mask));
+    _phase = 0;
+    _remaining = length;
+    _headerLen = 0;
+
+    if ((first & 0x30) != 0)
+      return fail(1002, "RSV2 and RSV3 must be clear");
+    if (_masked == _config.client)
+      return fail(1002, _masked ? "Unexpected masked frame"
+                                : "Expected a masked frame");
+    if (isControl()) {
+      if (_opcode != kWebSocketClose && _opcode != kWebSocketPing &&
+          _opcode != kWebSocketPong)
+        return fail(1002, "Invalid opcode");
+      if (!fin || rsv1 || length > kMaxControlPayload)
+        return fail(1002, "Invalid control frame");
+      _control.assign(1, _opcode);
+    } else if (_opcode == 0) {
+      if (!_messageOpen)
+        return fail(1002, "Unexpected continuation frame");
+      if (rsv1)
+        return fail(1002, "RSV1 set on a continuation frame");
+    } else {
+      if (_opcode != kWebSocketText && _opcode != kWebSocketBinary)
+        return fail(1002, "Invalid opcode");
+      if (_messageOpen)
+        return fail(1002, "Expected a continuation frame");
+      if (rsv1 && !_config.deflate)
+        return fail(1002, "RSV1 must be clear");
+      _messageOpen = true;
+      _compressed = rsv1;
+      _message.assign(1, _opcode);
+    }
+    if (!isControl() && _message.size() - 1 + length > _config.maxMessageSize)
+      return fail(1009, "Message too big");
+    _inFrame = true;
+    return true;
+  }
+
+  template <typename OnEvent> void endFrame(OnEvent &onEvent) {
+    _inFrame = false;
+    if (isControl()) {
+      if (_opcode == kWebSocketClose && !validClose())
+        return;
+      _closed = _opcode == kWebSocketClose;
+      onEvent(_control.data(), _control.size());
+      return;
+    }
+    if (!_fin)
+      return;
+    _messageOpen = false;
+    std::vector<uint8_t> *message = &_message;
+    if (_compressed) {
+      if (!inflateMessage())
+        return;
+      message = &_inflated;
+    }
+    if ((*message)[0] == kWebSocketText &&
+        !detail::isValidUtf8(message->data() + 1, message->size() - 1)) {
+      fail(1007, "Invalid UTF-8 in text message");
+      return;
+    }
+    onEvent(message->data(), message->size());
+    trim(_message);
+    trim(_inflated);
+  }
+
+  bool validClose() {
+    const size_t size = _control.size() - 1;
+    if (size == 0)
+      return true; // No status code (1005)
+    if (size == 1)
+      return fail(1002, "Invalid close frame");
+    const uint16_t code = static_cast<uint16_t>(_control[1] << 8 | _control[2]);
+    const bool valid = (code >= 1000 && code <= 1003) ||
+                       (code >= 1007 && code <= 1014) ||
+                       (code >= 3000 && code <= 4999);
+    if (!valid)
+      return fail(1002, "Invalid close code");
+    if (!detail::isValidUtf8(_control.data() + 3, size - 2))
+      return fail(1007, "Invalid UTF-8 in close reason");
+    return true;
+  }
+
+  bool inflateMessage() {
+    if (!_inflating) {
+      memset(&_inflater, 0, sizeof(_inflater));
+      // A 15-bit window decodes every smaller window the peer may use.
+      if (inflateInit2(&_inflater, -15) != Z_OK)
+        return fail(1011, "Cannot initialize inflate");
+      _inflating = true;
+    }
+    static constexpr uint8_t kTail[] = {0x00, 0x00, 0xFF, 0xFF};
+    _inflated.assign(1, _message[0]);
+    if (!inflateInput(_message.data() + 1, _message.size() - 1) ||
+        !inflateInput(kTail, sizeof(kTail)))
+      return false;
+    if (_peerResetsContext || _streamEnded) {
+      inflateReset(&_inflater);
+      _streamEnded = false;
+    }
+    return true;
+  }
+
+  bool inflateInput(const uint8_t *data, size_t len) {
+    if (_streamEnded)
+      return true; // Bytes after a final block carry nothing
+    _inflater.next_in = const_cast<Bytef *>(data);
+    _inflater.avail_in = static_cast<uInt>(len);
+    const size_t limit = _config.maxMessageSize + 1; // With the kind byte
+    do {
+      const size_t at = _inflated.size();
+      // One byte past the limit is enough to tell the message is too big.
+      const size_t room =
+          std::min(std::max<size_t>(at, 16 * 1024), limit + 1 - at);
+      _inflated.resize(at + room);
+      _inflater.next_out = _inflated.data() + at;
+      _inflater.avail_out = static_cast<uInt>(room);
+      const int rc = inflate(&_inflater, Z_SYNC_FLUSH);
+      _inflated.resize(_inflated.size() - _inflater.avail_out);
+      if (_inflated.size() > limit)
+        return fail(1009, "Message too big");
+      if (rc == Z_STREAM_END) {
+        _streamEnded = true;
+        return true;
+      }
+      if (rc == Z_BUF_ERROR)
+        break; // No progress possible: input exhausted
+      if (rc != Z_OK)
+        return fail(1007, "Invalid compressed data");
+    } while (_inflater.avail_in > 0 || _inflater.avail_out == 0);
+    return true;
+  }
+
+  static void trim(std::vector<uint8_t> &buffer) {
+    if (buffer.capacity() > kRetainedBufferSize) {
+      std::vector<uint8_t>().swap(buffer);
+    }
+  }
+
+  const WebSocketConfig _config;
+  const bool _peerResetsContext;
+
+  // Frame header being assembled
+  uint8_t _header[14];
+  size_t _headerLen = 0;
+
+  // Frame being read
+  bool _inFrame = false;
+  bool _fin = false;
+  bool _masked = false;
+  uint8_t _opcode = 0;
+  uint8_t _mask[4] = {};
+  uint32_t _phase = 0;
+  uint64_t _remaining = 0;
+
+  // Message being reassembled; byte 0 holds its kind
+  bool _messageOpen = false;
+  bool _compressed = false;
+  std::vector<uint8_t> _message;
+  std::vector<uint8_t> _inflated;
+  std::vector<uint8_t> _control;
+
+  z_stream _inflater;
+  bool _inflating = false;
+  bool _streamEnded = false;
+
+  bool _closed = false;
+  uint16_t _failureCode = 0;
+  const char *_failureReason = "";
+};
+
+/// Builds outgoing frames: one unfragmented frame per message, compressed
+/// when permessage-deflate is on and the message reaches the threshold, and
+/// masked on the client side. Not thread-safe.
+class WebSocketEncoder {
+public:
+  explicit WebSocketEncoder(const WebSocketConfig &config)
+      : _config(config),
+        _resetsContext(config.client ? config.clientNoContextTakeover
+                                     : config.serverNoContextTakeover),
+        _keyOffset(sizeof(_keys)) {}
+
+  ~WebSocketEncoder() {
+    if (_deflating)
+      deflateEnd(&_deflater);
+  }
+
+  WebSocketEncoder(const WebSocketEncoder &) = delete;
+  WebSocketEncoder &operator=(const WebSocketEncoder &) = delete;
+
+  /// Appends the frame for one message (or control frame) to `out`.
+  /// Returns false if the message cannot be encoded.
+  bool encode(uint8_t opcode, const uint8_t *data, size_t len,
+              std::vector<uint8_t> &out) {
+    const bool control = (opcode & 0x08) != 0;
+    if (control && len > 125)
+      return false;
+    uint8_t first = static_cast<uint8_t>(0x80 | opcode);
+    if (!control && _config.deflate && len >= _config.compressThreshold) {
+      if (!deflateMessage(data, len))
+        return false;
+      first |= 0x40;
+      data = _deflated.data();
+      len = _deflated.size();
+    }
+    appendFrame(first, data, len, out);
+    if (_deflated.capacity() > kRetainedBufferSize) {
+      std::vector<uint8_t>().swap(_deflated);
+    }
+    return true;
+  }
+
+private:
+  static constexpr size_t kRetainedBufferSize = 256 * 1024;
+
+  bool deflateMessage(const uint8_t *data, size_t len) {
+    if (!_deflating) {
+      memset(&_deflater, 0, sizeof(_deflater));
+      const int bits = detail::windowBits(_config.client
+                                              ? _config.clientMaxWindowBits
+                                              : _config.serverMaxWindowBits);
+      if (deflateInit2(&_deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -bits,
+                       8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+      _deflating = true;
+    }
+    _deflated.clear();
+    _deflater.next_in = const_cast<Bytef *>(data);
+    _deflater.avail_in = static_cast<uInt>(len);
+    do {
+      const size_t at = _deflated.size();
+      const size_t room = std::max<size_t>(len / 2 + 64, 4096);
+      _deflated.resize(at + room);
+      _deflater.next_out = _deflated.data() + at;
+      _deflater.avail_out = static_cast<uInt>(room);
+      if (deflate(&_deflater, Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+        return false;
+      _deflated.resize(_deflated.size() - _deflater.avail_out);
+    } while (_deflater.avail_out == 0);
+    // RFC 7692 7.2.1: drop the empty stored block's 00 00 FF FF.
+    const size_t size = _deflated.size();
+    if (size >= 4 && _deflated[size - 4] == 0x00 &&
+        _deflated[size - 3] == 0x00 && _deflated[size - 2] == 0xFF &&
+        _deflated[size - 1] == 0xFF) {
+      _deflated.resize(size - 4);
+    }
+    if (_resetsContext)
+      deflateReset(&_deflater);
+    return true;
+  }
+
+  void appendFrame(uint8_t first, const uint8_t *payload, size_t len,
+                   std::vector<uint8_t> &out) {
+    uint8_t header[14];
+    size_t n = 0;
+    header[n++] = first;
+    const uint8_t maskBit = _config.client ? 0x80 : 0;
+    if (len < 126) {
+      header[n++] = static_cast<uint8_t>(maskBit | len);
+    } else if (len <= 0xFFFF) {
+      header[n++] = maskBit | 126;
+      header[n++] = static_cast<uint8_t>(len >> 8);
+      header[n++] = static_cast<uint8_t>(len);
+    } else {
+      header[n++] = maskBit | 127;
+      for (int shift = 56; shift >= 0; shift -= 8) {
+        header[n++] = static_cast<uint8_t>(static_cast<uint64_t>(len) >> shift);
+      }
+    }
+    uint8_t key[4];
+    if (_config.client) {
+      nextMaskingKey(key);
+      memcpy(header + n, key, sizeof(key));
+      n += sizeof(key);
+    }
+
+    const size_t at = out.size();
+    out.resize(at + n + len);
+    memcpy(out.data() + at, header, n);
+    if (_config.client) {
+      uint32_t phase = 0;
+      detail::maskCopy(out.data() + at + n, payload, len, key, phase);
+    } else if (len > 0) {
+      memcpy(out.data() + at + n, payload, len);
+    }
+  }
+
+  // RFC 6455 10.3: masking keys must not be predictable from earlier frames,
+  // so they come from the system CSPRNG, fetched 64 keys at a time.
+  void nextMaskingKey(uint8_t key[4]) {
+    if (_keyOffset + 4 > sizeof(_keys)) {
+      fillRandom(_keys, sizeof(_keys));
+      _keyOffset = 0;
+    }
+    memcpy(key, _keys + _keyOffset, 4);
+    _keyOffset += 4;
+  }
+
+  static void fillRandom(uint8_t *out, size_t len) {
+#if defined(__APPLE__) || defined(__ANDROID__)
+    arc4random_buf(out, len);
+#elif defined(__linux__)
+    size_t filled = 0;
+    while (filled < len) {
+      const ssize_t n = getrandom(out + filled, len - filled, 0);
+      if (n > 0)
+        filled += static_cast<size_t>(n);
+    }
+#else
+    std::random_device device;
+    for (size_t i = 0; i < len; i += sizeof(unsigned int)) {
+      const unsigned int random = device();
+      memcpy(out + i, &random, std::min(sizeof(random), len - i));
+    }
+#endif
+  }
+
+  const WebSocketConfig _config;
+  const bool _resetsContext;
+  uint8_t _keys[256];
+  size_t _keyOffset;
+  z_stream _deflater;
+  bool _deflating = false;
+  std::vector<uint8_t> _deflated;
+};
+
+/// A WebSocket connection taken over by the codec. Until start() is called,
+/// incoming bytes are held, so bytes already on their way to JS (before the
+/// attach marker) can be handed back and decoded first. Pings are answered
+/// and close frames echoed natively. Incoming bytes and JS sends may arrive
+/// on different threads.
+class WebSocketSession {
+public:
+  /// Receives frames to write to the socket, or events for JS.
+  using Output = std::function<void(const uint8_t *data, size_t len)>;
+
+  WebSocketSession(const WebSocketConfig &config, Output write,
+                   Output deliver)
+      : _config(config), _decoder(config), _encoder(config),
+        _write(std::move(write)), _deliver(std::move(deliver)) {}
+
+  /// Raw bytes from the socket.
+  void onData(const uint8_t *data, size_t len) {
+    std::lock_guard lock(_readMutex);
+    if (!_started) {
+      _held.insert(_held.end(), data, data + len);
+      return;
+    }
+    decode(data, len);
+  }
+
+  /// Decodes `head` (bytes that reached JS before the attach marker), then
+  /// everything held since, and from then on decodes as bytes arrive.
+  void start(const uint8_t *head, size_t len) {
+    std::lock_guard lock(_readMutex);
+    if (_started)
+      return;
+    _started = true;
+    if (len > 0)
+      decode(head, len);
+    if (!_held.empty())
+      decode(_held.data(), _held.size());
+    std::vector<uint8_t>().swap(_held);
+  }
+
+  /// Sends one message or control frame. Returns false if it was not sent:
+  /// a close frame went out already, or a control payload is too long.
+  bool send(uint8_t opcode, const uint8_t *data, size_t len) {
+    std::lock_guard lock(_writeMutex);
+    return sendLocked(opcode, data, len);
+  }
+
+private:
+  // Caller holds _readMutex.
+  void decode(const uint8_t *data, size_t len) {
+    if (_decoder.closed() || _decoder.failureCode() != 0)
+      return;
+    const bool ok = _decoder.feed(
+        data, len,
+        [this](const uint8_t *event, size_t size) { onEvent(event, size); });
+    if (!ok)
+      failConnection();
+  }
+
+  void onEvent(const uint8_t *event, size_t size) {
+    if (event[0] == kWebSocketPing && _config.autoPong) {
+      send(kWebSocketPong, event + 1, size - 1);
+    } else if (event[0] == kWebSocketClose) {
+      // Echo the status code (RFC 6455 5.5.1), unless JS closed first.
+      std::lock_guard lock(_writeMutex);
+      sendLocked(kWebSocketClose, event + 1, std::min<size_t>(size - 1, 2));
+    }
+    _deliver(event, size);
+  }
+
+  // Sends close with the decoder's failure, and tells JS.
+  void failConnection() {
+    const uint16_t code = _decoder.failureCode();
+    const char *reason = _decoder.failureReason();
+    const size_t reasonLen = std::min<size_t>(strlen(reason), 123);
+    uint8_t event[126];
+    event[0] = kWebSocketClose | kWebSocketFailed;
+    event[1] = static_cast<uint8_t>(code >> 8);
+    event[2] = static_cast<uint8_t>(code);
+    memcpy(event + 3, reason, reasonLen);
+    {
+      std::lock_guard lock(_writeMutex);
+      sendLocked(kWebSocketClose, event + 1, 2 + reasonLen);
+    }
+    _deliver(event, 3 + reasonLen);
+  }
+
+  // Caller holds _writeMutex.
+  bool sendLocked(uint8_t opcode, const uint8_t *data, size_t len) {
+    if (_closeSent)
+      return false;
+    _frame.clear();
+    if (!_encoder.encode(opcode, data, len, _frame))
+      return false;
+    _closeSent = opcode == kWebSocketClose;
+    _write(_frame.data(), _frame.size());
+    if (_frame.capacity() > kRetainedFrameSize) {
+      std::vector<uint8_t>().swap(_frame);
+    }
+    return true;
+  }
+
+  static constexpr size_t kRetainedFrameSize = 256 * 1024;
+
+  const WebSocketConfig _config;
+
+  std::mutex _readMutex; // Taken before _writeMutex
+  WebSocketDecoder _decoder;
+  bool _started = false;
+  std::vector<uint8_t> _held;
+
+  std::mutex _writeMutex;
+  WebSocketEncoder _encoder;
+  bool _closeSent = false;
+  std::vector<uint8_t> _frame;
+
+  const Output _write;
+  const Output _deliver;
+};
+
+} // namespace margelo::nitro::net
@@ -21,11 +21,172 @@ export enum NetSocketEvent {
     LOOKUP = 8,
     SESSION = 9,
     KEYLOG = 10,
-    OCSP = 11
+    OCSP = 11,
+    /**
+     * Output of the WebSocket codec (see `attachWebSocket`). Payload: a kind
+     * byte, then the message. Kinds: 0 attached marker, 1 text, 2 binary,
+     * 8 close (status code and reason), 9 ping, 10 pong; 0x88 is a close the
+     * codec sent itself after a protocol error.
+     */
+    WEBSOCKET = 13,
+    /**
+     * Marker of `pipeTo`: follows the last DATA event JS sees before the
+     * socket's reads are piped natively. No payload.
+     */
+    PIPE = 14,
+    /**
+     * Output of the HTTP/2 engine (see `attachHttp2`): records of a 12-byte
+     * little-endian header (u8 kind, u8 flags, u16 reserved, u32 stream id,
+     * u32 payload length), then the payload. Kinds: 0 attached marker,
+     * 1 headers (NUL-terminated name and value pairs), 2 data, 3 stream
+     * closed (u32 error code), 4 GOAWAY (u32 last stream id, u32 error code,
+     * debug data), 5 peer settings (u32 max concurrent streams), 6 stream
+     * drained. Flags: 1 end of stream, 2 sent by the peer.
+     */
+    HTTP2 = 15
+}
+
+/**
+ * WebSocket connection settings, as agreed in the opening handshake
+ */
+export interface WebSocketOptions {
+    /** Client side: outgoing frames are masked, incoming ones must not be */
+    client: boolean
+    /** Largest message accepted after decompression, in bytes (default 64 MiB) */
+    maxMessageSize?: number
+    /** permessage-deflate was negotiated */
+    perMessageDeflate?: boolean
+    serverNoContextTakeover?: boolean
+    clientNoContextTakeover?: boolean
+    /** 9..15 (default 15) */
+    serverMaxWindowBits?: number
+    /** 9..15 (default 15) */
+    clientMaxWindowBits?: number
+    /** Messages shorter than this are sent uncompressed (default 1024) */
+    compressThreshold?: number
+    /** Answer pings natively (default true) */
+    autoPong?: boolean
+}
+
+/**
+ * Local settings of an HTTP/2 connection (see `attachHttp2`)
+ */
+export interface Http2Options {
+    /** Client side: sends the connection preface and opens streams */
+    client: boolean
+    /** Streams the peer may open at once (server side, default 100) */
+    maxConcurrentStreams?: number
+    /** Per-stream receive window in bytes (default 1 MiB) */
+    initialWindowSize?: number
+    /** HPACK dynamic table size for incoming headers (default 4096) */
+    headerTableSize?: number
+    /** Largest decoded header block accepted, in bytes (default 64 KiB) */
+    maxHeaderListSize?: number
+}
+
+/**
+ * Read coalescing of one socket (see `setReadCoalescing`)
+ */
+export interface ReadCoalescingOptions {
+    /**
+     * Bytes to collect before handing reads to JS (default 16 KiB). When
+     * adaptive, reads are only held while the socket receives at least this
+     * much per `maxDelayMicros`.
+     */
+    minBytes?: number
+    /** Longest a read waits for company, in microseconds (default 2000) */
+    maxDelayMicros?: number
+    /** Largest DATA event; bigger reads are split (default 64 KiB) */
+    maxReadSize?: number
+    /**
+     * Derive the threshold from the observed read rate (default true):
+     * bulk transfers get fewer, larger events, sparse traffic stays immediate
+     */
+    adaptive?: boolean
+}
+
+/**
+ * Settings of a native pipe between two sockets
+ */
+export interface PipeOptions {
+    /**
+     * Bytes waiting for the destination (in the bridge, or written since its
+     * last DRAIN) above which the source stops reading (default 1 MiB)
+     */
+    highWaterMark?: number
+    /** Shut down the destination's writing side when the source closes (default true) */
+    end?: boolean
+}
+
+/**
+ * Counters of a native pipe
+ */
+export interface PipeStats {
+    /** Bytes written to the destination */
+    bytesForwarded: number
+    /** Times the source was paused for backpressure */
+    pauses: number
+    /** Source currently paused for backpressure */
+    paused: boolean
+    /** A destination is attached */
+    active: boolean
+}
+
+/**
+ * Latency distribution in milliseconds. Percentiles come from a log-linear
+ * histogram and are within 12.5% of the recorded values.
+ */
+export interface LatencyStats {
+    count: number
+    min: number
+    mean: number
+    p50: number
+    p90: number
+    p99: number
+    max: number
+}
+
+/**
+ * Counters of one socket
+ */
+export interface SocketStats {
+    /** DATA payload bytes received */
+    bytesRead: number
+    /** Bytes handed to the native writer */
+    bytesWritten: number
+    /** Events delivered to JS */
+    eventsDispatched: number
+    /** Bytes of event ArrayBuffers handed to JS */
+    bufferBytes: number
+    /** Bytes written since the native writer last reported DRAIN */
+    writeQueueBytes: number
+    /** Milliseconds from connect() until the first address was tried */
+    dnsTime?: number
+    /** Milliseconds from connect() until a plain TCP socket connected */
+    connectTime?: number
+    /** Milliseconds from connect() until a TLS handshake completed */
+    handshakeTime?: number
 }
 
 export interface NetSocketDriver extends HybridObject<{ ios: 'swift', android: 'kotlin' }> {
     readonly id: number
+    /**
+     * Snapshot of this socket's counters
+     */
+    getStats(): SocketStats
+    /**
+     * Bytes handed to the native writer since it last reported DRAIN. Stays 0
+     * until the first DRAIN, as nothing else would count it down, and drops
+     * back to 0 (until the next DRAIN) when no DRAIN follows within 250 ms.
+     */
+    readonly writeQueueBytes: number
+    /**
+     * Connect mode for host names (call before connecting). Enabled (the default),
+     * the host's IPv6 and IPv4 addresses are raced Happy Eyeballs style, a new
+     * attempt starting every `attemptTimeout` ms (default `connectionAttemptDelay`);
+     * disabled, the next address is only tried once the previous one failed.
+     */
+    setAutoSelectFamily(enabled: boolean, attemptTimeout?: number): void
     connect(host: string, port: number): void
     connectTLS(host: string, port: number, serverName?: string, rejectUnauthorized?: boolean): void
     connectTLSWithContext(host: string, port: number, serverName?: string, rejectUnauthorized?: boolean, secureContextId?: number): void
@@ -34,6 +195,11 @@ export interface NetSocketDriver extends HybridObject<{ ios: 'swift', android: '
     getCipher(): string | undefined
     getALPN(): string | undefined
     getPeerCertificateJSON(): string | undefined
+    /**
+     * The peer's certificate, read from the core once per connection; fields
+     * are parsed natively on first access and cached
+     */
+    getPeerCertificate(): PeerCertificate | undefined
     getEphemeralKeyInfo(): string | undefined
     getSharedSigalgs(): string | undefined
     isSessionReused(): boolean
@@ -42,7 +208,15 @@ export interface NetSocketDriver extends HybridObject<{ ios: 'swift', android: '
     connectUnix(path: string): void
     connectUnixTLS(path: string, serverName?: string, rejectUnauthorized?: boolean): void
     connectUnixTLSWithContext(path: string, serverName?: string, rejectUnauthorized?: boolean, secureContextId?: number): void
-    write(data: ArrayBuffer): void
+    /**
+     * Writes `length` bytes of `data` starting at `offset` (default: the whole buffer)
+     */
+    write(data: ArrayBuffer, offset?: number, length?: number): void
+    /**
+     * Gather write: sends all buffers as one contiguous write.
+     * `ranges` optionally holds an (offset, length) pair per buffer.
+     */
+    writev(buffers: ArrayBuffer[], ranges?: number[]): void
     pause(): void
     resume(): void
     shutdown(): void
@@ -57,19 +231,153 @@ export interface NetSocketDriver extends HybridObject<{ ios: 'swift', android: '
     getLocalAddress(): string
     getRemoteAddress(): string
     onEvent: (event: number, data: ArrayBuffer) => void
+    /**
+     * Batched event callback, used while event batching is enabled.
+     * `descriptors` is a packed Uint32 array of (type, offset, length) triples;
+     * each payload is `data[offset, offset + length)`.
+     */
+    onEventBatch: (descriptors: ArrayBuffer, data: ArrayBuffer) => void
+    /**
+     * Opt in to batched delivery: events are queued natively and flushed to
+     * `onEventBatch` at most once per `intervalMicros` (default 1000), or
+     * earlier once `maxBatchBytes` (default 256 KiB) of payload is queued.
+     * Events that cannot wait flush the queue immediately, preserving order.
+     */
+    setEventBatching(enabled: boolean, intervalMicros?: number, maxBatchBytes?: number): void
+    /**
+     * Routes all further events through the runtime's event pump (see
+     * `NetDriver.setEventPump`) instead of `onEvent`/`onEventBatch`. Returns
+     * the key naming this driver in drained batches.
+     */
+    attachEventPump(): number
+    /**
+     * Opt in to merging small reads into larger DATA events. Only DATA waits;
+     * any other event first hands on the reads before it.
+     */
+    setReadCoalescing(enabled: boolean, options?: ReadCoalescingOptions): void
+    /** Bytes reads are currently collected up to (0 = delivered immediately) */
+    getReadCoalescingThreshold(): number
+    /**
+     * Hands the connection to the native WebSocket codec, after the 101
+     * response. Incoming bytes are held from here on; a WEBSOCKET event with
+     * the attached marker follows the last raw DATA event, and bytes received
+     * before it go back through `startWebSocket`.
+     */
+    attachWebSocket(options: WebSocketOptions): void
+    /**
+     * Starts decoding: `head` first, then the bytes held since attaching.
+     * Complete messages arrive as WEBSOCKET events.
+     */
+    startWebSocket(head?: ArrayBuffer): void
+    /**
+     * Sends one message or control frame (opcode 1 text, 2 binary, 8 close,
+     * 9 ping, 10 pong). Returns false once a close frame was sent.
+     */
+    sendWebSocket(opcode: number, data: ArrayBuffer, offset?: number, length?: number): boolean
+    /**
+     * Hands the connection to the native HTTP/2 engine, once ALPN chose
+     * h2 or the peer sent the cleartext preface. Sends the preface and
+     * SETTINGS; incoming bytes are held from here on, and an HTTP2 event
+     * with the attached marker follows the last raw DATA event.
+     */
+    attachHttp2(options: Http2Options): void
+    /**
+     * Starts decoding: `head` first, then the bytes held since attaching.
+     * Streams and their frames arrive as HTTP2 events.
+     */
+    startHttp2(head?: ArrayBuffer): void
+    /**
+     * Opens a client stream with a flat list of header names and values,
+     * pseudo-headers first. `urgency` (0..7, default 3) and `incremental`
+     * are its RFC 9218 priority. Returns the stream id, or 0 while the
+     * peer's concurrency limit is reached or after GOAWAY.
+     */
+    openHttp2Stream(headers: string[], endStream: boolean, urgency?: number, incremental?: boolean): number
+    /** Sends response headers or trailers; false if the stream is gone */
+    sendHttp2Headers(streamId: number, headers: string[], endStream: boolean): boolean
+    /**
+     * Sends body bytes, framed and flow-controlled natively. Returns false
+     * once the stream has buffered 64 KiB; a drained record follows.
+     */
+    sendHttp2Data(streamId: number, endStream: boolean, data: ArrayBuffer, offset?: number, length?: number): boolean
+    /** Sends RST_STREAM with `code` and forgets the stream */
+    resetHttp2Stream(streamId: number, code: number): void
+    /** Stops or resumes replenishing the stream's receive window */
+    setHttp2StreamPaused(streamId: number, paused: boolean): void
+    /** Sends GOAWAY with `code`; open streams may still finish */
+    closeHttp2(code: number): void
+    /**
+     * Pipes this socket's incoming bytes into `destination` inside the
+     * runtime, decrypted if this is a TLS socket and re-encrypted if the
+     * destination is. Incoming bytes are held from here on; a PIPE event
+     * follows the last DATA event, and JS writes what it still has to the
+     * destination before calling `startPipe`. CLOSE and ERROR are still
+     * reported.
+     */
+    pipeTo(destination: NetSocketDriver, options?: PipeOptions): void
+    /** Forwards the bytes held since `pipeTo`, then every later read */
+    startPipe(): void
+    /** Stops piping; held and later bytes arrive as DATA events again */
+    unpipe(): void
+    getPipeStats(): PipeStats
 }
 
 export enum NetServerEvent {
     CONNECTION = 6,
     ERROR = 3,
     CLOSE = 4,
-    DEBUG = 9
+    DEBUG = 9,
+    /**
+     * Admission pressure changed. Payload: "level,pending,shed" where level is
+     * 0 (normal), 1 (accepts queued by the rate limit) or 2 (shedding).
+     */
+    SERVER_PRESSURE = 12
+}
+
+/**
+ * Counters of one server
+ */
+export interface ServerStats {
+    /** Connections accepted by the native listeners */
+    connectionsAccepted: number
+    /** Connections turned away by admission control */
+    connectionsShed: number
+    /** Accepted connections queued natively or not yet picked up by JS */
+    pendingAccepts: number
+    /** Events delivered to JS */
+    eventsDispatched: number
+    /** Bytes of event ArrayBuffers handed to JS */
+    bufferBytes: number
 }
 
 export interface NetServerDriver extends HybridObject<{ ios: 'swift', android: 'kotlin' }> {
     onEvent: (event: number, data: ArrayBuffer) => void
-    listen(port: number, backlog?: number, ipv6Only?: boolean, reusePort?: boolean): void
-    listenTLS(port: number, secureContextId: number, backlog?: number, ipv6Only?: boolean, reusePort?: boolean): void
+    /**
+     * Batched event callback, used while event batching is enabled.
+     * `descriptors` is a packed Uint32 array of (type, offset, length) triples;
+     * each payload is `data[offset, offset + length)`.
+     */
+    onEventBatch: (descriptors: ArrayBuffer, data: ArrayBuffer) => void
+    /**
+     * Opt in to batched delivery: events are queued natively and flushed to
+     * `onEventBatch` at most once per `intervalMicros` (default 1000), or
+     * earlier once `maxBatchBytes` (default 256 KiB) of payload is queued.
+     * Events that cannot wait flush the queue immediately, preserving order.
+     */
+    setEventBatching(enabled: boolean, intervalMicros?: number, maxBatchBytes?: number): void
+    /**
+     * Routes all further events through the runtime's event pump (see
+     * `NetDriver.setEventPump`) instead of `onEvent`/`onEventBatch`. Returns
+     * the key naming this driver in drained batches.
+     */
+    attachEventPump(): number
+    /**
+     * `listeners` > 1 opens that many SO_REUSEPORT listeners on the port (0 = one
+     * per runtime worker thread), so the kernel spreads accepts across workers.
+     * 'listening' is reported once all of them are bound.
+     */
+    listen(port: number, backlog?: number, ipv6Only?: boolean, reusePort?: boolean, listeners?: number): void
+    listenTLS(port: number, secureContextId: number, backlog?: number, ipv6Only?: boolean, reusePort?: boolean, listeners?: number): void
     listenUnix(path: string, backlog?: number): void
     listenTLSUnix(path: string, secureContextId: number, backlog?: number): void
     /**
@@ -80,9 +388,48 @@ export interface NetServerDriver extends HybridObject<{ ios: 'swift', android: '
     listenHandle(fd: number, backlog?: number): void
     getLocalAddress(): string
     maxConnections: number
+    /**
+     * Snapshot of this server's counters
+     */
+    getStats(): ServerStats
+    /**
+     * Admission control. Accepted connections reach JS at most `acceptRate` per
+     * second (0 = unlimited), in bursts of up to `acceptBurst` (0 = acceptRate);
+     * the rest wait natively. Once `maxPendingAccepts` connections are waiting
+     * or handed to JS but not yet picked up (0 = no limit), new ones are shed:
+     * reset (`shedMode` 0) or answered with an HTTP 503 (`shedMode` 1).
+     */
+    acceptRate: number
+    acceptBurst: number
+    maxPendingAccepts: number
+    shedMode: number
     close(): void
 }
 
+/**
+ * A peer certificate as reported by the TLS core. Field names follow
+ * Node's `tls.PeerCertificate`.
+ */
+export interface PeerCertificate extends HybridObject<{ ios: 'swift', android: 'kotlin' }> {
+    readonly subject: Record<string, string>
+    readonly issuer: Record<string, string>
+    readonly validFrom: string
+    readonly validTo: string
+    /** SHA-1 fingerprint, colon-separated hex */
+    readonly fingerprint: string
+    /** SHA-256 fingerprint, colon-separated hex */
+    readonly fingerprint256: string
+    readonly serialNumber: string
+    /** Node's `subjectaltname` string, if the core reports it */
+    readonly subjectAltName?: string
+    /** DER encoding, if the core reports it */
+    readonly raw?: ArrayBuffer
+    /** Next certificate up the chain, if the core reports it */
+    readonly issuerCertificate?: PeerCertificate
+    /** The core's JSON for this certificate */
+    toJSON(): string
+}
+
 export interface HttpParser extends HybridObject<{ ios: 'swift', android: 'kotlin' }> {
     /**
      * Feed data to the parser
@@ -90,6 +437,104 @@ export interface HttpParser extends HybridObject<{ ios: 'swift', android: 'kotli
      * @returns JSON string of the parsed message if complete, empty string if partial, or error message starting with 'ERROR:'
      */
     feed(data: ArrayBuffer): string
+    /**
+     * Feed data to the parser and get the result as a binary frame
+     * (layout documented in cpp/HttpFrame.hpp)
+     * @param data Raw byte data from the network
+     * @returns Frame of the parsed message if complete, an empty buffer if partial, or an error frame
+     */
+    feedBinary(data: ArrayBuffer): ArrayBuffer
+    /**
+     * Feed data to the incremental parser and get every message piece it completes in one call.
+     * Unlike feed/feedBinary, messages are not buffered whole: each message touched by this data
+     * gets one frame with what arrived, i.e. the headers once the head is complete, the body bytes
+     * of this data, and the complete flag (with trailers) at the end.
+     * @param data Raw byte data from the network
+     * @returns Sequence of `u32 length` + binary frame records (each padded to 4 bytes); empty if nothing new was parsed.
+     * Parsing stops for good after an error frame. After a CONNECT request, a 101 response, a 2xx
+     * answer to CONNECT or an accepted upgrade request (frames flagged as upgrades), every later
+     * byte comes back unparsed in a tail frame, starting with the rest of that data.
+     */
+    feedAll(data: ArrayBuffer): ArrayBuffer
+    /**
+     * The connection ended: completes a response whose body runs until the close
+     * @returns feedAll-style batch; empty if no message was waiting for the close
+     */
+    finish(): ArrayBuffer
+    /**
+     * The next final response answers a HEAD request, so feedAll ends it after the headers
+     * whatever its Content-Length says (response mode only)
+     */
+    expectHeadResponse(): void
+    /**
+     * The next final response answers a CONNECT request: a 2xx one opens a tunnel, so feedAll
+     * stops after its headers (response mode only)
+     */
+    expectConnectResponse(): void
+    /**
+     * Whether requests asking for a protocol upgrade (`Upgrade` plus `Connection: upgrade`) stop
+     * feedAll like CONNECT does (request mode only; off by default)
+     */
+    acceptUpgrades(accept: boolean): void
+}
+
+/**
+ * Native HTTP/1.1 serializer. Renders response heads and chunked framing
+ * directly into the socket's write queue (through its writev path).
+ *
+ * Header lists are encoded as `headerIds` plus `headers`: for each entry, a
+ * non-zero ID names an interned header (see cpp/HttpHeaders.hpp, optionally
+ * OR-ed with 0x100 for its Title-Case spelling) and consumes one string, the
+ * value; ID 0 consumes two strings, the name and the value.
+ */
+export interface HttpSerializer extends HybridObject<{ ios: 'swift', android: 'kotlin' }> {
+    /**
+     * Writes a status line, headers and, optionally, the first body chunk as one write
+     * @param chunked Frame `body` as a chunk of a chunked body
+     * @returns Number of bytes written to the socket
+     */
+    writeHead(socket: NetSocketDriver, statusCode: number, statusMessage: string, headerIds: number[], headers: string[], chunked: boolean, body?: ArrayBuffer, bodyOffset?: number, bodyLength?: number): number
+    /**
+     * Writes `length` bytes of `data` starting at `offset` as one chunk (size line, data, CRLF)
+     * @returns Number of bytes written to the socket (0 for an empty chunk, which is skipped)
+     */
+    writeChunk(socket: NetSocketDriver, data: ArrayBuffer, offset?: number, length?: number): number
+    /**
+     * Writes the terminating zero-length chunk, followed by optional trailers
+     * given as flattened name/value pairs
+     * @returns Number of bytes written to the socket
+     */
+    writeLastChunk(socket: NetSocketDriver, trailers?: string[]): number
+}
+
+/**
+ * Native keep-alive pool for the client sockets of one Agent.
+ * Sockets are keyed by (host, port, secureContextId), where secureContextId is
+ * -1 for plain TCP and 0 for TLS with the default context. Idle sockets stay
+ * in native code: a peer closing one evicts it and idle timeouts fire there,
+ * without waking JS.
+ */
+export interface ConnectionPool extends HybridObject<{ ios: 'swift', android: 'kotlin' }> {
+    /**
+     * Idle sockets currently parked in this pool
+     */
+    readonly idleCount: number
+    /**
+     * Parks a connected socket. On success the driver is detached and must not be used again.
+     * @param idleTimeoutMs Close the connection after this long without reuse
+     * @param keepAliveMsecs TCP keep-alive delay while idle (0 = unchanged)
+     * @returns false if the key already holds `maxIdle` sockets; the socket is then left as is
+     */
+    release(socket: NetSocketDriver, host: string, port: number, secureContextId: number, idleTimeoutMs: number, keepAliveMsecs: number, maxIdle: number): boolean
+    /**
+     * Takes an idle, still-open socket for the key. The driver starts paused.
+     * @param lifo Take the most recently parked socket instead of the oldest
+     */
+    acquire(host: string, port: number, secureContextId: number, lifo: boolean): NetSocketDriver | undefined
+    /**
+     * Closes every idle socket
+     */
+    clear(): void
 }
 
 /**
@@ -97,20 +542,189 @@ export interface HttpParser extends HybridObject<{ ios: 'swift', android: 'kotli
  */
 export interface NetConfig {
     /**
-     * Number of worker threads for the async runtime
-     * 0 = use CPU core count (default)
+     * Number of worker threads for the async runtime, which starts when the
+     * first socket or server is created. 0 = the default, up to 2 threads.
      */
     workerThreads?: number
     /**
      * Whether to enable verbose debug logging
+     * Shorthand for `logLevel: 4`
      */
     debug?: boolean
+    /**
+     * Native log level: 0 = none, 1 = error, 2 = warn (default), 3 = info, 4 = debug
+     * Levels above the compile-time ceiling (NITRO_NET_LOG_LEVEL) are compiled out
+     */
+    logLevel?: number
+    /**
+     * Resolve host names natively (shared DNS cache) and race their addresses
+     * on connect (RFC 8305). false passes host names to the core unchanged.
+     * Default true
+     */
+    happyEyeballs?: boolean
+    /**
+     * Delay in ms before the next address is tried while an attempt is pending
+     * Default 250
+     */
+    connectionAttemptDelay?: number
+    /**
+     * How long in ms resolved addresses are cached (0 = no caching). Default 30000
+     */
+    dnsCacheTtl?: number
+    /**
+     * How long in ms failed lookups are cached (0 = no caching). Default 1000
+     */
+    dnsNegativeTtl?: number
+    /**
+     * Maximum number of host names in the DNS cache. Default 256
+     */
+    dnsCacheSize?: number
+}
+
+/**
+ * Counters for the native receive buffer pool
+ */
+export interface BufferPoolStats {
+    /** Event buffers served from a pooled block */
+    hits: number
+    /** Event buffers that needed a fresh block allocation */
+    misses: number
+    /** Event payloads larger than the biggest size class (not pooled) */
+    oversize: number
+    /** Bytes of pooled blocks currently referenced by JS */
+    inUseBytes: number
+    /** Bytes of idle blocks kept for reuse */
+    cachedBytes: number
+}
+
+/**
+ * Counters for the client TLS session cache of one secure context
+ */
+export interface TlsSessionCacheStats {
+    /** Connects that were offered a cached session ticket */
+    hits: number
+    /** Connects with no ticket cached for their server name */
+    misses: number
+    /** Server names dropped to stay within `capacity` */
+    evictions: number
+    /** Server names currently cached */
+    entries: number
+    /** Maximum number of server names kept (0 = cache disabled) */
+    capacity: number
+}
+
+/**
+ * Counters for the native DNS cache
+ */
+export interface DnsCacheStats {
+    /** Lookups answered from a cached address list */
+    hits: number
+    /** Lookups that had to query the resolver */
+    misses: number
+    /** Lookups answered by a cached failure */
+    negativeHits: number
+    /** Background refreshes of entries close to expiry */
+    prefetches: number
+    /** Host names currently cached */
+    entries: number
+}
+
+/**
+ * Process-wide counters of the native runtime
+ */
+export interface NetRuntimeStats {
+    /** DATA payload bytes received by all sockets */
+    bytesRead: number
+    /** Bytes handed to the native writer by all sockets */
+    bytesWritten: number
+    /** Events delivered to JS by all drivers */
+    eventsDispatched: number
+    /** Bytes of event ArrayBuffers handed to JS */
+    bufferBytes: number
+    openSockets: number
+    openServers: number
+    /** Sum of the open sockets' writeQueueBytes */
+    writeQueueBytes: number
+    /** Deferred native tasks (timers, batch flushes) waiting to run */
+    scheduledTasks: number
+    /**
+     * From the native event until it is handed to the JS callback, including
+     * time spent in an event batch
+     */
+    dispatchLatency: LatencyStats
+    /** Plain TCP connects, including DNS */
+    connectTime: LatencyStats
+    /** TLS connects up to the completed handshake, including TCP and DNS */
+    handshakeTime: LatencyStats
+    /** Resolver queries (DNS cache misses) */
+    dnsTime: LatencyStats
+}
+
+/**
+ * Key material of a secure context
+ */
+export interface SecureContextBundle {
+    cert?: string
+    key?: string
+    passphrase?: string
+    pfx?: ArrayBuffer
+    ca?: string[]
+}
+
+export interface SecureContextCacheStats {
+    /** Contexts handed out without parsing */
+    hits: number
+    /** Contexts parsed for the cache */
+    misses: number
+    /** Distinct bundles currently cached */
+    entries: number
+}
+
+/**
+ * Scheduling of an executor lane's threads. Applied on Android only.
+ */
+export interface LaneOptions {
+    /** Nice value of the lane's threads, -20 (highest) to 19 */
+    priority?: number
+    /** CPUs the lane's threads may run on */
+    cpus?: number[]
+}
+
+/**
+ * Events drained from the event pump. `descriptors` is a packed Uint32 array
+ * of (key, type, offset, length) entries; each payload is
+ * `data[offset, offset + length)`.
+ */
+export interface PumpedEvents {
+    descriptors: ArrayBuffer
+    data: ArrayBuffer
 }
 
 export interface NetDriver extends HybridObject<{ ios: 'swift', android: 'kotlin' }> {
-    createSocket(id?: string): NetSocketDriver
-    createServer(): NetServerDriver
+    /**
+     * `lane` names the executor lane running the socket's native timers
+     * (connect attempts, batch and coalescing flushes); default if omitted.
+     */
+    createSocket(id?: string, lane?: string): NetSocketDriver
+    createServer(lane?: string): NetServerDriver
+    /**
+     * Sets thread priority and CPU affinity of a lane, creating it if needed
+     * (up to 8 lanes; sockets name only lanes created here, others run on the
+     * default lane). The 'default' lane's settings also apply to the core's
+     * worker threads.
+     */
+    configureLane(name: string, options: LaneOptions): void
+    /**
+     * Sets the event pump's wake-up callback. Events of attached drivers are
+     * queued natively; the first one after a drain calls `onWake` once on the
+     * JS thread, which should then call `drainEvents`. ERROR and CLOSE come
+     * after all other events of a drained batch.
+     */
+    setEventPump(onWake?: () => void): void
+    drainEvents(): PumpedEvents
     createHttpParser(mode: number): HttpParser
+    createHttpSerializer(): HttpSerializer
+    createConnectionPool(): ConnectionPool
     createSecureContext(cert: string, key: string, passphrase?: string): number
     createEmptySecureContext(): number
     addCACertToSecureContext(scId: number, ca: string): void
@@ -119,10 +733,80 @@ export interface NetDriver extends HybridObject<{ ios: 'swift', android: 'kotlin
     setOCSPResponseToSecureContext(scId: number, ocsp: ArrayBuffer): void
     getTicketKeys(scId: number): ArrayBuffer | undefined
     setTicketKeys(scId: number, keys: ArrayBuffer): void
+    /**
+     * Builds a secure context from `bundle`. With `cached`, identical bundles
+     * share one context, found by a digest of their contents; a shared
+     * context leaves the cache once it is changed, but every earlier holder
+     * still sees the change, so re-create it uncached before changing it.
+     * Returns 0 if the material is invalid.
+     */
+    createSecureContextFromBundle(bundle: SecureContextBundle, cached: boolean): number
+    /**
+     * Like `createSecureContextFromBundle`, parsing on a native worker thread.
+     * Rejects if the material is invalid.
+     */
+    createSecureContextFromBundleAsync(bundle: SecureContextBundle, cached: boolean): Promise<number>
+    /**
+     * Like `addContextToSecureContext`, parsing on a native worker thread
+     */
+    addContextToSecureContextAsync(scId: number, hostname: string, cert: string, key: string, passphrase?: string): Promise<void>
+    /**
+     * Like `setPFXToSecureContext`, parsing on a native worker thread
+     */
+    setPFXToSecureContextAsync(scId: number, pfx: ArrayBuffer, passphrase?: string): Promise<void>
+    /**
+     * Snapshot of the secure context cache counters
+     */
+    getSecureContextCacheStats(): SecureContextCacheStats
+    /**
+     * Drops every cached secure context; contexts in use stay valid
+     */
+    clearSecureContextCache(): void
     /**
      * Initialize the network module with custom configuration
      * Must be called before any other network operations
      * @param config Configuration options
      */
     initWithConfig(config: NetConfig): void
+    /**
+     * Snapshot of the native receive buffer pool counters
+     */
+    getBufferPoolStats(): BufferPoolStats
+    /**
+     * Sets how many server names the client session cache of a secure context
+     * keeps (default 64, 0 disables it). Context 0 is the default client context.
+     */
+    setSessionCacheSize(secureContextId: number, maxEntries: number): void
+    /**
+     * Snapshot of the client session cache counters of a secure context
+     */
+    getSessionCacheStats(secureContextId: number): TlsSessionCacheStats
+    /**
+     * Resolves `host` into the DNS cache ahead of a connect
+     */
+    prefetchDns(host: string): void
+    /**
+     * Opens a connection to `host`:`port` in the background (resolving the
+     * host and, with `tls`, completing the handshake) and parks it for the
+     * next pooled request to the same host, port and protocol. Resolves with
+     * whether a connection was parked; false if it failed or enough are
+     * waiting already.
+     */
+    prewarm(host: string, port: number, tls: boolean): Promise<boolean>
+    /**
+     * Takes a connection parked by `prewarm`, if one is still idle
+     */
+    takePrewarmed(host: string, port: number, tls: boolean): NetSocketDriver | undefined
+    /**
+     * Drops every cached DNS answer
+     */
+    clearDnsCache(): void
+    /**
+     * Snapshot of the native DNS cache counters
+     */
+    getDnsCacheStats(): DnsCacheStats
+    /**
+     * Snapshot of the process-wide counters and latency histograms
+     */
+    getRuntimeStats(): NetRuntimeStats
 }
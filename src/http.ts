@@ -1,9 +1,12 @@
 import { Writable, Readable } from 'readable-stream'
 import { EventEmitter } from 'eventemitter3'
 import { Driver } from './Driver'
-import { Socket, isVerbose } from './net'
+import { Socket, isVerbose, takePrewarmed } from './net'
+import type { AdmissionOptions, ServerPressure } from './net'
 import { TLSSocket } from './tls'
 import { Buffer } from 'react-native-nitro-buffer'
+import type { ConnectionPool, HttpSerializer } from './Net.nitro'
+import { CLIENT_PREFACE, Http2Session, Http2Stream, constants as http2Constants } from './http2'
 
 function debugLog(message: string) {
     if (isVerbose()) {
@@ -12,6 +15,196 @@ function debugLog(message: string) {
     }
 }
 
+/**
+ * Returns the bytes of `data` as an ArrayBuffer for `parser.feed`.
+ * Socket chunks wrap the native event buffer as-is, so in the common case the
+ * underlying buffer is returned without copying.
+ */
+function toParserInput(data: Buffer): ArrayBuffer {
+    const buffer = data.buffer as ArrayBuffer;
+    if (data.byteOffset === 0 && data.byteLength === buffer.byteLength) {
+        return buffer;
+    }
+    return buffer.slice(data.byteOffset, data.byteOffset + data.byteLength);
+}
+
+// ========== Parser frames ==========
+
+/**
+ * A message decoded from a native parser frame. Field names follow the
+ * parser's original JSON output.
+ */
+interface ParsedMessage {
+    method?: string;
+    path?: string;
+    version: number;
+    status?: number;
+    // Repeated fields become arrays
+    headers: Record<string, any>;
+    trailers?: Record<string, any>;
+    is_headers: boolean;
+    is_connect: boolean;
+    complete: boolean;
+    /** Parsing stopped after this message (CONNECT, upgrade) */
+    upgrade: boolean;
+    /** Bytes after an upgrade, left unparsed */
+    tail: boolean;
+    /** Zero-copy view into the frame */
+    body?: Buffer;
+    /** For an upgrade: the bytes that came after its head */
+    head?: Buffer;
+}
+
+// Must match cpp/HttpFrame.hpp
+const FRAME_VERSION = 4;
+const FRAME_HEADER_SIZE = 48;
+const FRAME_ENTRY_SIZE = 16;
+const FRAME_IS_HEADERS = 1 << 0;
+const FRAME_IS_CONNECT = 1 << 1;
+const FRAME_COMPLETE = 1 << 2;
+const FRAME_ASCII = 1 << 3;
+const FRAME_ERROR = 1 << 4;
+const FRAME_UPGRADE = 1 << 5;
+const FRAME_TAIL = 1 << 6;
+const FRAME_INTERNED_NAME = 0x80000000;
+const FRAME_ARRAY_VALUE = 0x80000000;
+
+// Interned header names, indexed by id - 1. Must match kCommonHeaders in
+// cpp/HttpHeaders.hpp (append only).
+const COMMON_HEADERS = [
+    'host', 'content-length', 'content-type', 'connection', 'transfer-encoding',
+    'accept', 'accept-encoding', 'accept-language', 'user-agent', 'cookie',
+    'set-cookie', 'cache-control', 'date', 'server', 'location', 'authorization',
+    'origin', 'referer', 'upgrade', 'content-encoding', 'etag', 'last-modified',
+    'if-none-match', 'if-modified-since', 'expect', 'keep-alive',
+    'x-forwarded-for', 'vary', 'pragma', 'range', 'accept-ranges',
+    'access-control-allow-origin',
+];
+
+// Serializer IDs of the interned names, for both their lowercase and
+// Title-Case spellings (see HttpSerializer in Net.nitro.ts)
+const HEADER_TITLE_CASE = 0x100;
+const INTERNED_HEADER_IDS = new Map<string, number>();
+COMMON_HEADERS.forEach((name, i) => {
+    INTERNED_HEADER_IDS.set(name, i + 1);
+    const titleCase = name.replace(/(^|-)([a-z])/g, (_, dash, c) => dash + c.toUpperCase());
+    INTERNED_HEADER_IDS.set(titleCase, (i + 1) | HEADER_TITLE_CASE);
+});
+
+let serializer: HttpSerializer | undefined;
+function getSerializer(): HttpSerializer {
+    if (!serializer) serializer = Driver.createHttpSerializer();
+    return serializer;
+}
+
+/**
+ * Decodes a binary parser frame (layout in cpp/HttpFrame.hpp) stored at
+ * `start` in `buffer`.
+ * @returns the message, undefined if the parser needs more data, or an error string starting with 'ERROR:'
+ */
+function decodeParserFrame(buffer: ArrayBuffer, start: number = 0, size: number = buffer.byteLength - start): ParsedMessage | string | undefined {
+    if (size === 0) return undefined;
+    const view = new DataView(buffer, start, size);
+    if (size < FRAME_HEADER_SIZE || view.getUint8(0) !== FRAME_VERSION) {
+        return 'ERROR: Unsupported parser frame';
+    }
+    const flags = view.getUint8(1);
+    const headerCount = view.getUint32(8, true);
+    const trailerCount = view.getUint32(12, true);
+    const bodyOffset = view.getUint32(32, true);
+    const bodyLength = view.getUint32(36, true);
+
+    // ASCII frames decode the string region once and slice it by offset
+    const stringsStart = FRAME_HEADER_SIZE + (headerCount + trailerCount) * FRAME_ENTRY_SIZE;
+    const stringsEnd = bodyLength > 0 ? bodyOffset : size;
+    const ascii = (flags & FRAME_ASCII) !== 0
+        ? Buffer.from(buffer, start + stringsStart, stringsEnd - stringsStart).toString('latin1')
+        : undefined;
+    const readString = (at: number): string => {
+        const offset = view.getUint32(at, true);
+        const length = view.getUint32(at + 4, true) & ~FRAME_ARRAY_VALUE;
+        if (length === 0) return '';
+        if (ascii !== undefined) {
+            return ascii.substring(offset - stringsStart, offset - stringsStart + length);
+        }
+        return Buffer.from(buffer, start + offset, length).toString('utf8');
+    };
+
+    if (flags & FRAME_ERROR) {
+        return `ERROR: ${readString(40)}`;
+    }
+
+    const readFields = (first: number, count: number) => {
+        const fields: Record<string, string | string[]> = {};
+        for (let i = 0; i < count; i++) {
+            const at = FRAME_HEADER_SIZE + (first + i) * FRAME_ENTRY_SIZE;
+            const nameLength = view.getUint32(at + 4, true);
+            const name = (nameLength & FRAME_INTERNED_NAME) !== 0
+                ? COMMON_HEADERS[(nameLength & 0xffff) - 1]
+                : readString(at);
+            const value = readString(at + 8);
+            const array = (view.getUint32(at + 12, true) & FRAME_ARRAY_VALUE) !== 0;
+            const existing = fields[name];
+            if (existing === undefined) {
+                fields[name] = array ? [value] : value;
+            } else if (Array.isArray(existing)) {
+                existing.push(value);
+            } else {
+                fields[name] = [existing, value];
+            }
+        }
+        return fields;
+    };
+
+    const methodLength = view.getUint32(20, true);
+    const pathLength = view.getUint32(28, true);
+    const status = view.getUint16(4, true);
+    return {
+        method: methodLength > 0 ? readString(16) : undefined,
+        path: pathLength > 0 ? readString(24) : undefined,
+        version: view.getUint8(2),
+        status: status > 0 ? status : undefined,
+        headers: readFields(0, headerCount),
+        trailers: trailerCount > 0 ? readFields(headerCount, trailerCount) : undefined,
+        is_headers: (flags & FRAME_IS_HEADERS) !== 0,
+        is_connect: (flags & FRAME_IS_CONNECT) !== 0,
+        complete: (flags & FRAME_COMPLETE) !== 0,
+        upgrade: (flags & FRAME_UPGRADE) !== 0,
+        tail: (flags & FRAME_TAIL) !== 0,
+        body: bodyLength > 0 ? Buffer.from(buffer, start + bodyOffset, bodyLength) : undefined,
+    };
+}
+
+/**
+ * Decodes a `parser.feedAll` batch: `u32 length` + frame records, each padded
+ * to 4 bytes. The tail frame after an upgrade becomes that message's `head`.
+ * Stops early if `onMessage` returns false.
+ * @returns an error string starting with 'ERROR:' if the batch ended with one
+ */
+function decodeParserBatch(batch: ArrayBuffer, onMessage: (message: ParsedMessage) => boolean | void): string | undefined {
+    const view = new DataView(batch);
+    let at = 0;
+    while (at + 4 <= batch.byteLength) {
+        const size = view.getUint32(at, true);
+        const result = decodeParserFrame(batch, at + 4, size);
+        at += 4 + ((size + 3) & ~3);
+        if (result === undefined) continue;
+        if (typeof result === 'string') return result;
+        // A tail from a later feed: the new protocol owns the socket by then
+        if (result.tail) continue;
+        if (result.upgrade && at + 4 <= batch.byteLength) {
+            const tailSize = view.getUint32(at, true);
+            const tail = decodeParserFrame(batch, at + 4, tailSize);
+            if (typeof tail === 'object' && tail.tail) {
+                result.head = tail.body;
+                at += 4 + ((tailSize + 3) & ~3);
+            }
+        }
+        if (onMessage(result) === false) break;
+    }
+    return undefined;
+}
+
 // ========== STATUS_CODES ==========
 
 export const STATUS_CODES: Record<number, string> = {
@@ -82,6 +275,73 @@ export const METHODS = [
     'TRACE', 'UNBIND', 'UNLINK', 'UNLOCK', 'UNSUBSCRIBE'
 ];
 
+// ========== HTTP/2 ==========
+
+// Connection-specific fields, which HTTP/2 forbids (RFC 9113 8.2.2)
+const HTTP2_DROPPED_HEADERS = new Set(['connection', 'keep-alive', 'proxy-connection', 'transfer-encoding', 'upgrade', 'host']);
+
+/**
+ * Fills `message.headers` and `rawHeaders` from an HTTP/2 header list and
+ * returns its pseudo-headers. Repeated fields become arrays, as with the
+ * HTTP/1 parser; cookie crumbs are joined back (RFC 9113 8.2.3).
+ */
+function applyHttp2Headers(message: IncomingMessage, list: string[]): Record<string, string> {
+    const pseudo: Record<string, string> = {};
+    const headers: Record<string, string | string[]> = {};
+    for (let i = 0; i + 1 < list.length; i += 2) {
+        const name = list[i];
+        const value = list[i + 1];
+        if (name.startsWith(':')) {
+            pseudo[name] = value;
+            continue;
+        }
+        message.rawHeaders.push(name, value);
+        const existing = headers[name];
+        if (existing === undefined) {
+            // As in Node, set-cookie is always an array
+            headers[name] = name === 'set-cookie' ? [value] : value;
+        } else if (Array.isArray(existing)) {
+            existing.push(value);
+        } else if (name === 'cookie') {
+            headers[name] = `${existing}; ${value}`;
+        } else {
+            headers[name] = [existing, value];
+        }
+    }
+    message.headers = headers;
+    message.httpVersion = '2.0';
+    message.httpVersionMajor = 2;
+    message.httpVersionMinor = 0;
+    return pseudo;
+}
+
+function http2Trailers(list: string[]): Record<string, string> {
+    const trailers: Record<string, string> = {};
+    for (let i = 0; i + 1 < list.length; i += 2) {
+        const name = list[i];
+        trailers[name] = name in trailers ? `${trailers[name]}, ${list[i + 1]}` : list[i + 1];
+    }
+    return trailers;
+}
+
+/** Feeds the body of an HTTP/2 stream into `message`. */
+function readHttp2Body(message: IncomingMessage, stream: Http2Stream) {
+    message._http2Stream = stream;
+    stream.on('data', (chunk: Buffer) => message._pushHttp2(chunk));
+    stream.on('end', () => {
+        if (message.complete) return;
+        message.complete = true;
+        message.push(null);
+    });
+    stream.on('close', (code: number) => {
+        if (message.complete) return;
+        debugLog(`HTTP/2 stream ${stream.id} closed before the message ended (code ${code})`);
+        message.aborted = true;
+        message.emit('aborted');
+        message.push(null);
+    });
+}
+
 // ========== IncomingMessage ==========
 
 export class IncomingMessage extends Readable {
@@ -98,6 +358,9 @@ export class IncomingMessage extends Readable {
     public aborted: boolean = false;
     public complete: boolean = false;
     public trailers: Record<string, string> = {};
+    /** @internal Set when the message is a stream of an HTTP/2 connection */
+    public _http2Stream: Http2Stream | null = null;
+    private _http2Paused = false;
 
     constructor(socket: Socket) {
         // @ts-ignore
@@ -106,9 +369,25 @@ export class IncomingMessage extends Readable {
     }
 
     _read() {
+        if (this._http2Stream) {
+            // Only this stream stops; the connection keeps reading
+            if (this._http2Paused) {
+                this._http2Paused = false;
+                this._http2Stream.setPaused(false);
+            }
+            return;
+        }
         this.socket.resume();
     }
 
+    /** @internal */
+    public _pushHttp2(chunk: Buffer) {
+        if (!this.push(chunk) && !this._http2Paused) {
+            this._http2Paused = true;
+            this._http2Stream?.setPaused(true);
+        }
+    }
+
     public setTimeout(msecs: number, callback?: () => void): this {
         this.socket.setTimeout(msecs, callback);
         return this;
@@ -116,7 +395,11 @@ export class IncomingMessage extends Readable {
 
     public destroy(error?: Error): this {
         super.destroy(error);
-        this.socket.destroy();
+        if (this._http2Stream) {
+            this._http2Stream.reset();
+        } else {
+            this.socket.destroy();
+        }
         return this;
     }
 
@@ -142,6 +425,8 @@ export class OutgoingMessage extends Writable {
     protected _sendHeadersSent: boolean = false;
     public aborted: boolean = false;
     protected _trailers: Record<string, string> | null = null;
+    /** @internal Set when the message is a stream of an HTTP/2 connection */
+    public _http2Stream: Http2Stream | null = null;
 
     constructor() {
         // @ts-ignore - disable autoDestroy to prevent socket from being destroyed when stream ends
@@ -153,7 +438,9 @@ export class OutgoingMessage extends Writable {
 
     public destroy(error?: Error): this {
         super.destroy(error);
-        if (this.socket) {
+        if (this._http2Stream) {
+            this._http2Stream.reset();
+        } else if (this.socket) {
             this.socket.destroy();
         }
         return this;
@@ -220,37 +507,90 @@ export class OutgoingMessage extends Writable {
         return headerStr;
     }
 
-    protected _sendHeaders(firstLine: string) {
-        if (this.headersSent) return;
+    /**
+     * Flattens the headers into the serializer's (headerIds, headers) lists.
+     */
+    protected _collectHeaders(ids: number[], strings: string[]): void {
+        for (const key in this._headers) {
+            const name = this._headerNames[key];
+            const id = INTERNED_HEADER_IDS.get(name) ?? 0;
+            const value = this._headers[key];
+            for (const v of Array.isArray(value) ? value : [value]) {
+                ids.push(id);
+                if (id === 0) strings.push(name);
+                strings.push(String(v));
+            }
+        }
+    }
+
+    /**
+     * Appends the headers to an HTTP/2 header list: lowercase, without the
+     * connection-specific fields HTTP/2 forbids.
+     */
+    protected _collectHttp2Headers(list: string[]): string[] {
+        for (const key in this._headers) {
+            if (HTTP2_DROPPED_HEADERS.has(key)) continue;
+            const value = this._headers[key];
+            for (const v of Array.isArray(value) ? value : [value]) {
+                if (key === 'te' && String(v).toLowerCase() !== 'trailers') continue;
+                list.push(key, String(v));
+            }
+        }
+        return list;
+    }
 
-        // Check for Chunked Encoding
+    // Picks the body framing right before the head goes out
+    protected _prepareHeaders() {
         if (!this.hasHeader('Content-Length') && this._hasBody) {
             this.setHeader('Transfer-Encoding', 'chunked');
             this.chunkedEncoding = true;
         }
+    }
+
+    protected _sendHeaders(firstLine: string) {
+        if (this.headersSent) return;
 
+        this._prepareHeaders();
         this.headersSent = true;
         const headerStr = this._renderHeaders(firstLine);
         debugLog(`OutgoingMessage._sendHeaders: writing ${headerStr.length} bytes to socket (socket=${!!this.socket})`);
-        this.socket!.write(Buffer.from(headerStr));
+        // Cork until the next tick so the headers and the first body chunk go
+        // out as a single gather write.
+        const socket = this.socket!;
+        socket.cork();
+        socket.write(Buffer.from(headerStr));
+        process.nextTick(() => socket.uncork());
     }
 
     _write(chunk: any, encoding: string, callback: (error?: Error | null) => void) {
+        if (this._http2Stream) {
+            // Framed and flow-controlled natively. Bytes for a stream that was
+            // reset are dropped; its message reports the reset.
+            const buffer: Buffer = typeof chunk === 'string' ? Buffer.from(chunk, encoding as any) : chunk;
+            if (this._http2Stream.closed) callback();
+            else this._http2Stream.write(buffer, () => callback());
+            return;
+        }
         if (!this.socket) {
             callback(new Error('Socket not assigned'));
             return;
         }
 
         if (this.chunkedEncoding) {
-            const len = typeof chunk === 'string' ? Buffer.byteLength(chunk, encoding as any) : chunk.length;
-            const header = len.toString(16) + '\r\n';
-            this.socket.write(Buffer.from(header));
-            // Note: We don't return the backpressure status here because we are doing multiple writes
+            const buffer: Buffer = typeof chunk === 'string' ? Buffer.from(chunk, encoding as any) : chunk;
+            // Native framing: size line, data and CRLF in a single call
+            if (this.socket._writeDirect((driver) => getSerializer().writeChunk(driver, buffer.buffer as ArrayBuffer, buffer.byteOffset, buffer.byteLength), callback)) {
+                return;
+            }
+            const header = buffer.length.toString(16) + '\r\n';
+            // Frame the chunk as one corked gather write: size line, data, CRLF.
             // The final write determines the callback.
-            this.socket.write(chunk, encoding as any, (err) => {
-                if (err) return callback(err);
-                this.socket!.write(Buffer.from('\r\n'), undefined, callback);
-            });
+            const socket = this.socket;
+            socket.cork();
+            socket.write(Buffer.from(header));
+            socket.write(buffer);
+            socket.write(Buffer.from('\r\n'), undefined, callback);
+            socket.uncork();
         } else {
             this.socket.write(chunk, encoding as any, callback);
         }
@@ -258,6 +598,7 @@ export class OutgoingMessage extends Writable {
 
     public write(chunk: any, encoding?: any, callback?: any): boolean {
         const ret = super.write(chunk, encoding, callback);
+        if (this._http2Stream) return ret;
         // If writableLength is too high, return false
         // But since we are proxying to socket, we should also check socket backpressure
         if (this.socket && (this.socket as any)._writableState) {
@@ -269,7 +610,18 @@ export class OutgoingMessage extends Writable {
 
     // _final is called by the stream when all writes are complete before 'finish' event
     _final(callback: (error?: Error | null) => void) {
+        if (this._http2Stream) {
+            const trailers = this._trailers
+                ? Object.entries(this._trailers).flatMap(([key, value]) => [key.toLowerCase(), String(value)])
+                : undefined;
+            this._http2Stream.end(trailers, () => callback());
+            return;
+        }
         if (this.chunkedEncoding && this.socket) {
+            const trailers = this._trailers ? Object.entries(this._trailers).flat() : undefined;
+            if (this.socket._writeDirect((driver) => getSerializer().writeLastChunk(driver, trailers), callback)) {
+                return;
+            }
             let terminator = '0\r\n';
             if (this._trailers) {
                 for (const [key, value] of Object.entries(this._trailers)) {
@@ -286,7 +638,7 @@ export class OutgoingMessage extends Writable {
     }
 
     public addTrailers(headers: Record<string, string>) {
-        if (this.headersSent && !this.chunkedEncoding) {
+        if (this.headersSent && !this.chunkedEncoding && !this._http2Stream) {
             throw new Error('Trailers can only be used with chunked encoding');
         }
         this._trailers = headers;
@@ -342,12 +694,54 @@ export class ServerResponse extends OutgoingMessage {
 
     private _sendResponseHeaders() {
         if (this.headersSent) return;
+        if (this._http2Stream) {
+            this._sendHttp2Head(false);
+            return;
+        }
         const firstLine = `HTTP/1.1 ${this.statusCode} ${this.statusMessage || STATUS_CODES[this.statusCode] || 'OK'}`;
         this._sendHeaders(firstLine);
     }
 
+    /**
+     * Serializes the head, plus `body` if given, natively and writes it in a
+     * single call. Returns false if the socket has writes queued, in which
+     * case the JS path keeps them in order.
+     */
+    private _writeResponseHead(body?: Buffer, callback?: (error?: Error | null) => void): boolean {
+        if (this.headersSent) return false;
+        if (this._http2Stream) {
+            // A body goes out as DATA after the head; without one, the head
+            // can end the stream unless trailers follow.
+            if (body) return false;
+            this._sendHttp2Head(!this._trailers);
+            return true;
+        }
+        this._prepareHeaders();
+        const ids: number[] = [];
+        const strings: string[] = [];
+        this._collectHeaders(ids, strings);
+        const statusMessage = this.statusMessage || STATUS_CODES[this.statusCode] || 'OK';
+        const written = this.socket._writeDirect((driver) => body
+            ? getSerializer().writeHead(driver, this.statusCode, statusMessage, ids, strings, this.chunkedEncoding,
+                body.buffer as ArrayBuffer, body.byteOffset, body.byteLength)
+            : getSerializer().writeHead(driver, this.statusCode, statusMessage, ids, strings, false), callback);
+        if (written) this.headersSent = true;
+        return written;
+    }
+
+    private _sendHttp2Head(endStream: boolean) {
+        this.headersSent = true;
+        const list = this._collectHttp2Headers([':status', String(this.statusCode)]);
+        this._http2Stream!.sendHeaders(list, endStream);
+    }
+
     _write(chunk: any, encoding: string, callback: (error?: Error | null) => void) {
-        if (!this.headersSent) this._sendResponseHeaders();
+        if (!this.headersSent) {
+            const buffer: Buffer = typeof chunk === 'string' ? Buffer.from(chunk, encoding as any) : chunk;
+            if (this._writeResponseHead(buffer, callback)) return;
+            this._sendResponseHeaders();
+            chunk = buffer;
+        }
         super._write(chunk, encoding, callback);
     }
 
@@ -359,13 +753,14 @@ export class ServerResponse extends OutgoingMessage {
         if (!this.headersSent) {
             // If we have a single chunk and no headers sent yet, we can add Content-Length
             // to avoid chunked encoding for simple responses.
+            // The head then goes out with the chunk in _write.
             if (chunk) {
                 const len = typeof chunk === 'string' ? Buffer.byteLength(chunk, encoding) : chunk.length;
                 this.setHeader('Content-Length', len);
             } else {
                 this.setHeader('Content-Length', 0);
+                if (!this._writeResponseHead()) this._sendResponseHeaders();
             }
-            this._sendResponseHeaders();
         }
         // super.end will trigger _write if chunk was provided.
         super.end(chunk, encoding, () => {
@@ -403,6 +798,60 @@ export interface ServerOptions {
      * If defined, sets the maximum number of requests socket can handle.
      */
     maxRequestsPerSocket?: number;
+    /**
+     * Non-standard: native admission control (see net.Server). Shed
+     * connections are answered with a 503 unless `shed` says otherwise.
+     */
+    admission?: AdmissionOptions;
+    /**
+     * Non-standard: serve HTTP/2 on connections whose ALPN chose h2, and on
+     * cleartext connections that open with the HTTP/2 preface (default true).
+     */
+    http2?: boolean;
+}
+
+/**
+ * Serves an HTTP/2 connection: every stream the client opens becomes a
+ * 'request' with its own IncomingMessage and ServerResponse. `server` is
+ * an http or https Server.
+ */
+function setupHttp2Connection(server: any, socket: Socket, head?: Buffer) {
+    debugLog(`Server: serving HTTP/2 on socket`);
+    const session = new Http2Session(socket, { client: false }, head);
+
+    session.on('stream', (stream: Http2Stream, headers: string[]) => {
+        const req = new IncomingMessage(socket);
+        const pseudo = applyHttp2Headers(req, headers);
+        req.method = pseudo[':method'];
+        req.url = pseudo[':path'];
+        if (req.headers['host'] === undefined && pseudo[':authority'] !== undefined) {
+            req.headers['host'] = pseudo[':authority'];
+        }
+        readHttp2Body(req, stream);
+        stream.on('headers', (trailers: string[]) => {
+            req.trailers = http2Trailers(trailers);
+        });
+
+        const res = new ServerResponse(socket);
+        res._http2Stream = stream;
+
+        const expect = req.headers['expect'];
+        if (typeof expect === 'string' && expect.toLowerCase() === '100-continue') {
+            if (server.listenerCount('checkContinue') > 0) {
+                server.emit('checkContinue', req, res);
+                return;
+            }
+            stream.sendHeaders([':status', '100']);
+        }
+        debugLog(`Server: Emitting 'request' for HTTP/2 ${req.method} ${req.url}`);
+        server.emit('request', req, res);
+    });
+}
+
+/** Whether `data` starts like the HTTP/2 client preface. */
+function startsWithPreface(data: Buffer): boolean {
+    const length = Math.min(data.length, CLIENT_PREFACE.length);
+    return length > 0 && data.toString('latin1', 0, length) === CLIENT_PREFACE.slice(0, length);
 }
 
 export class Server extends EventEmitter {
@@ -413,6 +862,7 @@ export class Server extends EventEmitter {
     public headersTimeout: number = 60000;
     public requestTimeout: number = 300000;
     public keepAliveTimeout: number = 5000;
+    public http2: boolean = true;
 
     constructor(options?: ServerOptions | ((req: IncomingMessage, res: ServerResponse) => void), requestListener?: (req: IncomingMessage, res: ServerResponse) => void) {
         super();
@@ -429,6 +879,8 @@ export class Server extends EventEmitter {
             if (options.headersTimeout !== undefined) this.headersTimeout = options.headersTimeout;
             if (options.maxHeaderSize !== undefined) this.maxHeaderSize = options.maxHeaderSize;
             if (options.maxRequestsPerSocket !== undefined) this.maxRequestsPerSocket = options.maxRequestsPerSocket;
+            if (options.admission) this.setAdmissionControl(options.admission);
+            if (options.http2 !== undefined) this.http2 = options.http2;
             listener = requestListener;
         }
 
@@ -440,6 +892,7 @@ export class Server extends EventEmitter {
         this._netServer.on('listening', () => this.emit('listening'));
         this._netServer.on('close', () => this.emit('close'));
         this._netServer.on('error', (err: any) => this.emit('error', err));
+        this._netServer.on('pressure', (pressure: ServerPressure) => this.emit('pressure', pressure));
 
         this._netServer.on('connection', (socket: Socket) => {
             this._setupHttpConnection(socket);
@@ -448,9 +901,19 @@ export class Server extends EventEmitter {
 
     protected _setupHttpConnection(socket: Socket) {
         this._httpConnections.add(socket);
+        // `this` may be an https.Server, which shares this setup
+        const http2 = this.http2 !== false;
+        if (http2 && (socket as any).alpnProtocol === 'h2') {
+            socket.on('close', () => this._httpConnections.delete(socket));
+            socket.on('error', (err: Error) => this.emit('error', err));
+            setupHttp2Connection(this, socket);
+            return;
+        }
+        let firstChunk = true;
         let req: IncomingMessage | null = null;
         let res: ServerResponse | null = null;
         const parser = Driver.createHttpParser(0); // 0 = Request mode
+        let acceptingUpgrades = false;
         // @ts-ignore
         let bodyBytesRead = 0;
         // @ts-ignore
@@ -466,14 +929,18 @@ export class Server extends EventEmitter {
         }
 
         const onData = (data: Buffer) => {
-            const handleParsedResult = (result: string) => {
-                if (result.startsWith('ERROR:')) {
+            if (firstChunk) {
+                firstChunk = false;
+                if (http2 && startsWithPreface(data)) {
+                    // h2c with prior knowledge (RFC 9113 3.3)
+                    socket.removeListener('data', onData);
                     if (headersTimer) clearTimeout(headersTimer);
-                    this.emit('error', new Error(result));
-                    socket.destroy();
+                    headersTimer = null;
+                    setupHttp2Connection(this, socket, data);
                     return;
                 }
-                const parsed = JSON.parse(result);
+            }
+            const handleParsedResult = (parsed: ParsedMessage) => {
 
                 if (parsed.is_headers) {
                     if (headersTimer) {
@@ -495,8 +962,7 @@ export class Server extends EventEmitter {
 
                         debugLog(`Server: CONNECT request received, emitting 'connect' event`);
 
-                        // TODO: retrieve any remaining body from parser as 'head'
-                        const head = Buffer.alloc(0);
+                        const head = parsed.head ?? Buffer.alloc(0);
 
                         if (this.listenerCount('connect') > 0) {
                             this.emit('connect', req, socket, head);
@@ -524,10 +990,16 @@ export class Server extends EventEmitter {
                         // The parser should already be reset in Rust
                     });
 
-                    const upgrade = req.headers['upgrade'];
-                    if (upgrade && this.listenerCount('upgrade') > 0) {
+                    // The parser stops at upgrade requests while acceptUpgrades is on
+                    if (parsed.upgrade) {
                         debugLog(`Server: Upgrade request received, emitting 'upgrade' event`);
-                        this.emit('upgrade', req, socket, Buffer.alloc(0));
+                        // The connection speaks another protocol from here on
+                        socket.removeListener('data', onData);
+                        if (this.listenerCount('upgrade') > 0) {
+                            this.emit('upgrade', req, socket, parsed.head ?? Buffer.alloc(0));
+                        } else {
+                            socket.destroy();
+                        }
                         return;
                     }
 
@@ -546,7 +1018,7 @@ export class Server extends EventEmitter {
                 }
 
                 if (req && parsed.body && parsed.body.length > 0) {
-                    req.push(Buffer.from(parsed.body));
+                    req.push(parsed.body);
                 }
 
                 if (req && parsed.complete) {
@@ -563,21 +1035,17 @@ export class Server extends EventEmitter {
                 }
             };
 
-            let input: ArrayBuffer = data.buffer.slice(data.byteOffset, data.byteOffset + data.byteLength);
-            let iterations = 0;
-            const maxIterations = 100; // Safety limit
-            while (iterations < maxIterations) {
-                iterations++;
-                const result = parser.feed(input);
-                if (!result || result === '' || result.startsWith('ERROR:')) {
-                    // Empty result (partial) or error - exit loop
-                    if (result && result.startsWith('ERROR:')) {
-                        console.log(`[HTTP] Server: Parser error: ${result}`);
-                    }
-                    break;
-                }
-                handleParsedResult(result);
-                input = new ArrayBuffer(0); // Continue with empty input to drain Rust buffer
+            const upgrades = this.listenerCount('upgrade') > 0;
+            if (upgrades !== acceptingUpgrades) {
+                acceptingUpgrades = upgrades;
+                parser.acceptUpgrades(upgrades);
+            }
+            // One native call parses every complete (pipelined) message in the chunk
+            const error = decodeParserBatch(parser.feedAll(toParserInput(data)), handleParsedResult);
+            if (error) {
+                // The parser stops at an error, so the connection is unusable
+                console.log(`[HTTP] Server: Parser error: ${error}`);
+                socket.destroy();
             }
         };
         socket.on('data', onData);
@@ -628,6 +1096,15 @@ export class Server extends EventEmitter {
         this._netServer.setTimeout(ms, callback);
         return this;
     }
+
+    /**
+     * Non-standard: see net.Server.setAdmissionControl. Shed connections get
+     * an HTTP 503 by default.
+     */
+    setAdmissionControl(options: AdmissionOptions | null): this {
+        this._netServer.setAdmissionControl(options ? { shed: 'http503', ...options } : null);
+        return this;
+    }
 }
 
 // ========== Agent ==========
@@ -641,6 +1118,24 @@ export interface AgentOptions {
     scheduling?: 'fifo' | 'lifo';
     timeout?: number;
     maxCachedSessions?: number;
+    /**
+     * Non-standard: HTTP/2 use. By default requests go over HTTP/2 whenever
+     * a TLS connection's ALPN chooses h2; false never uses it, and true also
+     * speaks h2c by prior knowledge on plain connections. Requests to one
+     * origin then share a single connection.
+     */
+    http2?: boolean;
+}
+
+// Default lifetime of an idle pooled socket, kept below the common 5s server
+// keep-alive timeout so requests rarely race a server-side close
+const FREE_SOCKET_TIMEOUT = 4000;
+
+interface PoolKey {
+    host: string;
+    port: number;
+    /** -1 = plain TCP, 0 = TLS with the default context */
+    secureContextId: number;
 }
 
 export class Agent extends EventEmitter {
@@ -657,6 +1152,17 @@ export class Agent extends EventEmitter {
     public freeSockets: Record<string, Socket[]> = {};
     private _totalSockets: number = 0;
     public proxy: string | null = null;
+    public timeout?: number;
+    private _pool?: ConnectionPool;
+    public http2?: boolean;
+    // HTTP/2 connections by name, requests waiting for a stream slot, names
+    // with a connection under way that may turn out to speak h2, and names
+    // whose server answered with HTTP/1.1
+    private _h2Sessions: Record<string, Http2Session[]> = {};
+    private _h2Waiting: Record<string, ClientRequest[]> = {};
+    private _h2Probing: Record<string, boolean> = {};
+    private _h2Refused: Record<string, boolean> = {};
+    private _h2Idle = new Map<Http2Session, ReturnType<typeof setTimeout>>();
 
     /**
      * Gets the proxy URL for the given request options.
@@ -704,6 +1210,165 @@ export class Agent extends EventEmitter {
         if (options?.keepAliveMsecs) this.keepAliveMsecs = options.keepAliveMsecs;
         if (options?.scheduling) this.scheduling = options.scheduling;
         if (options?.maxCachedSessions !== undefined) this.maxCachedSessions = options.maxCachedSessions;
+        if (options?.timeout !== undefined) this.timeout = options.timeout;
+        if (options?.http2 !== undefined) this.http2 = options.http2;
+    }
+
+    private _http2Enabled(options: RequestOptions): boolean {
+        return options.protocol === 'https:' ? this.http2 !== false : this.http2 === true;
+    }
+
+    /**
+     * Puts the request on an HTTP/2 connection of its origin, or holds it
+     * while one is full or may be about to open. Returns false if it takes
+     * the HTTP/1 route, opening the connection that decides.
+     */
+    private _addHttp2Request(req: ClientRequest, options: RequestOptions, name: string): boolean {
+        if (!this._http2Enabled(options) || this._h2Refused[name]) return false;
+        const sessions = this._h2Sessions[name];
+        if (sessions) {
+            for (const session of sessions) {
+                if (session.available && this._openHttp2(session, req)) return true;
+            }
+        }
+        if (sessions || this._h2Probing[name]) {
+            if (!this._h2Waiting[name]) this._h2Waiting[name] = [];
+            this._h2Waiting[name].push(req);
+            return true;
+        }
+        this._h2Probing[name] = true;
+        return false;
+    }
+
+    /**
+     * @internal Called with each freshly connected socket. If it speaks
+     * HTTP/2, `req` and any waiting requests become its streams and true is
+     * returned.
+     */
+    public _adoptHttp2(socket: Socket, req: ClientRequest, options: RequestOptions): boolean {
+        if (!this._http2Enabled(options) || (socket as any)._http2Checked) return false;
+        (socket as any)._http2Checked = true;
+        const name = this.getName(options);
+        delete this._h2Probing[name];
+        const h2 = socket instanceof TLSSocket ? socket.alpnProtocol === 'h2' : this.http2 === true;
+        if (!h2) {
+            this._h2Refused[name] = true;
+            this._releaseHttp2Waiting(name);
+            return false;
+        }
+
+        debugLog(`Agent: HTTP/2 connection for ${name}`);
+        const session = new Http2Session(socket, { client: true });
+        if (!this._h2Sessions[name]) this._h2Sessions[name] = [];
+        this._h2Sessions[name].push(session);
+        const retire = () => {
+            const sessions = this._h2Sessions[name];
+            const idx = sessions ? sessions.indexOf(session) : -1;
+            if (idx === -1) return;
+            sessions.splice(idx, 1);
+            if (sessions.length === 0) delete this._h2Sessions[name];
+            clearTimeout(this._h2Idle.get(session));
+            this._h2Idle.delete(session);
+            // Nowhere left to go: the waiting requests open a new connection
+            if (!this._h2Sessions[name]) this._releaseHttp2Waiting(name);
+        };
+        session.on('goaway', retire);
+        session.on('close', () => {
+            retire();
+            this._removeSocket(socket, name);
+        });
+        session.on('available', () => {
+            this._dispatchHttp2(name);
+            this._watchHttp2Idle(session);
+        });
+
+        const opened = this._openHttp2(session, req);
+        this._dispatchHttp2(name);
+        if (!opened) this.addRequest(req, options);
+        return true;
+    }
+
+    private _openHttp2(session: Http2Session, req: ClientRequest): boolean {
+        const timer = this._h2Idle.get(session);
+        if (timer !== undefined) {
+            clearTimeout(timer);
+            this._h2Idle.delete(session);
+        }
+        return req._onHttp2Session(session);
+    }
+
+    private _dispatchHttp2(name: string) {
+        const waiting = this._h2Waiting[name];
+        if (!waiting) return;
+        for (const session of this._h2Sessions[name] ?? []) {
+            while (waiting.length > 0 && session.available && this._openHttp2(session, waiting[0])) {
+                waiting.shift();
+            }
+        }
+        if (waiting.length === 0) delete this._h2Waiting[name];
+    }
+
+    // Waiting requests take the regular route again
+    private _releaseHttp2Waiting(name: string) {
+        const waiting = this._h2Waiting[name];
+        if (!waiting) return;
+        delete this._h2Waiting[name];
+        for (const req of waiting) req._retry();
+    }
+
+    // An idle connection closes like an idle HTTP/1 socket would: after the
+    // free-socket timeout with keepAlive, right away without.
+    private _watchHttp2Idle(session: Http2Session) {
+        if (session.streamCount > 0 || session.goingAway) return;
+        clearTimeout(this._h2Idle.get(session));
+        const idleTimeout = this.keepAlive ? (this.timeout ?? FREE_SOCKET_TIMEOUT) : 0;
+        this._h2Idle.set(session, setTimeout(() => {
+            this._h2Idle.delete(session);
+            if (session.streamCount === 0) session.close();
+        }, idleTimeout));
+    }
+
+    /**
+     * Key of the native keep-alive and prewarm pools, or undefined for
+     * connections they cannot share (custom TLS material, local address,
+     * family, IPC). Only keep-alive Agents park sockets.
+     */
+    private _poolKey(options: RequestOptions): PoolKey | undefined {
+        const tlsOptions = options as any;
+        if (options.socketPath || options.localAddress || options.family ||
+            tlsOptions.ca || tlsOptions.cert || tlsOptions.key || tlsOptions.servername ||
+            options.rejectUnauthorized === false) {
+            return undefined;
+        }
+        const isHttps = options.protocol === 'https:';
+        return {
+            host: options.hostname || options.host || 'localhost',
+            port: Number(options.port || (isHttps ? 443 : 80)),
+            secureContextId: isHttps ? 0 : -1,
+        };
+    }
+
+    /**
+     * Moves a released socket into the native pool. Returns false if it has
+     * to stay in the JS free list instead.
+     */
+    private _parkSocket(socket: Socket, options: RequestOptions): boolean {
+        const key = this._poolKey(options);
+        if (!key) return false;
+        const driver = socket._detachDriver();
+        if (!driver) return false;
+
+        this._removePoolListeners(socket);
+        this._totalSockets--;
+        if (!this._pool) this._pool = Driver.createConnectionPool();
+        const idleTimeout = this.timeout ?? FREE_SOCKET_TIMEOUT;
+        if (!this._pool.release(driver, key.host, key.port, key.secureContextId, idleTimeout,
+            this.keepAliveMsecs, this.maxFreeSockets)) {
+            // Pool full for this key
+            driver.destroy();
+            socket.destroy();
+        }
+        return true;
     }
 
     public getName(options: RequestOptions): string {
@@ -716,6 +1381,7 @@ export class Agent extends EventEmitter {
     public addRequest(req: ClientRequest, options: RequestOptions) {
         const name = this.getName(options);
         debugLog(`Agent.addRequest: name=${name}, totalSockets=${this._totalSockets}`);
+        if (this._addHttp2Request(req, options, name)) return;
 
         // 1. Check if there's an idle socket in freeSockets
         if (this.freeSockets[name] && this.freeSockets[name].length > 0) {
@@ -733,7 +1399,22 @@ export class Agent extends EventEmitter {
             return;
         }
 
-        // 2. Check if we can create a new connection
+        // 2. Check the native keep-alive pool, then connections from prewarm()
+        const key = this._poolKey(options);
+        const driver = key && (this._pool?.acquire(key.host, key.port, key.secureContextId, this.scheduling === 'lifo')
+            ?? takePrewarmed(key.host, key.port, key.secureContextId >= 0));
+        if (key && driver) {
+            const socket = key.secureContextId >= 0
+                ? new TLSSocket({ socketDriver: driver })
+                : new Socket({ socketDriver: driver });
+            if (!this.sockets[name]) this.sockets[name] = [];
+            this.sockets[name].push(socket);
+            this._totalSockets++;
+            req.onSocket(socket);
+            return;
+        }
+
+        // 3. Check if we can create a new connection
         const currentSockets = (this.sockets[name]?.length || 0);
         if (currentSockets < this.maxSockets && this._totalSockets < this.maxTotalSockets) {
             if (!this.sockets[name]) this.sockets[name] = [];
@@ -746,7 +1427,7 @@ export class Agent extends EventEmitter {
             return;
         }
 
-        // 3. Queue the request
+        // 4. Queue the request
         if (!this.requests[name]) this.requests[name] = [];
         this.requests[name].push(req);
     }
@@ -800,6 +1481,10 @@ export class Agent extends EventEmitter {
             if (called) return;
             called = true;
             debugLog(`Agent.createConnection: socket ERROR for ${name}: ${err.message}`);
+            if (this._h2Probing[name]) {
+                delete this._h2Probing[name];
+                this._releaseHttp2Waiting(name);
+            }
             this._totalSockets--;
             if (this.sockets[name]) {
                 const idx = this.sockets[name].indexOf(socket);
@@ -826,6 +1511,12 @@ export class Agent extends EventEmitter {
             if (this.sockets[name].length === 0) delete this.sockets[name];
         }
 
+        // A connection that already closed cannot carry another request
+        if (socket.readyState === 'closed') {
+            this._totalSockets--;
+            return;
+        }
+
         const onClose = () => {
             debugLog(`Agent: socket closed while in pool, removing from ${name}`);
             this._removeSocket(socket, name);
@@ -846,6 +1537,7 @@ export class Agent extends EventEmitter {
         }
 
         if (this.keepAlive && this.keepSocketAlive(socket)) {
+            if (this._parkSocket(socket, options)) return;
             // Return to free pool
             if (!this.freeSockets[name]) this.freeSockets[name] = [];
             if (this.freeSockets[name].length < this.maxFreeSockets) {
@@ -867,12 +1559,16 @@ export class Agent extends EventEmitter {
     public reuseSocket(socket: Socket, req: ClientRequest): void {
         debugLog(`Agent.reuseSocket: reusing socket for ${req.method} ${req.path}`);
         // Remove agent listeners before reusing
+        this._removePoolListeners(socket);
+        req.onSocket(socket);
+    }
+
+    private _removePoolListeners(socket: Socket) {
         if ((socket as any)._agentOnClose) {
             socket.removeListener('close', (socket as any)._agentOnClose);
             socket.removeListener('error', (socket as any)._agentOnClose);
             delete (socket as any)._agentOnClose;
         }
-        req.onSocket(socket);
     }
 
     private _removeSocket(socket: Socket, name: string) {
@@ -903,6 +1599,7 @@ export class Agent extends EventEmitter {
                 socket.destroy();
             }
         }
+        this._pool?.clear();
     }
 }
 
@@ -925,6 +1622,12 @@ export interface RequestOptions {
     agent?: Agent | boolean;
     timeout?: number;
     rejectUnauthorized?: boolean;
+    /**
+     * Non-standard: RFC 9218 priority of the request when it goes over
+     * HTTP/2 (urgency 0..7, default 3). Sent as a `priority` header and
+     * applied to the request body.
+     */
+    priority?: { urgency?: number; incremental?: boolean };
     // ...
 }
 
@@ -939,6 +1642,7 @@ export class ClientRequest extends OutgoingMessage {
     private _ended: boolean = false;
     private _expectContinue: boolean = false;
     private _continueReceived: boolean = false;
+    private _agent: Agent;
 
     constructor(options: RequestOptions, callback?: (res: IncomingMessage) => void) {
         super();
@@ -971,6 +1675,7 @@ export class ClientRequest extends OutgoingMessage {
         }
 
         const agent = options.agent === false ? new Agent() : (options.agent instanceof Agent ? options.agent : globalAgent);
+        this._agent = agent;
 
         // Use setImmediate or setTimeout for React Native compatibility
         const nextTick = typeof setImmediate !== 'undefined' ? setImmediate : (fn: () => void) => setTimeout(fn, 0);
@@ -983,6 +1688,7 @@ export class ClientRequest extends OutgoingMessage {
     /** @internal */
     public onSocket(socket: Socket | null) {
         if (socket) {
+            if (this._agent._adoptHttp2(socket, this, this._options)) return;
             this.socket = socket;
             this._connected = true;
             this.emit('socket', this.socket);
@@ -995,7 +1701,7 @@ export class ClientRequest extends OutgoingMessage {
     }
 
     private _connect() {
-        const agent = this._options.agent === false ? new Agent() : (this._options.agent instanceof Agent ? this._options.agent : globalAgent);
+        const agent = this._agent;
 
         const connectCallback = (err: Error | null, socket: Socket) => {
             if (err) {
@@ -1005,6 +1711,7 @@ export class ClientRequest extends OutgoingMessage {
             }
             debugLog(`ClientRequest._connect: Socket connected! socket=${!!socket}, socket._driver=${!!(socket as any)._driver}`);
             console.log(`[HTTP] _connect: Socket connected!`);
+            if (agent._adoptHttp2(socket, this, this._options)) return;
             this.socket = socket;
             this._connected = true;
             this.emit('socket', this.socket);
@@ -1021,93 +1728,82 @@ export class ClientRequest extends OutgoingMessage {
         if (!this.socket) return;
 
         const parser = Driver.createHttpParser(1); // 1 = Response mode
-
-        const onData = (data: Buffer) => {
-            const handleParsedResult = (result: string) => {
-                if (result.startsWith('ERROR:')) {
-                    this.emit('error', new Error(result));
-                    this.socket!.destroy();
+        const method = this.method.toUpperCase();
+        if (method === 'HEAD') parser.expectHeadResponse();
+        if (method === 'CONNECT') parser.expectConnectResponse();
+
+        const handleParsedResult = (parsed: ParsedMessage) => {
+            console.log(`[HTTP] _connect: Parser result: ${parsed.is_headers ? 'HEADERS' : 'DATA'}${parsed.complete ? ' (COMPLETE)' : ''}`);
+
+            if (parsed.is_headers) {
+                const status = parsed.status || 0;
+                if (status >= 100 && status < 200 && status !== 101) {
+                    const info = {
+                        httpVersion: '1.' + parsed.version,
+                        httpVersionMajor: 1,
+                        httpVersionMinor: parsed.version,
+                        statusCode: status,
+                        statusMessage: STATUS_CODES[status] || '',
+                        headers: parsed.headers,
+                        rawHeaders: []
+                    };
+                    if (status === 100) {
+                        this._continueReceived = true;
+                        this.emit('continue');
+                        this._flushPendingWrites();
+                    } else {
+                        this.emit('information', info);
+                    }
                     return;
                 }
-                const parsed = JSON.parse(result);
-                console.log(`[HTTP] _connect: Parser result: ${parsed.is_headers ? 'HEADERS' : 'DATA'}${parsed.complete ? ' (COMPLETE)' : ''}`);
-
-                if (parsed.is_headers) {
-                    const status = parsed.status || 0;
-                    if (status >= 100 && status < 200 && status !== 101) {
-                        const info = {
-                            httpVersion: '1.' + parsed.version,
-                            httpVersionMajor: 1,
-                            httpVersionMinor: parsed.version,
-                            statusCode: status,
-                            statusMessage: STATUS_CODES[status] || '',
-                            headers: parsed.headers,
-                            rawHeaders: []
-                        };
-                        if (status === 100) {
-                            this._continueReceived = true;
-                            this.emit('continue');
-                            this._flushPendingWrites();
-                        } else {
-                            this.emit('information', info);
-                        }
-                        return;
-                    }
-
-                    this._res = new IncomingMessage(this.socket!);
-                    this._res.statusCode = status;
-                    this._res.httpVersion = '1.' + parsed.version;
-                    this._res.headers = parsed.headers;
-
-                    if (status === 101) {
-                        debugLog(`ClientRequest: 101 Switching Protocols received, detaching parser`);
-                        this.socket!.removeListener('data', onData);
-                        this.socket!.removeListener('error', onError);
-                        this.emit('upgrade', this._res, this.socket!, Buffer.alloc(0));
-                        return;
-                    }
-
-                    // Handle CONNECT method response (HTTP Tunneling)
-                    if (this.method.toUpperCase() === 'CONNECT' && status >= 200 && status < 300) {
-                        debugLog(`ClientRequest: CONNECT tunnel established (status=${status}), emitting 'connect' event`);
-                        this.socket!.removeListener('data', onData);
-                        this.socket!.removeListener('error', onError);
-                        this.emit('connect', this._res, this.socket!, Buffer.alloc(0));
-                        return;
-                    }
 
-                    this.emit('response', this._res);
+                this._res = new IncomingMessage(this.socket!);
+                this._res.statusCode = status;
+                this._res.httpVersion = '1.' + parsed.version;
+                this._res.headers = parsed.headers;
+
+                if (status === 101) {
+                    debugLog(`ClientRequest: 101 Switching Protocols received, detaching parser`);
+                    this.socket!.removeListener('data', onData);
+                    this.socket!.removeListener('error', onError);
+                    // Frames sent right after the 101 arrive as `head`, for the WebSocket codec
+                    this.emit('upgrade', this._res, this.socket!, parsed.head ?? Buffer.alloc(0));
+                    return;
                 }
 
-                if (this._res && parsed.body && parsed.body.length > 0) {
-                    this._res.push(Buffer.from(parsed.body));
+                // Handle CONNECT method response (HTTP Tunneling)
+                if (method === 'CONNECT' && status >= 200 && status < 300) {
+                    debugLog(`ClientRequest: CONNECT tunnel established (status=${status}), emitting 'connect' event`);
+                    this.socket!.removeListener('data', onData);
+                    this.socket!.removeListener('error', onError);
+                    this.emit('connect', this._res, this.socket!, parsed.head ?? Buffer.alloc(0));
+                    return;
                 }
 
-                if (this._res && parsed.complete) {
-                    this._res.complete = true;
-                    if (parsed.trailers) {
-                        this._res.trailers = parsed.trailers;
-                    }
-                    this._res.push(null);
-                    this._finishResponse();
-                }
-            };
+                this.emit('response', this._res);
+            }
 
-            let input: ArrayBuffer = data.buffer.slice(data.byteOffset, data.byteOffset + data.byteLength);
-            let iterations = 0;
-            const maxIterations = 100; // Safety limit
-            while (iterations < maxIterations) {
-                iterations++;
-                const result = parser.feed(input);
-                if (!result || result === '' || result.startsWith('ERROR:')) {
-                    // Empty result (partial) or error - exit loop
-                    if (result && result.startsWith('ERROR:')) {
-                        console.log(`[HTTP] ClientRequest: Parser error: ${result}`);
-                    }
-                    break;
+            if (this._res && parsed.body && parsed.body.length > 0) {
+                this._res.push(parsed.body);
+            }
+
+            if (this._res && parsed.complete) {
+                this._res.complete = true;
+                if (parsed.trailers) {
+                    this._res.trailers = parsed.trailers;
                 }
-                handleParsedResult(result);
-                input = new ArrayBuffer(0); // Continue with empty input to drain Rust buffer
+                this._res.push(null);
+                this._finishResponse();
+            }
+        };
+
+        const onData = (data: Buffer) => {
+            // One native call parses every complete (pipelined) message in the chunk
+            const error = decodeParserBatch(parser.feedAll(toParserInput(data)), handleParsedResult);
+            if (error) {
+                // The parser stops at an error, so the connection is unusable
+                console.log(`[HTTP] ClientRequest: Parser error: ${error}`);
+                this.socket?.destroy(new Error(`Parse Error: ${error.slice('ERROR: '.length)}`));
             }
         };
 
@@ -1119,6 +1815,8 @@ export class ClientRequest extends OutgoingMessage {
 
         const onClose = () => {
             console.log(`[HTTP] _connect: Socket closed`);
+            // A body without Content-Length or chunked framing ends with the connection
+            decodeParserBatch(parser.finish(), handleParsedResult);
             if (this._res && !this._res.readableEnded) this._res.push(null);
             this.emit('close');
             this._cleanupSocket();
@@ -1145,12 +1843,102 @@ export class ClientRequest extends OutgoingMessage {
 
     private _finishResponse() {
         // Release socket back to agent
-        const agent = this._options.agent === false ? new Agent() : (this._options.agent instanceof Agent ? this._options.agent : globalAgent);
+        const agent = this._agent;
         const socket = this.socket;
         this._cleanupSocket();
         if (socket) agent.releaseSocket(socket, this._options);
     }
 
+    /**
+     * @internal Sends the request as a stream of `session`. Returns false
+     * if the connection has no stream to spare after all.
+     */
+    public _onHttp2Session(session: Http2Session): boolean {
+        const isHttps = this._options.protocol === 'https:';
+        const port = Number(this._options.port || (isHttps ? 443 : 80));
+        const authority = this.getHeader('host') ?? (port === (isHttps ? 443 : 80) ? this.host : `${this.host}:${port}`);
+        const list = [':method', this.method, ':scheme', isHttps ? 'https' : 'http', ':path', this.path, ':authority', String(authority)];
+        const priority = this._options.priority;
+        if (priority && !this.hasHeader('priority')) {
+            const urgency = priority.urgency ?? 3;
+            this.setHeader('priority', priority.incremental ? `u=${urgency}, i` : `u=${urgency}`);
+        }
+        this._collectHttp2Headers(list);
+        // Nothing to send after the head: it ends the stream
+        const endStream = this._ended && this._pendingWrites.length === 0 && !this._expectContinue && !this._trailers;
+        const stream = session.request(list, endStream, priority?.urgency, priority?.incremental);
+        if (!stream) return false;
+
+        debugLog(`ClientRequest: ${this.method} ${this.path} on HTTP/2 stream ${stream.id}`);
+        this._http2Stream = stream;
+        this.socket = session.socket;
+        this._connected = true;
+        this.headersSent = true;
+        stream.on('headers', (headers: string[]) => this._onHttp2Headers(stream, headers));
+        stream.on('close', (code: number, byPeer: boolean) => this._onHttp2Close(stream, code, byPeer));
+        this.emit('socket', this.socket);
+        this._flushPendingWrites();
+        return true;
+    }
+
+    private _onHttp2Headers(stream: Http2Stream, headers: string[]) {
+        if (this._res) {
+            this._res.trailers = http2Trailers(headers);
+            return;
+        }
+        const res = new IncomingMessage(this.socket!);
+        const pseudo = applyHttp2Headers(res, headers);
+        const status = Number(pseudo[':status']) || 0;
+        if (status >= 100 && status < 200) {
+            if (status === 100) {
+                this._continueReceived = true;
+                this.emit('continue');
+                this._flushPendingWrites();
+            } else {
+                this.emit('information', {
+                    httpVersion: '2.0',
+                    httpVersionMajor: 2,
+                    httpVersionMinor: 0,
+                    statusCode: status,
+                    statusMessage: STATUS_CODES[status] || '',
+                    headers: res.headers,
+                    rawHeaders: res.rawHeaders
+                });
+            }
+            return;
+        }
+        res.statusCode = status;
+        res.statusMessage = STATUS_CODES[status] || '';
+        readHttp2Body(res, stream);
+        this._res = res;
+        this.emit('response', res);
+    }
+
+    private _onHttp2Close(stream: Http2Stream, code: number, byPeer: boolean) {
+        if (this._http2Stream !== stream) return;
+        if (code === http2Constants.NGHTTP2_REFUSED_STREAM && byPeer && !this._res && stream.ended && this._pendingWrites.length === 0) {
+            // Not processed by the server (RFC 9113 8.7): safe to send again
+            debugLog(`ClientRequest: HTTP/2 stream ${stream.id} refused, retrying`);
+            this._retry();
+            return;
+        }
+        if (!this._res && code !== http2Constants.NGHTTP2_NO_ERROR && !this.aborted) {
+            this.emit('error', new Error(byPeer
+                ? `HTTP/2 stream reset by server (code ${code})`
+                : 'socket hang up'));
+        }
+        this.emit('close');
+    }
+
+    /** @internal Sends the request again, from the Agent's queue. */
+    public _retry() {
+        this._http2Stream = null;
+        this.headersSent = false;
+        this._connected = false;
+        this.socket = null;
+        this._agent.addRequest(this, this._options);
+    }
+
     private _flushPendingWrites() {
         if (!this.socket) return;
         if (!this.headersSent) this._sendRequest();
@@ -1171,7 +1959,7 @@ export class ClientRequest extends OutgoingMessage {
     }
 
     private _finishRequest() {
-        if (!this._ended) return;
+        if (!this._ended || this.writableEnded) return;
         super.end();
     }
 
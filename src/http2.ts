@@ -0,0 +1,375 @@
+import { EventEmitter } from 'eventemitter3'
+import { Buffer } from 'react-native-nitro-buffer'
+import { Socket, isVerbose } from './net'
+import { Http2Options, NetSocketDriver, NetSocketEvent } from './Net.nitro'
+
+export type { Http2Options }
+
+function debugLog(message: string) {
+    if (isVerbose()) {
+        const timestamp = new Date().toISOString().split('T')[1].split('Z')[0];
+        console.log(`[NET DEBUG ${timestamp}] ${message}`);
+    }
+}
+
+// Records of an HTTP2 event (see NetSocketEvent.HTTP2)
+const RECORD_HEADER_SIZE = 12;
+const KIND_ATTACHED = 0;
+const KIND_HEADERS = 1;
+const KIND_DATA = 2;
+const KIND_STREAM_CLOSE = 3;
+const KIND_GOAWAY = 4;
+const KIND_SETTINGS = 5;
+const KIND_DRAIN = 6;
+
+const FLAG_END_STREAM = 1;
+const FLAG_BY_PEER = 2;
+
+/** RST_STREAM and GOAWAY error codes (RFC 9113 section 7) */
+export const constants = {
+    NGHTTP2_NO_ERROR: 0x0,
+    NGHTTP2_PROTOCOL_ERROR: 0x1,
+    NGHTTP2_INTERNAL_ERROR: 0x2,
+    NGHTTP2_FLOW_CONTROL_ERROR: 0x3,
+    NGHTTP2_STREAM_CLOSED: 0x5,
+    NGHTTP2_REFUSED_STREAM: 0x7,
+    NGHTTP2_CANCEL: 0x8,
+    NGHTTP2_ENHANCE_YOUR_CALM: 0xb,
+} as const;
+
+/** First bytes a client sends on a connection (RFC 9113 section 3.4) */
+export const CLIENT_PREFACE = 'PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n';
+
+// Streams the peer lets us open until its SETTINGS arrive
+const DEFAULT_PEER_STREAMS = 100;
+
+type Payload = ArrayBuffer | Uint8Array;
+
+function toBytes(data: Payload): Uint8Array {
+    return data instanceof Uint8Array ? data : new Uint8Array(data);
+}
+
+/** Splits a HEADERS payload ("name\0value\0" pairs) into a flat list. */
+function decodeHeaderList(payload: Uint8Array): string[] {
+    const buffer = Buffer.from(payload.buffer, payload.byteOffset, payload.byteLength);
+    const list: string[] = [];
+    let start = 0;
+    for (let i = 0; i < buffer.length; i++) {
+        if (buffer[i] !== 0) continue;
+        list.push(buffer.toString('utf8', start, i));
+        start = i + 1;
+    }
+    return list;
+}
+
+/**
+ * One request and response exchange of an Http2Session.
+ *
+ * Events: 'headers' (headers: string[], endStream: boolean) for the
+ * response head (client) or trailers, 'data' (chunk: Buffer), 'end',
+ * 'drain' once buffered body bytes went out, and 'close' (code: number,
+ * byPeer: boolean) when the stream is done. Header lists are flat:
+ * name, value, name, value..., pseudo-headers first.
+ */
+export class Http2Stream extends EventEmitter {
+    readonly id: number;
+    readonly session: Http2Session;
+    closed = false;
+    /** Our side ended the stream (END_STREAM sent or queued) */
+    ended = false;
+    private _waiting: Array<(error?: Error | null) => void> = [];
+
+    /** @internal */
+    constructor(session: Http2Session, id: number, ended: boolean) {
+        super();
+        this.session = session;
+        this.id = id;
+        this.ended = ended;
+    }
+
+    /** Sends headers (a server's response head) or trailers. */
+    sendHeaders(headers: string[], endStream: boolean = false): boolean {
+        if (this.closed || this.ended) return false;
+        this.ended = endStream;
+        return this.session._driver.sendHttp2Headers(this.id, headers, endStream);
+    }
+
+    /**
+     * Sends body bytes. `callback` runs once the engine holds less than its
+     * high-water mark for this stream, right away in the common case.
+     * Returns false if the caller should wait for 'drain'.
+     */
+    write(data: Buffer | Uint8Array | string, callback?: (error?: Error | null) => void, endStream: boolean = false): boolean {
+        if (this.closed || this.ended) {
+            callback?.(new Error('HTTP/2 stream is closed'));
+            return false;
+        }
+        const bytes = typeof data === 'string' ? Buffer.from(data, 'utf8') : data;
+        this.ended = endStream;
+        const below = this.session._driver.sendHttp2Data(this.id, endStream,
+            bytes.buffer as ArrayBuffer, bytes.byteOffset, bytes.byteLength);
+        if (below) {
+            callback?.(null);
+        } else if (callback) {
+            this._waiting.push(callback);
+        }
+        return below;
+    }
+
+    /** Ends our side, with trailers if given. */
+    end(trailers?: string[], callback?: (error?: Error | null) => void): void {
+        if (this.closed || this.ended) {
+            callback?.(null);
+            return;
+        }
+        if (trailers && trailers.length > 0) {
+            this.sendHeaders(trailers, true);
+            callback?.(null);
+        } else {
+            this.write(Buffer.alloc(0), callback, true);
+        }
+    }
+
+    /** Cancels the stream with RST_STREAM. */
+    reset(code: number = constants.NGHTTP2_CANCEL): void {
+        if (this.closed) return;
+        this.session._driver.resetHttp2Stream(this.id, code);
+        this._onClose(code, false);
+    }
+
+    /** Stops (or resumes) acknowledging received DATA, so the peer stops sending. */
+    setPaused(paused: boolean): void {
+        if (!this.closed) this.session._driver.setHttp2StreamPaused(this.id, paused);
+    }
+
+    /** @internal */
+    _onDrain() {
+        const waiting = this._waiting;
+        this._waiting = [];
+        for (const callback of waiting) callback(null);
+        this.emit('drain');
+    }
+
+    /** @internal */
+    _onClose(code: number, byPeer: boolean) {
+        if (this.closed) return;
+        this.closed = true;
+        this.session._forget(this);
+        const waiting = this._waiting;
+        this._waiting = [];
+        const error = code === constants.NGHTTP2_NO_ERROR ? null : new Error(`HTTP/2 stream closed (code ${code})`);
+        for (const callback of waiting) callback(error);
+        this.emit('close', code, byPeer);
+    }
+}
+
+/**
+ * An HTTP/2 connection over a socket whose ALPN chose h2, or that speaks
+ * h2c by prior knowledge. Framing, HPACK, flow control and prioritization
+ * run natively; JS sees finished header lists and body bytes per stream.
+ *
+ * Events: 'ready' once incoming frames are decoded, 'stream' (stream,
+ * headers, endStream) for each request a client opens (server side),
+ * 'settings' (maxConcurrentStreams) when the peer's limit arrives or
+ * changes, 'available' when a stream slot frees up, 'goaway' (code,
+ * lastStreamId, byPeer) and 'close'.
+ *
+ * @example
+ * ```ts
+ * const session = new Http2Session(tlsSocket, { client: true });
+ * const stream = session.request([':method', 'GET', ':scheme', 'https',
+ *     ':path', '/', ':authority', 'example.com'], true);
+ * stream?.on('headers', (headers) => console.log(headers));
+ * ```
+ */
+export class Http2Session extends EventEmitter {
+    readonly socket: Socket;
+    readonly client: boolean;
+    /** Streams the peer lets us open at once */
+    peerMaxConcurrentStreams = DEFAULT_PEER_STREAMS;
+    started = false;
+    /** GOAWAY sent or received: no new streams */
+    goingAway = false;
+    closed = false;
+    /** @internal */
+    readonly _driver: NetSocketDriver;
+    private readonly _streams = new Map<number, Http2Stream>();
+    private readonly _head: Uint8Array[] = [];
+    private readonly _onEvent: (eventType: number, data?: Payload) => void;
+
+    /**
+     * Takes over `socket`. `head` holds bytes read off the socket before
+     * (the start of the client preface, when a server sniffed it).
+     */
+    constructor(socket: Socket, options: Http2Options, head?: Buffer | Uint8Array) {
+        super();
+        this.socket = socket;
+        this.client = options.client;
+        this._driver = (socket as any)._driver as NetSocketDriver;
+        if (head && head.byteLength > 0) this._head.push(head);
+        // Reads already buffered by the socket come before any raw DATA
+        // event seen from here on.
+        let chunk: Buffer | null;
+        while ((chunk = socket.read()) !== null) this._head.push(chunk);
+
+        this._onEvent = (eventType: number, data?: Payload) => {
+            if (eventType === NetSocketEvent.DATA && data && !this.started) {
+                // Raw bytes already on their way when the engine attached
+                this._head.push(toBytes(data).slice());
+            } else if (eventType === NetSocketEvent.HTTP2 && data) {
+                this._onRecords(toBytes(data));
+            }
+        };
+        socket.on('event', this._onEvent);
+        socket.once('close', () => this._onSocketClose());
+        socket.on('error', (err: Error) => this.emit('error', err));
+        this._driver.attachHttp2(options);
+        // Nothing reads the socket stream any more; keep it flowing so
+        // the raw DATA left before the marker cannot stop the socket.
+        socket.resume();
+    }
+
+    /** Open streams */
+    get streamCount(): number {
+        return this._streams.size;
+    }
+
+    /** A request could be opened now */
+    get available(): boolean {
+        return this.client && !this.goingAway && !this.closed &&
+            this._streams.size < this.peerMaxConcurrentStreams;
+    }
+
+    /**
+     * Opens a client stream. `urgency` (0..7, default 3) and `incremental`
+     * are its RFC 9218 priority. Returns null while no stream can be opened
+     * (see `available`).
+     */
+    request(headers: string[], endStream: boolean, urgency?: number, incremental?: boolean): Http2Stream | null {
+        if (!this.available) return null;
+        const id = this._driver.openHttp2Stream(headers, endStream, urgency, incremental);
+        if (id === 0) return null;
+        const stream = new Http2Stream(this, id, endStream);
+        this._streams.set(id, stream);
+        return stream;
+    }
+
+    /** Sends GOAWAY; open streams still finish, then the socket ends. */
+    close(code: number = constants.NGHTTP2_NO_ERROR): void {
+        if (this.closed) return;
+        if (!this.goingAway) {
+            this.goingAway = true;
+            this._driver.closeHttp2(code);
+        }
+        this._endIfIdle();
+    }
+
+    /** Drops the connection and every open stream. */
+    destroy(): void {
+        this.socket.destroy();
+    }
+
+    /** @internal */
+    _forget(stream: Http2Stream) {
+        if (this._streams.get(stream.id) !== stream) return;
+        this._streams.delete(stream.id);
+        if (this.goingAway) {
+            this._endIfIdle();
+        } else if (this.client) {
+            this.emit('available');
+        }
+    }
+
+    private _endIfIdle() {
+        if (this.goingAway && this._streams.size === 0 && !this.closed) this.socket.end();
+    }
+
+    private _onRecords(event: Uint8Array) {
+        const view = new DataView(event.buffer, event.byteOffset, event.byteLength);
+        let at = 0;
+        while (at + RECORD_HEADER_SIZE <= event.byteLength) {
+            const kind = view.getUint8(at);
+            const flags = view.getUint8(at + 1);
+            const id = view.getUint32(at + 4, true);
+            const length = view.getUint32(at + 8, true);
+            const start = at + RECORD_HEADER_SIZE;
+            const payload = event.subarray(start, start + length);
+            at = start + length;
+            this._onRecord(kind, flags, id, payload, view, start);
+        }
+    }
+
+    private _onRecord(kind: number, flags: number, id: number, payload: Uint8Array, view: DataView, start: number) {
+        const endStream = (flags & FLAG_END_STREAM) !== 0;
+        switch (kind) {
+            case KIND_ATTACHED: {
+                const head = this._head.length > 0 ? Buffer.concat(this._head) : undefined;
+                this._head.length = 0;
+                this.started = true;
+                this._driver.startHttp2(head
+                    ? (head.buffer as ArrayBuffer).slice(head.byteOffset, head.byteOffset + head.byteLength)
+                    : undefined);
+                this.emit('ready');
+                return;
+            }
+            case KIND_HEADERS: {
+                const headers = decodeHeaderList(payload);
+                let stream = this._streams.get(id);
+                if (!stream && !this.client) {
+                    stream = new Http2Stream(this, id, false);
+                    this._streams.set(id, stream);
+                    this.emit('stream', stream, headers, endStream);
+                } else {
+                    stream?.emit('headers', headers, endStream);
+                }
+                if (endStream) stream?.emit('end');
+                return;
+            }
+            case KIND_DATA: {
+                const stream = this._streams.get(id);
+                if (!stream) return;
+                if (payload.byteLength > 0) {
+                    stream.emit('data', Buffer.from(payload.buffer, payload.byteOffset, payload.byteLength));
+                }
+                if (endStream) stream.emit('end');
+                return;
+            }
+            case KIND_STREAM_CLOSE:
+                this._streams.get(id)?._onClose(view.getUint32(start, true), (flags & FLAG_BY_PEER) !== 0);
+                return;
+            case KIND_DRAIN:
+                this._streams.get(id)?._onDrain();
+                return;
+            case KIND_SETTINGS:
+                this.peerMaxConcurrentStreams = view.getUint32(start, true);
+                this.emit('settings', this.peerMaxConcurrentStreams);
+                if (this.available) this.emit('available');
+                return;
+            case KIND_GOAWAY: {
+                const lastStreamId = view.getUint32(start, true);
+                const code = view.getUint32(start + 4, true);
+                const byPeer = (flags & FLAG_BY_PEER) !== 0;
+                debugLog(`HTTP/2 GOAWAY (code ${code}, last stream ${lastStreamId}${byPeer ? ', from peer' : ''})`);
+                this.goingAway = true;
+                this.emit('goaway', code, lastStreamId, byPeer);
+                if (!byPeer) {
+                    // Our engine failed the connection
+                    this.socket.end();
+                } else {
+                    this._endIfIdle();
+                }
+                return;
+            }
+        }
+    }
+
+    private _onSocketClose() {
+        this.socket.off('event', this._onEvent);
+        this.goingAway = true;
+        this.closed = true;
+        for (const stream of Array.from(this._streams.values())) {
+            stream._onClose(constants.NGHTTP2_CANCEL, false);
+        }
+        this.emit('close');
+    }
+}
@@ -11,6 +11,8 @@ export class Server extends tls.Server {
     public headersTimeout: number = 60000;
     public requestTimeout: number = 300000;
     public keepAliveTimeout: number = 5000;
+    /** Non-standard: see http.ServerOptions.http2 */
+    public http2: boolean = true;
 
     constructor(options?: any, requestListener?: (req: http.IncomingMessage, res: http.ServerResponse) => void) {
         if (typeof options === 'function') {
@@ -18,6 +20,10 @@ export class Server extends tls.Server {
             options = {};
         }
         super(options);
+        if (options?.admission) {
+            this.setAdmissionControl({ shed: 'http503', ...options.admission });
+        }
+        if (options?.http2 !== undefined) this.http2 = options.http2;
 
         if (requestListener) {
             this.on('request', requestListener);
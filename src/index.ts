@@ -2,12 +2,16 @@ import * as net from './net'
 import * as tls from './tls'
 import * as http from './http'
 import * as https from './https'
+import * as websocket from './websocket'
+import * as http2 from './http2'
 
 export * from './net'
 export {
     tls,
     http,
-    https
+    https,
+    http2,
+    websocket
 }
 
 export default {
@@ -15,4 +19,6 @@ export default {
     tls,
     http,
     https,
+    http2,
+    websocket,
 };
@@ -1,7 +1,7 @@
 import { Duplex, DuplexOptions } from 'readable-stream'
 import { EventEmitter } from 'eventemitter3'
 import { Driver } from './Driver'
-import type { NetSocketDriver, NetServerDriver, NetConfig } from './Net.nitro'
+import type { NetSocketDriver, NetServerDriver, NetConfig, BufferPoolStats, DnsCacheStats, NetRuntimeStats, SocketStats, ServerStats, LatencyStats, PipeOptions, PipeStats, ReadCoalescingOptions, LaneOptions } from './Net.nitro'
 import { NetSocketEvent, NetServerEvent } from './Net.nitro'
 import { Buffer } from 'react-native-nitro-buffer'
 
@@ -30,6 +30,7 @@ function isIPv6(input: string): boolean {
 // -----------------------------------------------------------------------------
 
 let _autoSelectFamilyDefault = 4; // Node default is usually 4/6 independent, but we mock it.
+let _autoSelectFamilyAttemptTimeoutDefault: number | undefined; // undefined = NetConfig.connectionAttemptDelay
 let _isVerbose = false;
 let _isInitialized = false;
 
@@ -57,6 +58,18 @@ function setDefaultAutoSelectFamily(family: number): void {
     _autoSelectFamilyDefault = family;
 }
 
+/**
+ * Delay in ms before the next address is tried while a connection attempt is pending.
+ */
+function getDefaultAutoSelectFamilyAttemptTimeout(): number {
+    return _autoSelectFamilyAttemptTimeoutDefault ?? 250;
+}
+
+function setDefaultAutoSelectFamilyAttemptTimeout(value: number): void {
+    if (typeof value !== 'number' || !(value > 0)) throw new Error('Timeout must be a positive number');
+    _autoSelectFamilyAttemptTimeoutDefault = Math.max(value, 10);
+}
+
 /**
  * Ensures that the network module is initialized.
  * If initWithConfig hasn't been called, it will be called with default options.
@@ -67,12 +80,107 @@ function ensureInitialized(): void {
     }
 }
 
+/**
+ * Event payload as delivered by the driver: an ArrayBuffer, or for batched
+ * DATA, WEBSOCKET and HTTP2 events a view into the batch's shared backing
+ * buffer.
+ */
+type EventPayload = ArrayBuffer | Uint8Array;
+
+/** Socket events whose batched payloads are handed over as views. */
+const SOCKET_VIEW_EVENTS = [NetSocketEvent.DATA, NetSocketEvent.WEBSOCKET, NetSocketEvent.HTTP2] as const;
+
+/**
+ * Unpacks a native event batch (see `setEventBatching`) into per-event calls.
+ * `descriptors` holds (type, offset, length) Uint32 triples into `data`.
+ * Payloads of `viewTypes` events are passed as views without copying; all
+ * others get their own ArrayBuffer, exactly as in unbatched delivery.
+ */
+function dispatchEventBatch(descriptors: ArrayBuffer, data: ArrayBuffer, onEvent: (eventType: number, data: EventPayload) => void, viewTypes: readonly number[] = []): void {
+    const entries = new Uint32Array(descriptors);
+    for (let i = 0; i + 2 < entries.length; i += 3) {
+        const eventType = entries[i];
+        const offset = entries[i + 1];
+        const length = entries[i + 2];
+        onEvent(eventType, viewTypes.includes(eventType)
+            ? new Uint8Array(data, offset, length)
+            : data.slice(offset, offset + length));
+    }
+}
+
+type EventHandler = (eventType: number, data: EventPayload) => void;
+
+/** A driver's handler in the event pump, by pump key. */
+interface PumpTarget {
+    onEvent: EventHandler;
+    viewTypes: readonly number[];
+}
+
+const pumpTargets = new Map<number, PumpTarget>();
+
+// How long a parked write waits for DRAIN. Must match kDrainTimeout in
+// cpp/HybridNetSocketDriver.hpp
+const NATIVE_DRAIN_TIMEOUT_MS = 250;
+let _eventPump = false;
+
+/**
+ * Drains the event pump (see `enableEventPump`) and demultiplexes the batch.
+ * `descriptors` holds (key, type, offset, length) Uint32 entries into `data`.
+ * Events of drivers no longer registered are dropped. A throwing handler
+ * does not stop the rest of the batch; the first error is rethrown after it.
+ */
+function drainEventPump(): void {
+    const { descriptors, data } = Driver.drainEvents();
+    const entries = new Uint32Array(descriptors);
+    let failure: unknown;
+    let failed = false;
+    for (let i = 0; i + 3 < entries.length; i += 4) {
+        const target = pumpTargets.get(entries[i]);
+        if (!target) continue;
+        const eventType = entries[i + 1];
+        const offset = entries[i + 2];
+        const length = entries[i + 3];
+        try {
+            target.onEvent(eventType, target.viewTypes.includes(eventType)
+                ? new Uint8Array(data, offset, length)
+                : data.slice(offset, offset + length));
+        } catch (e) {
+            if (!failed) {
+                failed = true;
+                failure = e;
+            }
+        }
+    }
+    if (failed) throw failure;
+}
+
+/**
+ * Route the events of all sockets and servers created from now on through
+ * one runtime-wide native queue. Instead of one JS call per event (or per
+ * socket batch), the JS thread is woken once per burst and drains the events
+ * of every socket in a single call, with ERROR and CLOSE delivered after the
+ * other events of the same drain. Sockets and servers created earlier keep
+ * their own delivery. Cannot be turned off again.
+ *
+ * @example
+ * ```ts
+ * enableEventPump();
+ * const server = createServer(onConnection);
+ * ```
+ */
+function enableEventPump(): void {
+    if (_eventPump) return;
+    ensureInitialized();
+    _eventPump = true;
+    Driver.setEventPump(drainEventPump);
+}
+
 /**
  * Initialize the network module with custom configuration.
  * Must be called before any socket/server operations, or the config will be ignored.
  * 
  * @param config Configuration options
- * @param config.workerThreads Number of worker threads (0 = use CPU core count)
+ * @param config.workerThreads Number of worker threads (0 = the default, up to 2)
  * 
  * @example
  * ```ts
@@ -90,6 +198,118 @@ function initWithConfig(config: NetConfig): void {
     Driver.initWithConfig(config);
 }
 
+/**
+ * Returns counters for the native receive buffer pool (hit rate, resident bytes).
+ *
+ * @example
+ * ```ts
+ * const { hits, misses, inUseBytes, cachedBytes } = getBufferPoolStats();
+ * console.log(`hit rate: ${hits / (hits + misses)}, resident: ${inUseBytes + cachedBytes}`);
+ * ```
+ */
+function getBufferPoolStats(): BufferPoolStats {
+    return Driver.getBufferPoolStats();
+}
+
+/**
+ * Resolves `host` into the native DNS cache, so a later connect to it starts
+ * without waiting for the resolver.
+ */
+function prefetchDns(host: string): void {
+    Driver.prefetchDns(host);
+}
+
+// Prewarms started and not yet taken; skips the native lookup when zero
+let _prewarmed = 0;
+
+/**
+ * Opens a connection to `host`:`port` in the background, resolving the host
+ * and, with `tls`, completing the TLS handshake, so the first request after
+ * launch starts on a ready connection. The connection is parked natively and
+ * picked up by the next request of any keep-alive capable Agent to the same
+ * host, port and protocol; it is closed after 30s if none comes. The runtime
+ * is started if it isn't running yet.
+ *
+ * @returns Whether a connection was parked
+ *
+ * @example
+ * ```ts
+ * prewarm('api.example.com', 443, true);
+ * ```
+ */
+function prewarm(host: string, port: number, tls: boolean = false): Promise<boolean> {
+    ensureInitialized();
+    _prewarmed++;
+    return Driver.prewarm(host, port, tls).then((parked) => {
+        if (!parked) _prewarmed = Math.max(_prewarmed - 1, 0);
+        return parked;
+    });
+}
+
+/**
+ * Takes a connection parked by `prewarm`, if one is still idle.
+ * @internal
+ */
+function takePrewarmed(host: string, port: number, tls: boolean): NetSocketDriver | undefined {
+    if (_prewarmed === 0) return undefined;
+    const driver = Driver.takePrewarmed(host, port, tls);
+    if (driver) _prewarmed--;
+    return driver;
+}
+
+/**
+ * Drops every answer from the native DNS cache.
+ */
+function clearDnsCache(): void {
+    Driver.clearDnsCache();
+}
+
+/**
+ * Returns counters for the native DNS cache.
+ *
+ * @example
+ * ```ts
+ * const { hits, misses, prefetches } = getDnsCacheStats();
+ * ```
+ */
+function getDnsCacheStats(): DnsCacheStats {
+    return Driver.getDnsCacheStats();
+}
+
+/**
+ * Returns process-wide native counters (bytes, events, open sockets, queue
+ * depths) and latency histograms (event dispatch, connect, TLS handshake,
+ * DNS), in milliseconds.
+ *
+ * @example
+ * ```ts
+ * const { dispatchLatency, handshakeTime } = getRuntimeStats();
+ * console.log(dispatchLatency.p99, handshakeTime.p50);
+ * ```
+ */
+function getRuntimeStats(): NetRuntimeStats {
+    return Driver.getRuntimeStats();
+}
+
+/**
+ * Sets thread priority and CPU affinity (Android) of an executor lane.
+ * Sockets and servers created with the `lane` option run their native
+ * timers on that lane's own thread instead of the shared one, so a
+ * latency-critical socket doesn't wait behind bulk transfers. A lane exists
+ * once configured here (at most 8); sockets naming any other lane use the
+ * default one. The 'default' lane's settings also apply to the core's
+ * worker threads.
+ *
+ * @example
+ * ```ts
+ * configureLane('control', { priority: -10 });
+ * const socket = new Socket({ lane: 'control' });
+ * ```
+ */
+function configureLane(name: string, options: LaneOptions): void {
+    Driver.configureLane(name, options);
+}
+
 // -----------------------------------------------------------------------------
 // SocketAddress
 
@@ -275,6 +495,18 @@ export interface SocketOptions extends DuplexOptions {
     // Extension for internal use
     socketDriver?: NetSocketDriver;
     remoteFamily?: string;
+    /**
+     * Deliver native events in batches (see `Socket.setEventBatching`).
+     * `true` uses the default interval; a number sets it in microseconds.
+     */
+    eventBatching?: boolean | number;
+    /**
+     * Merge small reads into larger 'data' chunks (see
+     * `Socket.setReadCoalescing`). `true` uses the adaptive defaults.
+     */
+    readCoalescing?: boolean | ReadCoalescingOptions;
+    /** Executor lane of the native socket (see `configureLane`) */
+    lane?: string;
 }
 
 export class Socket extends Duplex {
@@ -291,7 +523,16 @@ export class Socket extends Duplex {
     public bytesWritten: number = 0;
     public autoSelectFamilyAttemptedAddresses: string[] = [];
     private _autoSelectFamily: boolean = false;
+    private _autoSelectFamilyAttemptTimeout?: number;
+    private _lookupEmitted: boolean = false;
     private _timeout: number = 0;
+    // Native backpressure: a write parked until DRAIN, or NATIVE_DRAIN_TIMEOUT_MS
+    private _pendingWriteCallback: ((error?: Error | null) => void) | undefined;
+    private _pendingWriteTimer: ReturnType<typeof setTimeout> | undefined;
+    // Native pipe set up by pipeNative; `head` holds reads that raced the switch
+    private _nativePipe: { destination: Socket, head: Buffer[], started: boolean, onClose: () => void } | undefined;
+    // Registration in the event pump, while the driver is attached to it
+    private _pump: { key: number, target: PumpTarget } | undefined;
 
     get localFamily(): string {
         return this.localAddress && this.localAddress.includes(':') ? 'IPv6' : 'IPv4';
@@ -318,6 +559,9 @@ export class Socket extends Duplex {
             allowHalfOpen: options?.allowHalfOpen ?? false,
             readable: options?.readable ?? true,
             writable: options?.writable ?? true,
+            highWaterMark: options?.highWaterMark,
+            readableHighWaterMark: options?.readableHighWaterMark,
+            writableHighWaterMark: options?.writableHighWaterMark,
             // @ts-ignore
             autoDestroy: false
         });
@@ -335,7 +579,7 @@ export class Socket extends Duplex {
         } else {
             // New client socket
             ensureInitialized();
-            this._driver = Driver.createSocket();
+            this._driver = Driver.createSocket(undefined, options?.lane);
             this._setupEvents();
             // Enable noDelay by default to match Node.js and reduce latency for small writes
             this._driver.setNoDelay(true);
@@ -343,6 +587,14 @@ export class Socket extends Duplex {
             // resume() will be called after 'connect' event in _connect()
         }
 
+        if (options?.eventBatching) {
+            const interval = typeof options.eventBatching === 'number' ? options.eventBatching : undefined;
+            this.setEventBatching(true, interval);
+        }
+        if (options?.readCoalescing) {
+            this.setReadCoalescing(true, typeof options.readCoalescing === 'object' ? options.readCoalescing : undefined);
+        }
+
         this.on('finish', () => {
             // Writable side finished
         });
@@ -364,7 +616,7 @@ export class Socket extends Duplex {
     private _setupEvents() {
         if (!this._driver) return;
         const id = (this._driver as any).id ?? (this._driver as any)._id;
-        this._driver.onEvent = (eventType: number, data: ArrayBuffer) => {
+        const onEvent: EventHandler = (eventType, data) => {
             this.emit('event', eventType, data);
             if (eventType === 3) { // ERROR
                 const msg = new TextDecoder().decode(data);
@@ -389,9 +641,13 @@ export class Socket extends Duplex {
                 case NetSocketEvent.DATA:
                     debugLog(`Socket onEvent(DATA), len: ${data?.byteLength}, flowing: ${(this as any).readableFlowing}`);
                     if (data && data.byteLength > 0) {
-                        const buffer = Buffer.from(data);
+                        const buffer = data instanceof Uint8Array
+                            ? Buffer.from(data.buffer, data.byteOffset, data.byteLength)
+                            : Buffer.from(data);
                         this.bytesRead += buffer.length;
-                        if (!this.push(buffer)) {
+                        if (this._nativePipe) {
+                            this._nativePipe.head.push(Buffer.from(buffer));
+                        } else if (!this.push(buffer)) {
                             this.pause();
                         }
                     }
@@ -413,6 +669,7 @@ export class Socket extends Duplex {
                         }
                     }
 
+                    this._failPendingWrite(error);
                     this.emit('error', error);
                     this.destroy();
                     break;
@@ -420,11 +677,19 @@ export class Socket extends Duplex {
                 case NetSocketEvent.CLOSE:
                     this._connected = false;
                     this.connecting = false;
+                    this._leavePump(false);
+                    this._failPendingWrite(new Error('Socket closed before the write was flushed'));
                     this.push(null); // EOF
                     this.emit('close', this._hadError);
                     break;
-                case NetSocketEvent.DRAIN:
-                    this.emit('drain');
+                case NetSocketEvent.DRAIN: {
+                    // The native queue emptied: release a write parked by _write.
+                    // The stream itself emits 'drain' once its buffer empties.
+                    this._releasePendingWrite(null);
+                    break;
+                }
+                case NetSocketEvent.PIPE:
+                    this._startNativePipe();
                     break;
                 case NetSocketEvent.TIMEOUT:
                     if (this.connecting && this._autoSelectFamily) {
@@ -457,13 +722,40 @@ export class Socket extends Duplex {
                             }
                             this.autoSelectFamilyAttemptedAddresses.push(`${ip}:${port}`);
                         }
+                        // Every raced address is reported; 'lookup' fires once.
                         const host = parts.length > 2 ? parts[2] : undefined;
-                        this.emit('lookup', null, parts[0], parts[1] ? parseInt(parts[1], 10) : undefined, host);
+                        if (!this._lookupEmitted) {
+                            this._lookupEmitted = true;
+                            this.emit('lookup', null, parts[0], parts[1] ? parseInt(parts[1], 10) : undefined, host);
+                        }
                     }
                     break;
                 }
             }
         };
+        this._driver.onEvent = onEvent;
+        this._driver.onEventBatch = (descriptors: ArrayBuffer, data: ArrayBuffer) => {
+            dispatchEventBatch(descriptors, data, onEvent, SOCKET_VIEW_EVENTS);
+        };
+        if (_eventPump) {
+            this._pump = { key: this._driver.attachEventPump(), target: { onEvent, viewTypes: SOCKET_VIEW_EVENTS } };
+            pumpTargets.set(this._pump.key, this._pump.target);
+        }
+    }
+
+    /**
+     * Stops handling pumped events. With `forget`, the driver is gone or
+     * handed on; otherwise a reconnect picks the registration up again.
+     */
+    private _leavePump(forget: boolean): void {
+        if (!this._pump) return;
+        pumpTargets.delete(this._pump.key);
+        if (forget) this._pump = undefined;
+    }
+
+    /** Handles pumped events again after a CLOSE, before reconnecting. */
+    protected _rejoinPump(): void {
+        if (this._pump) pumpTargets.set(this._pump.key, this._pump.target);
     }
 
 
@@ -513,7 +805,7 @@ export class Socket extends Duplex {
             const host = (arguments.length > 1 && typeof arguments[1] === 'string') ? arguments[1] : 'localhost';
             const cb = typeof arguments[1] === 'function' ? arguments[1] : connectionListener;
             // Default: Node 20 defaults autoSelectFamily to true
-            this._autoSelectFamily = true;
+            this._setConnectMode(undefined);
             return this._connect(port, host, cb || arguments[2]);
         }
 
@@ -524,17 +816,24 @@ export class Socket extends Duplex {
         const port = options.port;
         const host = options.host || 'localhost';
 
-        // Handle autoSelectFamily option
-        if (typeof options.autoSelectFamily === 'boolean') {
-            this._autoSelectFamily = options.autoSelectFamily;
-        } else {
-            this._autoSelectFamily = true;
-        }
+        this._setConnectMode(options);
 
         debugLog(`Socket.connect: target=${host}:${port}, autoSelectFamily=${this._autoSelectFamily}`);
         return this._connect(port, host, connectionListener, options.signal);
     }
 
+    /**
+     * Applies the autoSelectFamily options to the driver before connecting.
+     * Host names are then raced across their IPv6 and IPv4 addresses.
+     */
+    protected _setConnectMode(options: any): void {
+        this._autoSelectFamily = typeof options?.autoSelectFamily === 'boolean' ? options.autoSelectFamily : true;
+        if (typeof options?.autoSelectFamilyAttemptTimeout === 'number') {
+            this._autoSelectFamilyAttemptTimeout = Math.max(options.autoSelectFamilyAttemptTimeout, 10);
+        }
+        this._driver?.setAutoSelectFamily(this._autoSelectFamily, this._autoSelectFamilyAttemptTimeout ?? _autoSelectFamilyAttemptTimeoutDefault);
+    }
+
     private _connect(port: number, host: string, listener?: () => void, signal?: AbortSignal): this {
         this.remotePort = port; // Store intended remote port
         if (this.connecting || this._connected) return this;
@@ -543,6 +842,7 @@ export class Socket extends Duplex {
             return this;
         }
         this.connecting = true;
+        this._rejoinPump();
         if (listener) this.once('connect', listener);
 
         if (signal) {
@@ -566,6 +866,7 @@ export class Socket extends Duplex {
             return this;
         }
         this.connecting = true;
+        this._rejoinPump();
         if (listener) this.once('connect', listener);
 
         if (signal) {
@@ -596,10 +897,10 @@ export class Socket extends Duplex {
         try {
             const buffer = (chunk instanceof Buffer) ? chunk : Buffer.from(chunk, encoding as any);
             this.bytesWritten += buffer.length;
-            const ab = buffer.buffer.slice(buffer.byteOffset, buffer.byteOffset + buffer.byteLength);
-            debugLog(`Socket _write, len: ${ab.byteLength}`);
-            this._driver.write(ab);
-            callback(null);
+            debugLog(`Socket _write, len: ${buffer.byteLength}`);
+            // Pass the backing store with a window instead of slicing a copy
+            this._driver.write(buffer.buffer as ArrayBuffer, buffer.byteOffset, buffer.byteLength);
+            this._completeWrite(callback);
         } catch (err: any) {
             callback(err);
         }
@@ -609,6 +910,93 @@ export class Socket extends Duplex {
         if (this._driver) this._driver.resume();
     }
 
+    _writev(chunks: Array<{ chunk: any; encoding: string }>, callback: (error?: Error | null) => void): void {
+        if (!this._driver) {
+            return callback(new Error('Socket not connected'));
+        }
+        try {
+            const buffers: ArrayBuffer[] = [];
+            const ranges: number[] = [];
+            for (const { chunk, encoding } of chunks) {
+                const buffer = (chunk instanceof Buffer) ? chunk : Buffer.from(chunk, encoding as any);
+                this.bytesWritten += buffer.length;
+                buffers.push(buffer.buffer as ArrayBuffer);
+                ranges.push(buffer.byteOffset, buffer.byteLength);
+            }
+            debugLog(`Socket _writev, chunks: ${buffers.length}`);
+            this._driver.writev(buffers, ranges);
+            this._completeWrite(callback);
+        } catch (err: any) {
+            callback(err);
+        }
+    }
+
+    /**
+     * Completes a write, or parks its callback while the native write queue is
+     * above writableHighWaterMark, so buffered bytes stay visible in
+     * writableLength and producers see backpressure. DRAIN releases it; so
+     * does a timer, since the core may report DRAIN only after backpressure
+     * (the driver then stops counting the queue, see queuedBytes in
+     * cpp/HybridNetSocketDriver.hpp).
+     */
+    private _completeWrite(callback: (error?: Error | null) => void): void {
+        if (this._driver && this._driver.writeQueueBytes >= this.writableHighWaterMark) {
+            this._pendingWriteCallback = callback;
+            this._pendingWriteTimer = setTimeout(() => this._releasePendingWrite(null), NATIVE_DRAIN_TIMEOUT_MS);
+            return;
+        }
+        callback(null);
+    }
+
+    private _releasePendingWrite(error: Error | null): void {
+        const callback = this._pendingWriteCallback;
+        this._pendingWriteCallback = undefined;
+        if (this._pendingWriteTimer !== undefined) clearTimeout(this._pendingWriteTimer);
+        this._pendingWriteTimer = undefined;
+        callback?.(error);
+    }
+
+    // A parked write can no longer drain once the socket is gone
+    private _failPendingWrite(error: Error): void {
+        this._releasePendingWrite(error);
+    }
+
+    /**
+     * Lets a native writer (e.g. the HTTP serializer) write straight to the
+     * driver, bypassing the stream, when nothing is queued ahead of it, so the
+     * bytes cannot overtake earlier writes. `writer` returns the number of
+     * bytes it wrote. Returns false, without calling `writer`, if the caller
+     * has to go through write() instead.
+     * @internal
+     */
+    _writeDirect(writer: (driver: NetSocketDriver) => number, callback?: (error?: Error | null) => void): boolean {
+        if (!this._driver || !this._connected || this.destroyed || this.writableEnded ||
+            this.writableLength > 0 || this.writableCorked > 0 || this._pendingWriteCallback) {
+            return false;
+        }
+        this.bytesWritten += writer(this._driver);
+        if (callback) this._completeWrite(callback);
+        return true;
+    }
+
+    /**
+     * Hands the native socket to a new owner (e.g. a connection pool) if the
+     * stream holds no unread or unsent data. This Socket no longer reads or
+     * writes afterwards; it is not destroyed and emits no 'close'.
+     * @internal
+     */
+    _detachDriver(): NetSocketDriver | undefined {
+        if (!this._driver || !this._connected || this.destroyed ||
+            this.readableLength > 0 || this.writableLength > 0 || this._pendingWriteCallback) {
+            return undefined;
+        }
+        const driver = this._driver;
+        this._leavePump(true);
+        this._driver = undefined;
+        this._connected = false;
+        return driver;
+    }
+
     _final(callback: (error?: Error | null) => void): void {
         if (this._driver) {
             this._driver.shutdown();
@@ -626,6 +1014,8 @@ export class Socket extends Duplex {
         this._connected = false;
         this.connecting = false;
         this.destroyed = true;
+        this._leavePump(true);
+        this._failPendingWrite(err ?? new Error('Socket destroyed before the write was flushed'));
         if (this._driver) {
             this._driver.destroy();
             this._driver = undefined;
@@ -683,6 +1073,27 @@ export class Socket extends Duplex {
         return this;
     }
 
+    /**
+     * Non-standard: deliver native events in batches to cut per-read JSI overhead.
+     * DATA/DRAIN events are flushed at most once per `intervalMicros` (default 1000);
+     * other events flush immediately, so ordering is unchanged.
+     */
+    setEventBatching(enable: boolean, intervalMicros?: number): this {
+        this._driver?.setEventBatching(enable, intervalMicros);
+        return this;
+    }
+
+    /**
+     * Non-standard: merge small native reads into larger 'data' chunks, so
+     * bulk transfers cost fewer JS calls. By default the amount collected
+     * follows the observed throughput: sparse, interactive traffic is still
+     * delivered immediately, and nothing waits longer than `maxDelayMicros`.
+     */
+    setReadCoalescing(enable: boolean, options?: ReadCoalescingOptions): this {
+        this._driver?.setReadCoalescing(enable, options);
+        return this;
+    }
+
     ref(): this { return this; }
     unref(): this { return this; }
 
@@ -700,10 +1111,93 @@ export class Socket extends Duplex {
     }
 
     get bufferSize(): number {
-        return 0; // Deprecated but often accessed
+        // Deprecated alias of writableLength, as in Node.js
+        return this.writableLength;
+    }
+
+    /**
+     * Non-standard: native counters of this socket (bytes, events, connect
+     * timings). Undefined once the socket is destroyed.
+     */
+    getStats(): SocketStats | undefined {
+        return this._driver?.getStats();
+    }
+
+    /**
+     * Non-standard: forwards everything this socket reads to `destination`
+     * natively, without crossing into JS; a TLS socket forwards decrypted
+     * bytes. Reads pause while more than `options.highWaterMark` bytes wait
+     * in the native bridge for `destination` or were written to it since it
+     * last drained; the native writer's own queue cannot be observed. When
+     * this socket closes, the
+     * destination's writing side is shut down unless `options.end` is false;
+     * 'close' and 'error' still fire on both sockets. Data already buffered
+     * here is written first. For a proxy, pipe each socket into the other.
+     */
+    pipeNative(destination: Socket, options?: PipeOptions): Socket {
+        const dest = destination._driver;
+        if (!this._driver || !dest) {
+            throw new Error('Socket not connected');
+        }
+        this.unpipeNative();
+        const onClose = () => this.unpipeNative();
+        this._nativePipe = { destination, head: [], started: false, onClose };
+        destination.once('close', onClose);
+        this._driver.pipeTo(dest, options);
+        return destination;
+    }
+
+    /**
+     * Non-standard: stops a pipeNative; reads reach the stream again.
+     */
+    unpipeNative(): this {
+        const pipe = this._nativePipe;
+        if (!pipe) return this;
+        this._nativePipe = undefined;
+        pipe.destination.off('close', pipe.onClose);
+        for (const chunk of pipe.head) {
+            this.push(chunk);
+        }
+        this._driver?.unpipe();
+        return this;
+    }
+
+    /**
+     * Non-standard: counters of the current (or last) pipeNative.
+     */
+    getPipeStats(): PipeStats | undefined {
+        return this._driver?.getPipeStats();
+    }
+
+    // The driver has switched to piping: hand over what JS still holds, in
+    // order, then let the native side forward the rest.
+    private _startNativePipe() {
+        const pipe = this._nativePipe;
+        if (!pipe || pipe.started) return;
+        pipe.started = true;
+        const chunks: Buffer[] = [];
+        let chunk: Buffer | string | null;
+        while ((chunk = this.read()) !== null) {
+            chunks.push(typeof chunk === 'string' ? Buffer.from(chunk, 'utf8') : chunk);
+        }
+        chunks.push(...pipe.head);
+        pipe.head.length = 0;
+        const start = () => {
+            if (this._nativePipe !== pipe || !this._driver) return;
+            this._driver.startPipe();
+            // Stream backpressure no longer applies; the pipe has its own
+            this._driver.resume();
+        };
+        if (chunks.length > 0 || pipe.destination.writableLength > 0) {
+            // The callback runs once earlier writes reached the driver
+            pipe.destination.write(Buffer.concat(chunks), start);
+        } else {
+            start();
+        }
     }
 
     resetAndDestroy(): this {
+        this._leavePump(true);
         if (this._driver) {
             this._driver.resetAndDestroy();
             this._driver = undefined;
@@ -719,10 +1213,44 @@ export class Socket extends Duplex {
 // Server
 // -----------------------------------------------------------------------------
 
+/**
+ * Non-standard: native admission control for accepted connections.
+ */
+export interface AdmissionOptions {
+    /** Connections handed to JS per second; 0 = unlimited (default) */
+    acceptRate?: number;
+    /** Connections that may be handed over at once; defaults to acceptRate */
+    acceptBurst?: number;
+    /**
+     * Connections waiting for the rate limit or for JS to pick them up before
+     * new ones are shed; 0 = never shed (default)
+     */
+    maxPendingAccepts?: number;
+    /** How shed connections are turned away (default 'reset') */
+    shed?: 'reset' | 'http503';
+}
+
+/**
+ * Payload of the non-standard 'pressure' event.
+ */
+export interface ServerPressure {
+    /** 0 = normal, 1 = accepts are being rate limited, 2 = shedding */
+    level: number;
+    /** Connections waiting natively or not yet picked up by JS */
+    pending: number;
+    /** Connections shed since the server was created */
+    shed: number;
+}
+
 export class Server extends EventEmitter {
     private _driver: NetServerDriver;
     private _sockets = new Set<Socket>();
     private _connections: number = 0;
+    private _eventBatching: boolean | number = false;
+    private _readCoalescing: boolean | ReadCoalescingOptions = false;
+    private _lane: string | undefined;
+    // Registration in the event pump, while the driver is attached to it
+    private _pump: { key: number, target: PumpTarget } | undefined;
 
     private _maxConnections: number = 0;
     private _dropMaxConnection: boolean = false;
@@ -757,7 +1285,8 @@ export class Server extends EventEmitter {
     constructor(options?: any, connectionListener?: (socket: Socket) => void) {
         super();
         ensureInitialized();
-        this._driver = Driver.createServer();
+        this._lane = options?.lane;
+        this._driver = Driver.createServer(this._lane);
 
         if (typeof options === 'function') {
             connectionListener = options;
@@ -768,7 +1297,7 @@ export class Server extends EventEmitter {
             this.on('connection', connectionListener);
         }
 
-        this._driver.onEvent = (eventType: number, data: ArrayBuffer) => {
+        const onEvent: EventHandler = (eventType, data) => {
             switch (eventType) {
                 case NetServerEvent.CONNECTION: {
                     const payload = data ? Buffer.from(data).toString() : '';
@@ -804,11 +1333,13 @@ export class Server extends EventEmitter {
                                 return;
                             }
 
-                            const socketDriver = Driver.createSocket(clientId);
+                            const socketDriver = Driver.createSocket(clientId, this._lane);
                             const socket = new Socket({
                                 socketDriver: socketDriver,
                                 readable: true,
-                                writable: true
+                                writable: true,
+                                eventBatching: this._eventBatching,
+                                readCoalescing: this._readCoalescing
                             });
 
                             // Initialize addresses immediately for server-side socket
@@ -837,10 +1368,67 @@ export class Server extends EventEmitter {
                     break;
                 }
                 case NetServerEvent.CLOSE:
+                    if (this._pump) pumpTargets.delete(this._pump.key);
                     this.emit('close');
                     break;
+                case NetServerEvent.SERVER_PRESSURE: {
+                    const [level, pending, shed] = (data ? Buffer.from(data).toString() : '').split(',').map(Number);
+                    const pressure: ServerPressure = { level: level || 0, pending: pending || 0, shed: shed || 0 };
+                    this.emit('pressure', pressure);
+                    break;
+                }
             }
         };
+        this._driver.onEvent = onEvent;
+        this._driver.onEventBatch = (descriptors: ArrayBuffer, data: ArrayBuffer) => {
+            dispatchEventBatch(descriptors, data, onEvent);
+        };
+        if (_eventPump) {
+            this._pump = { key: this._driver.attachEventPump(), target: { onEvent, viewTypes: [] } };
+            pumpTargets.set(this._pump.key, this._pump.target);
+        }
+
+        if (options?.eventBatching) {
+            this._eventBatching = options.eventBatching;
+            const interval = typeof options.eventBatching === 'number' ? options.eventBatching : undefined;
+            this._driver.setEventBatching(true, interval);
+        }
+        if (options?.readCoalescing) {
+            this._readCoalescing = options.readCoalescing;
+        }
+        if (options?.admission) {
+            this.setAdmissionControl(options.admission);
+        }
+    }
+
+    /**
+     * Non-standard: shape and shed accepted connections natively, before they
+     * reach JS. Pass null to turn admission control off. Changes in pressure
+     * are reported through the 'pressure' event.
+     */
+    setAdmissionControl(options: AdmissionOptions | null): this {
+        this._driver.acceptRate = options?.acceptRate ?? 0;
+        this._driver.acceptBurst = options?.acceptBurst ?? 0;
+        this._driver.maxPendingAccepts = options?.maxPendingAccepts ?? 0;
+        this._driver.shedMode = options?.shed === 'http503' ? 1 : 0;
+        return this;
+    }
+
+    /**
+     * Non-standard: native counters of this server (accepts, sheds, events).
+     */
+    getStats(): ServerStats {
+        return this._driver.getStats();
+    }
+
+    /**
+     * Non-standard: batch native accept events, and enable batching on sockets
+     * accepted from now on (see `Socket.setEventBatching`).
+     */
+    setEventBatching(enable: boolean, intervalMicros?: number): this {
+        this._eventBatching = enable ? (intervalMicros ?? true) : false;
+        this._driver.setEventBatching(enable, intervalMicros);
+        return this;
     }
 
 
@@ -854,6 +1442,7 @@ export class Server extends EventEmitter {
         });
     }
     listen(port?: any, host?: any, backlog?: any, callback?: any): this {
+        if (this._pump) pumpTargets.set(this._pump.key, this._pump.target); // After a close
         let _port = 0;
         let _host: string | undefined;
         let _backlog: number | undefined;
@@ -862,6 +1451,7 @@ export class Server extends EventEmitter {
         let signal: AbortSignal | undefined;
         let ipv6Only = false;
         let reusePort = false;
+        let listeners: number | undefined;
         let handle: { fd?: number } | undefined;
 
         if (typeof port === 'object' && port !== null) {
@@ -878,6 +1468,7 @@ export class Server extends EventEmitter {
                 signal = port.signal;
                 ipv6Only = port.ipv6Only === true;
                 reusePort = port.reusePort === true;
+                listeners = typeof port.listeners === 'number' ? port.listeners : undefined;
                 _callback = host; // listen(options, cb)
             }
         } else {
@@ -916,7 +1507,7 @@ export class Server extends EventEmitter {
         } else if (_path) {
             this._driver.listenUnix(_path, _backlog);
         } else {
-            this._driver.listen(_port || 0, _backlog, ipv6Only, reusePort);
+            this._driver.listen(_port || 0, _backlog, ipv6Only, reusePort, listeners);
         }
 
         return this;
@@ -980,12 +1571,23 @@ export {
     isIPv6,
     getDefaultAutoSelectFamily,
     setDefaultAutoSelectFamily,
+    getDefaultAutoSelectFamilyAttemptTimeout,
+    setDefaultAutoSelectFamilyAttemptTimeout,
     isVerbose,
     setVerbose,
     initWithConfig,
+    getBufferPoolStats,
+    prefetchDns,
+    clearDnsCache,
+    getDnsCacheStats,
+    getRuntimeStats,
+    configureLane,
+    enableEventPump,
+    prewarm,
+    takePrewarmed,
 };
 
-export type { NetConfig };
+export type { NetConfig, BufferPoolStats, DnsCacheStats, NetRuntimeStats, SocketStats, ServerStats, LatencyStats, PipeOptions, PipeStats, ReadCoalescingOptions, LaneOptions };
 
 export default {
     Socket,
@@ -1000,6 +1602,16 @@ export default {
     isIPv6,
     getDefaultAutoSelectFamily,
     setDefaultAutoSelectFamily,
+    getDefaultAutoSelectFamilyAttemptTimeout,
+    setDefaultAutoSelectFamilyAttemptTimeout,
     setVerbose,
     initWithConfig,
+    getBufferPoolStats,
+    prefetchDns,
+    clearDnsCache,
+    getDnsCacheStats,
+    getRuntimeStats,
+    configureLane,
+    enableEventPump,
+    prewarm,
 };
@@ -1,6 +1,6 @@
 import { Socket, Server as NetServer, SocketOptions, isVerbose } from './net'
 import { Driver } from './Driver'
-import { NetSocketDriver } from './Net.nitro'
+import { NetSocketDriver, PeerCertificate as NativePeerCertificate, SecureContextBundle, SecureContextCacheStats, TlsSessionCacheStats } from './Net.nitro'
 
 function debugLog(message: string) {
     if (isVerbose()) {
@@ -17,6 +17,30 @@ export interface PeerCertificate {
     fingerprint: string
     fingerprint256: string
     serialNumber: string
+    subjectaltname?: string
+    raw?: Buffer
+    issuerCertificate?: PeerCertificate
+}
+
+function toPeerCertificate(native: NativePeerCertificate, withChain: boolean): PeerCertificate {
+    const cert: PeerCertificate = {
+        subject: native.subject,
+        issuer: native.issuer,
+        valid_from: native.validFrom,
+        valid_to: native.validTo,
+        fingerprint: native.fingerprint,
+        fingerprint256: native.fingerprint256,
+        serialNumber: native.serialNumber,
+    }
+    const altNames = native.subjectAltName
+    if (altNames !== undefined) cert.subjectaltname = altNames
+    const raw = native.raw
+    if (raw) cert.raw = Buffer.from(raw)
+    if (withChain) {
+        const issuer = native.issuerCertificate
+        if (issuer) cert.issuerCertificate = toPeerCertificate(issuer, true)
+    }
+    return cert
 }
 
 export interface ConnectionOptions extends SocketOptions {
@@ -48,6 +72,11 @@ export interface SecureContextOptions {
     cert?: string | string[]
     key?: string | string[]
     ca?: string | string[]
+    /**
+     * Server names whose client session tickets are cached for automatic
+     * resumption (default 64, 0 disables the cache)
+     */
+    sessionCacheSize?: number
 }
 
 export const DEFAULT_MIN_VERSION = 'TLSv1.2';
@@ -56,32 +85,63 @@ export const rootCertificates: string[] = [];
 export const DEFAULT_ECDH_CURVE = 'auto'; // Managed by rustls
 export const SLAB_BUFFER_SIZE = 10 * 1024 * 1024; // 10MB default
 
+function bundleOf(options?: SecureContextOptions): SecureContextBundle | undefined {
+    if (!options) return undefined;
+    const bundle: SecureContextBundle = {};
+    if (options.pfx) {
+        bundle.pfx = typeof options.pfx === 'string' ? Buffer.from(options.pfx).buffer : options.pfx;
+        bundle.passphrase = options.passphrase;
+    } else if (options.cert && options.key) {
+        bundle.cert = Array.isArray(options.cert) ? options.cert[0] : options.cert;
+        bundle.key = Array.isArray(options.key) ? options.key[0] : options.key;
+        bundle.passphrase = options.passphrase;
+    }
+    if (options.ca) {
+        bundle.ca = Array.isArray(options.ca) ? options.ca : [options.ca];
+    }
+    return bundle.pfx || bundle.cert || bundle.ca ? bundle : undefined;
+}
+
 export class SecureContext {
     private _id: number;
-
-    constructor(options?: SecureContextOptions) {
-        if (options && options.pfx) {
-            this._id = Driver.createEmptySecureContext();
-            const pfx = typeof options.pfx === 'string' ? Buffer.from(options.pfx).buffer : options.pfx;
-            Driver.setPFXToSecureContext(this._id, pfx, options.passphrase);
-        } else if (options && options.cert && options.key) {
-            const cert = Array.isArray(options.cert) ? options.cert[0] : options.cert;
-            const key = Array.isArray(options.key) ? options.key[0] : options.key;
-            this._id = Driver.createSecureContext(cert, key, options.passphrase);
+    private readonly _bundle?: SecureContextBundle;
+    // Handed out by the native context cache, maybe to other holders too
+    private _shared: boolean;
+
+    /** @param _native context built by `createSecureContextAsync` */
+    constructor(options?: SecureContextOptions, _native?: { id: number, shared: boolean }) {
+        this._bundle = bundleOf(options);
+        // A session cache size is per context, so such contexts stay private.
+        const cached = options?.sessionCacheSize === undefined;
+        if (_native) {
+            this._id = _native.id;
+            this._shared = _native.shared;
+        } else if (this._bundle) {
+            this._id = Driver.createSecureContextFromBundle(this._bundle, cached);
+            this._shared = cached;
         } else {
             this._id = Driver.createEmptySecureContext();
+            this._shared = false;
         }
 
-        if (options && options.ca) {
-            const cas = Array.isArray(options.ca) ? options.ca : [options.ca];
-            for (const ca of cas) {
-                Driver.addCACertToSecureContext(this._id, ca);
-            }
+        if (options && options.sessionCacheSize !== undefined) {
+            Driver.setSessionCacheSize(this._id, options.sessionCacheSize);
         }
     }
 
+    /**
+     * Counters of this context's client session cache
+     */
+    getSessionCacheStats(): TlsSessionCacheStats {
+        return Driver.getSessionCacheStats(this._id);
+    }
+
+    setSessionCacheSize(size: number): void {
+        Driver.setSessionCacheSize(this._own(), size);
+    }
+
     setOCSPResponse(ocsp: ArrayBuffer): void {
-        Driver.setOCSPResponseToSecureContext(this._id, ocsp);
+        Driver.setOCSPResponseToSecureContext(this._own(), ocsp);
     }
 
     getTicketKeys(): ArrayBuffer | undefined {
@@ -89,7 +149,7 @@ export class SecureContext {
     }
 
     setTicketKeys(keys: ArrayBuffer): void {
-        Driver.setTicketKeys(this._id, keys);
+        Driver.setTicketKeys(this._own(), keys);
     }
 
     get id(): number {
@@ -98,16 +158,93 @@ export class SecureContext {
 
     // Node.js doesn't have these on SecureContext but we might need them
     addCACert(ca: string): void {
-        Driver.addCACertToSecureContext(this._id, ca);
+        Driver.addCACertToSecureContext(this._own(), ca);
+    }
+
+    /** Adds an SNI certificate. */
+    addContext(hostname: string, cert: string, key: string, passphrase?: string): void {
+        Driver.addContextToSecureContext(this._own(), hostname, cert, key, passphrase);
+    }
+
+    /** Like `addContext`, parsing the certificate off the JS thread. */
+    addContextAsync(hostname: string, cert: string, key: string, passphrase?: string): Promise<void> {
+        return Driver.addContextToSecureContextAsync(this._own(), hostname, cert, key, passphrase);
+    }
+
+    /**
+     * Context ID safe to change: a cached context may be shared, so it is
+     * rebuilt privately first, keeping its key material.
+     */
+    private _own(): number {
+        if (this._shared) {
+            this._shared = false;
+            this._id = this._bundle
+                ? Driver.createSecureContextFromBundle(this._bundle, false)
+                : Driver.createEmptySecureContext();
+        }
+        return this._id;
     }
 }
 
+/**
+ * Creates a secure context. Identical cert/key/CA (or PFX) material shares
+ * one native context, parsed once per process.
+ */
 export function createSecureContext(options?: SecureContextOptions): SecureContext {
     return new SecureContext(options);
 }
 
+/**
+ * Like `createSecureContext`, but parses the certificates and keys on a
+ * native worker thread, so several contexts do not stall the JS thread.
+ */
+export async function createSecureContextAsync(options?: SecureContextOptions): Promise<SecureContext> {
+    const bundle = bundleOf(options);
+    if (!bundle) return new SecureContext(options);
+    const cached = options?.sessionCacheSize === undefined;
+    const id = await Driver.createSecureContextFromBundleAsync(bundle, cached);
+    return new SecureContext(options, { id, shared: cached });
+}
+
+/**
+ * Counters of the native secure context cache (`hits`, `misses`, `entries`).
+ */
+export function getSecureContextCacheStats(): SecureContextCacheStats {
+    return Driver.getSecureContextCacheStats();
+}
+
+/**
+ * Drops every cached secure context, so the next matching
+ * `createSecureContext` parses its material again.
+ */
+export function clearSecureContextCache(): void {
+    Driver.clearSecureContextCache();
+}
+
+/**
+ * Sets the client session cache size of `secureContext`, or of the default
+ * context used by connections without one. 0 disables automatic resumption.
+ */
+export function setSessionCacheSize(size: number, secureContext?: SecureContext): void {
+    if (secureContext) {
+        secureContext.setSessionCacheSize(size);
+    } else {
+        Driver.setSessionCacheSize(0, size);
+    }
+}
+
+/**
+ * Client session cache counters of `secureContext`, or of the default context.
+ */
+export function getSessionCacheStats(secureContext?: SecureContext): TlsSessionCacheStats {
+    return Driver.getSessionCacheStats(secureContext ? secureContext.id : 0);
+}
+
+export type { TlsSessionCacheStats, SecureContextCacheStats, NativePeerCertificate as PeerCertificateHandle };
+
 export class TLSSocket extends Socket {
     private _servername?: string
+    private _peerCertificate?: PeerCertificate
 
     get encrypted(): boolean {
         return true
@@ -151,16 +288,23 @@ export class TLSSocket extends Socket {
     }
 
     getPeerCertificate(detailed?: boolean): PeerCertificate | {} {
+        if (!detailed && this._peerCertificate) return this._peerCertificate
+        const native = this.getPeerCertificateHandle()
+        if (!native) return {}
+        const cert = toPeerCertificate(native, !!detailed)
+        if (!detailed) this._peerCertificate = cert
+        return cert
+    }
+
+    /**
+     * **Extension**: the native certificate object behind `getPeerCertificate`.
+     * It is read from the core once per connection and parses fields on first
+     * access, so pinning checks like `handle.fingerprint256 === pin` stay
+     * cheap when repeated.
+     */
+    getPeerCertificateHandle(): NativePeerCertificate | undefined {
         const driver = (this as any)._driver as NetSocketDriver
-        const json = driver.getPeerCertificateJSON()
-        if (json) {
-            try {
-                return JSON.parse(json) as PeerCertificate
-            } catch (e) {
-                console.error('Failed to parse peer certificate JSON', e)
-            }
-        }
-        return {}
+        return driver?.getPeerCertificate()
     }
 
     isSessionReused(): boolean {
@@ -278,6 +422,7 @@ export class TLSSocket extends Socket {
 
         if (driver) {
             this.connecting = true;
+            this._rejoinPump();
             if (connectionListener) this.once('secureConnect', connectionListener);
 
             this.once('connect', () => {
@@ -319,6 +464,10 @@ export class TLSSocket extends Socket {
                 driver.enableKeylog()
             }
 
+            if (!path) {
+                this._setConnectMode(typeof options === 'object' ? options : undefined)
+            }
+
             if (path) {
                 if (secureContextId !== undefined) {
                     debugLog(`TLSSocket.connect: Calling driver.connectUnixTLSWithContext(${path}, ${servername}, ctx=${secureContextId})`);
@@ -380,22 +529,22 @@ export function connect(...args: any[]): TLSSocket {
 }
 
 export class Server extends NetServer {
-    private _secureContextId: number = 0;
+    private _secureContext: SecureContext;
 
     constructor(options?: any, connectionListener?: (socket: Socket) => void) {
         super(options);
 
         if (options && options.secureContext) {
-            this._secureContextId = (options.secureContext as SecureContext).id;
+            this._secureContext = options.secureContext as SecureContext;
         } else if (options && (options.key || options.cert || options.ca)) {
-            this._secureContextId = createSecureContext({
+            this._secureContext = createSecureContext({
                 cert: options.cert,
                 key: options.key,
                 ca: options.ca
-            }).id;
+            });
         } else {
             // Create empty secure context to allow late configuration (addContext)
-            this._secureContextId = createSecureContext().id;
+            this._secureContext = createSecureContext();
         }
 
         this.on('connection', (socket: Socket) => {
@@ -420,20 +569,32 @@ export class Server extends NetServer {
         if (!this._secureContextId) {
             throw new Error("Cannot addContext to a non-TLS server. Provide initial cert/key in constructor.");
         }
-        Driver.addContextToSecureContext(this._secureContextId, hostname, context.cert, context.key);
+        this._secureContext.addContext(hostname, context.cert, context.key);
+    }
+
+    /**
+     * Like `addContext`, parsing the certificate off the JS thread. Await it
+     * before `listen` so the first handshakes already see the name.
+     */
+    addContextAsync(hostname: string, context: { key: string, cert: string, passphrase?: string }): Promise<void> {
+        return this._secureContext.addContextAsync(hostname, context.cert, context.key, context.passphrase);
     }
 
     setSecureContext(options: { key: string, cert: string, ca?: string | string[] }): void {
-        this._secureContextId = createSecureContext(options).id;
+        this._secureContext = createSecureContext(options);
     }
 
     getTicketKeys(): ArrayBuffer | undefined {
-        return this._secureContextId ? Driver.getTicketKeys(this._secureContextId) : undefined;
+        return this._secureContextId ? this._secureContext.getTicketKeys() : undefined;
     }
 
     setTicketKeys(keys: ArrayBuffer): void {
         if (!this._secureContextId) throw new Error("Not a TLS server");
-        Driver.setTicketKeys(this._secureContextId, keys);
+        this._secureContext.setTicketKeys(keys);
+    }
+
+    private get _secureContextId(): number {
+        return this._secureContext.id;
     }
 
     override listen(port?: any, host?: any, backlog?: any, callback?: any): this {
@@ -448,6 +609,7 @@ export class Server extends NetServer {
         let _callback: (() => void) | undefined;
         let ipv6Only = false;
         let reusePort = false;
+        let listeners: number | undefined;
         let handle: { fd?: number } | undefined;
 
         if (typeof port === 'object' && port !== null) {
@@ -462,6 +624,7 @@ export class Server extends NetServer {
                 _path = port.path;
                 ipv6Only = port.ipv6Only === true;
                 reusePort = port.reusePort === true;
+                listeners = typeof port.listeners === 'number' ? port.listeners : undefined;
                 _callback = host;
             }
         } else {
@@ -485,9 +648,9 @@ export class Server extends NetServer {
             driver.listenTLSUnix(_path, this._secureContextId, _backlog);
         } else if (handle) {
             console.warn("TLS over handles not fully implemented yet");
-            driver.listenTLS(_port || 0, this._secureContextId, _backlog, ipv6Only, reusePort);
+            driver.listenTLS(_port || 0, this._secureContextId, _backlog, ipv6Only, reusePort, listeners);
         } else {
-            driver.listenTLS(_port || 0, this._secureContextId, _backlog, ipv6Only, reusePort);
+            driver.listenTLS(_port || 0, this._secureContextId, _backlog, ipv6Only, reusePort, listeners);
         }
 
         return this;
@@ -0,0 +1,239 @@
+import { EventEmitter } from 'eventemitter3'
+import { Buffer } from 'react-native-nitro-buffer'
+import { Socket, isVerbose } from './net'
+import { NetSocketDriver, NetSocketEvent, WebSocketOptions } from './Net.nitro'
+
+export type { WebSocketOptions }
+
+function debugLog(message: string) {
+    if (isVerbose()) {
+        const timestamp = new Date().toISOString().split('T')[1].split('Z')[0];
+        console.log(`[NET DEBUG ${timestamp}] ${message}`);
+    }
+}
+
+// Kind byte leading each WEBSOCKET event payload
+const KIND_ATTACHED = 0;
+const KIND_TEXT = 1;
+const KIND_BINARY = 2;
+const KIND_CLOSE = 8;
+const KIND_PING = 9;
+const KIND_PONG = 10;
+const KIND_FAILED = 0x88;
+
+const OPCODE_TEXT = 1;
+const OPCODE_BINARY = 2;
+const OPCODE_CLOSE = 8;
+const OPCODE_PING = 9;
+const OPCODE_PONG = 10;
+
+export const CONNECTING = 0;
+export const OPEN = 1;
+export const CLOSING = 2;
+export const CLOSED = 3;
+
+type Payload = ArrayBuffer | Uint8Array;
+
+function toBytes(data: Payload): Uint8Array {
+    return data instanceof Uint8Array ? data : new Uint8Array(data);
+}
+
+function toArrayBuffer(data: string | Buffer | Uint8Array | ArrayBuffer): { buffer: ArrayBuffer, offset: number, length: number } {
+    if (data instanceof ArrayBuffer) return { buffer: data, offset: 0, length: data.byteLength };
+    const bytes = typeof data === 'string' ? Buffer.from(data, 'utf8') : data;
+    return { buffer: bytes.buffer as ArrayBuffer, offset: bytes.byteOffset, length: bytes.byteLength };
+}
+
+/**
+ * Reads the permessage-deflate parameters out of a `Sec-WebSocket-Extensions`
+ * header (the first offer, or the server's answer). Returns null when the
+ * extension is absent. Window bits are clamped to 9..15.
+ */
+export function parsePerMessageDeflate(header: string | undefined): Partial<WebSocketOptions> | null {
+    if (!header) return null;
+    for (const extension of header.split(',')) {
+        const [name, ...params] = extension.split(';').map((part) => part.trim());
+        if (name.toLowerCase() !== 'permessage-deflate') continue;
+        const options: Partial<WebSocketOptions> = { perMessageDeflate: true };
+        for (const param of params) {
+            const [key, raw] = param.split('=').map((part) => part.trim());
+            const value = raw !== undefined ? parseInt(raw.replace(/"/g, ''), 10) : NaN;
+            const bits = Number.isNaN(value) ? 15 : Math.min(15, Math.max(9, value));
+            switch (key.toLowerCase()) {
+                case 'server_no_context_takeover':
+                    options.serverNoContextTakeover = true;
+                    break;
+                case 'client_no_context_takeover':
+                    options.clientNoContextTakeover = true;
+                    break;
+                case 'server_max_window_bits':
+                    options.serverMaxWindowBits = bits;
+                    break;
+                case 'client_max_window_bits':
+                    options.clientMaxWindowBits = bits;
+                    break;
+            }
+        }
+        return options;
+    }
+    return null;
+}
+
+/**
+ * Formats negotiated permessage-deflate parameters for a
+ * `Sec-WebSocket-Extensions` response header.
+ */
+export function formatPerMessageDeflate(options: Partial<WebSocketOptions>): string {
+    const params = ['permessage-deflate'];
+    if (options.serverNoContextTakeover) params.push('server_no_context_takeover');
+    if (options.clientNoContextTakeover) params.push('client_no_context_takeover');
+    if (options.serverMaxWindowBits !== undefined && options.serverMaxWindowBits < 15) {
+        params.push(`server_max_window_bits=${options.serverMaxWindowBits}`);
+    }
+    if (options.clientMaxWindowBits !== undefined && options.clientMaxWindowBits < 15) {
+        params.push(`client_max_window_bits=${options.clientMaxWindowBits}`);
+    }
+    return params.join('; ');
+}
+
+/**
+ * A WebSocket connection over an upgraded socket. Framing, unmasking,
+ * reassembly, UTF-8 validation and permessage-deflate all run natively;
+ * JS sees one event per complete message.
+ *
+ * The handshake stays with the caller: construct this after the 101
+ * response, passing the bytes that followed it as `head`.
+ *
+ * @example
+ * ```ts
+ * server.on('upgrade', (req, socket, head) => {
+ *     socket.write(handshakeResponse(req));
+ *     const ws = new WebSocketConnection(socket, { client: false }, head);
+ *     ws.on('message', (data, isBinary) => ws.send(data));
+ * });
+ * ```
+ */
+export class WebSocketConnection extends EventEmitter {
+    readonly socket: Socket;
+    readyState: number = CONNECTING;
+    private readonly _driver: NetSocketDriver;
+    private readonly _head: Uint8Array[] = [];
+    private readonly _onEvent: (eventType: number, data?: Payload) => void;
+    private _closeSent = false;
+
+    constructor(socket: Socket, options: WebSocketOptions, head?: Buffer | Uint8Array) {
+        super();
+        this.socket = socket;
+        this._driver = (socket as any)._driver as NetSocketDriver;
+        if (head && head.byteLength > 0) this._head.push(head);
+
+        this._onEvent = (eventType: number, data?: Payload) => {
+            if (eventType === NetSocketEvent.DATA && data && this.readyState === CONNECTING) {
+                // Raw bytes already on their way when the codec attached
+                this._head.push(toBytes(data).slice());
+            } else if (eventType === NetSocketEvent.WEBSOCKET && data) {
+                this._onMessage(toBytes(data));
+            }
+        };
+        socket.on('event', this._onEvent);
+        socket.once('close', () => this._onSocketClose());
+        socket.on('error', (err: Error) => this.emit('error', err));
+        this._driver.attachWebSocket(options);
+    }
+
+    /** Sends a text (string) or binary message. Returns false once closing. */
+    send(data: string | Buffer | Uint8Array | ArrayBuffer): boolean {
+        if (this.readyState !== OPEN) return false;
+        const { buffer, offset, length } = toArrayBuffer(data);
+        const opcode = typeof data === 'string' ? OPCODE_TEXT : OPCODE_BINARY;
+        return this._driver.sendWebSocket(opcode, buffer, offset, length);
+    }
+
+    ping(data: string | Buffer | Uint8Array = ''): boolean {
+        return this._sendControl(OPCODE_PING, data);
+    }
+
+    pong(data: string | Buffer | Uint8Array = ''): boolean {
+        return this._sendControl(OPCODE_PONG, data);
+    }
+
+    /** Starts the closing handshake; 'close' fires once the peer answers. */
+    close(code: number = 1000, reason: string = ''): void {
+        if (this.readyState === CLOSING || this.readyState === CLOSED) return;
+        this.readyState = CLOSING;
+        const reasonBytes = Buffer.from(reason, 'utf8');
+        const payload = Buffer.alloc(2 + reasonBytes.length);
+        payload.writeUInt16BE(code, 0);
+        reasonBytes.copy(payload, 2);
+        this._sendControl(OPCODE_CLOSE, payload);
+        this._closeSent = true;
+    }
+
+    /** Drops the connection without a closing handshake. */
+    terminate(): void {
+        this.socket.destroy();
+    }
+
+    private _sendControl(opcode: number, data: string | Buffer | Uint8Array): boolean {
+        if (this.readyState === CONNECTING || this.readyState === CLOSED) return false;
+        const { buffer, offset, length } = toArrayBuffer(data);
+        return this._driver.sendWebSocket(opcode, buffer, offset, length);
+    }
+
+    private _onMessage(event: Uint8Array) {
+        const kind = event[0];
+        const payload = Buffer.from(event.buffer, event.byteOffset + 1, event.byteLength - 1);
+        switch (kind) {
+            case KIND_ATTACHED: {
+                const head = this._head.length > 0 ? Buffer.concat(this._head) : undefined;
+                this._head.length = 0;
+                this.readyState = OPEN;
+                this._driver.startWebSocket(head
+                    ? (head.buffer as ArrayBuffer).slice(head.byteOffset, head.byteOffset + head.byteLength)
+                    : undefined);
+                this.emit('open');
+                break;
+            }
+            case KIND_TEXT:
+                this.emit('message', payload.toString('utf8'), false);
+                break;
+            case KIND_BINARY:
+                this.emit('message', Buffer.from(payload), true);
+                break;
+            case KIND_PING:
+                this.emit('ping', Buffer.from(payload));
+                break;
+            case KIND_PONG:
+                this.emit('pong', Buffer.from(payload));
+                break;
+            case KIND_CLOSE:
+            case KIND_FAILED: {
+                const code = payload.length >= 2 ? payload.readUInt16BE(0) : 1005;
+                const reason = payload.length > 2 ? payload.toString('utf8', 2) : '';
+                if (kind === KIND_FAILED) {
+                    debugLog(`WebSocket protocol error ${code}: ${reason}`);
+                    this.emit('error', new Error(`WebSocket protocol error (${code}): ${reason}`));
+                }
+                // The codec already answered the peer's close frame, or sent
+                // its own on failure; the TCP side can go.
+                this.readyState = CLOSING;
+                this.socket.end();
+                this._finish(code, reason);
+                break;
+            }
+        }
+    }
+
+    private _onSocketClose() {
+        this.socket.off('event', this._onEvent);
+        // Closed without a close frame from the peer
+        this._finish(1006, '');
+    }
+
+    private _finish(code: number, reason: string) {
+        if (this.readyState === CLOSED) return;
+        this.readyState = CLOSED;
+        debugLog(`WebSocket closed (${code}${this._closeSent ? ', after our close' : ''})`);
+        this.emit('close', code, reason);
+    }
+}